@@ -267,6 +267,28 @@ int dmtcp_enable_ckpt(void) __attribute__((weak));
 #define dmtcp_enable_ckpt() \
   (dmtcp_enable_ckpt ? dmtcp_enable_ckpt() : DMTCP_NOT_PRESENT)
 
+/**
+ * Application-defined safe point, for the "quiesce then checkpoint" mode
+ * (dmtcp_launch --quiesce-timeout MS).  When a checkpoint is pending, the
+ * calling thread suspends itself here; the ckpt thread waits up to MS
+ * milliseconds for such threads before signalling them.  Cheap to call
+ * often: without a pending checkpoint, it is a single load.
+ * + returns 0 if no checkpoint was pending.
+ * + returns DMTCP_AFTER_CHECKPOINT or DMTCP_AFTER_RESTART if the thread was
+ *   suspended here.
+ */
+int dmtcp_safe_point(void) __attribute__((weak));
+#define dmtcp_safe_point() \
+  (dmtcp_safe_point ? dmtcp_safe_point() : DMTCP_NOT_PRESENT)
+
+/**
+ * Microseconds taken by the last checkpoint of this process to go from the
+ * checkpoint request to all user threads suspended.
+ */
+uint64_t dmtcp_get_suspend_latency(void) __attribute__((weak));
+#define dmtcp_get_suspend_latency() \
+  (dmtcp_get_suspend_latency ? dmtcp_get_suspend_latency() : 0)
+
 void dmtcp_initialize_plugin(void) __attribute((weak));
 
 /*
@@ -281,6 +303,12 @@ void dmtcp_initialize_plugin(void) __attribute((weak));
 void dmtcp_global_barrier(const char *barrier) __attribute((weak));
 void dmtcp_local_barrier(const char *barrier) __attribute((weak));
 
+/* Name-service databases whose id starts with DMTCP_CKPT_SCOPED_DB hold data
+ * for the current checkpoint only: the coordinator drops them when the next
+ * checkpoint starts.
+ */
+#define DMTCP_CKPT_SCOPED_DB "ckpt:"
+
 // See: test/plugin/example-db dir for an example:
 int dmtcp_send_key_val_pair_to_coordinator(const char *id,
                                            const void *key,
@@ -435,6 +463,14 @@ const char *dmtcp_get_executable_path();
 // True if dmtcp_launch called with --no-coordinator
 int dmtcp_no_coordinator(void);
 
+// True during (and at resume from) a checkpoint that covers only some of the
+// processes of the computation (dmtcp_command --checkpoint --only ...).
+int dmtcp_is_subset_checkpoint(void);
+
+// True during a checkpoint after which the process exits instead of resuming
+// (dmtcp_command --kcheckpoint, dmtcp_coordinator --exit-after-ckpt).
+int dmtcp_exits_after_ckpt(void);
+
 /* If your plugin invokes wrapper functions before DMTCP is initialized,
  *   then call this prior to your first wrapper function call.
  */
@@ -467,6 +503,11 @@ int dmtcp_protected_environ_fd(void);
 pid_t dmtcp_real_to_virtual_pid(pid_t realPid) __attribute((weak));
 pid_t dmtcp_virtual_to_real_pid(pid_t virtualPid) __attribute((weak));
 
+// For a process that a plugin recreates on restart (e.g., the stand-in for
+// the process of a pidfd), so that the wait() family reports virtualPid.
+void dmtcp_update_virtual_pid(pid_t virtualPid, pid_t realPid)
+  __attribute((weak));
+
 // bq_file -> "batch queue file"; used only by batch-queue plugin
 int dmtcp_is_bq_file(const char *path) __attribute((weak));
 int dmtcp_bq_should_ckpt_file(const char *path, int *type) __attribute((weak));
@@ -56,9 +56,19 @@ typedef char *VA;  /* VA = virtual address */
 
 typedef enum ProcMapsAreaProperties {
   DMTCP_ZERO_PAGE = 0x0001,
-  DMTCP_SKIP_WRITING_TEXT_SEGMENTS = 0x0002
+  DMTCP_SKIP_WRITING_TEXT_SEGMENTS = 0x0002,
+  DMTCP_CHECKSUMMED = 0x0004
 } ProcMapsAreaProperties;
 
+/* In a ckpt image, the header of a DMTCP_CHECKSUMMED area carries the CRC32C
+ * of itself (computed with 'checksum' set to 0).  Its data, if any, is
+ * written in blocks of DMTCP_CKSUM_BLOCK_SIZE bytes (the last one may be
+ * shorter), each followed by the uint32_t CRC32C of the block.
+ */
+#define DMTCP_CKSUM_BLOCK_SIZE (1024 * 1024)
+#define DMTCP_CKSUM_NUM_BLOCKS(size) \
+  (((size) + DMTCP_CKSUM_BLOCK_SIZE - 1) / DMTCP_CKSUM_BLOCK_SIZE)
+
 typedef union ProcMapsArea {
   struct {
     union {
@@ -101,6 +111,8 @@ typedef union ProcMapsArea {
     uint64_t properties;
 
     char name[FILENAMESIZE];
+
+    uint32_t checksum;
   };
   char _padding[4096];
 } ProcMapsArea;
@@ -44,6 +44,7 @@ enum ProtectedFds {
   PROTECTED_ENVIRON_FD,
   PROTECTED_NS_FD,
   PROTECTED_DEBUG_SOCKET_FD,
+  PROTECTED_CKPT_KEY_FD,
   PROTECTED_FD_END
 };
 
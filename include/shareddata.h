@@ -39,6 +39,8 @@
 #define MAX_PTRACE_ID_MAPS       256
 #define MAX_INCOMING_CONNECTIONS 10240
 #define MAX_INODE_PID_MAPS       10240
+#define MAX_SHARED_AREA_MAPS     10240
+#define MAX_MEMFD_MAPS           1024
 #define CON_ID_LEN \
   (sizeof(DmtcpUniqueProcessId) + sizeof(int64_t))
 
@@ -57,6 +59,8 @@ typedef struct CoordinatorInfo {
   uint64_t timeStamp;
   uint32_t interval;
   uint32_t addrLen;
+  uint32_t reconnectTimeout;
+  uint32_t _pad;
   struct sockaddr_storage addr;
 } CoordinatorInfo;
 
@@ -98,6 +102,27 @@ typedef struct InodeConnIdMap {
   char id[CON_ID_LEN];
 } InodeConnIdMap;
 
+// The process (and address) that writes the contents of a range of a shared
+// mapping to its ckpt image; the other processes that map the same range
+// write only its header.
+struct SharedAreaMap {
+  uint64_t devnum;
+  uint64_t inode;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t addr;
+  DmtcpUniqueProcessId owner;
+};
+
+// A memfd recreated on restart, for the object that was (devnum, inode) at
+// checkpoint time.  The other processes open it as /proc/<pid>/fd/<fd>.
+struct MemfdMap {
+  uint64_t devnum;
+  uint64_t inode;
+  pid_t pid;
+  int32_t fd;
+};
+
 struct BarrierInfo {
   uint64_t numCkptPeers;
 
@@ -140,6 +165,8 @@ struct Header {
 
   uint64_t numIncomingConMaps;
   uint64_t numInodeConnIdMaps;
+  uint64_t numSharedAreaMaps;
+  uint64_t numMemfdMaps;
 
   union {
     struct BarrierInfo barrierInfo;
@@ -155,6 +182,8 @@ struct Header {
   struct PtyNameMap ptyNameMap[MAX_PTY_NAME_MAPS];
   struct IncomingConMap incomingConMap[MAX_INCOMING_CONNECTIONS];
   InodeConnIdMap inodeConnIdMap[MAX_INODE_PID_MAPS];
+  struct SharedAreaMap sharedAreaMap[MAX_SHARED_AREA_MAPS];
+  struct MemfdMap memfdMap[MAX_MEMFD_MAPS];
 
   char versionStr[32];
   DmtcpUniqueProcessId compId;
@@ -192,6 +221,7 @@ uint32_t coordPort();
 void getCoordAddr(struct sockaddr *addr, uint32_t *len);
 void setCoordHost(struct in_addr *in);
 uint64_t getCoordTimeStamp();
+uint32_t getCoordReconnectTimeout();
 
 string getTmpDir();
 char *getTmpDir(char *buf, uint32_t len);
@@ -230,6 +260,22 @@ void getMissingConMaps(struct IncomingConMap **map, uint32_t *nmaps);
 
 void insertInodeConnIdMaps(vector<InodeConnIdMap> &maps);
 bool getCkptLeaderForFile(dev_t devnum, ino_t inode, void *id);
+
+// Returns true if the calling process, at address addr, is the first to claim
+// the range [offset, offset + size) of the shared object (devnum, inode) for
+// this checkpoint, and no range claimed before contains it.
+bool claimSharedArea(dev_t devnum, ino_t inode, off_t offset, size_t size,
+                     void *addr);
+
+// True if a claimed range contains the range, and the calling process did not
+// claim it at address addr.
+bool isSharedAreaCopy(dev_t devnum, ino_t inode, off_t offset, size_t size,
+                      void *addr);
+
+// Registers (*pid, *fd) as the memfd recreated for (devnum, inode) and returns
+// true; if one was already registered, returns false with it in *pid, *fd.
+bool insertMemfdMap(dev_t devnum, ino_t inode, pid_t *pid, int32_t *fd);
+bool getMemfdMap(dev_t devnum, ino_t inode, pid_t *pid, int32_t *fd);
 }
 }
 #endif // ifndef SHARED_DATA_H
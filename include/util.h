@@ -22,6 +22,8 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "procmapsarea.h"
 
 #ifndef EXTERNC
@@ -117,6 +119,7 @@ bool strEndsWith(const char *str, const char *pattern);
 bool isNscdArea(const ProcMapsArea &area);
 bool isSysVShmArea(const ProcMapsArea &area);
 bool isIBShmArea(const ProcMapsArea &area);
+bool isIoUringArea(const ProcMapsArea &area);
 
 ssize_t writeAll(int fd, const void *buf, size_t count);
 ssize_t readAll(int fd, void *buf, size_t count);
@@ -134,6 +137,9 @@ void setVirtualPidEnvVar(pid_t pid, pid_t virtPpid, pid_t realPpid);
 bool isScreen(const char *filename);
 void setScreenDir();
 bool isSetuid(const char *filename);
+bool untrackedHelpersEnabled();
+bool isUntrackedHelper(const char *filename);
+uint32_t untrackedHelperTimeout();
 void freePatchedArgv(void *ptr);
 void patchArgvIfSetuid(const char *filename,
                        const char *origArgv[],
@@ -143,6 +149,7 @@ int readLine(int fd, char *buf, int count);
 
 
 void writeCoordPortToFile(int port, const char *portFile);
+socklen_t coordUnixSocketAddr(int port, struct sockaddr_un *addr);
 char *calcTmpDir(const char *tmpDir);
 void initializeLogFile(const char *tmpDir,
                        const char *procname = "",
@@ -172,6 +179,21 @@ char *findExecutable(char *executable, const char *path_env, char *exec_path);
 char *getPath(const char *cmd, bool is32bit = false);
 char **getDmtcpArgs();
 void allowGdbDebug(int currentDebugLevel);
+
+// Native pids (dmtcp_restart --native-pids); see util_pidns.cpp.
+bool nativePids();
+void setNativePids(bool enable);
+pid_t forkWithPid(pid_t pid);
+pid_t cloneWithTid(int (*fn)(void *),
+                   void *childStack,
+                   int flags,
+                   void *arg,
+                   pid_t *parentTid,
+                   void *tls,
+                   pid_t *childTid,
+                   pid_t tid);
+bool setLastPid(pid_t pid);
+bool dropCapSysAdmin();
 }
 }
 #endif // ifdef __cplusplus
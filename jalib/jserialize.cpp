@@ -41,6 +41,11 @@ jalib::JBinarySerializeWriter::JBinarySerializeWriter(const dmtcp::string &path)
                                           O_CREAT | O_WRONLY | O_TRUNC, 0600))
 {}
 
+jalib::JBinarySerializeWriterMem::JBinarySerializeWriterMem(
+  const dmtcp::string &name)
+  : JBinarySerializer(name)
+{}
+
 jalib::JBinarySerializeReaderRaw::JBinarySerializeReaderRaw(
   const dmtcp::string &path, int fd)
   : JBinarySerializer(path)
@@ -69,6 +74,9 @@ jalib::JBinarySerializeWriterRaw::isReader() { return false; }
 bool
 jalib::JBinarySerializeReaderRaw::isReader() { return true; }
 
+bool
+jalib::JBinarySerializeWriterMem::isReader() { return false; }
+
 // Rewind file descriptor to start value
 void
 jalib::JBinarySerializeWriterRaw::rewind()
@@ -76,6 +84,13 @@ jalib::JBinarySerializeWriterRaw::rewind()
   JASSERT(lseek(_fd, 0, SEEK_SET) == 0)(strerror(errno)).Text("Cannot rewind");
 }
 
+void
+jalib::JBinarySerializeWriterMem::rewind()
+{
+  _buffer.clear();
+  _bytes = 0;
+}
+
 void
 jalib::JBinarySerializeReaderRaw::rewind()
 {
@@ -91,6 +106,12 @@ jalib::JBinarySerializeWriterRaw::isempty()
   return buf.st_size == 0;
 }
 
+bool
+jalib::JBinarySerializeWriterMem::isempty()
+{
+  return _buffer.empty();
+}
+
 bool
 jalib::JBinarySerializeReaderRaw::isempty()
 {
@@ -123,6 +144,13 @@ jalib::JBinarySerializeWriterRaw::readOrWrite(void *buffer, size_t len)
   _bytes += len;
 }
 
+void
+jalib::JBinarySerializeWriterMem::readOrWrite(void *buffer, size_t len)
+{
+  _buffer.append((const char *)buffer, len);
+  _bytes += len;
+}
+
 void
 jalib::JBinarySerializeReaderRaw::readOrWrite(void *buffer, size_t len)
 {
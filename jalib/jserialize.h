@@ -181,6 +181,22 @@ class JBinarySerializeWriter : public JBinarySerializeWriterRaw
     ~JBinarySerializeWriter();
 };
 
+// Accumulates the serialized data in memory, so that the caller can emit it
+// with a single write instead of one write per field.
+class JBinarySerializeWriterMem : public JBinarySerializer
+{
+  public:
+    JBinarySerializeWriterMem(const dmtcp::string &name);
+    void readOrWrite(void *buffer, size_t len);
+    bool isReader();
+    void rewind();
+    bool isempty();
+    dmtcp::string &buffer() { return _buffer; }
+
+  protected:
+    dmtcp::string _buffer;
+};
+
 class JBinarySerializeReaderRaw : public JBinarySerializer
 {
   public:
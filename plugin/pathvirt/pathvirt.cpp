@@ -757,12 +757,11 @@ extern "C" int statfs(const char *path, struct statfs *buf)
 static dmtcp::string
 resolve_symlink(const char *path)
 {
-  struct stat statBuf;
-  if (_real_lxstat(_STAT_VER, path, &statBuf) == 0
-      && S_ISLNK(statBuf.st_mode)) {
-    char buf[PATH_MAX];
-    memset(buf, 0, sizeof(buf));
-    JASSERT(_real_readlink(path, buf, sizeof(buf) - 1) != -1);
+  // readlink() fails unless path is a symbolic link.  (glibc 2.33 and later
+  // no longer define _STAT_VER for a call to __lxstat().)
+  char buf[PATH_MAX];
+  memset(buf, 0, sizeof(buf));
+  if (_real_readlink(path, buf, sizeof(buf) - 1) != -1) {
     return virtual_to_physical_path(buf);
   }
 
@@ -1,7 +1,17 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <iomanip>
 #include <string>
+#include "jassert.h"
 #include "jfilesystem.h"
 #include "config.h"
 #include "dmtcp.h"
@@ -10,6 +20,66 @@
 using namespace dmtcp;
 #define GEN_WIDTH 5
 
+// Keep in sync with src/constants.h.
+#define ENV_VAR_KEEP_GENERATIONS "DMTCP_KEEP_GENERATIONS"
+#define ENV_VAR_KEEP_BYTES       "DMTCP_KEEP_BYTES"
+#define ENV_VAR_FORKED_CKPT      "DMTCP_FORKED_CHECKPOINT"
+#define RESTART_SCRIPT_BASENAME  "dmtcp_restart_script"
+#define RESTART_MANIFEST_BASENAME "dmtcp_restart_manifest"
+
+// ".ckpt_<comp>_<gen>.reclaim" is created by the one process (per
+// filesystem) that reclaims old generations once <gen> is committed.
+// A generation being deleted is first renamed to ".ckpt_<comp>_<gen>.deleting"
+// so that restart can never pick up a partially deleted generation.
+#define RECLAIM_MARKER_SUFFIX    ".reclaim"
+#define RECLAIM_DIR_SUFFIX       ".deleting"
+
+#define MAX_GENERATIONS          4096
+#define MAX_TREE_DEPTH           8
+
+// With forked checkpointing, the images are still being written when the
+// computation resumes.  The reclaimer polls until they all exist, and gives
+// up (deleting nothing) after this long.
+#define COMMIT_POLL_SECONDS      1
+#define COMMIT_WAIT_SECONDS      (24 * 3600)
+
+// Large images are truncated in steps of this size before they are unlinked,
+// so that no single system call holds filesystem locks for long.
+#define TRUNCATE_STEP            (1ULL << 30)
+
+#ifdef SYS_newfstatat
+typedef struct stat reclaim_stat_t;
+# define SYS_reclaim_fstatat SYS_newfstatat
+#else // ifdef SYS_newfstatat
+typedef struct stat64 reclaim_stat_t;
+# define SYS_reclaim_fstatat SYS_fstatat64
+#endif // ifdef SYS_newfstatat
+
+#ifndef IOPRIO_CLASS_IDLE
+# define IOPRIO_WHO_PROCESS 1
+# define IOPRIO_CLASS_IDLE  3
+# define IOPRIO_CLASS_SHIFT 13
+#endif // ifndef IOPRIO_CLASS_IDLE
+
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+static unsigned int keepGenerations = 0;
+static uint64_t keepBytes = 0;
+static bool forkedCkpt = false;
+
+// The reclaimer runs in a process that DMTCP does not know about.  It was
+// cloned while other threads may hold locks (malloc, DMTCP wrappers), so it
+// may only issue system calls, through libc's syscall() rather than DMTCP's
+// wrapper around it.
+typedef long (*syscall_t)(long, ...);
+static syscall_t realSyscall = NULL;
+
 extern "C" int
 dmtcp_unique_ckpt_enabled(void)
 {
@@ -33,12 +103,502 @@ updateCkptDir()
   dmtcp_set_ckpt_dir(o.str().c_str());
 }
 
+// Accepts a plain byte count, or one with a K, M, G or T suffix.
+static uint64_t
+parseBytes(const char *str)
+{
+  char *end = NULL;
+  uint64_t bytes = strtoull(str, &end, 10);
+
+  switch (*end) {
+  case 'T': case 't': bytes <<= 10;
+  // Fall through
+  case 'G': case 'g': bytes <<= 10;
+  // Fall through
+  case 'M': case 'm': bytes <<= 10;
+  // Fall through
+  case 'K': case 'k': bytes <<= 10;
+  }
+  return bytes;
+}
+
+static void
+initRetention()
+{
+  const char *generations = getenv(ENV_VAR_KEEP_GENERATIONS);
+  const char *bytes = getenv(ENV_VAR_KEEP_BYTES);
+
+  if (generations != NULL) {
+    keepGenerations = atoi(generations);
+  }
+  if (bytes != NULL) {
+    keepBytes = parseBytes(bytes);
+  }
+  forkedCkpt = getenv(ENV_VAR_FORKED_CKPT) != NULL;
+  if (keepGenerations != 0 || keepBytes != 0) {
+    realSyscall = (syscall_t)NEXT_FNC_LIB("libc.so", syscall);
+    JWARNING(realSyscall != NULL)
+    .Text("libc syscall() not found; old generations will be kept.");
+  }
+}
+
+static uint64_t
+treeBytes(int dirfd, const char *name, int depth)
+{
+  reclaim_stat_t st;
+
+  if (realSyscall(SYS_reclaim_fstatat, dirfd, name, &st,
+                  AT_SYMLINK_NOFOLLOW) != 0) {
+    return 0;
+  }
+
+  uint64_t bytes = (uint64_t)st.st_blocks * 512;
+  if (S_ISDIR(st.st_mode) && depth < MAX_TREE_DEPTH) {
+    int fd = realSyscall(SYS_openat, dirfd, name,
+                         O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd >= 0) {
+      char buf[4096];
+      long n;
+      while ((n = realSyscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+        for (long off = 0; off < n;) {
+          struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+          off += d->d_reclen;
+          if (strcmp(d->d_name, ".") != 0 && strcmp(d->d_name, "..") != 0) {
+            bytes += treeBytes(fd, d->d_name, depth + 1);
+          }
+        }
+      }
+      realSyscall(SYS_close, fd);
+    }
+  }
+  return bytes;
+}
+
+static void
+removeTree(int dirfd, const char *name, int depth)
+{
+  reclaim_stat_t st;
+
+  if (realSyscall(SYS_reclaim_fstatat, dirfd, name, &st,
+                  AT_SYMLINK_NOFOLLOW) != 0) {
+    return;
+  }
+
+  if (S_ISDIR(st.st_mode)) {
+    int fd = -1;
+    if (depth < MAX_TREE_DEPTH) {
+      fd = realSyscall(SYS_openat, dirfd, name,
+                       O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    }
+    if (fd >= 0) {
+      char buf[4096];
+      long n;
+      while ((n = realSyscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+        for (long off = 0; off < n;) {
+          struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+          off += d->d_reclen;
+          if (strcmp(d->d_name, ".") != 0 && strcmp(d->d_name, "..") != 0) {
+            removeTree(fd, d->d_name, depth + 1);
+          }
+        }
+      }
+      realSyscall(SYS_close, fd);
+    }
+    realSyscall(SYS_unlinkat, dirfd, name, AT_REMOVEDIR);
+    return;
+  }
+
+#ifdef __LP64__
+  if (S_ISREG(st.st_mode) && (uint64_t)st.st_size > TRUNCATE_STEP) {
+    int fd = realSyscall(SYS_openat, dirfd, name,
+                         O_WRONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd >= 0) {
+      uint64_t len = st.st_size;
+      while (len > 0) {
+        len = len > TRUNCATE_STEP ? len - TRUNCATE_STEP : 0;
+        realSyscall(SYS_ftruncate, fd, len);
+      }
+      realSyscall(SYS_close, fd);
+    }
+  }
+#endif // ifdef __LP64__
+  realSyscall(SYS_unlinkat, dirfd, name, 0);
+}
+
+// Parses "<prefix><digits><suffix>"; returns -1 if 'name' is not of that form.
+static long
+parseGeneration(const char *name, const char *prefix, const char *suffix)
+{
+  size_t prefixLen = strlen(prefix);
+  if (strncmp(name, prefix, prefixLen) != 0) {
+    return -1;
+  }
+
+  const char *digits = name + prefixLen;
+  const char *end = digits;
+  long gen = 0;
+  while (*end >= '0' && *end <= '9' && gen < MAX_GENERATIONS * 1000L) {
+    gen = gen * 10 + (*end++ - '0');
+  }
+  if (end == digits || strcmp(end, suffix) != 0) {
+    return -1;
+  }
+  return gen;
+}
+
+// Writes "<a><b><gen, zero-padded to GEN_WIDTH digits><c>" into 'buf', or
+// "<a><b><c>" if gen is negative; the reclaimer cannot use snprintf().
+// Truncates at 'size'.
+static void
+formatName(char *buf, size_t size,
+           const char *a, const char *b, long gen, const char *c)
+{
+  char digits[24];
+  size_t n = 0;
+  for (; gen > 0 && n < sizeof(digits); gen /= 10) {
+    digits[n++] = '0' + gen % 10;
+  }
+  while (gen == 0 && n < GEN_WIDTH) {
+    digits[n++] = '0';
+  }
+
+  size_t len = 0;
+  for (; *a != '\0' && len + 1 < size; a++) {
+    buf[len++] = *a;
+  }
+  for (; *b != '\0' && len + 1 < size; b++) {
+    buf[len++] = *b;
+  }
+  while (n > 0 && len + 1 < size) {
+    buf[len++] = digits[--n];
+  }
+  for (; *c != '\0' && len + 1 < size; c++) {
+    buf[len++] = *c;
+  }
+  buf[len] = '\0';
+}
+
+/* Returns true once every image that the manifest lists, and that is
+ * visible from this host, exists.  An image is visible if it belongs in the
+ * generation directory 'genDir' of this filesystem, or if its directory
+ * exists; images on the local disks of other hosts are not.  A writer renames
+ * its image into place only once it is complete.  Runs in the reclaimer
+ * process.
+ */
+static bool
+generationCommitted(const char *manifest, const char *genDir)
+{
+  int fd = realSyscall(SYS_openat, AT_FDCWD, manifest, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  reclaim_stat_t st;
+  char *buf = (char *)MAP_FAILED;
+  if (realSyscall(SYS_reclaim_fstatat, fd, "", &st, AT_EMPTY_PATH) == 0 &&
+      st.st_size > 0) {
+    buf = (char *)realSyscall(SYS_mmap, NULL, st.st_size, PROT_READ,
+                              MAP_PRIVATE, fd, 0L);
+  }
+  realSyscall(SYS_close, fd);
+  if (buf == MAP_FAILED) {
+    return false;
+  }
+
+  // Each entry is "<hostname> <image>"; comments start with '#'.
+  size_t dirLen = strlen(genDir);
+  bool committed = true;
+  char path[4096];
+  reclaim_stat_t imageSt;
+  for (off_t off = 0; off < st.st_size && committed;) {
+    const char *line = buf + off;
+    const char *eol = (const char *)memchr(line, '\n', st.st_size - off);
+    size_t lineLen = eol != NULL ? eol - line : st.st_size - off;
+    off += lineLen + 1;
+
+    const char *image = (const char *)memchr(line, ' ', lineLen);
+    if (line[0] == '#' || image == NULL) {
+      continue;
+    }
+    image++;
+    size_t imageLen = line + lineLen - image;
+    if (imageLen >= sizeof(path)) {
+      continue;
+    }
+    memcpy(path, image, imageLen);
+    path[imageLen] = '\0';
+    if (realSyscall(SYS_reclaim_fstatat, AT_FDCWD, path, &imageSt, 0) == 0) {
+      continue;
+    }
+
+    char *slash = strrchr(path, '/');
+    if (imageLen > dirLen && strncmp(path, genDir, dirLen) == 0 &&
+        path[dirLen] == '/') {
+      committed = false;
+    } else if (slash != NULL) {
+      *slash = '\0';
+      committed = realSyscall(SYS_reclaim_fstatat, AT_FDCWD, path, &imageSt,
+                              0) != 0;
+    }
+  }
+  realSyscall(SYS_munmap, buf, st.st_size);
+  return committed;
+}
+
+/* Deletes the generations of this computation in baseDir that fall outside
+ * the retention policy, along with their restart scripts and manifests in
+ * the coordinator's checkpoint directory, coordDir.  Runs in the reclaimer
+ * process: system calls and string functions that neither lock nor allocate.
+ * Generation 'current' has been committed by all processes, and is never
+ * deleted; nor is anything newer.
+ */
+static void
+reclaimGenerations(const char *baseDir, const char *coordDir,
+                   const char *compId, long current)
+{
+  char prefix[256];
+  char hiddenPrefix[256];
+  char scriptPrefix[256];
+  char manifestPrefix[256];
+  char name[512];
+  long generations[MAX_GENERATIONS];
+  long leftovers[MAX_GENERATIONS];
+  size_t numGenerations = 0;
+  size_t numLeftovers = 0;
+
+  formatName(prefix, sizeof(prefix), "ckpt_", compId, -1, "_");
+  formatName(hiddenPrefix, sizeof(hiddenPrefix), ".ckpt_", compId, -1, "_");
+  formatName(scriptPrefix, sizeof(scriptPrefix),
+             RESTART_SCRIPT_BASENAME "_", compId, -1, "_");
+  formatName(manifestPrefix, sizeof(manifestPrefix),
+             RESTART_MANIFEST_BASENAME "_", compId, -1, "_");
+
+  int dirfd = realSyscall(SYS_openat, AT_FDCWD, baseDir,
+                          O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirfd < 0) {
+    return;
+  }
+  // The coordinator may run on another host; then its files are not ours
+  // to delete.
+  int coordDirfd = realSyscall(SYS_openat, AT_FDCWD, coordDir,
+                               O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  // Collect the committed generations older than 'current', and the
+  // leftovers of reclaimers that were interrupted.
+  char buf[4096];
+  long n;
+  while ((n = realSyscall(SYS_getdents64, dirfd, buf, sizeof(buf))) > 0) {
+    for (long off = 0; off < n;) {
+      struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+      off += d->d_reclen;
+
+      long gen = parseGeneration(d->d_name, prefix, "");
+      if (gen >= 0 && gen < current && numGenerations < MAX_GENERATIONS) {
+        generations[numGenerations++] = gen;
+      }
+      gen = parseGeneration(d->d_name, hiddenPrefix, RECLAIM_DIR_SUFFIX);
+      if (gen >= 0 && numLeftovers < MAX_GENERATIONS) {
+        leftovers[numLeftovers++] = gen;
+      }
+      gen = parseGeneration(d->d_name, hiddenPrefix, RECLAIM_MARKER_SUFFIX);
+      if (gen >= 0 && gen < current) {
+        realSyscall(SYS_unlinkat, dirfd, d->d_name, 0);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < numLeftovers; i++) {
+    formatName(name, sizeof(name), hiddenPrefix, "", leftovers[i],
+               RECLAIM_DIR_SUFFIX);
+    removeTree(dirfd, name, 0);
+  }
+
+  // Newest first.
+  for (size_t i = 1; i < numGenerations; i++) {
+    long gen = generations[i];
+    size_t j = i;
+    for (; j > 0 && generations[j - 1] < gen; j--) {
+      generations[j] = generations[j - 1];
+    }
+    generations[j] = gen;
+  }
+
+  uint64_t totalBytes = 0;
+  if (keepBytes != 0) {
+    formatName(name, sizeof(name), prefix, "", current, "");
+    totalBytes = treeBytes(dirfd, name, 0);
+  }
+
+  bool reclaimRest = false;
+  for (size_t i = 0; i < numGenerations; i++) {
+    char claimed[512];
+    long gen = generations[i];
+
+    formatName(name, sizeof(name), prefix, "", gen, "");
+    if (!reclaimRest && keepGenerations != 0 && i + 1 >= keepGenerations) {
+      reclaimRest = true;
+    }
+    if (!reclaimRest && keepBytes != 0) {
+      totalBytes += treeBytes(dirfd, name, 0);
+      reclaimRest = totalBytes > keepBytes;
+    }
+    if (!reclaimRest) {
+      continue;
+    }
+
+    // Claim the generation first; a concurrent reclaimer loses the race.
+    formatName(claimed, sizeof(claimed), hiddenPrefix, "", gen,
+               RECLAIM_DIR_SUFFIX);
+    if (realSyscall(SYS_renameat, dirfd, name, dirfd, claimed) != 0) {
+      continue;
+    }
+
+    // The restart script and manifest of this generation now point nowhere.
+    if (coordDirfd >= 0) {
+      formatName(name, sizeof(name), scriptPrefix, "", gen, ".sh");
+      realSyscall(SYS_unlinkat, coordDirfd, name, 0);
+      formatName(name, sizeof(name), manifestPrefix, "", gen, ".txt");
+      realSyscall(SYS_unlinkat, coordDirfd, name, 0);
+    }
+
+    removeTree(dirfd, claimed, 0);
+  }
+  if (coordDirfd >= 0) {
+    realSyscall(SYS_close, coordDirfd);
+  }
+  realSyscall(SYS_close, dirfd);
+}
+
+/* Called once all processes have passed the checkpoint of the current
+ * generation.  One process per host is elected through the coordinator, and
+ * the first of those to create the generation's marker in the base directory
+ * starts a reclaimer; that is one process per filesystem.
+ */
+static void
+startReclaimer()
+{
+  string ckptDir = dmtcp_get_ckpt_dir();
+  string baseDir = jalib::Filesystem::DirName(ckptDir);
+  string coordDir = dmtcp_get_coord_ckpt_dir();
+  string compId = dmtcp_get_computation_id_str();
+  long current = dmtcp_get_generation();
+
+  // Nothing to do unless updateCkptDir() chose the directory.
+  if (realSyscall == NULL ||
+      strstr(ckptDir.c_str(), compId.c_str()) == NULL) {
+    return;
+  }
+
+  // Of the processes on this host, only the first to ask the coordinator
+  // tries to create the marker; the marker then picks one of the hosts that
+  // share the filesystem.
+  if (!dmtcp_no_coordinator()) {
+    DmtcpUniqueProcessId upid = dmtcp_get_uniquepid();
+    ostringstream db;
+    db << DMTCP_CKPT_SCOPED_DB "unique-ckpt-reclaim:" << std::hex
+       << upid._hostid;
+    uint32_t rank = 0;
+    dmtcp_get_unique_id_from_coordinator(db.str().c_str(), &upid, sizeof(upid),
+                                         &rank, 1, sizeof(rank));
+    if (rank != 1) {
+      return;
+    }
+  }
+
+  ostringstream o;
+  o << baseDir << "/.ckpt_" << compId << "_"
+    << std::setw(GEN_WIDTH) << std::setfill('0') << current
+    << RECLAIM_MARKER_SUFFIX;
+  int fd = open(o.str().c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    return;
+  }
+  close(fd);
+
+  ostringstream manifestPath;
+  manifestPath << coordDir << "/" << RESTART_MANIFEST_BASENAME << "_" << compId
+               << "_" << std::setw(GEN_WIDTH) << std::setfill('0') << current
+               << ".txt";
+  string manifest = manifestPath.str();
+
+  // Like fork(), but without SIGCHLD and without running atfork handlers;
+  // the application must not notice the reclaimer.  The intermediate child
+  // exits at once, so that the reclaimer is reparented and never becomes
+  // our zombie.
+  pid_t child = realSyscall(SYS_clone, 0, NULL, NULL, NULL, NULL);
+  if (child == -1) {
+    JWARNING(false) (JASSERT_ERRNO).Text("Failed to start reclaimer.");
+    return;
+  } else if (child > 0) {
+    realSyscall(SYS_wait4, child, NULL, __WCLONE, NULL);
+    JTRACE("Started reclaimer.") (baseDir) (current);
+    return;
+  }
+
+  if (realSyscall(SYS_clone, 0, NULL, NULL, NULL, NULL) != 0) {
+    realSyscall(SYS_exit_group, 0);
+  }
+
+  // Don't hold on to the coordinator socket or any other fd of ours.
+#ifdef SYS_close_range
+  if (realSyscall(SYS_close_range, 0, ~0U, 0) != 0)
+#endif // ifdef SYS_close_range
+  {
+    for (int i = 0; i < 65536; i++) {
+      realSyscall(SYS_close, i);
+    }
+  }
+
+  // Deleting is never urgent; stay out of the way of the computation.
+  realSyscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+              IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+  realSyscall(SYS_setpriority, PRIO_PROCESS, 0, 19);
+
+  // Without forked checkpointing, every image was renamed into place before
+  // its process resumed.  With it, the images are committed by children of
+  // the processes, in the background; the generation is only committed once
+  // the coordinator has written its manifest and every image listed in it
+  // exists.  Until then, the previous generation is the only one to restart
+  // from.
+  if (forkedCkpt) {
+    long waited = 0;
+    while (!generationCommitted(manifest.c_str(), ckptDir.c_str())) {
+      if (waited >= COMMIT_WAIT_SECONDS) {
+        realSyscall(SYS_exit_group, 0);
+      }
+      struct timespec poll = { COMMIT_POLL_SECONDS, 0 };
+      realSyscall(SYS_nanosleep, &poll, NULL);
+      waited += COMMIT_POLL_SECONDS;
+    }
+  }
+
+  reclaimGenerations(baseDir.c_str(), coordDir.c_str(), compId.c_str(),
+                     current);
+  realSyscall(SYS_exit_group, 0);
+}
+
 static void
 uniqueckpt_EventHook(DmtcpEvent_t event, DmtcpEventData_t *data)
 {
   switch (event) {
+  case DMTCP_EVENT_INIT:
+    initRetention();
+    break;
+
   case DMTCP_EVENT_PRECHECKPOINT:
-    updateCkptDir();
+    // A subset checkpoint has its own directory, and is not a generation.
+    if (!dmtcp_is_subset_checkpoint()) {
+      updateCkptDir();
+    }
+    break;
+
+  case DMTCP_EVENT_RESUME:
+    // The DMT:WriteCkpt barrier is behind us: every process has written (or,
+    // with forked checkpointing, is writing) its image of this generation.
+    if ((keepGenerations != 0 || keepBytes != 0) &&
+        !dmtcp_is_subset_checkpoint()) {
+      startReclaimer();
+    }
     break;
 
   default:  // other events are not registered
@@ -19,7 +19,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include "config.h"
 #include "dmtcp.h"
@@ -28,22 +30,53 @@
 
 namespace dmtcp
 {
-static unsigned int timeLeft = 0;
+// ITIMER_REAL (alarm() and setitimer()) is stopped while we are checkpointed,
+// and resumes with the time it had left.  (With --virtual-time, so do the
+// POSIX timers of the monotonic clocks; see plugin/timer/virtualtime.h.)
+// The CPU-time timers don't advance while we are suspended, but must be
+// re-armed on restart.
+static struct itimerval realTimer;
+static struct itimerval virtualTimer;
+static struct itimerval profTimer;
+
+static bool
+isArmed(const struct itimerval &timer)
+{
+  return timer.it_value.tv_sec != 0 || timer.it_value.tv_usec != 0;
+}
 
 static void
 checkpoint()
 {
-  timeLeft = alarm(0);
-  JTRACE("*** Alarm stopped. ***") (timeLeft);
+  struct itimerval disarm;
+
+  memset(&disarm, 0, sizeof(disarm));
+  JASSERT(setitimer(ITIMER_REAL, &disarm, &realTimer) == 0) (JASSERT_ERRNO);
+  JASSERT(getitimer(ITIMER_VIRTUAL, &virtualTimer) == 0) (JASSERT_ERRNO);
+  JASSERT(getitimer(ITIMER_PROF, &profTimer) == 0) (JASSERT_ERRNO);
+  JTRACE("*** Alarm stopped. ***") (realTimer.it_value.tv_sec);
 }
 
 static void
 resume()
 {
   /* Need to restart the timer on resume/restart. */
-  if (timeLeft > 0) {
-    JTRACE("*** Resuming alarm. ***") (timeLeft);
-    timeLeft = alarm(timeLeft);
+  if (isArmed(realTimer)) {
+    JTRACE("*** Resuming alarm. ***") (realTimer.it_value.tv_sec);
+    JASSERT(setitimer(ITIMER_REAL, &realTimer, NULL) == 0) (JASSERT_ERRNO);
+  }
+}
+
+static void
+restart()
+{
+  resume();
+  if (isArmed(virtualTimer)) {
+    JASSERT(setitimer(ITIMER_VIRTUAL, &virtualTimer, NULL) == 0)
+      (JASSERT_ERRNO);
+  }
+  if (isArmed(profTimer)) {
+    JASSERT(setitimer(ITIMER_PROF, &profTimer, NULL) == 0) (JASSERT_ERRNO);
   }
 }
 
@@ -56,10 +89,13 @@ alarm_EventHook(DmtcpEvent_t event, DmtcpEventData_t *data)
     break;
 
   case DMTCP_EVENT_RESUME:
-  case DMTCP_EVENT_RESTART:
     resume();
     break;
 
+  case DMTCP_EVENT_RESTART:
+    restart();
+    break;
+
   default:
     break;
   }
@@ -0,0 +1,374 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+/* Checkpoint budgets.  See ckptbudget.h.
+ *
+ * The clock and the sleeps go straight to the kernel:  with virtual time
+ * (plugin/timer), the monotonic clock of the process stands still while it
+ * is checkpointed.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include "../jalib/jassert.h"
+#include "ckptbudget.h"
+#include "constants.h"
+#include "syscallwrappers.h"
+#include "util.h"
+
+using namespace dmtcp;
+
+// Check the budgets every BUDGET_CHECK_BYTES bytes of image.
+#define BUDGET_CHECK_BYTES (1024 * 1024)
+
+// Unused budget that may be spent at once, in seconds of budget.
+#define BUDGET_BURST       0.1
+
+// Longest sleep per check.  A helper that burns CPU whether or not it is fed
+// can't be slowed by sleeping; don't stall the checkpoint for it.
+#define BUDGET_MAX_SLEEP   1.0
+
+#define CGROUP_ROOT        "/sys/fs/cgroup"
+
+static uint64_t writeRate = 0;    // Bytes per second; 0 = unlimited
+static double helperCpus = 0;     // CPUs the helpers may use; 0 = unlimited
+static pid_t helpers[2] = { -1, -1 };
+
+static double imageStart;
+static double writeDue;           // When the bytes so far are paid for
+static double cpuDue;             // When the helper CPU time is paid for
+static double helperCpuSeen;
+static double slept;
+static uint64_t imageBytes;
+static uint64_t uncheckedBytes;
+
+static double
+now()
+{
+  struct timespec ts;
+
+  _real_syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sleepFor(double sec)
+{
+  struct timespec ts;
+
+  ts.tv_sec = (time_t)sec;
+  ts.tv_nsec = (long)((sec - ts.tv_sec) * 1e9);
+  while (_real_syscall(SYS_nanosleep, &ts, &ts) == -1 && errno == EINTR) {
+  }
+}
+
+// Accepts a plain number, or one with a K, M, G or T suffix.
+static uint64_t
+parseBytes(const char *str)
+{
+  char *end = NULL;
+  uint64_t bytes = strtoull(str, &end, 10);
+
+  switch (*end) {
+  case 'T': case 't': bytes <<= 10;
+  // Fall through
+  case 'G': case 'g': bytes <<= 10;
+  // Fall through
+  case 'M': case 'm': bytes <<= 10;
+  // Fall through
+  case 'K': case 'k': bytes <<= 10;
+  }
+  return bytes;
+}
+
+static uint64_t
+envBytes(const char *name)
+{
+  const char *str = getenv(name);
+
+  return str == NULL ? 0 : parseBytes(str);
+}
+
+// Reads a small file into buf, NUL-terminated.
+static bool
+readFile(const char *path, char *buf, size_t size)
+{
+  int fd = _real_open(path, O_RDONLY, 0);
+
+  if (fd == -1) {
+    return false;
+  }
+  ssize_t len = Util::readAll(fd, buf, size - 1);
+  _real_close(fd);
+  if (len < 0) {
+    return false;
+  }
+  buf[len] = '\0';
+  return true;
+}
+
+/* Reads a file of the cgroup of this process:  'v2' of its cgroup v2, or
+ * else 'v1' of its cgroup v1 'controller'.  Inside a container, the cgroup
+ * of the process is usually the root of what is mounted.
+ */
+static bool
+readCgroupFile(const char *controller,
+               const char *v1,
+               const char *v2,
+               char *buf,
+               size_t size)
+{
+  char cgroups[4096];
+  char path[PATH_MAX];
+  char *saveptr;
+
+  if (!readFile("/proc/self/cgroup", cgroups, sizeof(cgroups))) {
+    return false;
+  }
+
+  // Lines are "ID:CONTROLLERS:PATH"; cgroup v2 is "0::PATH".
+  for (char *line = strtok_r(cgroups, "\n", &saveptr); line != NULL;
+       line = strtok_r(NULL, "\n", &saveptr)) {
+    char *controllers = strchr(line, ':');
+    char *cgroup = controllers ? strchr(controllers + 1, ':') : NULL;
+    if (cgroup == NULL) {
+      continue;
+    }
+    *controllers++ = '\0';
+    *cgroup++ = '\0';
+
+    const char *file;
+    string dir = CGROUP_ROOT;
+    if (strcmp(line, "0") == 0 && controllers[0] == '\0') {
+      file = v2;
+    } else {
+      string list = string(",") + controllers + ",";
+      if (strstr(list.c_str(), (string(",") + controller + ",").c_str()) ==
+          NULL) {
+        continue;
+      }
+      file = v1;
+      dir = dir + "/" + controller;
+    }
+    snprintf(path, sizeof(path), "%s%s/%s", dir.c_str(), cgroup, file);
+    if (readFile(path, buf, size)) {
+      return true;
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir.c_str(), file);
+    if (readFile(path, buf, size)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Memory that may still be charged to the cgroup of this process.
+static uint64_t
+cgroupMemoryHeadroom()
+{
+  char limit[64];
+  char usage[64];
+
+  if (readCgroupFile("memory", "memory.limit_in_bytes", "memory.max",
+                     limit, sizeof(limit)) &&
+      strncmp(limit, "max", 3) != 0 &&
+      readCgroupFile("memory", "memory.usage_in_bytes", "memory.current",
+                     usage, sizeof(usage))) {
+    uint64_t max = strtoull(limit, NULL, 10);
+    uint64_t cur = strtoull(usage, NULL, 10);
+    return max > cur ? max - cur : 0;
+  }
+  return UINT64_MAX;
+}
+
+// CPUs available to this process:  its cgroup quota, or its affinity mask.
+static double
+availableCpus()
+{
+  char buf[64];
+  double quota = -1;
+  double period = 0;
+
+  if (readCgroupFile("cpu", "cpu.cfs_quota_us", "cpu.max", buf, sizeof(buf))) {
+    // cgroup v2:  "QUOTA PERIOD" or "max PERIOD";  v1:  QUOTA or -1.
+    if (sscanf(buf, "%lf %lf", &quota, &period) != 2 &&
+        readCgroupFile("cpu", "cpu.cfs_period_us", "cpu.max",
+                       buf, sizeof(buf))) {
+      period = strtod(buf, NULL);
+    }
+  }
+  if (quota > 0 && period > 0) {
+    return quota / period;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (_real_syscall(SYS_sched_getaffinity, 0, sizeof(set), &set) > 0) {
+    return CPU_COUNT(&set);
+  }
+  return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+// User and system time of a process, in seconds.
+static double
+cpuTime(pid_t pid)
+{
+  char path[64];
+  char buf[1024];
+
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  if (!readFile(path, buf, sizeof(buf))) {
+    return 0;
+  }
+
+  // utime and stime are fields 14 and 15, after the 12th space that follows
+  // the command name (field 2, which may hold spaces but ends with ')').
+  char *p = strrchr(buf, ')');
+  for (int i = 0; i < 12 && p != NULL; i++) {
+    p = strchr(p + 1, ' ');
+  }
+  if (p == NULL) {
+    return 0;
+  }
+  char *end;
+  uint64_t utime = strtoull(p, &end, 10);
+  uint64_t stime = strtoull(end, NULL, 10);
+  return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static double
+helperCpuTime()
+{
+  double sec = 0;
+
+  for (size_t i = 0; i < sizeof(helpers) / sizeof(helpers[0]); i++) {
+    if (helpers[i] != -1) {
+      sec += cpuTime(helpers[i]);
+    }
+  }
+  return sec;
+}
+
+void
+CkptBudget::startImage(pid_t compressor, pid_t encryptor)
+{
+  const char *cpu = getenv(ENV_VAR_CKPT_HELPER_CPU);
+
+  writeRate = envBytes(ENV_VAR_CKPT_WRITE_RATE);
+  helpers[0] = compressor;
+  helpers[1] = encryptor;
+  helperCpus = 0;
+  if (cpu != NULL && atof(cpu) > 0 && (compressor != -1 || encryptor != -1)) {
+    helperCpus = atof(cpu) / 100 * availableCpus();
+  }
+
+  imageStart = now();
+  writeDue = imageStart;
+  cpuDue = imageStart;
+  helperCpuSeen = 0;
+  slept = 0;
+  imageBytes = 0;
+  uncheckedBytes = 0;
+  JTRACE("Checkpoint budget") (writeRate) (helperCpus);
+}
+
+void
+CkptBudget::wrote(size_t len)
+{
+  imageBytes += len;
+  if (writeRate == 0 && helperCpus == 0) {
+    return;
+  }
+  uncheckedBytes += len;
+  if (uncheckedBytes < BUDGET_CHECK_BYTES) {
+    return;
+  }
+
+  double t = now();
+  double due = t;
+  if (writeRate != 0) {
+    writeDue = std::max(writeDue, t - BUDGET_BURST) +
+               (double)uncheckedBytes / writeRate;
+    due = std::max(due, writeDue);
+  }
+  if (helperCpus != 0) {
+    double cpu = helperCpuTime();
+    cpuDue = std::max(cpuDue, t - BUDGET_BURST) +
+             (cpu - helperCpuSeen) / helperCpus;
+    helperCpuSeen = cpu;
+    due = std::max(due, cpuDue);
+  }
+  uncheckedBytes = 0;
+
+  if (due > t) {
+    double sec = std::min(due - t, BUDGET_MAX_SLEEP);
+    sleepFor(sec);
+    slept += sec;
+  }
+}
+
+void
+CkptBudget::endImage()
+{
+  JTRACE("Checkpoint image written")
+    (imageBytes) (now() - imageStart) (slept);
+}
+
+bool
+CkptBudget::forkedCkptFits()
+{
+  // The forked child shares our pages until we write to them; at worst, we
+  // write to every one of our private pages before the child is done.
+  char buf[4096];
+  uint64_t cow = 0;
+  char *anon;
+
+  if (readFile("/proc/self/smaps_rollup", buf, sizeof(buf)) &&
+      (anon = strstr(buf, "\nAnonymous:")) != NULL) {
+    cow = strtoull(anon + strlen("\nAnonymous:"), NULL, 10) * 1024;
+  } else if (readFile("/proc/self/statm", buf, sizeof(buf))) {
+    unsigned long size, resident, shared;
+    if (sscanf(buf, "%lu %lu %lu", &size, &resident, &shared) == 3) {
+      cow = (uint64_t)(resident - shared) * Util::pageSize();
+    }
+  }
+
+  uint64_t maxMemory = envBytes(ENV_VAR_CKPT_MAX_MEMORY);
+  if (maxMemory != 0 && cow > maxMemory) {
+    JNOTE("Forked checkpoint could exceed its memory budget;"
+          " using a normal checkpoint") (cow) (maxMemory);
+    return false;
+  }
+
+  uint64_t headroom = cgroupMemoryHeadroom();
+  if (cow > headroom) {
+    JNOTE("Forked checkpoint could exceed the cgroup memory limit;"
+          " using a normal checkpoint") (cow) (headroom);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,61 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+#ifndef CKPT_BUDGET_H
+#define CKPT_BUDGET_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Resource budgets of a checkpoint, for nodes shared with other jobs.
+ *
+ *   DMTCP_CKPT_WRITE_RATE   Bytes per second written to the image stream.
+ *   DMTCP_CKPT_HELPER_CPU   CPU share of the compressor and encryptor, in
+ *                           percent of the CPUs available to the process
+ *                           (its cgroup CPU quota, or else its affinity mask).
+ *   DMTCP_CKPT_MAX_MEMORY   Memory a forked checkpoint may add by copy-on-
+ *                           write, in bytes.  The headroom left below the
+ *                           cgroup memory limit is a ceiling too.
+ *
+ * The first two are enforced by the checkpoint thread: it sleeps between
+ * blocks of the image until both the bytes written and the CPU time used by
+ * the helpers are back under budget.  The helpers only get what the thread
+ * feeds them, so slowing the feed slows them.  Sizes and rates may end in
+ * K, M, G or T.
+ */
+
+namespace dmtcp
+{
+namespace CkptBudget
+{
+// Starts the budget of one image, written through the given helper
+// processes (-1 if unused).
+void startImage(pid_t compressor, pid_t encryptor);
+
+// Accounts for 'len' bytes written to the image, and sleeps if the write
+// rate or the helpers' CPU share is over budget.
+void wrote(size_t len);
+
+// Logs the time spent writing the image, and how much of it was throttled.
+void endImage();
+
+// False if the copy-on-write copy of a forked checkpoint could exceed
+// DMTCP_CKPT_MAX_MEMORY or the cgroup memory limit.
+bool forkedCkptFits();
+}
+}
+#endif // ifndef CKPT_BUDGET_H
@@ -0,0 +1,968 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+/* AES-256-GCM for checkpoint images.  See ckptcrypt.h for the format.
+ *
+ * On x86_64 with AES-NI and PCLMULQDQ, counter mode runs four blocks at a
+ * time, and GHASH multiplies four blocks at a time by H^4..H^1 and reduces
+ * once, which keeps it near memory speed.  Elsewhere, we fall back to a
+ * portable table-driven AES and a 4-bit-table GHASH, which are correct but
+ * much slower.  That includes aarch64:  there is no AESE/AESMC/PMULL path
+ * yet, so encryption there runs at table speed, well below disk speed.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__)
+# include <immintrin.h>
+#endif // if defined(__x86_64__)
+
+#include "../jalib/jassert.h"
+#include "ckptcrypt.h"
+#include "constants.h"
+#include "protectedfds.h"
+#include "syscallwrappers.h"
+#include "util.h"
+
+using namespace dmtcp;
+
+#define AES_ROUNDS 14
+
+#ifndef MFD_ALLOW_SEALING
+# define MFD_ALLOW_SEALING 0x0002U
+#endif // ifndef MFD_ALLOW_SEALING
+
+struct GcmKey {
+  uint8_t rk[16 * (AES_ROUNDS + 1)];   // AES-256 round keys
+  uint32_t te[256];                    // Table for the portable AES
+  uint64_t hl[16], hh[16];             // 4-bit tables of H (portable GHASH)
+  uint8_t hpow[4][16];                 // H^1..H^4, byte-reversed (AES-NI)
+  bool hw;
+};
+
+static const uint8_t sbox[256] = {
+  0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5,
+  0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+  0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+  0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+  0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc,
+  0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+  0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a,
+  0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+  0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+  0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+  0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b,
+  0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+  0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85,
+  0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+  0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+  0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+  0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17,
+  0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+  0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88,
+  0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+  0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+  0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+  0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9,
+  0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+  0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6,
+  0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+  0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+  0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+  0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94,
+  0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+  0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68,
+  0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static inline uint64_t
+load_be64(const uint8_t *p)
+{
+  uint64_t v = 0;
+
+  for (int i = 0; i < 8; i++) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+static inline void
+store_be64(uint8_t *p, uint64_t v)
+{
+  for (int i = 7; i >= 0; i--) {
+    p[i] = v & 0xff;
+    v >>= 8;
+  }
+}
+
+static inline void
+store_be32(uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+// The compiler may drop a memset() of memory that is never read again.
+static void
+wipe(void *p, size_t len)
+{
+  volatile uint8_t *v = (volatile uint8_t *)p;
+
+  while (len-- > 0) {
+    *v++ = 0;
+  }
+}
+
+static inline uint8_t
+xtime(uint8_t x)
+{
+  return (x << 1) ^ ((x >> 7) * 0x1b);
+}
+
+static void
+aes_expand_key(const uint8_t key[CKPT_CRYPT_KEY_SIZE], uint8_t *rk)
+{
+  static const uint8_t rcon[7] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40 };
+
+  memcpy(rk, key, CKPT_CRYPT_KEY_SIZE);
+  for (int i = 8; i < 4 * (AES_ROUNDS + 1); i++) {
+    uint8_t t[4];
+    memcpy(t, rk + 4 * (i - 1), 4);
+    if (i % 8 == 0) {
+      uint8_t t0 = t[0];
+      t[0] = sbox[t[1]] ^ rcon[i / 8 - 1];
+      t[1] = sbox[t[2]];
+      t[2] = sbox[t[3]];
+      t[3] = sbox[t0];
+    } else if (i % 8 == 4) {
+      for (int j = 0; j < 4; j++) {
+        t[j] = sbox[t[j]];
+      }
+    }
+    for (int j = 0; j < 4; j++) {
+      rk[4 * i + j] = rk[4 * (i - 8) + j] ^ t[j];
+    }
+  }
+}
+
+static inline uint32_t
+rotl32(uint32_t v, int n)
+{
+  return (v << n) | (v >> (32 - n));
+}
+
+static inline uint32_t
+load_le32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// te[x] is the column that MixColumns makes of S(x) in row 0; S(x) in row r
+// gives the same column rotated by r bytes.
+static void
+aes_init_table(uint32_t te[256])
+{
+  for (int x = 0; x < 256; x++) {
+    uint8_t s = sbox[x];
+    uint8_t s2 = xtime(s);
+    te[x] = s2 | (s << 8) | (s << 16) | ((uint32_t)(s2 ^ s) << 24);
+  }
+}
+
+static void
+aes_encrypt_block_sw(const GcmKey *k, const uint8_t in[16], uint8_t out[16])
+{
+  const uint32_t *te = k->te;
+  uint32_t s[4], t[4];
+
+  // The state is stored column by column; row 0 is the low byte of a column.
+  for (int c = 0; c < 4; c++) {
+    s[c] = load_le32(in + 4 * c) ^ load_le32(k->rk + 4 * c);
+  }
+  for (int r = 1; r < AES_ROUNDS; r++) {
+    for (int c = 0; c < 4; c++) {
+      t[c] = te[s[c] & 0xff] ^
+             rotl32(te[(s[(c + 1) % 4] >> 8) & 0xff], 8) ^
+             rotl32(te[(s[(c + 2) % 4] >> 16) & 0xff], 16) ^
+             rotl32(te[s[(c + 3) % 4] >> 24], 24) ^
+             load_le32(k->rk + 16 * r + 4 * c);
+    }
+    memcpy(s, t, sizeof(s));
+  }
+  // The last round has no MixColumns.
+  for (int c = 0; c < 4; c++) {
+    uint32_t v = sbox[s[c] & 0xff] |
+                 (sbox[(s[(c + 1) % 4] >> 8) & 0xff] << 8) |
+                 (sbox[(s[(c + 2) % 4] >> 16) & 0xff] << 16) |
+                 ((uint32_t)sbox[s[(c + 3) % 4] >> 24] << 24);
+    v ^= load_le32(k->rk + 16 * AES_ROUNDS + 4 * c);
+    for (int i = 0; i < 4; i++) {
+      out[4 * c + i] = v >> (8 * i);
+    }
+  }
+}
+
+// x = x * H in GF(2^128), with Shoup's 4-bit tables.
+static void
+ghash_mult_sw(const GcmKey *k, uint8_t x[16])
+{
+  static const uint64_t last4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+  };
+  uint8_t lo = x[15] & 0xf;
+  uint64_t zh = k->hh[lo];
+  uint64_t zl = k->hl[lo];
+
+  for (int i = 15; i >= 0; i--) {
+    uint8_t hi = x[i] >> 4;
+    uint8_t rem;
+    lo = x[i] & 0xf;
+    if (i != 15) {
+      rem = zl & 0xf;
+      zl = (zh << 60) | (zl >> 4);
+      zh = (zh >> 4) ^ (last4[rem] << 48);
+      zh ^= k->hh[lo];
+      zl ^= k->hl[lo];
+    }
+    rem = zl & 0xf;
+    zl = (zh << 60) | (zl >> 4);
+    zh = (zh >> 4) ^ (last4[rem] << 48);
+    zh ^= k->hh[hi];
+    zl ^= k->hl[hi];
+  }
+  store_be64(x, zh);
+  store_be64(x + 8, zl);
+}
+
+// Absorb len bytes into the GHASH state x; a partial last block is padded
+// with zeros.
+static void
+ghash_sw(const GcmKey *k, uint8_t x[16], const uint8_t *p, size_t len)
+{
+  while (len > 0) {
+    size_t n = len < 16 ? len : 16;
+    for (size_t i = 0; i < n; i++) {
+      x[i] ^= p[i];
+    }
+    ghash_mult_sw(k, x);
+    p += n;
+    len -= n;
+  }
+}
+
+static void
+gcm_sw(const GcmKey *k, const uint8_t iv[12], const uint8_t *aad,
+       size_t aadLen, uint8_t *buf, size_t len, bool encrypt, uint8_t tag[16])
+{
+  uint8_t x[16] = { 0 };
+  uint8_t ctr[16], ks[16];
+
+  ghash_sw(k, x, aad, aadLen);
+  if (!encrypt) {
+    ghash_sw(k, x, buf, len);
+  }
+  memcpy(ctr, iv, 12);
+  for (size_t off = 0, blk = 2; off < len; off += 16, blk++) {
+    store_be32(ctr + 12, blk);
+    aes_encrypt_block_sw(k, ctr, ks);
+    for (size_t i = 0; i < 16 && off + i < len; i++) {
+      buf[off + i] ^= ks[i];
+    }
+  }
+  if (encrypt) {
+    ghash_sw(k, x, buf, len);
+  }
+
+  uint8_t lens[16];
+  store_be64(lens, (uint64_t)aadLen * 8);
+  store_be64(lens + 8, (uint64_t)len * 8);
+  ghash_sw(k, x, lens, 16);
+
+  store_be32(ctr + 12, 1);
+  aes_encrypt_block_sw(k, ctr, ks);
+  for (int i = 0; i < 16; i++) {
+    tag[i] = x[i] ^ ks[i];
+  }
+}
+
+#if defined(__x86_64__)
+# define HW_TARGET __attribute__((target("aes,pclmul,ssse3,sse4.1")))
+
+HW_TARGET static inline __m128i
+bswap128(__m128i v)
+{
+  return _mm_shuffle_epi8(v, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                          8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// Unreduced 256-bit carry-less product of a and b, added into (lo, hi).
+HW_TARGET static inline void
+clmul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+{
+  __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+  __m128i t1 = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                             _mm_clmulepi64_si128(a, b, 0x01));
+  __m128i t3 = _mm_clmulepi64_si128(a, b, 0x11);
+
+  *lo = _mm_xor_si128(*lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+  *hi = _mm_xor_si128(*hi, _mm_xor_si128(t3, _mm_srli_si128(t1, 8)));
+}
+
+// Reduce (lo, hi) modulo the GCM polynomial, in the bit-reflected domain.
+// This is the reduction from Intel's "Carry-Less Multiplication and Its
+// Usage for Computing the GCM Mode" white paper.
+HW_TARGET static inline __m128i
+gf_reduce(__m128i lo, __m128i hi)
+{
+  __m128i t3 = _mm_srli_epi32(lo, 31);
+  __m128i t4 = _mm_srli_epi32(hi, 31);
+  __m128i t5 = _mm_srli_si128(t3, 12);
+
+  lo = _mm_or_si128(_mm_slli_epi32(lo, 1), _mm_slli_si128(t3, 4));
+  hi = _mm_or_si128(_mm_slli_epi32(hi, 1), _mm_slli_si128(t4, 4));
+  hi = _mm_or_si128(hi, t5);
+
+  t3 = _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30));
+  t3 = _mm_xor_si128(t3, _mm_slli_epi32(lo, 25));
+  t4 = _mm_srli_si128(t3, 4);
+  lo = _mm_xor_si128(lo, _mm_slli_si128(t3, 12));
+
+  __m128i t2 = _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2));
+  t2 = _mm_xor_si128(t2, _mm_srli_epi32(lo, 7));
+  t2 = _mm_xor_si128(t2, t4);
+  return _mm_xor_si128(hi, _mm_xor_si128(lo, t2));
+}
+
+HW_TARGET static inline __m128i
+gf_mult(__m128i a, __m128i b)
+{
+  __m128i lo = _mm_setzero_si128();
+  __m128i hi = _mm_setzero_si128();
+
+  clmul_acc(a, b, &lo, &hi);
+  return gf_reduce(lo, hi);
+}
+
+// x = (x + c0) H^4 + c1 H^3 + c2 H^2 + c3 H, with a single reduction.
+HW_TARGET static inline __m128i
+ghash4_hw(const __m128i h[4], __m128i x,
+          __m128i c0, __m128i c1, __m128i c2, __m128i c3)
+{
+  __m128i lo = _mm_setzero_si128();
+  __m128i hi = _mm_setzero_si128();
+
+  clmul_acc(_mm_xor_si128(x, bswap128(c0)), h[3], &lo, &hi);
+  clmul_acc(bswap128(c1), h[2], &lo, &hi);
+  clmul_acc(bswap128(c2), h[1], &lo, &hi);
+  clmul_acc(bswap128(c3), h[0], &lo, &hi);
+  return gf_reduce(lo, hi);
+}
+
+HW_TARGET static __m128i
+ghash_hw(const __m128i h[4], __m128i x, const uint8_t *p, size_t len)
+{
+  while (len >= 64) {
+    const __m128i *q = (const __m128i *)p;
+    x = ghash4_hw(h, x, _mm_loadu_si128(q), _mm_loadu_si128(q + 1),
+                  _mm_loadu_si128(q + 2), _mm_loadu_si128(q + 3));
+    p += 64;
+    len -= 64;
+  }
+  while (len > 0) {
+    uint8_t block[16] = { 0 };
+    size_t n = len < 16 ? len : 16;
+    memcpy(block, p, n);
+    x = gf_mult(_mm_xor_si128(x, bswap128(_mm_loadu_si128((__m128i *)block))),
+                h[0]);
+    p += n;
+    len -= n;
+  }
+  return x;
+}
+
+HW_TARGET static inline __m128i
+aes_encrypt_hw(const __m128i rk[AES_ROUNDS + 1], __m128i b)
+{
+  b = _mm_xor_si128(b, rk[0]);
+  for (int r = 1; r < AES_ROUNDS; r++) {
+    b = _mm_aesenc_si128(b, rk[r]);
+  }
+  return _mm_aesenclast_si128(b, rk[AES_ROUNDS]);
+}
+
+// Four independent blocks keep the AES unit busy.
+HW_TARGET static inline void
+aes_encrypt4_hw(const __m128i rk[AES_ROUNDS + 1],
+                __m128i *b0, __m128i *b1, __m128i *b2, __m128i *b3)
+{
+  *b0 = _mm_xor_si128(*b0, rk[0]);
+  *b1 = _mm_xor_si128(*b1, rk[0]);
+  *b2 = _mm_xor_si128(*b2, rk[0]);
+  *b3 = _mm_xor_si128(*b3, rk[0]);
+  for (int r = 1; r < AES_ROUNDS; r++) {
+    *b0 = _mm_aesenc_si128(*b0, rk[r]);
+    *b1 = _mm_aesenc_si128(*b1, rk[r]);
+    *b2 = _mm_aesenc_si128(*b2, rk[r]);
+    *b3 = _mm_aesenc_si128(*b3, rk[r]);
+  }
+  *b0 = _mm_aesenclast_si128(*b0, rk[AES_ROUNDS]);
+  *b1 = _mm_aesenclast_si128(*b1, rk[AES_ROUNDS]);
+  *b2 = _mm_aesenclast_si128(*b2, rk[AES_ROUNDS]);
+  *b3 = _mm_aesenclast_si128(*b3, rk[AES_ROUNDS]);
+}
+
+HW_TARGET static inline __m128i
+ctr_block(__m128i base, uint32_t blk)
+{
+  return _mm_insert_epi32(base, (int)__builtin_bswap32(blk), 3);
+}
+
+HW_TARGET static void
+gcm_hw(const GcmKey *k, const uint8_t iv[12], const uint8_t *aad,
+       size_t aadLen, uint8_t *buf, size_t len, bool encrypt, uint8_t tag[16])
+{
+  __m128i rk[AES_ROUNDS + 1];
+  __m128i h[4];
+  uint8_t ivBlock[16] = { 0 };
+
+  for (int r = 0; r <= AES_ROUNDS; r++) {
+    rk[r] = _mm_loadu_si128((const __m128i *)(k->rk + 16 * r));
+  }
+  for (int i = 0; i < 4; i++) {
+    h[i] = _mm_loadu_si128((const __m128i *)k->hpow[i]);
+  }
+  memcpy(ivBlock, iv, 12);
+  __m128i base = _mm_loadu_si128((__m128i *)ivBlock);
+  __m128i x = ghash_hw(h, _mm_setzero_si128(), aad, aadLen);
+
+  size_t off = 0;
+  uint32_t blk = 2;
+  for (; len - off >= 64; off += 64, blk += 4) {
+    __m128i *q = (__m128i *)(buf + off);
+    __m128i k0 = ctr_block(base, blk);
+    __m128i k1 = ctr_block(base, blk + 1);
+    __m128i k2 = ctr_block(base, blk + 2);
+    __m128i k3 = ctr_block(base, blk + 3);
+    aes_encrypt4_hw(rk, &k0, &k1, &k2, &k3);
+
+    __m128i d0 = _mm_loadu_si128(q);
+    __m128i d1 = _mm_loadu_si128(q + 1);
+    __m128i d2 = _mm_loadu_si128(q + 2);
+    __m128i d3 = _mm_loadu_si128(q + 3);
+    __m128i o0 = _mm_xor_si128(d0, k0);
+    __m128i o1 = _mm_xor_si128(d1, k1);
+    __m128i o2 = _mm_xor_si128(d2, k2);
+    __m128i o3 = _mm_xor_si128(d3, k3);
+    _mm_storeu_si128(q, o0);
+    _mm_storeu_si128(q + 1, o1);
+    _mm_storeu_si128(q + 2, o2);
+    _mm_storeu_si128(q + 3, o3);
+    if (encrypt) {
+      x = ghash4_hw(h, x, o0, o1, o2, o3);
+    } else {
+      x = ghash4_hw(h, x, d0, d1, d2, d3);
+    }
+  }
+
+  // The last (up to 63) bytes.
+  size_t rest = len - off;
+  if (rest > 0) {
+    if (!encrypt) {
+      x = ghash_hw(h, x, buf + off, rest);
+    }
+    for (size_t o = off; o < len; o += 16, blk++) {
+      uint8_t ks[16];
+      _mm_storeu_si128((__m128i *)ks, aes_encrypt_hw(rk, ctr_block(base, blk)));
+      for (size_t i = 0; i < 16 && o + i < len; i++) {
+        buf[o + i] ^= ks[i];
+      }
+    }
+    if (encrypt) {
+      x = ghash_hw(h, x, buf + off, rest);
+    }
+  }
+
+  uint8_t lens[16];
+  store_be64(lens, (uint64_t)aadLen * 8);
+  store_be64(lens + 8, (uint64_t)len * 8);
+  x = ghash_hw(h, x, lens, 16);
+
+  __m128i ek0 = aes_encrypt_hw(rk, ctr_block(base, 1));
+  _mm_storeu_si128((__m128i *)tag, _mm_xor_si128(bswap128(x), ek0));
+
+  for (int r = 0; r <= AES_ROUNDS; r++) {
+    rk[r] = _mm_setzero_si128();
+  }
+}
+
+HW_TARGET static void
+init_hpow_hw(GcmKey *k, const uint8_t h[16])
+{
+  __m128i h1 = bswap128(_mm_loadu_si128((const __m128i *)h));
+  __m128i h2 = gf_mult(h1, h1);
+  __m128i h3 = gf_mult(h2, h1);
+  __m128i h4 = gf_mult(h3, h1);
+
+  _mm_storeu_si128((__m128i *)k->hpow[0], h1);
+  _mm_storeu_si128((__m128i *)k->hpow[1], h2);
+  _mm_storeu_si128((__m128i *)k->hpow[2], h3);
+  _mm_storeu_si128((__m128i *)k->hpow[3], h4);
+}
+#endif // if defined(__x86_64__)
+
+static void
+gcm_init_key(GcmKey *k, const uint8_t key[CKPT_CRYPT_KEY_SIZE])
+{
+  uint8_t zero[16] = { 0 };
+  uint8_t h[16];
+
+  memset(k, 0, sizeof(*k));
+  aes_expand_key(key, k->rk);
+  aes_init_table(k->te);
+  aes_encrypt_block_sw(k, zero, h);
+
+  uint64_t vh = load_be64(h);
+  uint64_t vl = load_be64(h + 8);
+  k->hl[8] = vl;
+  k->hh[8] = vh;
+  for (int i = 4; i > 0; i >>= 1) {
+    uint64_t t = (vl & 1) * 0xe1000000;
+    vl = (vh << 63) | (vl >> 1);
+    vh = (vh >> 1) ^ (t << 32);
+    k->hl[i] = vl;
+    k->hh[i] = vh;
+  }
+  for (int i = 2; i <= 8; i *= 2) {
+    for (int j = 1; j < i; j++) {
+      k->hh[i + j] = k->hh[i] ^ k->hh[j];
+      k->hl[i + j] = k->hl[i] ^ k->hl[j];
+    }
+  }
+
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  k->hw = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") &&
+          __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+  if (k->hw) {
+    init_hpow_hw(k, h);
+  }
+#endif // if defined(__x86_64__)
+  wipe(h, sizeof(h));
+}
+
+static void
+gcm(const GcmKey *k, const uint8_t iv[12], const uint8_t *aad, size_t aadLen,
+    uint8_t *buf, size_t len, bool encrypt, uint8_t tag[16])
+{
+#if defined(__x86_64__)
+  if (k->hw) {
+    gcm_hw(k, iv, aad, aadLen, buf, len, encrypt, tag);
+    return;
+  }
+#endif // if defined(__x86_64__)
+  gcm_sw(k, iv, aad, aadLen, buf, len, encrypt, tag);
+}
+
+// Known-answer tests: the AES-256 test cases 13 to 16 of "The Galois/Counter
+// Mode of Operation (GCM)" by McGrew and Viega, as used by NIST.
+static const uint8_t kat_zero[32] = { 0 };
+
+static const uint8_t kat_key[32] = {
+  0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+  0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+  0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+  0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+};
+
+static const uint8_t kat_iv[12] = {
+  0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,
+  0xde, 0xca, 0xf8, 0x88,
+};
+
+static const uint8_t kat_plain[64] = {
+  0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5,
+  0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+  0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda,
+  0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,
+  0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53,
+  0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+  0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57,
+  0xba, 0x63, 0x7b, 0x39, 0x1a, 0xaf, 0xd2, 0x55,
+};
+
+static const uint8_t kat_cipher[64] = {
+  0x52, 0x2d, 0xc1, 0xf0, 0x99, 0x56, 0x7d, 0x07,
+  0xf4, 0x7f, 0x37, 0xa3, 0x2a, 0x84, 0x42, 0x7d,
+  0x64, 0x3a, 0x8c, 0xdc, 0xbf, 0xe5, 0xc0, 0xc9,
+  0x75, 0x98, 0xa2, 0xbd, 0x25, 0x55, 0xd1, 0xaa,
+  0x8c, 0xb0, 0x8e, 0x48, 0x59, 0x0d, 0xbb, 0x3d,
+  0xa7, 0xb0, 0x8b, 0x10, 0x56, 0x82, 0x88, 0x38,
+  0xc5, 0xf6, 0x1e, 0x63, 0x93, 0xba, 0x7a, 0x0a,
+  0xbc, 0xc9, 0xf6, 0x62, 0x89, 0x80, 0x15, 0xad,
+};
+
+static const uint8_t kat_zero_cipher[16] = {
+  0xce, 0xa7, 0x40, 0x3d, 0x4d, 0x60, 0x6b, 0x6e,
+  0x07, 0x4e, 0xc5, 0xd3, 0xba, 0xf3, 0x9d, 0x18,
+};
+
+static const uint8_t kat_aad[20] = {
+  0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+  0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+  0xab, 0xad, 0xda, 0xd2,
+};
+
+struct GcmKat {
+  const uint8_t *key;
+  const uint8_t *iv;
+  const uint8_t *plain;
+  const uint8_t *cipher;
+  size_t len;
+  size_t aadLen;                       // A prefix of kat_aad
+  uint8_t tag[16];
+};
+
+static const GcmKat gcm_kats[] = {
+  { kat_zero, kat_zero, kat_zero, kat_zero_cipher, 0, 0,
+    { 0x53, 0x0f, 0x8a, 0xfb, 0xc7, 0x45, 0x36, 0xb9,
+      0xa9, 0x63, 0xb4, 0xf1, 0xc4, 0xcb, 0x73, 0x8b } },
+  { kat_zero, kat_zero, kat_zero, kat_zero_cipher, 16, 0,
+    { 0xd0, 0xd1, 0xc8, 0xa7, 0x99, 0x99, 0x6b, 0xf0,
+      0x26, 0x5b, 0x98, 0xb5, 0xd4, 0x8a, 0xb9, 0x19 } },
+  { kat_key, kat_iv, kat_plain, kat_cipher, 64, 0,
+    { 0xb0, 0x94, 0xda, 0xc5, 0xd9, 0x34, 0x71, 0xbd,
+      0xec, 0x1a, 0x50, 0x22, 0x70, 0xe3, 0xcc, 0x6c } },
+  { kat_key, kat_iv, kat_plain, kat_cipher, 60, 20,
+    { 0x76, 0xfc, 0x6e, 0xce, 0x0f, 0x4e, 0x17, 0x68,
+      0xcd, 0xdf, 0x88, 0x53, 0xbb, 0x2d, 0x55, 0x1b } },
+};
+
+typedef void (*GcmFn)(const GcmKey *k, const uint8_t iv[12],
+                      const uint8_t *aad, size_t aadLen, uint8_t *buf,
+                      size_t len, bool encrypt, uint8_t tag[16]);
+
+// Encrypts, then decrypts, one test case.
+static bool
+gcm_kat(GcmFn fn, const GcmKey *k, const GcmKat &t)
+{
+  uint8_t buf[64], tag[16];
+
+  memcpy(buf, t.plain, t.len);
+  fn(k, t.iv, kat_aad, t.aadLen, buf, t.len, true, tag);
+  if (memcmp(buf, t.cipher, t.len) != 0 || memcmp(tag, t.tag, 16) != 0) {
+    return false;
+  }
+  fn(k, t.iv, kat_aad, t.aadLen, buf, t.len, false, tag);
+  return memcmp(buf, t.plain, t.len) == 0 && memcmp(tag, t.tag, 16) == 0;
+}
+
+#if defined(__x86_64__)
+
+// The test cases are too short to run the four-block loop of gcm_hw more
+// than once, so also check it against gcm_sw on a longer, unaligned input.
+static bool
+gcm_hw_matches_sw(const GcmKey *k)
+{
+  static uint8_t a[1000], b[1000];
+  uint8_t tagA[16], tagB[16];
+
+  for (size_t i = 0; i < sizeof(a); i++) {
+    a[i] = b[i] = (uint8_t)(i * 7 + 3);
+  }
+  gcm_sw(k, kat_iv, kat_aad, 13, a + 1, sizeof(a) - 1, true, tagA);
+  gcm_hw(k, kat_iv, kat_aad, 13, b + 1, sizeof(b) - 1, true, tagB);
+  return memcmp(a, b, sizeof(a)) == 0 && memcmp(tagA, tagB, 16) == 0;
+}
+#endif // if defined(__x86_64__)
+
+bool
+CkptCrypt::selfTest()
+{
+  GcmKey k;
+  bool ok = true;
+
+  for (size_t i = 0; ok && i < sizeof(gcm_kats) / sizeof(gcm_kats[0]); i++) {
+    gcm_init_key(&k, gcm_kats[i].key);
+    ok = gcm_kat(gcm_sw, &k, gcm_kats[i]);
+#if defined(__x86_64__)
+    if (ok && k.hw) {
+      ok = gcm_kat(gcm_hw, &k, gcm_kats[i]) && gcm_hw_matches_sw(&k);
+    }
+#endif // if defined(__x86_64__)
+  }
+  wipe(&k, sizeof(k));
+  return ok;
+}
+
+// The nonce of a segment, and the data that its tag also covers.
+static void
+segment_iv_and_aad(const CkptCryptHeader &hdr, uint32_t segment, bool last,
+                   uint8_t iv[12], uint8_t aad[sizeof(CkptCryptHeader) + 1])
+{
+  memcpy(iv, hdr.noncePrefix, sizeof(hdr.noncePrefix));
+  store_be32(iv + sizeof(hdr.noncePrefix), segment);
+  memcpy(aad, &hdr, sizeof(hdr));
+  aad[sizeof(hdr)] = last ? 1 : 0;
+}
+
+static int
+random_bytes(void *buf, size_t len)
+{
+#ifdef SYS_getrandom
+  if (_real_syscall(SYS_getrandom, buf, len, 0) == (long)len) {
+    return 0;
+  }
+#endif // ifdef SYS_getrandom
+  int fd = _real_open("/dev/urandom", O_RDONLY);
+  if (fd == -1) {
+    return -1;
+  }
+  ssize_t rc = Util::readAll(fd, buf, len);
+  _real_close(fd);
+  return rc == (ssize_t)len ? 0 : -1;
+}
+
+/* The encryptor runs in a child forked from the checkpoint thread, where even
+ * malloc() or a wrapped mmap() could deadlock.  A static buffer is only ever
+ * touched by that child (or by the decryptor child of dmtcp_restart), so it
+ * costs the checkpointed process nothing.
+ */
+static uint8_t segmentBuf[CKPT_CRYPT_SEGMENT_SIZE + CKPT_CRYPT_TAG_SIZE];
+
+int
+CkptCrypt::encryptStream(int infd, int outfd,
+                         const uint8_t key[CKPT_CRYPT_KEY_SIZE])
+{
+  const size_t segmentSize = CKPT_CRYPT_SEGMENT_SIZE;
+  CkptCryptHeader hdr;
+  GcmKey k;
+  int ret = -1;
+
+  memset(&hdr, 0, sizeof(hdr));
+  strncpy(hdr.magic, CKPT_CRYPT_MAGIC, sizeof(hdr.magic));
+  hdr.segmentSize = segmentSize;
+
+  // A random nonce prefix per image lets us reuse the key for every image.
+  uint8_t *buf = segmentBuf;
+  if (random_bytes(hdr.noncePrefix, sizeof(hdr.noncePrefix)) != 0) {
+    return -1;
+  }
+  gcm_init_key(&k, key);
+
+  // Read the first segment before writing the header, so that the header can
+  // say if the image is gzipped.  dmtcp_restart needs to know that up front.
+  ssize_t n = Util::readAll(infd, buf, segmentSize);
+  if (n > 0 && buf[0] == 037) {
+    hdr.flags |= CKPT_CRYPT_GZIPPED;
+  }
+  if (n >= 0 &&
+      Util::writeAll(outfd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr)) {
+    for (uint32_t segment = 0; ; segment++) {
+      uint8_t iv[12], aad[sizeof(hdr) + 1];
+      bool last = (size_t)n < segmentSize;
+      segment_iv_and_aad(hdr, segment, last, iv, aad);
+      gcm(&k, iv, aad, sizeof(aad), buf, n, true, buf + n);
+      ssize_t len = n + CKPT_CRYPT_TAG_SIZE;
+      if (Util::writeAll(outfd, buf, len) != len) {
+        break;
+      }
+      if (last) {
+        ret = 0;
+        break;
+      }
+      if (segment == UINT32_MAX) {
+        break;
+      }
+      n = Util::readAll(infd, buf, segmentSize);
+      if (n < 0) {
+        break;
+      }
+    }
+  }
+
+  wipe(&k, sizeof(k));
+  wipe(buf, segmentSize + CKPT_CRYPT_TAG_SIZE);
+  return ret;
+}
+
+bool
+CkptCrypt::readHeader(int fd, CkptCryptHeader *hdr)
+{
+  if (Util::readAll(fd, hdr, sizeof(*hdr)) != (ssize_t)sizeof(*hdr)) {
+    return false;
+  }
+  return strncmp(hdr->magic, CKPT_CRYPT_MAGIC, sizeof(hdr->magic)) == 0 &&
+         hdr->segmentSize > 0 && hdr->segmentSize <= CKPT_CRYPT_SEGMENT_SIZE;
+}
+
+int
+CkptCrypt::decryptStream(int infd,
+                         int outfd,
+                         const uint8_t key[CKPT_CRYPT_KEY_SIZE],
+                         const CkptCryptHeader &hdr)
+{
+  const size_t segmentSize = hdr.segmentSize;
+  GcmKey k;
+  int ret = -1;
+
+  uint8_t *buf = segmentBuf;
+  gcm_init_key(&k, key);
+
+  for (uint32_t segment = 0; ; segment++) {
+    ssize_t n = Util::readAll(infd, buf, segmentSize + CKPT_CRYPT_TAG_SIZE);
+    if (n < CKPT_CRYPT_TAG_SIZE) {
+      break; // Read error, or truncated image.
+    }
+    size_t len = n - CKPT_CRYPT_TAG_SIZE;
+    bool last = len < segmentSize;
+    uint8_t iv[12], aad[sizeof(hdr) + 1], tag[CKPT_CRYPT_TAG_SIZE];
+    segment_iv_and_aad(hdr, segment, last, iv, aad);
+    gcm(&k, iv, aad, sizeof(aad), buf, len, false, tag);
+
+    // Compare in constant time.
+    uint8_t diff = 0;
+    for (int i = 0; i < CKPT_CRYPT_TAG_SIZE; i++) {
+      diff |= tag[i] ^ buf[len + i];
+    }
+    if (diff != 0) {
+      break;
+    }
+    if (Util::writeAll(outfd, buf, len) != (ssize_t)len) {
+      break;
+    }
+    if (last) {
+      ret = 0;
+      break;
+    }
+    if (segment == UINT32_MAX) {
+      break;
+    }
+  }
+
+  wipe(&k, sizeof(k));
+  wipe(buf, segmentSize + CKPT_CRYPT_TAG_SIZE);
+  return ret;
+}
+
+static int
+hex_value(char c)
+{
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// A key is 32 raw bytes, or 64 hex digits (optionally followed by a newline).
+static bool
+parse_key(const char *data, size_t len, uint8_t key[CKPT_CRYPT_KEY_SIZE])
+{
+  if (len == CKPT_CRYPT_KEY_SIZE) {
+    memcpy(key, data, CKPT_CRYPT_KEY_SIZE);
+    return true;
+  }
+  while (len > 0 && (data[len - 1] == '\n' || data[len - 1] == '\r')) {
+    len--;
+  }
+  if (len != 2 * CKPT_CRYPT_KEY_SIZE) {
+    return false;
+  }
+  for (size_t i = 0; i < CKPT_CRYPT_KEY_SIZE; i++) {
+    int hi = hex_value(data[2 * i]);
+    int lo = hex_value(data[2 * i + 1]);
+    if (hi < 0 || lo < 0) {
+      return false;
+    }
+    key[i] = (hi << 4) | lo;
+  }
+  return true;
+}
+
+void
+CkptCrypt::installKey()
+{
+  const char *keyFile = getenv(ENV_VAR_CKPT_KEY_FILE);
+  const char *keyFdStr = getenv(ENV_VAR_CKPT_KEY_FD);
+
+  if ((keyFile == NULL || keyFile[0] == '\0') &&
+      (keyFdStr == NULL || keyFdStr[0] == '\0')) {
+    return;
+  }
+
+  int fd;
+  if (keyFile != NULL && keyFile[0] != '\0') {
+    fd = open(keyFile, O_RDONLY);
+    JASSERT(fd != -1) (keyFile) (JASSERT_ERRNO)
+    .Text("Cannot open the checkpoint key file");
+  } else {
+    fd = atoi(keyFdStr);
+  }
+
+  // Room for one byte too many, so that a longer file is rejected.
+  char data[2 * CKPT_CRYPT_KEY_SIZE + 3];
+  uint8_t key[CKPT_CRYPT_KEY_SIZE];
+  ssize_t len = Util::readAll(fd, data, sizeof(data));
+  JASSERT(len != -1) (fd) (JASSERT_ERRNO)
+  .Text("Cannot read the checkpoint key");
+  close(fd);
+  JASSERT(parse_key(data, len, key)) (len)
+  .Text("The checkpoint key must be 32 bytes, or 64 hex digits");
+  wipe(data, sizeof(data));
+  JASSERT(selfTest())
+  .Text("AES-256-GCM failed its known-answer test; not using the key");
+
+  // Keep the key in an anonymous, sealed memfd: unlike an environment
+  // variable, it is not visible in /proc/PID/environ, and it is never written
+  // into the checkpoint image.
+#ifdef SYS_memfd_create
+  int keyFd = syscall(SYS_memfd_create, "dmtcp-ckpt-key", MFD_ALLOW_SEALING);
+#else // ifdef SYS_memfd_create
+  int keyFd = -1;
+  errno = ENOSYS;
+#endif // ifdef SYS_memfd_create
+  JASSERT(keyFd != -1) (JASSERT_ERRNO)
+  .Text("memfd_create() failed; cannot keep the checkpoint key");
+  JASSERT(Util::writeAll(keyFd, key, sizeof(key)) == (ssize_t)sizeof(key));
+  wipe(key, sizeof(key));
+#ifdef F_ADD_SEALS
+  fcntl(keyFd, F_ADD_SEALS, F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW |
+                            F_SEAL_WRITE);
+#endif // ifdef F_ADD_SEALS
+  Util::changeFd(keyFd, PROTECTED_CKPT_KEY_FD);
+
+  unsetenv(ENV_VAR_CKPT_KEY_FILE);
+  unsetenv(ENV_VAR_CKPT_KEY_FD);
+}
+
+bool
+CkptCrypt::getKey(uint8_t key[CKPT_CRYPT_KEY_SIZE])
+{
+  return pread(PROTECTED_CKPT_KEY_FD, key, CKPT_CRYPT_KEY_SIZE, 0) ==
+         CKPT_CRYPT_KEY_SIZE;
+}
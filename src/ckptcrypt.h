@@ -0,0 +1,89 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+#ifndef CKPT_CRYPT_H
+#define CKPT_CRYPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Encrypted checkpoint images (AES-256-GCM).
+ *
+ * An encrypted image starts with a plaintext CkptCryptHeader, followed by
+ * the (possibly gzipped) image cut into segments of segmentSize bytes.  Each
+ * segment is written as its ciphertext followed by a 16-byte GCM tag.  The
+ * nonce of segment i is noncePrefix followed by i (32 bits, big-endian); the
+ * additional authenticated data is the header followed by one byte that is 1
+ * for the last segment and 0 otherwise.  The last segment is always shorter
+ * than segmentSize (possibly empty), so a truncated or re-ordered image fails
+ * authentication instead of restarting from partial data.
+ *
+ * The key never appears in the environment or in the image: dmtcp_launch and
+ * dmtcp_restart read it once (--ckpt-key-file/--ckpt-key-fd) and keep it in
+ * an anonymous memfd at PROTECTED_CKPT_KEY_FD, which is inherited by the
+ * processes under checkpoint control.
+ */
+
+#define CKPT_CRYPT_MAGIC        "ENCRYPTED_DMTCP_IMAGE_v1\n"
+#define CKPT_CRYPT_FIRST        'E'
+#define CKPT_CRYPT_KEY_SIZE     32
+#define CKPT_CRYPT_TAG_SIZE     16
+#define CKPT_CRYPT_SEGMENT_SIZE (1024 * 1024)
+
+// Flags of CkptCryptHeader
+#define CKPT_CRYPT_GZIPPED      0x1
+
+struct CkptCryptHeader {
+  char magic[32];
+  uint32_t segmentSize;
+  uint32_t flags;
+  uint8_t noncePrefix[8];
+  uint8_t reserved[16];
+};
+
+namespace dmtcp
+{
+namespace CkptCrypt
+{
+// Reads the key named by DMTCP_CKPT_KEY_FILE or DMTCP_CKPT_KEY_FD (if any),
+// installs it at PROTECTED_CKPT_KEY_FD, and unsets both variables.
+void installKey();
+
+// Checks the portable AES-GCM, and the AES-NI one if this CPU has it, against
+// the AES-256 test vectors of the GCM specification.  installKey() refuses to
+// install a key if this fails.
+bool selfTest();
+
+// Copies the installed key to 'key'; returns false if there is none.
+bool getKey(uint8_t key[CKPT_CRYPT_KEY_SIZE]);
+
+// Reads the header of an encrypted image; returns false if it is not one.
+bool readHeader(int fd, CkptCryptHeader *hdr);
+
+// Encrypts everything read from infd until EOF, and writes the header and
+// the segments to outfd.  Decrypts the segments read from infd (just after
+// the header) and writes only the authenticated plaintext to outfd.  These
+// run in a child process of their own: they use neither malloc nor JASSERT,
+// and return 0 on success and -1 on failure.
+int encryptStream(int infd, int outfd, const uint8_t key[CKPT_CRYPT_KEY_SIZE]);
+int decryptStream(int infd,
+                  int outfd,
+                  const uint8_t key[CKPT_CRYPT_KEY_SIZE],
+                  const CkptCryptHeader &hdr);
+}
+}
+#endif // ifndef CKPT_CRYPT_H
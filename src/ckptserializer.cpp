@@ -41,6 +41,10 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
+#include "../jalib/jfilesystem.h"
+#include "../jalib/jtimer.h"
+#include "ckptbudget.h"
+#include "ckptcrypt.h"
 #include "ckptserializer.h"
 #include "constants.h"
 #include "dmtcp.h"
@@ -64,8 +68,17 @@ using namespace dmtcp;
 
 static int forked_ckpt_status = -1;
 static pid_t ckpt_extcomp_child_pid = -1;
+static pid_t ckpt_encrypt_child_pid = -1;
 static struct sigaction saved_sigchld_action;
+
+// Per-stage cost of writing the checkpoint image (configure --enable-timing).
+JTIMER(ckptOpen);
+JTIMER(ckptHeader);
+JTIMER(ckptMemory);
+JTIMER(ckptCommit);
 static int open_ckpt_to_write(int fd, int pipe_fds[2], char **extcomp_args);
+static int open_ckpt_to_write_encrypted(int fd,
+                                        const uint8_t key[CKPT_CRYPT_KEY_SIZE]);
 void mtcp_writememoryareas(int fd) __attribute__((weak));
 
 /* We handle SIGCHLD while checkpointing. */
@@ -115,7 +128,9 @@ restore_sigchld_handler_and_wait_for_zombie(pid_t pid)
   sigfillset(&suspend_sigset);
   sigdelset(&suspend_sigset, SIGCHLD);
   _real_sigsuspend(&suspend_sigset);
-  JWARNING(_real_waitpid(pid, NULL, 0) != -1) (pid) (JASSERT_ERRNO);
+  if (pid != -1) {
+    JWARNING(_real_waitpid(pid, NULL, 0) != -1) (pid) (JASSERT_ERRNO);
+  }
   pid = -1;
   sigaction(SIGCHLD, &saved_sigchld_action, NULL);
 }
@@ -226,14 +241,36 @@ perform_open_ckpt_image_fd(const char *tempCkptFilename,
   /* Create temp checkpoint file and write magic number to it */
   int flags = O_CREAT | O_TRUNC | O_WRONLY;
   int fd = _real_open(tempCkptFilename, flags, 0600);
+  if (fd == -1 && errno == ENOENT) {
+    /* First checkpoint into this directory.  Creating the directory only on
+     * demand saves a mkdir() and an access() on every later checkpoint.
+     */
+    CkptSerializer::createCkptDir();
+    fd = _real_open(tempCkptFilename, flags, 0600);
+  }
   *fdCkptFileOnDisk = fd; /* if use_compression, fd will be reset to pipe */
   JASSERT(fd != -1) (tempCkptFilename) (JASSERT_ERRNO)
   .Text("Error creating file.");
 
+  uint8_t key[CKPT_CRYPT_KEY_SIZE];
+  bool use_encryption = CkptCrypt::getKey(key);
+
 #ifdef FAST_RST_VIA_MMAP
+  JASSERT(!use_encryption)
+  .Text("Encrypted checkpoint images cannot be restored via mmap.");
   return fd;
 #endif // ifdef FAST_RST_VIA_MMAP
 
+  /* 1b. If there is a key, a child process encrypts whatever we (or the
+   *     compressor, below) write to it, on the way to the file.
+   */
+  int encrypt_fd = -1;
+  if (use_encryption) {
+    prepare_sigchld_handler();
+    fd = encrypt_fd = open_ckpt_to_write_encrypted(fd, key);
+    memset(key, 0, sizeof(key));
+  }
+
   /* 2. Test if using GZIP/HBICT compression */
   /* 2a. Test if using GZIP compression */
   int use_gzip_compression = 0;
@@ -262,7 +299,9 @@ perform_open_ckpt_image_fd(const char *tempCkptFilename,
     /* 3a. Set SIGCHLD to our own handler;
      *     User handling is restored after gzip finishes.
      */
-    prepare_sigchld_handler();
+    if (!use_encryption) {
+      prepare_sigchld_handler();
+    }
 
     /* 3b. Open pipe */
     int pipe_fds[2];
@@ -293,9 +332,41 @@ perform_open_ckpt_image_fd(const char *tempCkptFilename,
     }
   }
 
+  /* 3d. Only the compressor writes to the encryptor now; the encryptor sees
+   *     EOF when the compressor exits.
+   */
+  if (use_encryption && fd != encrypt_fd) {
+    JWARNING(_real_close(encrypt_fd) == 0) (JASSERT_ERRNO);
+  }
+
   return fd;
 }
 
+static int
+open_ckpt_to_write_encrypted(int fd, const uint8_t key[CKPT_CRYPT_KEY_SIZE])
+{
+  int pipe_fds[2];
+
+  JASSERT(_real_pipe(pipe_fds) != -1) (JASSERT_ERRNO)
+  .Text("Error creating pipe; cannot encrypt the checkpoint image.");
+
+  // A pipe that holds a whole segment lets us write the next segment while
+  // the encryptor is busy with the last one.
+  _real_fcntl(pipe_fds[1], F_SETPIPE_SZ, CKPT_CRYPT_SEGMENT_SIZE);
+
+  pid_t cpid = _real_sys_fork();
+  JASSERT(cpid != -1) (JASSERT_ERRNO)
+  .Text("Error forking the encryptor; no checkpoint will be written.");
+  if (cpid == 0) {
+    _real_close(pipe_fds[1]);
+    _exit(CkptCrypt::encryptStream(pipe_fds[0], fd, key) == 0 ? 0 : 1);
+  }
+
+  ckpt_encrypt_child_pid = cpid;
+  JWARNING(_real_close(pipe_fds[0]) == 0) (JASSERT_ERRNO);
+  return pipe_fds[1];
+}
+
 static int
 test_and_prepare_for_forked_ckpt()
 {
@@ -303,7 +374,8 @@ test_and_prepare_for_forked_ckpt()
   return 1;
 #endif // ifdef TEST_FORKED_CHECKPOINTING
 
-  if (getenv(ENV_VAR_FORKED_CKPT) == NULL) {
+  if (getenv(ENV_VAR_FORKED_CKPT) == NULL ||
+      !CkptBudget::forkedCkptFits()) {
     return 0;
   }
 
@@ -381,6 +453,7 @@ open_ckpt_to_write(int fd, int pipe_fds[2], char **extcomp_args)
     if (fd > STDERR_FILENO) {
       _real_close(fd);
     }
+    _real_close(PROTECTED_CKPT_KEY_FD);
 
     // Don't load libdmtcp.so, etc. in exec.
     unsetenv("LD_PRELOAD"); // If in bash, this is bash env. var. version
@@ -412,6 +485,15 @@ CkptSerializer::createCkptDir()
 
   JASSERT(0 == access(ckptDir.c_str(), X_OK | W_OK)) (ckptDir)
   .Text("ERROR: Missing execute- or write-access to checkpoint dir");
+
+  // The image may live in a shard subdirectory (DMTCP_CKPT_SHARDS).
+  string shardDir = jalib::Filesystem::DirName(
+      ProcessInfo::instance().getCkptFilename());
+  if (shardDir != ckptDir) {
+    JASSERT(mkdir(shardDir.c_str(), S_IRWXU) == 0 || errno == EEXIST)
+      (JASSERT_ERRNO) (shardDir)
+    .Text("Error creating checkpoint shard directory");
+  }
 }
 
 // See comments above for open_ckpt_to_read()
@@ -424,7 +506,6 @@ CkptSerializer::writeCkptImage(void *mtcpHdr, size_t mtcpHdrLen)
   tempCkptFilename += ".temp";
 
   JTRACE("Thread performing checkpoint.") (dmtcp_gettid());
-  createCkptDir();
   forked_ckpt_status = test_and_prepare_for_forked_ckpt();
   if (forked_ckpt_status == FORKED_CKPT_PARENT) {
     JTRACE("*** Using forked checkpointing.\n");
@@ -438,25 +519,45 @@ CkptSerializer::writeCkptImage(void *mtcpHdr, size_t mtcpHdrLen)
   int fdCkptFileOnDisk = -1;
   int fd = -1;
 
+  JTIMER_START(ckptOpen);
   fd = perform_open_ckpt_image_fd(tempCkptFilename.c_str(), &use_compression,
                                   &fdCkptFileOnDisk);
   JASSERT(fdCkptFileOnDisk >= 0);
-  JASSERT(use_compression || fd == fdCkptFileOnDisk);
+  JASSERT(use_compression || ckpt_encrypt_child_pid != -1 ||
+          fd == fdCkptFileOnDisk);
+  JTIMER_STOP(ckptOpen);
+  CkptBudget::startImage(use_compression ? ckpt_extcomp_child_pid : -1,
+                         ckpt_encrypt_child_pid);
 
-  // The rest of this function is for compatibility with original definition.
-  writeDmtcpHeader(fd);
-
-  // Write MTCP header
-  JASSERT(Util::writeAll(fd, mtcpHdr, mtcpHdrLen) == (ssize_t)mtcpHdrLen);
+  // DMTCP header, ProcessInfo and MTCP header go out in a single write.
+  JTIMER_START(ckptHeader);
+  writeDmtcpHeader(fd, mtcpHdr, mtcpHdrLen);
+  JTIMER_STOP(ckptHeader);
 
   JTRACE("MTCP is about to write checkpoint image.")(ckptFilename);
+  JTIMER_START(ckptMemory);
   mtcp_writememoryareas(fd);
+  JTIMER_STOP(ckptMemory);
 
-  if (use_compression) {
+  JTIMER_START(ckptCommit);
+  bool use_encryption = ckpt_encrypt_child_pid != -1;
+  if (use_encryption) {
+    /* The encryptor exits after the compressor (if any), once it has written
+     * the last segment.  Anything but a clean exit means a bad image.
+     */
+    int status;
+    JASSERT(_real_waitpid(ckpt_encrypt_child_pid, &status, 0) ==
+            ckpt_encrypt_child_pid) (JASSERT_ERRNO);
+    JASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0) (status)
+    .Text("Encrypting the checkpoint image failed.");
+    ckpt_encrypt_child_pid = -1;
+  }
+  if (use_compression || use_encryption) {
     /* In perform_open_ckpt_image_fd(), we set SIGCHLD to our own handler.
      * Restore it now.
      */
-    restore_sigchld_handler_and_wait_for_zombie(ckpt_extcomp_child_pid);
+    restore_sigchld_handler_and_wait_for_zombie(
+      use_compression ? ckpt_extcomp_child_pid : -1);
 
     /* IF OUT OF DISK SPACE, REPORT IT HERE. */
     JASSERT(fsync(fdCkptFileOnDisk) != -1) (JASSERT_ERRNO)
@@ -470,6 +571,8 @@ CkptSerializer::writeCkptImage(void *mtcpHdr, size_t mtcpHdrLen)
    * So, gzip process can continue to write to file even after renaming.
    */
   JASSERT(rename(tempCkptFilename.c_str(), ckptFilename.c_str()) == 0);
+  JTIMER_STOP(ckptCommit);
+  CkptBudget::endImage();
 
   if (forked_ckpt_status == FORKED_CKPT_CHILD) {
     // Use _exit() instead of exit() to avoid popping atexit() handlers
@@ -481,19 +584,23 @@ CkptSerializer::writeCkptImage(void *mtcpHdr, size_t mtcpHdrLen)
 }
 
 void
-CkptSerializer::writeDmtcpHeader(int fd)
+CkptSerializer::writeDmtcpHeader(int fd, void *mtcpHdr, size_t mtcpHdrLen)
 {
-  const ssize_t len = strlen(DMTCP_FILE_HEADER);
-
-  JASSERT(write(fd, DMTCP_FILE_HEADER, len) == len);
+  // Serialize into memory: JBinarySerializeWriterRaw would issue one small
+  // write() per field, which is costly on parallel filesystems.
+  jalib::JBinarySerializeWriterMem wr("");
+  string &buf = wr.buffer();
 
-  jalib::JBinarySerializeWriterRaw wr("", fd);
+  buf.append(DMTCP_FILE_HEADER);
   ProcessInfo::instance().serialize(wr);
-  ssize_t written = len + wr.bytes();
 
-  // We must write in multiple of PAGE_SIZE
-  const ssize_t pagesize = Util::pageSize();
-  ssize_t remaining = pagesize - (written % pagesize);
-  char buf[remaining];
-  JASSERT(Util::writeAll(fd, buf, remaining) == remaining);
+  // We must write in multiple of PAGE_SIZE.  This keeps the MTCP header and
+  // the memory areas after it page aligned, as required for direct I/O.
+  const size_t pagesize = Util::pageSize();
+  buf.append(pagesize - (buf.size() % pagesize), '\0');
+
+  buf.append((const char *)mtcpHdr, mtcpHdrLen);
+
+  JASSERT(Util::writeAll(fd, buf.data(), buf.size()) == (ssize_t)buf.size())
+    (buf.size()) (JASSERT_ERRNO);
 }
@@ -33,7 +33,7 @@ namespace CkptSerializer
 int openCkptFileToWrite(const string &path);
 void createCkptDir();
 void writeCkptImage(void *mtcpHdr, size_t mtcpHdrLen);
-void writeDmtcpHeader(int fd);
+void writeDmtcpHeader(int fd, void *mtcpHdr, size_t mtcpHdrLen);
 }
 }
 #endif // ifndef CKPT_SERIZLIZER_H
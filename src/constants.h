@@ -50,6 +50,8 @@
 #define CKPT_FILE_SUFFIX_LEN     strlen(".dmtcp")
 #define CKPT_FILES_SUBDIR_PREFIX "ckpt_"
 #define CKPT_FILES_SUBDIR_SUFFIX "_files"
+#define CKPT_SHARD_PREFIX        "ckpt_shard_"
+#define CKPT_SUBSET_DIR_PREFIX   "subset_"
 
 // Not used
 // #define X11_LISTENER_PORT_START 6000
@@ -81,6 +83,10 @@
 #define ENV_VAR_HIJACK_LIBS         "DMTCP_HIJACK_LIBS"
 #define ENV_VAR_HIJACK_LIBS_M32     "DMTCP_HIJACK_LIBS_M32"
 #define ENV_VAR_CHECKPOINT_DIR      "DMTCP_CHECKPOINT_DIR"
+#define ENV_VAR_CKPT_SHARDS         "DMTCP_CKPT_SHARDS"
+#define ENV_VAR_KEEP_GENERATIONS    "DMTCP_KEEP_GENERATIONS"
+#define ENV_VAR_KEEP_BYTES          "DMTCP_KEEP_BYTES"
+#define ENV_VAR_CKPT_SUBSET         "DMTCP_CKPT_SUBSET"
 #define ENV_VAR_TMPDIR              "DMTCP_TMPDIR"
 #define ENV_VAR_CKPT_OPEN_FILES     "DMTCP_CKPT_OPEN_FILES"
 #define ENV_VAR_ALLOW_OVERWRITE_WITH_CKPTED_FILES \
@@ -92,12 +98,25 @@
 // Keep in sync with plugin/pid/pidwrappers.h
 #define ENV_VAR_VIRTUAL_PID         "DMTCP_VIRTUAL_PID"
 
+// Set by dmtcp_restart --native-pids: the processes run in a PID namespace
+// of their own with their original pids, which are not translated.
+#define ENV_VAR_NATIVE_PIDS         "DMTCP_NATIVE_PIDS"
+
+// dmtcp_launch --virtual-time.  Keep in sync with plugin/timer/virtualtime.h
+#define ENV_VAR_VIRTUAL_TIME        "DMTCP_VIRTUAL_TIME"
+
 // Keep in sync with plugin/batch-queue/rm_pmi.h
 #define ENV_VAR_EXPLICIT_SRUN       "DMTCP_EXPLICIT_SRUN"
 #define ENV_VAR_SKIP_WRITING_TEXT_SEGMENTS \
                                     "DMTCP_SKIP_WRITING_TEXT_SEGMENTS"
 
 #define ENV_VAR_COORD_LOGFILE       "DMTCP_COORD_LOG_FILENAME"
+#define ENV_VAR_COORD_JOURNAL       "DMTCP_COORD_JOURNAL"
+#define ENV_VAR_COORD_RECONNECT_TIMEOUT "DMTCP_COORD_RECONNECT_TIMEOUT"
+
+// Reach a coordinator on the same host over TCP, rather than through its
+// Unix-domain socket.
+#define ENV_VAR_COORD_TCP_ONLY      "DMTCP_COORD_TCP_ONLY"
 
 // it is not yet safe to change these; these names are hard-wired in the code
 #define ENV_VAR_STDERR_PATH         "JALIB_STDERR_PATH"
@@ -112,16 +131,43 @@
 #endif // ifdef HBICT_DELTACOMP
 
 #define ENV_VAR_FORKED_CKPT             "DMTCP_FORKED_CHECKPOINT"
+
+// Checkpoint budgets; see ckptbudget.h.
+#define ENV_VAR_CKPT_WRITE_RATE         "DMTCP_CKPT_WRITE_RATE"
+#define ENV_VAR_CKPT_HELPER_CPU         "DMTCP_CKPT_HELPER_CPU"
+#define ENV_VAR_CKPT_MAX_MEMORY         "DMTCP_CKPT_MAX_MEMORY"
+
 #define ENV_VAR_SIGCKPT                 "DMTCP_SIGCKPT"
 #define ENV_VAR_SCREENDIR               "SCREENDIR"
 #define ENV_VAR_DISABLE_STRICT_CHECKING "DMTCP_DISABLE_STRICT_CHECKING"
 
 #define ENV_VAR_REMOTE_SHELL_CMD        "DMTCP_REMOTE_SHELL_CMD"
 
+#define ENV_VAR_UNTRACKED_HELPERS         "DMTCP_UNTRACKED_HELPERS"
+#define ENV_VAR_UNTRACKED_HELPERS_TIMEOUT "DMTCP_UNTRACKED_HELPERS_TIMEOUT"
+
+// Milliseconds to let threads park at dmtcp_safe_point() before signalling.
+#define ENV_VAR_QUIESCE_TIMEOUT           "DMTCP_QUIESCE_TIMEOUT"
+
+// Key to encrypt checkpoint images with: a file, or an open fd, holding 32
+// raw bytes or 64 hex digits.  These are read once by dmtcp_launch or
+// dmtcp_restart and then unset, so they are deliberately not in ENV_VARS_ALL.
+#define ENV_VAR_CKPT_KEY_FILE             "DMTCP_CKPT_KEY_FILE"
+#define ENV_VAR_CKPT_KEY_FD               "DMTCP_CKPT_KEY_FD"
+#define ENV_VAR_RESTART_VERIFY_INLINE     "DMTCP_RESTART_VERIFY_INLINE"
+
+// Seconds a checkpoint waits for untracked helpers to exit.
+#define DEFAULT_UNTRACKED_HELPERS_TIMEOUT 10
+
+// Seconds the processes of a computation wait for a journaling coordinator
+// that died to come back.
+#define DEFAULT_COORD_RECONNECT_TIMEOUT 60
+
 // this list should be kept up to date with all "protected" environment vars
 #define ENV_VARS_ALL                  \
   ENV_VAR_NAME_HOST,                  \
   ENV_VAR_NAME_PORT,                  \
+  ENV_VAR_COORD_TCP_ONLY,             \
   ENV_VAR_CKPT_INTR,                  \
   ENV_VAR_REMOTE_SHELL_CMD,           \
   ENV_VAR_ORIG_LD_PRELOAD,            \
@@ -129,17 +175,28 @@
   ENV_VAR_HIJACK_LIBS_M32,            \
   ENV_VAR_PLUGIN,                     \
   ENV_VAR_CHECKPOINT_DIR,             \
+  ENV_VAR_CKPT_SHARDS,                \
+  ENV_VAR_KEEP_GENERATIONS,           \
+  ENV_VAR_KEEP_BYTES,                 \
   ENV_VAR_TMPDIR,                     \
   ENV_VAR_CKPT_OPEN_FILES,            \
   ENV_VAR_QUIET,                      \
   ENV_VAR_STDERR_PATH,                \
   ENV_VAR_COMPRESSION,                \
+  ENV_VAR_CKPT_WRITE_RATE,            \
+  ENV_VAR_CKPT_HELPER_CPU,            \
+  ENV_VAR_CKPT_MAX_MEMORY,            \
   ENV_VAR_ALLOC_PLUGIN,               \
   ENV_VAR_DL_PLUGIN,                  \
   ENV_VAR_SIGCKPT,                    \
   ENV_VAR_SCREENDIR,                  \
   ENV_VAR_VIRTUAL_PID,                \
+  ENV_VAR_NATIVE_PIDS,                \
+  ENV_VAR_VIRTUAL_TIME,               \
   ENV_VAR_SKIP_WRITING_TEXT_SEGMENTS, \
+  ENV_VAR_UNTRACKED_HELPERS,          \
+  ENV_VAR_UNTRACKED_HELPERS_TIMEOUT,  \
+  ENV_VAR_QUIESCE_TIMEOUT,            \
   ENV_DELTACOMPRESSION
 
 #define DMTCP_RESTART_CMD       "dmtcp_restart"
@@ -147,6 +204,9 @@
 #define RESTART_SCRIPT_BASENAME "dmtcp_restart_script"
 #define RESTART_SCRIPT_EXT      "sh"
 
+#define RESTART_MANIFEST_BASENAME "dmtcp_restart_manifest"
+#define RESTART_MANIFEST_EXT      "txt"
+
 #define DMTCP_FILE_HEADER       "DMTCP_CHECKPOINT_IMAGE_v2.0\n"
 
 // #define MIN_SIGNAL 1
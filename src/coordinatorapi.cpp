@@ -30,6 +30,7 @@
 #include <semaphore.h>  // for sem_post(&sem_launch)
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include "../jalib/jconvert.h"
 #include "../jalib/jfilesystem.h"
@@ -211,6 +212,72 @@ getCkptInterval()
   return ret;
 }
 
+static bool
+isLocalCoordHost(const string &host)
+{
+  return strcmp(host.c_str(), "localhost") == 0 ||
+         strcmp(host.c_str(), "127.0.0.1") == 0 ||
+         jalib::Filesystem::GetCurrentHostname() == host.c_str();
+}
+
+/* A coordinator on this host also listens on an abstract Unix-domain socket
+ * (see Util::coordUnixSocketAddr()), which saves the TCP/IP stack on each
+ * message.  Anyone may bind an abstract name, so we only talk to a
+ * coordinator of our own user.  Returns -1 if there is none, and the caller
+ * falls back to TCP.
+ */
+static int
+connectToLocalCoordinator(int port)
+{
+  struct sockaddr_un addr;
+  struct ucred cred;
+  socklen_t credLen = sizeof(cred);
+
+  if (port <= 0 || getenv(ENV_VAR_COORD_TCP_ONLY) != NULL) {
+    return -1;
+  }
+
+  socklen_t len = Util::coordUnixSocketAddr(port, &addr);
+  int sock = _real_socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock == -1) {
+    return -1;
+  }
+  if (_real_connect(sock, (struct sockaddr *)&addr, len) != 0) {
+    _real_close(sock);
+    return -1;
+  }
+  if (_real_getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) != 0 ||
+      cred.uid != getuid()) {
+    JWARNING(false) (port) (cred.uid) (getuid())
+      .Text("Coordinator socket belongs to another user; using TCP.");
+    _real_close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+/* The same, for an address recorded by SharedData:  the coordinator is local
+ * if we reached it over the loopback or through our own IP address.
+ */
+static int
+connectToCoordinator(const struct sockaddr *addr, socklen_t len)
+{
+  const struct sockaddr_in *sin = (const struct sockaddr_in *)addr;
+
+  if (sin->sin_family == AF_INET) {
+    struct in_addr localIP;
+    SharedData::getLocalIPAddr(&localIP);
+    if ((ntohl(sin->sin_addr.s_addr) >> 24) == IN_LOOPBACKNET ||
+        sin->sin_addr.s_addr == localIP.s_addr) {
+      int sock = connectToLocalCoordinator(ntohs(sin->sin_port));
+      if (sock != -1) {
+        return sock;
+      }
+    }
+  }
+  return jalib::JClientSocket(addr, len).sockfd();
+}
+
 int
 createNewSocketToCoordinator(CoordinatorMode mode)
 {
@@ -218,9 +285,38 @@ createNewSocketToCoordinator(CoordinatorMode mode)
   int port = UNINITIALIZED_PORT;
 
   getCoordHostAndPort(COORD_ANY, &host, &port);
+  if (isLocalCoordHost(host)) {
+    int sock = connectToLocalCoordinator(port);
+    if (sock != -1) {
+      return sock;
+    }
+  }
   return jalib::JClientSocket(host.c_str(), port).sockfd();
 }
 
+/* Records the coordinator's address for SharedData.  That is its TCP address
+ * even when we reached it through its Unix-domain socket:  it is handed to
+ * processes on other hosts (ssh), and coordHost()/coordPort() read it.
+ */
+static void
+recordCoordAddr(CoordinatorInfo *coordInfo)
+{
+  coordInfo->addrLen = sizeof(coordInfo->addr);
+  JASSERT(getpeername(coordinatorSocket,
+                      (struct sockaddr *)&coordInfo->addr,
+                      &coordInfo->addrLen) == 0)
+    (JASSERT_ERRNO);
+
+  if (coordInfo->addr.ss_family == AF_UNIX) {
+    string host = "";
+    int port = UNINITIALIZED_PORT;
+    getCoordHostAndPort(COORD_ANY, &host, &port);
+    jalib::JSockAddr sockAddr(host.c_str(), port);
+    memcpy(&coordInfo->addr, sockAddr.addr(), sockAddr.addrlen());
+    coordInfo->addrLen = sockAddr.addrlen();
+  }
+}
+
 void init()
 {
   JTRACE("Informing coordinator of new process") (UniquePid::ThisProcess());
@@ -260,7 +356,8 @@ connectAndSendUserCommand(char c,
                           int *coordCmdStatus,
                           int *numPeers,
                           int *isRunning,
-                          int *ckptInterval)
+                          int *ckptInterval,
+                          uint64_t *lastCkptDuration)
 {
   char *replyData = NULL;
   int coordFd = createNewSocketToCoordinator(COORD_ANY);
@@ -279,7 +376,17 @@ connectAndSendUserCommand(char c,
       msg.theCheckpointInterval = jalib::StringToInt(interval);
     }
   }
+
+  // Checkpoint only the listed processes.
+  const char *ckptSubset = c == 'c' ? getenv(ENV_VAR_CKPT_SUBSET) : NULL;
+  if (ckptSubset != NULL) {
+    msg.extraBytes = strlen(ckptSubset) + 1;
+  }
   JASSERT(Util::writeAll(coordFd, &msg, sizeof(msg)) == sizeof(msg));
+  if (ckptSubset != NULL) {
+    JASSERT(Util::writeAll(coordFd, ckptSubset, msg.extraBytes) ==
+            (ssize_t)msg.extraBytes);
+  }
 
   // The coordinator will violently close our socket...
   if (c == 'q' || c == 'Q') {
@@ -306,6 +413,9 @@ connectAndSendUserCommand(char c,
   if (ckptInterval != NULL) {
     *ckptInterval = reply.theCheckpointInterval;
   }
+  if (lastCkptDuration != NULL) {
+    *lastCkptDuration = reply.lastCkptDuration;
+  }
 
   _real_close(coordFd);
 
@@ -477,9 +587,7 @@ startNewCoordinator(CoordinatorMode mode)
   int port;
   getCoordHostAndPort(mode, &host, &port);
 
-  JASSERT(strcmp(host.c_str(), "localhost") == 0 ||
-          strcmp(host.c_str(), "127.0.0.1") == 0 ||
-          jalib::Filesystem::GetCurrentHostname() == host.c_str())
+  JASSERT(isLocalCoordHost(host))
     (host) (jalib::Filesystem::GetCurrentHostname())
   .Text("Won't automatically start coordinator because DMTCP_HOST"
         " is set to a remote host.");
@@ -659,11 +767,8 @@ connectToCoordOnStartup(CoordinatorMode mode,
   *compId = hello_remote.compGroup.upid();
   coordInfo->id = hello_remote.from.upid();
   coordInfo->timeStamp = hello_remote.coordTimeStamp;
-  coordInfo->addrLen = sizeof (coordInfo->addr);
-  JASSERT(getpeername(coordinatorSocket,
-                      (struct sockaddr*) &coordInfo->addr,
-                      &coordInfo->addrLen) == 0)
-    (JASSERT_ERRNO);
+  coordInfo->reconnectTimeout = hello_remote.reconnectTimeout;
+  recordCoordAddr(coordInfo);
   memcpy(localIP, &hello_remote.ipAddr, sizeof hello_remote.ipAddr);
 }
 
@@ -678,7 +783,7 @@ createNewConnectionBeforeFork(string& progname)
   uint32_t len;
   SharedData::getCoordAddr((struct sockaddr *)&addr, &len);
   socklen_t addrlen = len;
-  int sock = jalib::JClientSocket((struct sockaddr *)&addr, addrlen);
+  int sock = connectToCoordinator((struct sockaddr *)&addr, addrlen);
   JASSERT(sock != -1);
 
   DmtcpMessage hello_local(DMT_NEW_WORKER);
@@ -724,11 +829,8 @@ connectToCoordOnRestart(CoordinatorMode  mode,
   if (coordInfo != NULL) {
     coordInfo->id = hello_remote.from.upid();
     coordInfo->timeStamp = hello_remote.coordTimeStamp;
-    coordInfo->addrLen = sizeof(coordInfo->addr);
-    JASSERT(getpeername(coordinatorSocket,
-                        (struct sockaddr *)&coordInfo->addr,
-                        &coordInfo->addrLen) == 0)
-      (JASSERT_ERRNO);
+    coordInfo->reconnectTimeout = hello_remote.reconnectTimeout;
+    recordCoordAddr(coordInfo);
   }
   if (localIP != NULL) {
     memcpy(localIP, &hello_remote.ipAddr, sizeof hello_remote.ipAddr);
@@ -737,6 +839,58 @@ connectToCoordOnRestart(CoordinatorMode  mode,
   JTRACE("Coordinator handshake RECEIVED!!!!!");
 }
 
+/* Called by the checkpoint thread when the connection to the coordinator is
+ * lost while running.  A coordinator that journals its state asks us to wait
+ * for it to be restarted (on the same host and port), and to reconnect as the
+ * same process; the computation carries on as if nothing had happened.
+ * Returns false if we should give up.
+ */
+bool
+reconnectToCoordinator()
+{
+  uint32_t timeout = SharedData::getCoordReconnectTimeout();
+  struct sockaddr_storage addr;
+  uint32_t len;
+
+  if (timeout == 0 || WorkerState::currentState() != WorkerState::RUNNING) {
+    return false;
+  }
+
+  SharedData::getCoordAddr((struct sockaddr *)&addr, &len);
+  JNOTE("Lost the connection to the coordinator; waiting for it to come back")
+    (timeout);
+
+  for (uint32_t i = 0; i < timeout; i++) {
+    struct timespec delay = { 1, 0 };
+    nanosleep(&delay, NULL);
+
+    int sock = connectToCoordinator((struct sockaddr *)&addr, len);
+    if (sock == -1) {
+      continue;
+    }
+
+    DmtcpMessage hello_local(DMT_RECONNECT_WORKER);
+    hello_local.compGroup = SharedData::getCompId();
+    hello_local.virtualPid = getpid();
+    hello_local.coordTimeStamp = SharedData::getCoordTimeStamp();
+    UniquePid compGroup = hello_local.compGroup;
+    sendRecvHandshake(sock, hello_local,
+                      jalib::Filesystem::GetProgramName(), &compGroup);
+
+    Util::changeFd(sock, PROTECTED_COORD_FD);
+    JASSERT(Util::isValidFd(coordinatorSocket));
+
+    // The name-service connection went down with the old coordinator.
+    if (nsSock != -1) {
+      _real_close(nsSock);
+      nsSock = -1;
+    }
+    JNOTE("Reconnected to the coordinator") (UniquePid::ThisProcess());
+    return true;
+  }
+  return false;
+}
+
 void
 sendCkptFilename()
 {
@@ -1002,6 +1156,7 @@ setupVirtualCoordinator(CoordinatorInfo *coordInfo, struct in_addr *localIP)
 
   coordInfo->id = coordId.upid();
   coordInfo->timeStamp = coordId.time();
+  coordInfo->reconnectTimeout = 0;
   coordInfo->addrLen = 0;
   if (getenv(ENV_VAR_CKPT_INTR) != NULL) {
     coordInfo->interval = (uint32_t)strtol(getenv(ENV_VAR_CKPT_INTR), NULL, 0);
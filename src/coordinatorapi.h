@@ -71,11 +71,13 @@ void sendMsgToCoordinator(DmtcpMessage msg,
 void sendMsgToCoordinator(const DmtcpMessage &msg, const string &data);
 void recvMsgFromCoordinator(DmtcpMessage *msg, void **extraData = NULL);
 bool waitForBarrier(const string& barrier, uint32_t *numPeers = NULL);
+bool reconnectToCoordinator();
 char *connectAndSendUserCommand(char c,
                                 int *coordCmdStatus = NULL,
                                 int *numPeers = NULL,
                                 int *isRunning = NULL,
-                                int *ckptInterval = NULL);
+                                int *ckptInterval = NULL,
+                                uint64_t *lastCkptDuration = NULL);
 
 void updateCoordCkptDir(const char *dir);
 string getCoordCkptDir(void);
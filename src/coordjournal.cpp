@@ -0,0 +1,195 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+#include "coordjournal.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../jalib/jassert.h"
+#include "util.h"
+
+// Don't bother compacting a journal smaller than this.
+#define COORD_JOURNAL_MIN_COMPACT (1024 * 1024)
+
+using namespace dmtcp;
+
+void
+CoordJournal::open(const string &path, vector<Record> *records)
+{
+  const size_t magicLen = strlen(COORD_JOURNAL_MAGIC);
+
+  _path = path;
+  _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  JASSERT(_fd != -1) (path) (JASSERT_ERRNO)
+    .Text("Failed to open the coordinator journal");
+
+  struct stat st;
+  JASSERT(fstat(_fd, &st) == 0) (path) (JASSERT_ERRNO);
+  if (st.st_size == 0) {
+    clear();
+    return;
+  }
+
+  string contents(st.st_size, '\0');
+  JASSERT(Util::readAll(_fd, &contents[0], st.st_size) == st.st_size)
+    (path) (JASSERT_ERRNO);
+  JASSERT(contents.compare(0, magicLen, COORD_JOURNAL_MAGIC) == 0) (path)
+    .Text("Not a DMTCP coordinator journal");
+
+  size_t offset = magicLen;
+  while (offset + sizeof(CoordJournalRecord) <= contents.size()) {
+    CoordJournalRecord hdr;
+    memcpy(&hdr, &contents[offset], sizeof(hdr));
+    if (hdr.len > contents.size() - offset - sizeof(hdr)) {
+      break;
+    }
+    Record record;
+    record.type = hdr.type;
+    record.data = contents.substr(offset + sizeof(hdr), hdr.len);
+    records->push_back(record);
+    offset += sizeof(hdr) + hdr.len;
+  }
+
+  // Drop a record that was torn by a crash, so that appends line up again.
+  if (offset != contents.size()) {
+    JWARNING(false) (path) (contents.size() - offset)
+      .Text("Dropping a partial record at the end of the journal");
+    JASSERT(ftruncate(_fd, offset) == 0) (path) (JASSERT_ERRNO);
+  }
+  JASSERT(lseek(_fd, offset, SEEK_SET) == (off_t)offset) (JASSERT_ERRNO);
+  _size = _compactedSize = offset;
+}
+
+void
+CoordJournal::addRecord(string *buf,
+                        uint32_t type,
+                        const void *data,
+                        size_t len,
+                        const void *data2,
+                        size_t len2)
+{
+  CoordJournalRecord hdr;
+
+  hdr.type = type;
+  hdr.len = len + len2;
+  buf->append((const char *)&hdr, sizeof(hdr));
+  buf->append((const char *)data, len);
+  buf->append((const char *)data2, len2);
+}
+
+void
+CoordJournal::append(RecordType type,
+                     const void *data,
+                     size_t len,
+                     const void *data2,
+                     size_t len2)
+{
+  if (_fd == -1) {
+    return;
+  }
+
+  string buf;
+  addRecord(&buf, type, data, len, data2, len2);
+  if (Util::writeAll(_fd, buf.data(), buf.size()) != (ssize_t)buf.size()) {
+    // Better to keep coordinating the computation than to stop for this.
+    JWARNING(false) (_path) (JASSERT_ERRNO)
+      .Text("Failed to write the coordinator journal; no longer journaling");
+    ::close(_fd);
+    _fd = -1;
+    return;
+  }
+  _size += buf.size();
+}
+
+void
+CoordJournal::sync()
+{
+  if (_fd != -1) {
+    JWARNING(fdatasync(_fd) == 0) (_path) (JASSERT_ERRNO);
+  }
+}
+
+void
+CoordJournal::clear()
+{
+  if (_fd == -1) {
+    return;
+  }
+  const size_t magicLen = strlen(COORD_JOURNAL_MAGIC);
+  JASSERT(ftruncate(_fd, 0) == 0) (_path) (JASSERT_ERRNO);
+  JASSERT(lseek(_fd, 0, SEEK_SET) == 0) (JASSERT_ERRNO);
+  JASSERT(Util::writeAll(_fd, COORD_JOURNAL_MAGIC, magicLen) ==
+          (ssize_t)magicLen) (_path) (JASSERT_ERRNO);
+  _size = _compactedSize = magicLen;
+}
+
+bool
+CoordJournal::needsCompaction() const
+{
+  return _fd != -1 && _size > 2 * _compactedSize + COORD_JOURNAL_MIN_COMPACT;
+}
+
+void
+CoordJournal::compact(const vector<Record> &records)
+{
+  if (_fd == -1) {
+    return;
+  }
+
+  string buf = COORD_JOURNAL_MAGIC;
+  for (size_t i = 0; i < records.size(); i++) {
+    addRecord(&buf, records[i].type, records[i].data.data(),
+              records[i].data.size());
+  }
+
+  // Until the rename, a crash leaves the old journal, which is still valid.
+  string tmpPath = _path + ".tmp";
+  int fd = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  S_IRUSR | S_IWUSR);
+  if (fd == -1 ||
+      Util::writeAll(fd, buf.data(), buf.size()) != (ssize_t)buf.size() ||
+      fdatasync(fd) != 0 ||
+      rename(tmpPath.c_str(), _path.c_str()) != 0) {
+    JWARNING(false) (tmpPath) (JASSERT_ERRNO)
+      .Text("Failed to compact the coordinator journal; keeping it as is");
+    if (fd != -1) {
+      ::close(fd);
+      unlink(tmpPath.c_str());
+    }
+    sync();
+    return;
+  }
+
+  ::close(_fd);
+  _fd = fd;
+  _size = _compactedSize = buf.size();
+}
+
+void
+CoordJournal::remove()
+{
+  if (_fd == -1) {
+    return;
+  }
+  ::close(_fd);
+  _fd = -1;
+  unlink(_path.c_str());
+}
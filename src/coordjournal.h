@@ -0,0 +1,124 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+#ifndef COORD_JOURNAL_H
+#define COORD_JOURNAL_H
+
+#include <stdint.h>
+
+#include "dmtcp.h"
+#include "dmtcpalloc.h"
+
+/* The coordinator's journal (dmtcp_coordinator --journal).
+ *
+ * The journal is an append-only file of records, each a CoordJournalRecord
+ * header followed by 'len' bytes.  A record is written with a single write(),
+ * so it is in the page cache as soon as the coordinator has acted on it, and
+ * survives the coordinator dying; the journal is only fsync'ed once a
+ * checkpoint is complete.  A torn record at the end (machine crash) is
+ * dropped on replay.  The journal is cleared when a new computation starts,
+ * and removed when the coordinator quits.
+ *
+ * So that it does not grow without bound, the coordinator compacts the
+ * journal when a checkpoint completes, or when it has doubled in size: it
+ * writes the records that recreate its current state to a new file, and
+ * renames that over the journal.
+ */
+
+#define COORD_JOURNAL_MAGIC "DMTCP_COORD_JOURNAL_v1\n"
+
+namespace dmtcp
+{
+struct CoordJournalRecord {
+  uint32_t type;
+  uint32_t len;
+};
+
+struct CoordJournalComputation {
+  DmtcpUniqueProcessId compId;
+  uint64_t timeStamp;
+  int64_t ckptTimeStamp;
+  int32_t numPeers;
+  uint32_t _pad;
+};
+
+class CoordJournal
+{
+  public:
+    enum RecordType {
+      COMPUTATION = 1,     // CoordJournalComputation
+      CKPT_INTERVAL,       // uint32_t interval
+      CKPT_DIR,            // the directory, without its '\0'
+      CKPT_START,          // empty; the restart filenames are cleared
+      CKPT_FILENAME,       // uint32_t unique, then DMT_CKPT_FILENAME data
+      VIRTUAL_PID,         // pid_t pid, int32_t live
+      NAME_SERVICE,        // DmtcpMessage, then its extra data
+      NAME_SERVICE_CKPT_RESET, // empty
+      NAME_SERVICE_STATE   // the whole database (LookupService::save())
+    };
+
+    struct Record {
+      uint32_t type;
+      string data;
+    };
+
+    CoordJournal() : _fd(-1), _size(0), _compactedSize(0) {}
+
+    bool isOpen() const { return _fd != -1; }
+
+    const string &path() const { return _path; }
+
+    // Opens the journal at 'path', creating it if needed, and returns the
+    // records already in it.
+    void open(const string &path, vector<Record> *records);
+
+    void append(RecordType type,
+                const void *data = NULL,
+                size_t len = 0,
+                const void *data2 = NULL,
+                size_t len2 = 0);
+
+    // Forces the records appended so far to disk.
+    void sync();
+
+    // True if the journal has grown enough since it was last compacted.
+    bool needsCompaction() const;
+
+    // Atomically replaces all records with 'records', and syncs them.
+    void compact(const vector<Record> &records);
+
+    // Drops all records.
+    void clear();
+
+    // Deletes the journal; nothing is journaled afterwards.
+    void remove();
+
+  private:
+    static void addRecord(string *buf,
+                          uint32_t type,
+                          const void *data,
+                          size_t len,
+                          const void *data2 = NULL,
+                          size_t len2 = 0);
+
+    string _path;
+    int _fd;
+    size_t _size;
+    size_t _compactedSize;
+};
+}
+#endif // ifndef COORD_JOURNAL_H
@@ -54,6 +54,12 @@ static const char *theUsage =
                                                                       " done\n"
 // Could add -K as synonym for -kc
   "    -kc, --kcheckpoint     Checkpoint all nodes, kill all nodes when done\n"
+  "    --only LIST            With -c, -bc or -kc: checkpoint (and kill) only\n"
+  "                           the processes in LIST, a comma-separated list of\n"
+  "                           virtual pids and program names (see --list).\n"
+  "                           The others keep running.  The checkpoint goes to\n"
+  "                           its own subdirectory of the coordinator's ckpt\n"
+  "                           dir, with a restart script and manifest.\n"
 // "    -xc, --xcheckpoint  deprecated synonym for '-kc': kill nodes if done\n"
   "    -i, --interval <val>   Update ckpt interval to <val> seconds (0=never)\n"
   "    -k, --kill             Kill all nodes\n"
@@ -95,6 +101,9 @@ main(int argc, char **argv)
                (s == "-p" || s == "--coord-port" || s == "--port")) {
       setenv(ENV_VAR_NAME_PORT, argv[1], 1);
       shift; shift;
+    } else if (argc > 1 && s == "--only") {
+      setenv(ENV_VAR_CKPT_SUBSET, argv[1], 1);
+      shift; shift;
     } else if (argv[0][0] == '-' && argv[0][1] == 'p' &&
                isdigit(argv[0][2])) { // else if -p0, for example
       setenv(ENV_VAR_NAME_PORT, argv[0] + 2, 1);
@@ -146,6 +155,7 @@ main(int argc, char **argv)
   int numPeers;
   int isRunning;
   int ckptInterval;
+  uint64_t lastCkptDuration = 0;
   char *workerList = NULL;
   char *cmd = (char *)request.c_str();
   switch (*cmd) {
@@ -172,7 +182,8 @@ main(int argc, char **argv)
                                               &coordCmdStatus,
                                               &numPeers,
                                               &isRunning,
-                                              &ckptInterval);
+                                              &ckptInterval,
+                                              &lastCkptDuration);
     break;
   case 'l':
     workerList =
@@ -205,6 +216,12 @@ main(int argc, char **argv)
       fprintf(stderr,
               "Unknown command: %c, try 'dmtcp_command --help'\n", *cmd);
       break;
+    case CoordCmdStatus::ERROR_NO_MATCHING_PROCESS:
+      fprintf(stderr,
+              "No connected process matches --only %s.\n"
+              "  Try 'dmtcp_command --list'.\n",
+              getenv(ENV_VAR_CKPT_SUBSET));
+      break;
     case CoordCmdStatus::ERROR_NOT_RUNNING_STATE:
       fprintf(stderr,
               "Error, computation not in running state."
@@ -218,7 +235,7 @@ main(int argc, char **argv)
     return 2;
   }
 
-  if(*cmd == 's'){
+  if (*cmd == 's' || *cmd == 'l') {
     printf("Coordinator:\n");
     char *host = getenv(ENV_VAR_NAME_HOST);
     if (host == NULL) {
@@ -240,6 +257,9 @@ main(int argc, char **argv)
       } else {
         printf("  CKPT_INTERVAL=0 (checkpoint manually)\n");
       }
+      if (lastCkptDuration != 0) {
+        printf("  LAST_CKPT_DURATION=%.3f s\n", lastCkptDuration / 1e9);
+      }
     } else {
       if (workerList) {
         printf("%s", workerList);
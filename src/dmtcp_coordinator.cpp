@@ -66,6 +66,7 @@
 #include <sys/stat.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <algorithm>
@@ -75,6 +76,7 @@
 #include "../jalib/jfilesystem.h"
 #include "../jalib/jtimer.h"
 #include "constants.h"
+#include "coordjournal.h"
 #include "dmtcpmessagetypes.h"
 #include "lookup_service.h"
 #include "protectedfds.h"
@@ -127,6 +129,17 @@ static const char *theUsage =
   "      (default: 0, disabled)\n"
   "  --coord-logfile PATH (environment variable DMTCP_COORD_LOG_FILENAME\n"
   "              Coordinator will dump its logs to the given file\n"
+  "  --journal PATH (environment variable DMTCP_COORD_JOURNAL)\n"
+  "      Journal the state of the computation to the given file.  If the\n"
+  "      coordinator dies, restart it with the same journal and port; the\n"
+  "      processes reconnect to it and carry on (default: no journal)\n"
+  "  --reconnect-timeout SECONDS\n"
+  "      (environment variable DMTCP_COORD_RECONNECT_TIMEOUT)\n"
+  "      How long processes wait for a journaling coordinator to come back\n"
+  "      (default: " STRINGIFY(DEFAULT_COORD_RECONNECT_TIMEOUT) ")\n"
+  "  --tcp-only (environment variable DMTCP_COORD_TCP_ONLY)\n"
+  "      Don't listen on a Unix-domain socket for processes on this host;\n"
+  "      they connect over TCP, as remote processes do\n"
   "  -q, --quiet \n"
   "      Skip startup msg; Skip NOTE msgs; if given twice, also skip WARNINGs\n"
   "  --help:\n"
@@ -183,6 +196,7 @@ static uint32_t theDefaultCheckpointInterval = 0; /* Reset to this on new comp.
 static bool timerExpired = false;
 
 static void resetCkptTimer();
+static uint64_t getCurrTimestamp();
 
 const int STDIN_FD = fileno(stdin);
 
@@ -198,7 +212,13 @@ static int numPeers = -1;
 static time_t curTimeStamp = -1;
 static time_t ckptTimeStamp = -1;
 
+// From the start of a checkpoint until all workers run again, in ns.
+static uint64_t ckptStartTime = 0;
+static uint64_t lastCkptDuration = 0;
+
 static LookupService lookupService;
+static CoordJournal journal;
+static uint32_t theReconnectTimeout = DEFAULT_COORD_RECONNECT_TIMEOUT;
 
 static string coordHostname;
 static struct in_addr localhostIPAddr;
@@ -210,12 +230,51 @@ static string ckptDir;
 struct epoll_event events[MAX_EVENTS];
 int epollFd;
 static jalib::JSocket *listenSock = NULL;
+static jalib::JSocket *unixListenSock = NULL;
 
 static void removeStaleSharedAreaFile();
 static void preExitCleanup();
 
 static pid_t _nextVirtualPid = INITIAL_VIRTUAL_PID;
 
+static CoordJournalComputation
+currentComputation()
+{
+  CoordJournalComputation c;
+
+  memset(&c, 0, sizeof(c));
+  c.compId = compId.upid();
+  c.timeStamp = curTimeStamp;
+  c.ckptTimeStamp = ckptTimeStamp;
+  c.numPeers = numPeers;
+  return c;
+}
+
+static void
+journalComputation()
+{
+  CoordJournalComputation c = currentComputation();
+
+  journal.append(CoordJournal::COMPUTATION, &c, sizeof(c));
+}
+
+static void
+journalVirtualPid(pid_t pid, bool live)
+{
+  int32_t rec[2] = { pid, live };
+
+  journal.append(CoordJournal::VIRTUAL_PID, rec, sizeof(rec));
+}
+
+// Name-service requests that change the database are replayed from the
+// journal, in order; unique ids, in particular, depend on that order.
+static void
+journalNameService(const DmtcpMessage &msg, const void *extraData)
+{
+  journal.append(CoordJournal::NAME_SERVICE, &msg, sizeof(msg),
+                 extraData, msg.extraBytes);
+}
+
 static int theNextClientNumber = 1;
 vector<CoordClient *>clients;
 
@@ -228,6 +287,7 @@ CoordClient::CoordClient(const jalib::JSocket &sock,
     _barrier("")
 {
   _isNSWorker = isNSWorker;
+  _excludedFromCkpt = false;
   _realPid = hello_remote.realPid;
   _clientNumber = theNextClientNumber++;
   _identity = hello_remote.from;
@@ -272,7 +332,9 @@ DmtcpCoordinator::getNewVirtualPid()
 static string replyData = "";
 
 void
-DmtcpCoordinator::handleUserCommand(char cmd, DmtcpMessage *reply /*= NULL*/)
+DmtcpCoordinator::handleUserCommand(char cmd,
+                                    DmtcpMessage *reply /*= NULL*/,
+                                    const string &ckptSubset /*= ""*/)
 {
   if (reply != NULL) {
     reply->coordCmdStatus = CoordCmdStatus::NOERROR;
@@ -288,8 +350,14 @@ DmtcpCoordinator::handleUserCommand(char cmd, DmtcpMessage *reply /*= NULL*/)
     killAfterCkptOnce = true;
     break;
   case 'c':
-    JTRACE("checkpointing...");
-    if (startCheckpoint()) {
+    JTRACE("checkpointing...") (ckptSubset);
+    if (!ckptSubset.empty() && countCkptSubset(ckptSubset) == 0) {
+      JNOTE("No connected process matches the checkpoint subset.")
+        (ckptSubset);
+      if (reply != NULL) {
+        reply->coordCmdStatus = CoordCmdStatus::ERROR_NO_MATCHING_PROCESS;
+      }
+    } else if (startCheckpoint(ckptSubset)) {
       if (reply != NULL) {
         reply->numPeers = getStatus().numPeers;
       }
@@ -346,12 +414,16 @@ DmtcpCoordinator::handleUserCommand(char cmd, DmtcpMessage *reply /*= NULL*/)
   case 'q':
   {
     JNOTE("killing all connected peers and quitting ...");
+    endCkptSubset();
     broadcastMessage(DMT_KILL_PEER);
     JASSERT_STDERR << "DMTCP coordinator exiting... (per request)\n";
     for (size_t i = 0; i < clients.size(); i++) {
       clients[i]->sock().close();
     }
     listenSock->close();
+    if (unixListenSock != NULL) {
+      unixListenSock->close();
+    }
     preExitCleanup();
     JTRACE("Exiting ...");
     exit(0);
@@ -359,6 +431,7 @@ DmtcpCoordinator::handleUserCommand(char cmd, DmtcpMessage *reply /*= NULL*/)
   }
   case 'k':
     JNOTE("Killing all connected peers...");
+    endCkptSubset();
     broadcastMessage(DMT_KILL_PEER);
     break;
   case 'h': case '?':
@@ -373,6 +446,7 @@ DmtcpCoordinator::handleUserCommand(char cmd, DmtcpMessage *reply /*= NULL*/)
       reply->numPeers = s.numPeers;
       reply->isRunning = running;
       reply->theCheckpointInterval = theCheckpointInterval;
+      reply->lastCkptDuration = lastCkptDuration;
     } else {
       printStatus(s.numPeers, running);
     }
@@ -413,8 +487,12 @@ DmtcpCoordinator::printStatus(size_t numPeers, bool isRunning)
     // << "Kill after checkpoint (first time only): " << killAfterCkptOnce
     // << std::endl
     << "Computation Id: " << compId << std::endl
-    << "Checkpoint Dir: " << ckptDir << std::endl
-    << "NUM_PEERS=" << numPeers << std::endl
+    << "Checkpoint Dir: " << ckptDir << std::endl;
+  if (lastCkptDuration != 0) {
+    o << "Last checkpoint duration: " << lastCkptDuration / 1e9 << " s"
+      << std::endl;
+  }
+  o << "NUM_PEERS=" << numPeers << std::endl
     << "RUNNING=" << (isRunning ? "yes" : "no") << std::endl;
   printf("%s", o.str().c_str());
   fflush(stdout);
@@ -459,7 +537,14 @@ DmtcpCoordinator::releaseBarrier(const string &barrier)
                      prevBarrier.length() + 1,
                      prevBarrier.c_str());
     if (status.minimumState == WorkerState::RUNNING) {
-      JNOTE("Checkpoint complete; all workers running");
+      if (ckptStartTime != 0) {
+        lastCkptDuration = getCurrTimestamp() - ckptStartTime;
+        ckptStartTime = 0;
+        double seconds = lastCkptDuration / 1e9;
+        JNOTE("Checkpoint complete; all workers running") (seconds);
+      } else {
+        JNOTE("Checkpoint complete; all workers running");
+      }
       resetCkptTimer();
     }
   }
@@ -482,12 +567,8 @@ DmtcpCoordinator::processBarrier(const string &barrier)
 
 
 void
-DmtcpCoordinator::recordCkptFilename(CoordClient *client, const char *extraData)
+DmtcpCoordinator::addCkptFilename(const char *extraData)
 {
-  client->setState(WorkerState::CHECKPOINTED);
-  JASSERT(extraData != NULL)
-  .Text("extra data expected with DMT_CKPT_FILENAME message");
-
   string ckptFilename = extraData;
   string hostname = extraData + ckptFilename.length() + 1;
   string shellType;
@@ -510,10 +591,40 @@ DmtcpCoordinator::recordCkptFilename(CoordClient *client, const char *extraData)
       .Text("Shell command not supported. Report this to DMTCP community.");
   }
   _numRestartFilenames++;
+}
+
+void
+DmtcpCoordinator::recordCkptFilename(CoordClient *client,
+                                     const char *extraData,
+                                     size_t len)
+{
+  client->setState(WorkerState::CHECKPOINTED);
+  JASSERT(extraData != NULL)
+  .Text("extra data expected with DMT_CKPT_FILENAME message");
+
+  uint32_t unique = uniqueCkptFilenames;
+  string record((const char *)&unique, sizeof(unique));
+  record.append(extraData, len);
+  journal.append(CoordJournal::CKPT_FILENAME, record.data(), record.size());
+  _ckptFilenameRecords.push_back(record);
+  addCkptFilename(extraData);
 
   if (_numRestartFilenames == _numCkptWorkers) {
+    // A subset checkpoint gets its own restart script and manifest, next to
+    // its images; those of the whole computation are left alone.
+    const string &scriptDir = _ckptSubsetDir.empty() ? ckptDir
+                                                     : _ckptSubsetDir;
+    vector<string> excluded;
+    for (size_t i = 0; i < clients.size(); i++) {
+      if (clients[i]->excludedFromCkpt()) {
+        excluded.push_back(clients[i]->hostname() + " " +
+                           clients[i]->progname() + " " +
+                           clients[i]->identity().toString());
+      }
+    }
+
     const string restartScriptPath =
-      RestartScript::writeScript(ckptDir,
+      RestartScript::writeScript(scriptDir,
                                  uniqueCkptFilenames,
                                  ckptTimeStamp,
                                  theCheckpointInterval,
@@ -523,7 +634,18 @@ DmtcpCoordinator::recordCkptFilename(CoordClient *client, const char *extraData)
                                  _rshCmdFileNames,
                                  _sshCmdFileNames);
 
-    JNOTE("Checkpoint complete. Wrote restart script") (restartScriptPath);
+    const string manifestPath =
+      RestartScript::writeManifest(scriptDir,
+                                   uniqueCkptFilenames,
+                                   compId,
+                                   _restartFilenames,
+                                   _rshCmdFileNames,
+                                   _sshCmdFileNames,
+                                   excluded);
+
+    JNOTE("Checkpoint complete. Wrote restart script")
+      (restartScriptPath) (manifestPath);
+    compactJournal();
 
     JTIMER_STOP(checkpoint);
 
@@ -581,6 +703,15 @@ DmtcpCoordinator::onData(CoordClient *client)
       (msg.from) (prevClientState) (msg.state);
 
     client->setBarrier("");
+
+    // The subset checkpoint is over once all its processes are running.
+    ComputationStatus s = getStatus();
+    if (!_ckptSubsetDir.empty() &&
+        s.minimumStateUnanimous && s.minimumState == WorkerState::RUNNING) {
+      JNOTE("Subset checkpoint complete; all workers running")
+        (_ckptSubsetDir);
+      endCkptSubset();
+    }
     break;
   }
 
@@ -602,7 +733,7 @@ DmtcpCoordinator::onData(CoordClient *client)
 
   // Fall though
   case DMT_CKPT_FILENAME:
-    recordCkptFilename(client, extraData);
+    recordCkptFilename(client, extraData, msg.extraBytes);
     break;
 
   case DMT_GET_CKPT_DIR:
@@ -620,6 +751,7 @@ DmtcpCoordinator::onData(CoordClient *client)
     if (strcmp(ckptDir.c_str(), extraData) != 0) {
       ckptDir = extraData;
       JNOTE("Updated ckptDir") (ckptDir);
+      journal.append(CoordJournal::CKPT_DIR, ckptDir.data(), ckptDir.length());
     }
     break;
   }
@@ -627,6 +759,7 @@ DmtcpCoordinator::onData(CoordClient *client)
   case DMT_REGISTER_NAME_SERVICE_DATA:
   {
     JTRACE("received REGISTER_NAME_SERVICE_DATA msg") (client->identity());
+    journalNameService(msg, extraData);
     lookupService.registerData(msg, (const void *)extraData);
     break;
   }
@@ -642,6 +775,7 @@ DmtcpCoordinator::onData(CoordClient *client)
   case DMT_NAME_SERVICE_GET_UNIQUE_ID:
   {
     JTRACE("received NAME_SERVICE_GET_UNIQUE_ID msg") (client->identity());
+    journalNameService(msg, extraData);
     lookupService.respondToQuery(client->sock(), msg,
                                  (const void *)extraData);
     break;
@@ -703,6 +837,9 @@ preExitCleanup()
   removeStaleSharedAreaFile();
   JTRACE("Removing port-file") (thePortFile);
   unlink(thePortFile.c_str());
+
+  // The computation is over; there is nothing to resume.
+  journal.remove();
 }
 
 void
@@ -722,9 +859,9 @@ DmtcpCoordinator::onDisconnect(CoordClient *client)
   client->sock().close();
   JNOTE("client disconnected") (client->identity()) (client->progname());
   _virtualPidToClientMap.erase(client->virtualPid());
+  journalVirtualPid(client->virtualPid(), false);
 
-  ComputationStatus s = getStatus();
-  if (s.numPeers < 1) {
+  if (clients.size() < 1) {
     if (exitOnLast) {
       JNOTE("last client exited, shutting down..");
       handleUserCommand('q');
@@ -741,6 +878,16 @@ DmtcpCoordinator::onDisconnect(CoordClient *client)
       JNOTE("CheckpointInterval reset on end of current computation")
         (theCheckpointInterval);
     }
+  } else if (client->excludedFromCkpt()) {
+    // Not part of the subset checkpoint in progress; no barrier to update.
+  } else if (!_ckptSubsetDir.empty() && getStatus().numPeers < 1) {
+    // All processes of the subset checkpoint are gone; the rest of the
+    // computation is still running, and may be checkpointed again.
+    JNOTE("last process of subset checkpoint exited") (_ckptSubsetDir);
+    endCkptSubset();
+    currentBarrier.clear();
+    workersAtCurrentBarrier = 0;
+    workersRunningAndSuspendMsgSent = false;
   } else {
     // If all other workers are at currentBarrier, release it.
     if (!currentBarrier.empty() &&
@@ -774,14 +921,19 @@ DmtcpCoordinator::initializeComputation()
 
   prevBarrier.clear();
   currentBarrier.clear();
+
+  // Virtual pids of processes of the last computation that never came back.
+  _virtualPidToClientMap.clear();
+  _ckptFilenameRecords.clear();
+  journal.clear();
 }
 
 void
-DmtcpCoordinator::onConnect()
+DmtcpCoordinator::onConnect(jalib::JSocket *listener)
 {
   struct sockaddr_storage remoteAddr;
   socklen_t remoteLen = sizeof(remoteAddr);
-  jalib::JSocket remote = listenSock->accept(&remoteAddr, &remoteLen);
+  jalib::JSocket remote = listener->accept(&remoteAddr, &remoteLen);
 
   JTRACE("accepting new connection") (remote.sockfd());
 
@@ -790,6 +942,25 @@ DmtcpCoordinator::onConnect()
     return;
   }
 
+  // A process on this host, on the Unix-domain socket.  Only our own user may
+  // connect there; the rest of the coordinator sees it as a loopback client.
+  if (listener == unixListenSock) {
+    struct ucred cred;
+    socklen_t credLen = sizeof(cred);
+    if (getsockopt(remote.sockfd(), SOL_SOCKET, SO_PEERCRED,
+                   &cred, &credLen) != 0 || cred.uid != getuid()) {
+      JWARNING(false) (cred.pid) (cred.uid)
+        .Text("Refusing connection from a process of another user.");
+      remote.close();
+      return;
+    }
+    struct sockaddr_in *sin = (struct sockaddr_in *)&remoteAddr;
+    memset(&remoteAddr, 0, sizeof(remoteAddr));
+    sin->sin_family = AF_INET;
+    sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    remoteLen = sizeof(*sin);
+  }
+
   DmtcpMessage hello_remote;
   hello_remote.poison();
   JTRACE("Reading from incoming connection...");
@@ -824,6 +995,7 @@ DmtcpCoordinator::onConnect()
 
     JTRACE("received NAME_SERVICE_GET_UNIQUE_ID msg on running")
           (hello_remote.from);
+    journalNameService(hello_remote, extraData);
     lookupService.respondToQuery(remote, hello_remote, extraData);
     delete[] extraData;
     remote.close();
@@ -836,6 +1008,7 @@ DmtcpCoordinator::onConnect()
 
     JTRACE("received REGISTER_NAME_SERVICE_DATA msg on running") (hello_remote.
                                                                   from);
+    journalNameService(hello_remote, extraData);
     lookupService.registerData(hello_remote, (const void *)extraData);
     delete[] extraData;
     remote.close();
@@ -862,7 +1035,9 @@ DmtcpCoordinator::onConnect()
 
   // If no client is connected to Coordinator, then there can be only zero data
   // sockets OR there can be one data socket and that should be STDIN.
-  if (clients.size() == 0) {
+  // A reconnecting process belongs to the computation that we have (or will
+  // adopt); that one is not reset.
+  if (clients.size() == 0 && hello_remote.type != DMT_RECONNECT_WORKER) {
     initializeComputation();
   }
 
@@ -880,6 +1055,14 @@ DmtcpCoordinator::onConnect()
     }
     client->virtualPid(hello_remote.from.pid());
     _virtualPidToClientMap[client->virtualPid()] = client;
+    journalVirtualPid(client->virtualPid(), true);
+  } else if (hello_remote.type == DMT_RECONNECT_WORKER) {
+    if (!validateReconnectingWorkerProcess(hello_remote, remote,
+                                           &remoteAddr, remoteLen)) {
+      return;
+    }
+    client->virtualPid(hello_remote.virtualPid);
+    _virtualPidToClientMap[client->virtualPid()] = client;
   } else if (hello_remote.type == DMT_NEW_WORKER) {
     // Comping from dmtcp_launch or fork(), ssh(), etc.
     JASSERT(hello_remote.state == WorkerState::RUNNING ||
@@ -891,6 +1074,7 @@ DmtcpCoordinator::onConnect()
       return;
     }
     _virtualPidToClientMap[client->virtualPid()] = client;
+    journalVirtualPid(client->virtualPid(), true);
   } else {
     JASSERT(false) (hello_remote.type)
     .Text("Connect request from Unknown Remote Process Type");
@@ -914,12 +1098,29 @@ DmtcpCoordinator::processDmtUserCmd(DmtcpMessage &hello_remote,
   DmtcpMessage reply;
   reply.type = DMT_USER_CMD_RESULT;
 
+  // 'c' may carry the processes to checkpoint (dmtcp_command --only).
+  string ckptSubset;
+  if (hello_remote.extraBytes > 0) {
+    char *extraData = new char[hello_remote.extraBytes];
+    remote.readAll(extraData, hello_remote.extraBytes);
+    ckptSubset = string(extraData, strnlen(extraData,
+                                           hello_remote.extraBytes));
+    delete[] extraData;
+  }
+
   // if previous 'b' blocking prefix command had set blockUntilDone
   if (blockUntilDone && blockUntilDoneRemote == -1 &&
       hello_remote.coordCmd == 'c') {
     // Reply will be done in DmtcpCoordinator::onData in this file.
     blockUntilDoneRemote = remote.sockfd();
-    handleUserCommand(hello_remote.coordCmd, &reply);
+    handleUserCommand(hello_remote.coordCmd, &reply, ckptSubset);
+    if (reply.coordCmdStatus != CoordCmdStatus::NOERROR) {
+      // No checkpoint was started; don't leave dmtcp_command waiting.
+      remote << reply;
+      remote.close();
+      blockUntilDone = false;
+      blockUntilDoneRemote = -1;
+    }
   } else if (hello_remote.coordCmd == 'i') {
     // theDefaultCheckpointInterval = hello_remote.theCheckpointInterval;
     // theCheckpointInterval = theDefaultCheckpointInterval;
@@ -927,7 +1128,7 @@ DmtcpCoordinator::processDmtUserCmd(DmtcpMessage &hello_remote,
     remote << reply;
     remote.close();
   } else {
-    handleUserCommand(hello_remote.coordCmd, &reply);
+    handleUserCommand(hello_remote.coordCmd, &reply, ckptSubset);
     remote << reply;
     if (reply.extraBytes > 0) {
       remote.writeAll(replyData.c_str(), reply.extraBytes);
@@ -974,6 +1175,7 @@ DmtcpCoordinator::validateRestartingWorkerProcess(
     curTimeStamp = getCurrTimestamp();
     JNOTE("FIRST dmtcp_restart connection.  Set numPeers. Generate timestamp")
       (numPeers) (curTimeStamp) (compId);
+    journalComputation();
     JTIMER_START(restart);
   } else if (minimumState() != WorkerState::RESTARTING) {
     JNOTE("Computation not in RESTARTING state."
@@ -1001,6 +1203,7 @@ DmtcpCoordinator::validateRestartingWorkerProcess(
     (compId) (hello_remote.compGroup) (minimumState());
 
   hello_local.coordTimeStamp = curTimeStamp;
+  hello_local.reconnectTimeout = journal.isOpen() ? theReconnectTimeout : 0;
   if (Util::strStartsWith(remoteIP.c_str(), "127.")) {
     memcpy(&hello_local.ipAddr, &localhostIPAddr, sizeof localhostIPAddr);
   } else {
@@ -1027,6 +1230,228 @@ DmtcpCoordinator::validateRestartingWorkerProcess(
   return true;
 }
 
+/* A process whose coordinator died reconnects with its old identity, to the
+ * coordinator restarted from the journal.  Without a journal, or after the
+ * computation was over, the coordinator takes the computation of the process
+ * as its own; it then knows no more than the processes tell it.
+ */
+bool
+DmtcpCoordinator::validateReconnectingWorkerProcess(
+  DmtcpMessage &hello_remote,
+  jalib::JSocket &remote,
+  const struct sockaddr_storage *remoteAddr,
+  socklen_t remoteLen)
+{
+  const struct sockaddr_in *sin = (const struct sockaddr_in *)remoteAddr;
+  string remoteIP = inet_ntoa(sin->sin_addr);
+  DmtcpMessage hello_local(DMT_ACCEPT);
+  ComputationStatus s = getStatus();
+
+  // Reserved virtual pids mean that we are still waiting for the processes
+  // of the computation in the journal.
+  if (compId == UniquePid(0, 0, 0) ||
+      (clients.size() == 0 && _virtualPidToClientMap.empty())) {
+    initializeComputation();
+    compId = hello_remote.compGroup;
+    curTimeStamp = hello_remote.coordTimeStamp;
+    numPeers = -1;
+    JNOTE("Taking over the computation of a reconnecting process")
+      (compId) (hello_remote.from);
+    journalComputation();
+  } else if (hello_remote.compGroup != compId) {
+    JNOTE("Reject reconnecting process, since it is not from current"
+          " computation.")
+      (compId) (hello_remote.compGroup);
+    hello_local.type = DMT_REJECT_WRONG_COMP;
+    remote << hello_local;
+    remote.close();
+    return false;
+  } else if (s.numPeers > 0 && s.minimumState != WorkerState::RUNNING) {
+    JNOTE("Current computation not in RUNNING state."
+          "  Reject reconnecting process.")
+      (compId) (hello_remote.from) (s.minimumState);
+    hello_local.type = DMT_REJECT_NOT_RUNNING;
+    remote << hello_local;
+    remote.close();
+    return false;
+  }
+
+  JWARNING(_virtualPidToClientMap[hello_remote.virtualPid] == NULL)
+    (hello_remote.virtualPid) (hello_remote.from)
+    .Text("Two processes reconnected with the same virtual pid");
+  journalVirtualPid(hello_remote.virtualPid, true);
+  JTRACE("Process reconnected") (hello_remote.from) (hello_remote.virtualPid);
+
+  hello_local.compGroup = compId;
+  hello_local.virtualPid = hello_remote.virtualPid;
+  hello_local.coordTimeStamp = curTimeStamp;
+  hello_local.reconnectTimeout = journal.isOpen() ? theReconnectTimeout : 0;
+  if (Util::strStartsWith(remoteIP.c_str(), "127.")) {
+    memcpy(&hello_local.ipAddr, &localhostIPAddr, sizeof localhostIPAddr);
+  } else {
+    memcpy(&hello_local.ipAddr, &sin->sin_addr, sizeof localhostIPAddr);
+  }
+  remote << hello_local;
+  return true;
+}
+
+/* Restores the state of the computation from the records of the journal.
+ * The processes that were connected keep their virtual pids reserved (with
+ * no client) until they reconnect.
+ */
+void
+DmtcpCoordinator::replayJournal(const vector<CoordJournal::Record> &records)
+{
+  size_t numRecords = 0;
+
+  for (size_t i = 0; i < records.size(); i++) {
+    const string &data = records[i].data;
+    switch (records[i].type) {
+    case CoordJournal::COMPUTATION:
+    {
+      CoordJournalComputation c;
+      JASSERT(data.size() == sizeof(c)) (data.size());
+      memcpy(&c, data.data(), sizeof(c));
+      compId = UniquePid(c.compId);
+      curTimeStamp = c.timeStamp;
+      ckptTimeStamp = c.ckptTimeStamp;
+      numPeers = c.numPeers;
+      break;
+    }
+    case CoordJournal::CKPT_INTERVAL:
+      JASSERT(data.size() == sizeof(theCheckpointInterval)) (data.size());
+      memcpy(&theCheckpointInterval, data.data(), data.size());
+      break;
+    case CoordJournal::CKPT_DIR:
+      ckptDir = data;
+      break;
+    case CoordJournal::CKPT_START:
+      uniqueCkptFilenames = false;
+      _restartFilenames.clear();
+      _rshCmdFileNames.clear();
+      _sshCmdFileNames.clear();
+      _ckptFilenameRecords.clear();
+      break;
+    case CoordJournal::CKPT_FILENAME:
+    {
+      uint32_t unique;
+      JASSERT(data.size() > sizeof(unique)) (data.size());
+      memcpy(&unique, data.data(), sizeof(unique));
+      uniqueCkptFilenames = unique;
+      addCkptFilename(data.c_str() + sizeof(unique));
+      _ckptFilenameRecords.push_back(data);
+      break;
+    }
+    case CoordJournal::VIRTUAL_PID:
+    {
+      int32_t rec[2];
+      JASSERT(data.size() == sizeof(rec)) (data.size());
+      memcpy(rec, data.data(), sizeof(rec));
+      if (rec[1]) {
+        _virtualPidToClientMap[rec[0]] = NULL;
+        if (rec[0] >= _nextVirtualPid) {
+          _nextVirtualPid = rec[0] + 1000;
+        }
+      } else {
+        _virtualPidToClientMap.erase(rec[0]);
+      }
+      break;
+    }
+    case CoordJournal::NAME_SERVICE:
+    {
+      DmtcpMessage msg;
+      JASSERT(data.size() >= sizeof(msg)) (data.size());
+      memcpy(&msg, data.data(), sizeof(msg));
+      JASSERT(data.size() == sizeof(msg) + msg.extraBytes) (data.size());
+      const char *extraData = data.data() + sizeof(msg);
+      if (msg.type == DMT_REGISTER_NAME_SERVICE_DATA) {
+        lookupService.registerData(msg, extraData);
+      } else {
+        JASSERT(msg.type == DMT_NAME_SERVICE_GET_UNIQUE_ID) (msg.type);
+        void *val = NULL;
+        lookupService.getUniqueId(msg.nsid, extraData, msg.keyLen, &val,
+                                  msg.uniqueIdOffset, msg.valLen);
+        delete[] (char *)val;
+      }
+      break;
+    }
+    case CoordJournal::NAME_SERVICE_CKPT_RESET:
+      lookupService.resetCkptScoped();
+      break;
+    case CoordJournal::NAME_SERVICE_STATE:
+      lookupService.restore(data);
+      break;
+    default:
+      JWARNING(false) (records[i].type).Text("Unknown journal record");
+      continue;
+    }
+    numRecords++;
+  }
+
+  if (_nextVirtualPid > MAX_VIRTUAL_PID) {
+    _nextVirtualPid = INITIAL_VIRTUAL_PID;
+  }
+
+  // A checkpoint that was in progress will not complete.
+  _numRestartFilenames = 0;
+  _numCkptWorkers = 0;
+
+  if (compId != UniquePid(0, 0, 0)) {
+    JNOTE("Resuming computation from the journal; waiting for its processes")
+      (journal.path()) (numRecords) (compId) (_virtualPidToClientMap.size());
+  }
+}
+
+/* Replaces the journal with the records that replayJournal() needs to
+ * recreate the current state: no more than one record per process, per
+ * checkpoint image, and one for the whole name service.
+ */
+void
+DmtcpCoordinator::compactJournal()
+{
+  vector<CoordJournal::Record> records;
+  CoordJournal::Record r;
+  CoordJournalComputation c = currentComputation();
+
+  r.type = CoordJournal::COMPUTATION;
+  r.data.assign((const char *)&c, sizeof(c));
+  records.push_back(r);
+
+  r.type = CoordJournal::CKPT_INTERVAL;
+  r.data.assign((const char *)&theCheckpointInterval,
+                sizeof(theCheckpointInterval));
+  records.push_back(r);
+
+  r.type = CoordJournal::CKPT_DIR;
+  r.data = ckptDir;
+  records.push_back(r);
+
+  r.type = CoordJournal::CKPT_START;
+  r.data.clear();
+  records.push_back(r);
+  r.type = CoordJournal::CKPT_FILENAME;
+  for (size_t i = 0; i < _ckptFilenameRecords.size(); i++) {
+    r.data = _ckptFilenameRecords[i];
+    records.push_back(r);
+  }
+
+  r.type = CoordJournal::VIRTUAL_PID;
+  map<pid_t, CoordClient *>::iterator it;
+  for (it = _virtualPidToClientMap.begin();
+       it != _virtualPidToClientMap.end(); it++) {
+    int32_t rec[2] = { it->first, true };
+    r.data.assign((const char *)rec, sizeof(rec));
+    records.push_back(r);
+  }
+
+  r.type = CoordJournal::NAME_SERVICE_STATE;
+  r.data.clear();
+  lookupService.save(&r.data);
+  records.push_back(r);
+
+  journal.compact(records);
+}
+
 bool
 DmtcpCoordinator::validateNewWorkerProcess(
   DmtcpMessage &hello_remote,
@@ -1040,12 +1465,21 @@ DmtcpCoordinator::validateNewWorkerProcess(
   DmtcpMessage hello_local(DMT_ACCEPT);
 
   hello_local.virtualPid = client->virtualPid();
+  hello_local.reconnectTimeout = journal.isOpen() ? theReconnectTimeout : 0;
   ComputationStatus s = getStatus();
 
   JASSERT(hello_remote.state == WorkerState::RUNNING ||
           hello_remote.state == WorkerState::UNKNOWN) (hello_remote.state);
 
-  if (workersRunningAndSuspendMsgSent == true) {
+  if (!_ckptSubsetDir.empty()) {
+    // A process that shows up during a subset checkpoint is not part of it,
+    // even if its parent is.  It joins the computation as a running process.
+    JNOTE("New process connected during subset checkpoint; excluding it.")
+      (hello_remote.from) (_ckptSubsetDir);
+    client->excludeFromCkpt(true);
+  }
+
+  if (workersRunningAndSuspendMsgSent == true && _ckptSubsetDir.empty()) {
     /* Worker trying to connect after SUSPEND message has been sent.
      * This happens if the worker process is executing a fork() system call
      * when the DMT_DO_SUSPEND is broadcast. We need to make sure that the
@@ -1065,7 +1499,8 @@ DmtcpCoordinator::validateNewWorkerProcess(
     DmtcpMessage suspendMsg(DMT_DO_CHECKPOINT);
     suspendMsg.compGroup = compId;
     remote << suspendMsg;
-  } else if (s.numPeers > 0 && s.minimumState != WorkerState::RUNNING &&
+  } else if (_ckptSubsetDir.empty() &&
+             s.numPeers > 0 && s.minimumState != WorkerState::RUNNING &&
              s.minimumState != WorkerState::UNKNOWN) {
     // If some of the processes are not in RUNNING state
     JNOTE("Current computation not in RUNNING state."
@@ -1099,6 +1534,7 @@ DmtcpCoordinator::validateNewWorkerProcess(
       numPeers = -1;
       JTRACE("First process connected.  Creating new computation group.")
         (compId);
+      journalComputation();
     } else {
       JTRACE("New process connected")
         (hello_remote.from) (client->virtualPid());
@@ -1115,25 +1551,125 @@ DmtcpCoordinator::validateNewWorkerProcess(
   return true;
 }
 
+/* A checkpoint subset is a comma-separated list of virtual pids and program
+ * names, as shown by 'dmtcp_command --list'.
+ */
+static bool
+inCkptSubset(CoordClient *client, const vector<string> &selectors)
+{
+  for (size_t i = 0; i < selectors.size(); i++) {
+    const string &s = selectors[i];
+    if (s.find_first_not_of("0123456789") == string::npos) {
+      if (client->identity().pid() == (pid_t)strtol(s.c_str(), NULL, 10)) {
+        return true;
+      }
+    } else if (client->progname() == s) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t
+DmtcpCoordinator::countCkptSubset(const string &ckptSubset)
+{
+  vector<string> selectors = tokenizeString(ckptSubset, ",");
+  size_t count = 0;
+
+  for (size_t i = 0; i < clients.size(); i++) {
+    if (inCkptSubset(clients[i], selectors)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/* Leaves every process outside 'ckptSubset' out of the checkpoint that is
+ * being started: it is sent no checkpoint messages and doesn't count towards
+ * barriers.  The images of the subset go to their own directory.
+ */
+void
+DmtcpCoordinator::selectCkptSubset(const string &ckptSubset)
+{
+  vector<string> selectors = tokenizeString(ckptSubset, ",");
+  size_t numExcluded = 0;
+
+  for (size_t i = 0; i < clients.size(); i++) {
+    bool excluded = !inCkptSubset(clients[i], selectors);
+    clients[i]->excludeFromCkpt(excluded);
+    numExcluded += excluded;
+  }
+
+  // A subset that covers everybody is just a checkpoint.
+  if (numExcluded == 0) {
+    return;
+  }
+
+  // A restarted coordinator starts counting again; skip the directories of
+  // the subset checkpoints of its earlier life.
+  do {
+    ostringstream o;
+    o << ckptDir << "/" << CKPT_SUBSET_DIR_PREFIX << compId << "_"
+      << std::setw(5) << std::setfill('0') << ++_ckptSubsetGeneration;
+    _ckptSubsetDir = o.str();
+  } while (mkdir(_ckptSubsetDir.c_str(), S_IRWXU) == -1 && errno == EEXIST);
+  JWARNING(access(_ckptSubsetDir.c_str(), W_OK) == 0)
+    (_ckptSubsetDir) (JASSERT_ERRNO);
+  JNOTE("checkpointing a subset of the computation")
+    (ckptSubset) (numExcluded) (_ckptSubsetDir);
+}
+
+void
+DmtcpCoordinator::endCkptSubset()
+{
+  for (size_t i = 0; i < clients.size(); i++) {
+    clients[i]->excludeFromCkpt(false);
+  }
+  _ckptSubsetDir.clear();
+}
+
 bool
-DmtcpCoordinator::startCheckpoint()
+DmtcpCoordinator::startCheckpoint(const string &ckptSubset /*= ""*/)
 {
   ComputationStatus s = getStatus();
   if (s.minimumState == WorkerState::RUNNING && s.minimumStateUnanimous
       && !workersRunningAndSuspendMsgSent) {
     uniqueCkptFilenames = false;
     time(&ckptTimeStamp);
+    ckptStartTime = getCurrTimestamp();
     JTIMER_START(checkpoint);
     _numRestartFilenames = 0;
     _restartFilenames.clear();
     _rshCmdFileNames.clear();
     _sshCmdFileNames.clear();
-    compId.incrementGeneration();
-    JNOTE("starting checkpoint; incrementing generation; suspending all nodes")
-      (s.numPeers) (compId.computationGeneration());
-
-    // Pass number of connected peers to all clients
-    broadcastMessage(DMT_DO_CHECKPOINT);
+    _ckptFilenameRecords.clear();
+    if (!ckptSubset.empty()) {
+      selectCkptSubset(ckptSubset);
+    }
+    // A subset checkpoint leaves the generation of the computation alone;
+    // its images go to a directory of their own.
+    if (_ckptSubsetDir.empty()) {
+      compId.incrementGeneration();
+    }
+    journalComputation();
+    journal.append(CoordJournal::CKPT_START);
+    JNOTE("starting checkpoint; suspending all nodes")
+      (getStatus().numPeers) (compId.computationGeneration())
+      (_ckptSubsetGeneration);
+
+    // Name-service data of the previous checkpoint is stale.
+    lookupService.resetCkptScoped();
+    journal.append(CoordJournal::NAME_SERVICE_CKPT_RESET);
+
+    // Pass number of connected peers to all clients, and the directory of a
+    // subset checkpoint to the processes in it.
+    if (_ckptSubsetDir.empty()) {
+      broadcastMessage(DMT_DO_CHECKPOINT);
+    } else {
+      broadcastMessage(DMT_DO_CHECKPOINT,
+                       _ckptSubsetDir.length() + 1,
+                       _ckptSubsetDir.c_str());
+    }
 
     // Suspend Message has been sent but the workers are still in running
     // state.  If the coordinator receives another checkpoint request from user
@@ -1158,18 +1694,23 @@ DmtcpCoordinator::broadcastMessage(DmtcpMessageType type,
 
   msg.type = type;
   msg.compGroup = compId;
-  msg.numPeers = clients.size();
+  msg.numPeers = getStatus().numPeers;
   // From DMTCP coord viewpoint, we are killing peers after ckpt.
   // From DMTCP peer viewpoint, we will exit after ckpt.
   msg.exitAfterCkpt = killAfterCkpt || killAfterCkptOnce;
   msg.extraBytes = extraBytes;
 
-  if (msg.type == DMT_KILL_PEER && clients.size() > 0) {
+  // Killing a checkpointed subset leaves the rest of the computation running.
+  if (msg.type == DMT_KILL_PEER && clients.size() > 0 &&
+      _ckptSubsetDir.empty()) {
     killInProgress = true;
   }
 
   JTRACE("sending message")(type);
   for (size_t i = 0; i < clients.size(); i++) {
+    if (clients[i]->excludedFromCkpt()) {
+      continue;
+    }
     clients[i]->sock() << msg;
     if (extraBytes > 0) {
       clients[i]->sock().writeAll((const char *)extraData, extraBytes);
@@ -1189,7 +1730,11 @@ DmtcpCoordinator::getStatus() const
   int count = 0;
   bool unanimous = true;
 
+  // During a subset checkpoint, the status is that of the subset.
   for (size_t i = 0; i < clients.size(); i++) {
+    if (clients[i]->excludedFromCkpt()) {
+      continue;
+    }
     WorkerState::eWorkerState cliState = clients[i]->state();
     count++;
     unanimous = unanimous && (min == cliState || min == INITIAL_MIN);
@@ -1240,6 +1785,11 @@ setupSignalHandlers()
 
   sigaction(SIGINT, &action, NULL);
   sigaction(SIGALRM, &action, NULL);
+
+  // A worker may exit just as we send it a message; we learn of it when we
+  // read its end of file, and must not die of the write.
+  action.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &action, NULL);
 }
 
 // This code is also copied to ssh.cpp:updateCoordHost()
@@ -1365,6 +1915,8 @@ DmtcpCoordinator::updateCheckpointInterval(uint32_t interval)
     }
     JNOTE("CheckpointInterval updated (for this computation only)")
       (oldInterval) (theCheckpointInterval);
+    journal.append(CoordJournal::CKPT_INTERVAL, &theCheckpointInterval,
+                   sizeof(theCheckpointInterval));
     firstClient = false;
     resetCkptTimer();
   }
@@ -1383,6 +1935,12 @@ DmtcpCoordinator::eventLoop(bool daemon)
   JASSERT(epoll_ctl(epollFd, EPOLL_CTL_ADD, listenSock->sockfd(), &ev) != -1)
     (JASSERT_ERRNO);
 
+  if (unixListenSock != NULL) {
+    ev.data.ptr = unixListenSock;
+    JASSERT(epoll_ctl(epollFd, EPOLL_CTL_ADD, unixListenSock->sockfd(), &ev)
+            != -1) (JASSERT_ERRNO);
+  }
+
   if (!daemon &&
 
       // epoll_ctl below fails if STDIN is pointing to /dev/null.
@@ -1432,7 +1990,7 @@ DmtcpCoordinator::eventLoop(bool daemon)
           (events[n].events & EPOLLRDHUP) ||
 #endif // ifdef EPOLLRDHUP
           (events[n].events & EPOLLERR)) {
-        JASSERT(ptr != listenSock);
+        JASSERT(ptr != listenSock && ptr != unixListenSock);
         if (ptr == (void *)STDIN_FILENO) {
           JASSERT(epoll_ctl(epollFd, EPOLL_CTL_DEL, STDIN_FILENO, &ev) != -1)
             (JASSERT_ERRNO);
@@ -1441,8 +1999,8 @@ DmtcpCoordinator::eventLoop(bool daemon)
           onDisconnect((CoordClient *)ptr);
         }
       } else if (events[n].events & EPOLLIN) {
-        if (ptr == (void *)listenSock) {
-          onConnect();
+        if (ptr == (void *)listenSock || ptr == (void *)unixListenSock) {
+          onConnect((jalib::JSocket *)ptr);
         } else if (ptr == (void *)STDIN_FILENO) {
           char buf[1];
           int ret = Util::readAll(STDIN_FD, buf, sizeof(buf));
@@ -1460,6 +2018,10 @@ DmtcpCoordinator::eventLoop(bool daemon)
         }
       }
     }
+
+    if (journal.needsCompaction()) {
+      compactJournal();
+    }
   }
 }
 
@@ -1562,6 +2124,15 @@ main(int argc, char **argv)
     } else if (argc > 1 && (s == "-t" || s == "--tmpdir")) {
       tmpdir_arg = argv[1];
       shift; shift;
+    } else if (argc > 1 && s == "--journal") {
+      setenv(ENV_VAR_COORD_JOURNAL, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--reconnect-timeout") {
+      setenv(ENV_VAR_COORD_RECONNECT_TIMEOUT, argv[1], 1);
+      shift; shift;
+    } else if (s == "--tcp-only") {
+      setenv(ENV_VAR_COORD_TCP_ONLY, "1", 1);
+      shift;
     } else if (argc == 1) { // last arg can be port
       char *endptr;
       long x = strtol(argv[0], &endptr, 10);
@@ -1621,6 +2192,28 @@ main(int argc, char **argv)
   }
   JTRACE("Listening on port")(thePort);
 
+  // Processes on this host connect through here, if they can.  Another
+  // coordinator may hold the name in a different network namespace than our
+  // TCP port's, or another user may have taken it; TCP still works then.
+  if (getenv(ENV_VAR_COORD_TCP_ONLY) == NULL) {
+    struct sockaddr_un addr;
+    socklen_t addrlen = Util::coordUnixSocketAddr(thePort, &addr);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd != -1 &&
+        bind(fd, (struct sockaddr *)&addr, addrlen) == 0 &&
+        listen(fd, 128) == 0) {
+      unixListenSock = new jalib::JSocket(fd);
+      JTRACE("Listening on Unix-domain socket") (&addr.sun_path[1]);
+    } else {
+      JWARNING(false) (&addr.sun_path[1]) (JASSERT_ERRNO)
+        .Text("Can't listen on a Unix-domain socket; local processes will"
+              " connect over TCP.");
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+  }
+
   // parse checkpoint interval
   const char *interval = getenv(ENV_VAR_CKPT_INTR);
   if (interval != NULL) {
@@ -1628,6 +2221,18 @@ main(int argc, char **argv)
     theCheckpointInterval = theDefaultCheckpointInterval;
   }
 
+  const char *reconnectTimeout = getenv(ENV_VAR_COORD_RECONNECT_TIMEOUT);
+  if (reconnectTimeout != NULL) {
+    theReconnectTimeout = jalib::StringToInt(reconnectTimeout);
+  }
+
+  // The journal of a previous coordinator overrides the settings above.
+  if (getenv(ENV_VAR_COORD_JOURNAL) != NULL) {
+    vector<CoordJournal::Record> records;
+    journal.open(getenv(ENV_VAR_COORD_JOURNAL), &records);
+    prog.replayJournal(records);
+  }
+
 #if 0
   if (!quiet) {
     JASSERT_STDERR <<
@@ -23,6 +23,7 @@
 #define DMTCPDMTCPCOORDINATOR_H
 
 #include "../jalib/jsocket.h"
+#include "coordjournal.h"
 #include "dmtcpalloc.h"
 #include "dmtcpmessagetypes.h"
 
@@ -73,6 +74,11 @@ class CoordClient
 
     int isNSWorker() { return _isNSWorker; }
 
+    // True while a subset checkpoint that leaves this process out is running.
+    bool excludedFromCkpt() const { return _excludedFromCkpt; }
+
+    void excludeFromCkpt(bool value) { _excludedFromCkpt = value; }
+
     void readProcessInfo(DmtcpMessage &msg);
 
   private:
@@ -87,6 +93,7 @@ class CoordClient
     pid_t _realPid;
     pid_t _virtualPid;
     int _isNSWorker;
+    bool _excludedFromCkpt;
 };
 
 class DmtcpCoordinator
@@ -100,7 +107,7 @@ class DmtcpCoordinator
     } ComputationStatus;
 
     void onData(CoordClient *client);
-    void onConnect();
+    void onConnect(jalib::JSocket *listener);
     void onDisconnect(CoordClient *client);
     void eventLoop(bool daemon);
 
@@ -115,10 +122,17 @@ class DmtcpCoordinator
     void processBarrier(const string &barrier);
     void releaseBarrier(const string &barrier);
 
-    bool startCheckpoint();
-    void recordCkptFilename(CoordClient *client, const char *barrierList);
-
-    void handleUserCommand(char cmd, DmtcpMessage *reply = NULL);
+    bool startCheckpoint(const string &ckptSubset = "");
+    size_t countCkptSubset(const string &ckptSubset);
+    void selectCkptSubset(const string &ckptSubset);
+    void endCkptSubset();
+    void recordCkptFilename(CoordClient *client,
+                            const char *extraData,
+                            size_t len);
+
+    void handleUserCommand(char cmd,
+                           DmtcpMessage *reply = NULL,
+                           const string &ckptSubset = "");
     void printStatus(size_t numPeers, bool isRunning);
     string printList();
 
@@ -132,6 +146,12 @@ class DmtcpCoordinator
                                          jalib::JSocket &remote,
                                          const struct sockaddr_storage *addr,
                                          socklen_t len);
+    bool validateReconnectingWorkerProcess(DmtcpMessage &hello_remote,
+                                           jalib::JSocket &remote,
+                                           const struct sockaddr_storage *addr,
+                                           socklen_t len);
+    void replayJournal(const vector<CoordJournal::Record> &records);
+    void compactJournal();
 
     ComputationStatus getStatus() const;
     WorkerState::eWorkerState minimumState() const
@@ -144,6 +164,8 @@ class DmtcpCoordinator
     void writeRestartScript();
 
   private:
+    void addCkptFilename(const char *extraData);
+
     size_t _numCkptWorkers;
     size_t _numRestartFilenames;
 
@@ -153,6 +175,17 @@ class DmtcpCoordinator
 
     // map from hostname to checkpoint files
     map<string, vector<string> >_restartFilenames;
+
+    // The journal records of the images of the last checkpoint.
+    vector<string> _ckptFilenameRecords;
+
+    // Where a subset checkpoint, and its restart script and manifest, are
+    // written; empty unless a subset checkpoint is in progress.
+    string _ckptSubsetDir;
+
+    // Subset checkpoints are numbered on their own; they don't start a new
+    // generation of the computation.
+    uint32_t _ckptSubsetGeneration;
     map<pid_t, CoordClient *>_virtualPidToClientMap;
 };
 }
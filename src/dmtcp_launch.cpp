@@ -23,6 +23,7 @@
 #include "../jalib/jassert.h"
 #include "../jalib/jconvert.h"
 #include "../jalib/jfilesystem.h"
+#include "ckptcrypt.h"
 #include "constants.h"
 #include "coordinatorapi.h"
 #include "dmtcpmessagetypes.h"
@@ -97,6 +98,37 @@ static const char *theUsage =
   "  --ckptdir PATH (environment variable DMTCP_CHECKPOINT_DIR)\n"
   "              Directory to store checkpoint images\n"
   "              (default: curr dir at launch)\n"
+  "  --ckpt-shards N (environment variable DMTCP_CKPT_SHARDS)\n"
+  "              Spread checkpoint images over N subdirectories of the\n"
+  "              checkpoint dir, to reduce metadata load on a shared\n"
+  "              filesystem for very large computations (default: 0, flat)\n"
+  "  --keep-generations N (environment variable DMTCP_KEEP_GENERATIONS)\n"
+  "              Write each checkpoint to a new generation subdirectory of\n"
+  "              the checkpoint dir, and delete all but the newest N complete\n"
+  "              generations in the background (default: 0, keep all)\n"
+  "  --keep-bytes SIZE (environment variable DMTCP_KEEP_BYTES)\n"
+  "              Like --keep-generations, but delete the oldest generations\n"
+  "              once all generations together use more than SIZE bytes.\n"
+  "              SIZE may end in K, M, G or T.  The newest generation is\n"
+  "              always kept.  (default: 0, no limit)\n"
+  "  --ckpt-key-file FILE (environment variable DMTCP_CKPT_KEY_FILE)\n"
+  "              Encrypt and authenticate checkpoint images (AES-256-GCM)\n"
+  "              with the key in FILE: 32 bytes, or 64 hex digits.  The key\n"
+  "              is kept in memory only; it is never written to an image.\n"
+  "  --ckpt-key-fd FD (environment variable DMTCP_CKPT_KEY_FD)\n"
+  "              Like --ckpt-key-file, but read the key from open fd FD.\n"
+  "  --ckpt-write-rate RATE (environment variable DMTCP_CKPT_WRITE_RATE)\n"
+  "              Write checkpoint images at most RATE bytes per second (before\n"
+  "              compression).  RATE may end in K, M or G.  (default: 0, no\n"
+  "              limit)\n"
+  "  --ckpt-compress-cpu PERCENT (environment variable DMTCP_CKPT_HELPER_CPU)\n"
+  "              Let the compressor and encryptor of each process use at most\n"
+  "              PERCENT of the CPUs available to it.  (default: no limit)\n"
+  "  --ckpt-max-memory SIZE (environment variable DMTCP_CKPT_MAX_MEMORY)\n"
+  "              With DMTCP_FORKED_CHECKPOINT, fall back to a normal\n"
+  "              checkpoint if the forked copy could take more than SIZE bytes\n"
+  "              (or more than the cgroup memory limit allows).  SIZE may end\n"
+  "              in K, M, G or T.  (default: 0, only the cgroup limit)\n"
   "  --ckpt-open-files\n"
   "  --checkpoint-open-files\n"
   "              Checkpoint open files and restore old working dir.\n"
@@ -105,6 +137,9 @@ static const char *theUsage =
   "              If used with --checkpoint-open-files, allows a saved file\n"
   "              to overwrite its existing copy at original location\n"
   "              (default: file overwrites are not allowed)\n"
+  "  --virtual-time (environment variable DMTCP_VIRTUAL_TIME)\n"
+  "              Hide the time spent checkpointed from the monotonic clocks,\n"
+  "              their timers, and sleeps.  (default: disabled)\n"
   "  --ckpt-signal signum\n"
   "              Signal number used internally by DMTCP for checkpointing\n"
   "              (default: SIGUSR2/12).\n"
@@ -146,6 +181,22 @@ static const char *theUsage =
   "              Skip NOTE messages; if given twice, also skip WARNINGs\n"
   "  --coord-logfile PATH (environment variable DMTCP_COORD_LOG_FILENAME\n"
   "              Coordinator will dump its logs to the given file\n"
+  "  --untracked-helpers PATTERNS (environment variable\n"
+  "                                DMTCP_UNTRACKED_HELPERS)\n"
+  "              Colon-separated list of shell patterns for short-lived\n"
+  "              helper programs (e.g., '*/gzip:sort:cc1').  Matching\n"
+  "              programs are exec'ed outside of DMTCP and are never\n"
+  "              checkpointed; a checkpoint waits for them to exit instead.\n"
+  "              Patterns without '/' match the program's basename.\n"
+  "  --untracked-helpers-timeout SECONDS (environment variable\n"
+  "                                DMTCP_UNTRACKED_HELPERS_TIMEOUT)\n"
+  "              Maximum time a checkpoint waits for untracked helpers\n"
+  "              to exit (default: "
+                            STRINGIFY(DEFAULT_UNTRACKED_HELPERS_TIMEOUT) ")\n"
+  "  --quiesce-timeout MS (environment variable DMTCP_QUIESCE_TIMEOUT)\n"
+  "              Quiesce-then-checkpoint mode: threads that call\n"
+  "              dmtcp_safe_point() get up to MS milliseconds to park\n"
+  "              themselves before they are signalled (default: 0, off)\n"
   "  --help\n"
   "              Print this message and exit.\n"
   "  --version\n"
@@ -283,6 +334,15 @@ processArgs(int *orig_argc, const char ***orig_argv)
     } else if (s == "--coord-logfile") {
       setenv(ENV_VAR_COORD_LOGFILE, argv[1], 1);
       shift; shift;
+    } else if (argc > 1 && s == "--untracked-helpers") {
+      setenv(ENV_VAR_UNTRACKED_HELPERS, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--untracked-helpers-timeout") {
+      setenv(ENV_VAR_UNTRACKED_HELPERS_TIMEOUT, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--quiesce-timeout") {
+      setenv(ENV_VAR_QUIESCE_TIMEOUT, argv[1], 1);
+      shift; shift;
     } else if (argv[0][0] == '-' && argv[0][1] == 'i' &&
                isdigit(argv[0][2])) { // else if -i5, for example
       setenv(ENV_VAR_CKPT_INTR, argv[0] + 2, 1);
@@ -305,6 +365,32 @@ processArgs(int *orig_argc, const char ***orig_argv)
     } else if (argc > 1 && (s == "-c" || s == "--ckptdir")) {
       setenv(ENV_VAR_CHECKPOINT_DIR, argv[1], 1);
       shift; shift;
+    } else if (argc > 1 && s == "--ckpt-shards") {
+      setenv(ENV_VAR_CKPT_SHARDS, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--ckpt-key-file") {
+      setenv(ENV_VAR_CKPT_KEY_FILE, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--ckpt-key-fd") {
+      setenv(ENV_VAR_CKPT_KEY_FD, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--ckpt-write-rate") {
+      setenv(ENV_VAR_CKPT_WRITE_RATE, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--ckpt-compress-cpu") {
+      setenv(ENV_VAR_CKPT_HELPER_CPU, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--ckpt-max-memory") {
+      setenv(ENV_VAR_CKPT_MAX_MEMORY, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--keep-generations") {
+      setenv(ENV_VAR_KEEP_GENERATIONS, argv[1], 1);
+      enableUniqueCkptPlugin = true;
+      shift; shift;
+    } else if (argc > 1 && s == "--keep-bytes") {
+      setenv(ENV_VAR_KEEP_BYTES, argv[1], 1);
+      enableUniqueCkptPlugin = true;
+      shift; shift;
     } else if (argc > 1 && (s == "-t" || s == "--tmpdir")) {
       tmpdir_arg = argv[1];
       shift; shift;
@@ -317,6 +403,9 @@ processArgs(int *orig_argc, const char ***orig_argv)
     } else if (s == "--allow-file-overwrite") {
       setenv(ENV_VAR_ALLOW_OVERWRITE_WITH_CKPTED_FILES, "1", 0);
       shift;
+    } else if (s == "--virtual-time") {
+      setenv(ENV_VAR_VIRTUAL_TIME, "1", 1);
+      shift;
     } else if (s == "--ptrace") {
       enablePtracePlugin = true;
       shift;
@@ -427,6 +516,8 @@ main(int argc, const char **argv)
   UniquePid::ThisProcess(true);
   Util::initializeLogFile(tmpDir.c_str(), NULL, NULL);
 
+  CkptCrypt::installKey();
+
 #ifdef FORKED_CHECKPOINTING
 
   /* When this is robust, add --forked-checkpointing option on command-line,
@@ -519,6 +610,9 @@ main(int argc, const char **argv)
     unsetenv(ENV_VAR_CKPT_OPEN_FILES);
   }
 
+  // Only dmtcp_restart --native-pids sets this.
+  unsetenv(ENV_VAR_NATIVE_PIDS);
+
   bool isElf, is32bitElf;
   if (Util::elfType(argv[0], &isElf, &is32bitElf) == -1) {
     // Couldn't read argv_buf
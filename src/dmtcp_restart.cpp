@@ -21,18 +21,21 @@
 
 #include <elf.h>
 #include <limits.h>
+#include <sched.h>
 #include <stdio.h>
 #include <sys/fcntl.h>
 #include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
+#include <linux/capability.h>
 #include "config.h"
-#ifdef HAS_PR_SET_PTRACER
-#include <sys/prctl.h>
-#endif  // ifdef HAS_PR_SET_PTRACER
 
 #include "../jalib/jassert.h"
 #include "../jalib/jfilesystem.h"
+#include "ckptcrypt.h"
 #include "constants.h"
 #include "coordinatorapi.h"
 #include "processinfo.h"
@@ -58,7 +61,8 @@ static void setEnvironFd();
 // string has at least one format specifier with corresponding format argument.
 // Ubuntu 9.01 uses -Wformat=2 by default.
 static const char *theUsage =
-  "Usage: dmtcp_restart [OPTIONS] <ckpt1.dmtcp> [ckpt2.dmtcp...]\n\n"
+  "Usage: dmtcp_restart [OPTIONS] <ckpt1.dmtcp> [ckpt2.dmtcp...]\n"
+  "       dmtcp_restart [OPTIONS] --manifest FILE\n\n"
   "Restart processes from a checkpoint image.\n\n"
   "Connecting to the DMTCP Coordinator:\n"
   "  -h, --coord-host HOSTNAME (environment variable DMTCP_COORD_HOST)\n"
@@ -102,6 +106,30 @@ static const char *theUsage =
   "  --ckptdir (environment variable DMTCP_CHECKPOINT_DIR):\n"
   "              Directory to store checkpoint images\n"
   "              (default: use the same dir used in previous checkpoint)\n"
+  "  --ckpt-key-file FILE (environment variable DMTCP_CKPT_KEY_FILE)\n"
+  "              Key of encrypted checkpoint images: 32 bytes, or 64 hex\n"
+  "              digits.  Later checkpoints are encrypted with it, too.\n"
+  "  --ckpt-key-fd FD (environment variable DMTCP_CKPT_KEY_FD)\n"
+  "              Like --ckpt-key-file, but read the key from open fd FD.\n"
+  "  --manifest FILE\n"
+  "              Restart the checkpoint images listed in FILE, as written\n"
+  "              by the coordinator (dmtcp_restart_manifest.txt in the ckpt\n"
+  "              dir), instead of naming them on the command line.\n"
+  "  --manifest-host HOSTNAME\n"
+  "              With --manifest, restart only the images of HOSTNAME.\n"
+  "  --verify-inline (environment variable DMTCP_RESTART_VERIFY_INLINE)\n"
+  "              Check the checksums of each image while restoring it,\n"
+  "              instead of reading it twice.  Faster, but a corrupt image\n"
+  "              then fails the restart only after part of it was restored.\n"
+  "  --native-pids\n"
+  "              Restart the processes in a new user and PID namespace with\n"
+  "              their original pids and tids, which then need no\n"
+  "              translation.  Requires Linux 5.5 or later.\n"
+  "  --standby\n"
+  "              Keep the restarted process paused, as a hot standby of the\n"
+  "              running one:  apply each new checkpoint written to the\n"
+  "              (single, uncompressed) image, and resume as soon as the\n"
+  "              checkpointed process is gone from this host, or on SIGUSR1.\n"
   "  --tmpdir PATH (environment variable DMTCP_TMPDIR)\n"
   "              Directory to store temp files (default: $TMDPIR or /tmp)\n"
   "  -q, --quiet (or set environment variable DMTCP_QUIET = 0, 1, or 2)\n"
@@ -133,8 +161,11 @@ int coord_port = UNINITIALIZED_PORT;
 string thePortFile;
 
 CoordinatorMode allowedModes = COORD_ANY;
+bool nativePids = false;
+string standbyImage;  // With --standby
 
 static void setEnvironFd();
+static pid_t forkProcess(pid_t pid);
 static void runMtcpRestart(int is32bitElf, int fd, ProcessInfo *pInfo);
 static int readCkptHeader(const string &path, ProcessInfo *pInfo);
 static int openCkptFileToRead(const string &path);
@@ -181,6 +212,10 @@ class RestoreTarget
       return _pInfo.isRootOfProcessTree();
     }
 
+    void setRootOfProcessTree() { _pInfo.setRootOfProcessTree(); }
+
+    bool isChild(const UniquePid &upid) { return _pInfo.isChild(upid); }
+
     const string& procSelfExe() const { return _pInfo.procSelfExe(); }
 
     bool isOrphan()
@@ -207,7 +242,7 @@ class RestoreTarget
 
     void createDependentChildProcess()
     {
-      pid_t pid = fork();
+      pid_t pid = forkProcess(_pInfo.pid());
 
       JASSERT(pid != -1);
       if (pid != 0) {
@@ -222,7 +257,7 @@ class RestoreTarget
 
       JASSERT(pid != -1);
       if (pid == 0) {
-        pid_t gchild = fork();
+        pid_t gchild = forkProcess(_pInfo.pid());
         JASSERT(gchild != -1);
         if (gchild != 0) {
           exit(0);
@@ -239,7 +274,7 @@ class RestoreTarget
 
       JASSERT(pid != -1);
       if (pid == 0) {
-        pid_t gchild = fork();
+        pid_t gchild = forkProcess(_pInfo.pid());
         JASSERT(gchild != -1);
         if (gchild != 0) {
           exit(0);
@@ -377,6 +412,11 @@ class RestoreTarget
         // Create the ckpt-dir fd so that the restarted process can know about
         // the abs-path of ckpt-image.
         string dirName = jalib::Filesystem::DirName(_path);
+        if (Util::strStartsWith(jalib::Filesystem::BaseName(dirName).c_str(),
+                                CKPT_SHARD_PREFIX)) {
+          // Image from a sharded ckpt dir; use the top-level ckpt dir.
+          dirName = jalib::Filesystem::DirName(dirName);
+        }
         int dirfd = open(dirName.c_str(), O_RDONLY);
         JASSERT(dirfd != -1) (JASSERT_ERRNO);
         if (dirfd != PROTECTED_CKPT_DIR_FD) {
@@ -508,17 +548,36 @@ runMtcpRestart(int is32bitElf, int fd, ProcessInfo *pInfo)
     //     postRestartDebug() in the checkpoint image instead of postRestart().
   }
 
-  char *const newArgs[] = {
-    (char *)mtcprestart.c_str(),
-    const_cast<char *>("--fd"), fdBuf,
-    const_cast<char *>("--stderr-fd"), stderrFdBuf,
-    // These two flag must be last, since they may become NULL
-    ( mtcp_restart_pause ? const_cast<char *>("--mtcp-restart-pause") : NULL ),
-    ( mtcp_restart_pause ? pause_param : NULL ),
-    NULL
-  };
+  vector<char *> newArgs;
+  newArgs.push_back((char *)mtcprestart.c_str());
+  newArgs.push_back(const_cast<char *>("--fd"));
+  newArgs.push_back(fdBuf);
+  newArgs.push_back(const_cast<char *>("--stderr-fd"));
+  newArgs.push_back(stderrFdBuf);
+  if (!standbyImage.empty()) {
+    newArgs.push_back(const_cast<char *>("--standby"));
+    newArgs.push_back((char *)standbyImage.c_str());
+  }
+  if (getenv(ENV_VAR_RESTART_VERIFY_INLINE) != NULL) {
+    newArgs.push_back(const_cast<char *>("--verify-inline"));
+  }
+  if (mtcp_restart_pause) {
+    newArgs.push_back(const_cast<char *>("--mtcp-restart-pause"));
+    newArgs.push_back(pause_param);
+  }
+  newArgs.push_back(NULL);
+
+  // glibc 2.35 and later register an rseq area with the kernel; for a
+  // program as small as mtcp_restart, it lies in the data of ld.so.  Once
+  // mtcp_restart unmaps ld.so, the kernel's next update of the area would
+  // kill the process.
+  string tunables = "glibc.pthread.rseq=0";
+  if (getenv("GLIBC_TUNABLES") != NULL) {
+    tunables = string(getenv("GLIBC_TUNABLES")) + ":" + tunables;
+  }
+  setenv("GLIBC_TUNABLES", tunables.c_str(), 1);
 
-  execve(newArgs[0], newArgs, environ);
+  execve(newArgs[0], &newArgs[0], environ);
   JASSERT(false) (newArgs[0]) (newArgs[1]) (JASSERT_ERRNO)
   .Text("exec() failed");
 }
@@ -560,6 +619,48 @@ first_char(const char *filename)
   return c;
 }
 
+// Returns the read end of a pipe, into which a grandchild process writes the
+// authenticated plaintext of the encrypted image open at fd.  See the comments
+// in open_ckpt_to_read() for why it is a grandchild.
+static int
+open_ckpt_to_decrypt(const char *filename, int fd, const CkptCryptHeader &hdr)
+{
+  uint8_t key[CKPT_CRYPT_KEY_SIZE];
+  int fds[2];
+
+  JASSERT(CkptCrypt::getKey(key)) (filename)
+  .Text("This checkpoint image is encrypted; please give its key with"
+        " --ckpt-key-file or --ckpt-key-fd.");
+  JASSERT(pipe(fds) != -1) (filename) (JASSERT_ERRNO)
+  .Text("Cannot create pipe to decrypt ckpt file!");
+
+  pid_t cpid = fork();
+  JASSERT(cpid != -1) (JASSERT_ERRNO)
+  .Text("ERROR: Cannot fork to decrypt ckpt file!");
+  if (cpid > 0) { /* parent process */
+    JTRACE("created child process to decrypt checkpoint file") (cpid);
+    memset(key, 0, sizeof(key));
+    close(fd);
+    close(fds[1]);
+    JASSERT(waitpid(cpid, NULL, 0) == cpid);
+    return fds[0];
+  }
+
+  cpid = fork();
+  JASSERT(cpid != -1);
+  if (cpid > 0) {
+    _exit(0);
+  }
+
+  // Grandchild process
+  close(fds[0]);
+  JASSERT(CkptCrypt::decryptStream(fd, fds[1], key, hdr) == 0) (filename)
+  .Text("Checkpoint image failed authentication: the key is wrong, or the"
+        " image is corrupt or truncated.");
+  _exit(0);
+  return -1;
+}
+
 // Copied from mtcp/mtcp_restart.c.
 // Let's keep this code close to MTCP code to avoid maintenance problems.
 // MTCP code in:  mtcp/mtcp_restart.c:open_ckpt_to_read()
@@ -596,6 +697,16 @@ open_ckpt_to_read(const char *filename)
   fd = open(filename, O_RDONLY);
   JASSERT(fd >= 0)(filename).Text("Failed to open file.");
 
+  if (fc == CKPT_CRYPT_FIRST) {
+    CkptCryptHeader hdr;
+    JASSERT(CkptCrypt::readHeader(fd, &hdr)) (filename)
+    .Text("ERROR: Invalid header of encrypted checkpoint file!");
+    fd = open_ckpt_to_decrypt(filename, fd, hdr);
+
+    // Then handle the plaintext as if it were the file.
+    fc = (hdr.flags & CKPT_CRYPT_GZIPPED) ? GZIP_FIRST : DMTCP_MAGIC_FIRST;
+  }
+
   if (fc == DMTCP_MAGIC_FIRST) { /* no compression */
     return fd;
   } else if (fc == GZIP_FIRST
@@ -658,6 +769,7 @@ open_ckpt_to_read(const char *filename)
       close(fd);
       JASSERT(dup2(fds[1], STDOUT_FILENO) == STDOUT_FILENO);
       close(fds[1]);
+      close(PROTECTED_CKPT_KEY_FD);
       execvp(decomp_path, (char **)decomp_args);
       JASSERT(decomp_path != NULL) (decomp_path)
       .Text("Failed to launch gzip.");
@@ -743,6 +855,157 @@ setNewCkptDir(char *path)
   }
 }
 
+// With --native-pids, each process is recreated with its original pid.
+static pid_t
+forkProcess(pid_t pid)
+{
+  if (!nativePids) {
+    return fork();
+  }
+
+  pid_t child = Util::forkWithPid(pid);
+  JASSERT(child != -1) (pid) (JASSERT_ERRNO)
+  .Text("--native-pids: failed to recreate the process with its pid");
+  return child;
+}
+
+static void
+writeProcFile(const char *path, const char *buf)
+{
+  int fd = open(path, O_WRONLY);
+  JASSERT(fd != -1) (path) (JASSERT_ERRNO);
+  JASSERT(write(fd, buf, strlen(buf)) == (ssize_t)strlen(buf))
+    (path) (buf) (JASSERT_ERRNO);
+  close(fd);
+}
+
+static int
+exitStatus(int status)
+{
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+#ifndef PR_CAP_AMBIENT
+# define PR_CAP_AMBIENT           47
+# define PR_CAP_AMBIENT_RAISE     2
+#endif // ifndef PR_CAP_AMBIENT
+
+// Creating a process or thread with a given id, and writing ns_last_pid, need
+// CAP_SYS_ADMIN in the PID namespace.  We own the new user namespace, and so
+// have it until we exec mtcp_restart; an ambient capability survives the exec.
+// Each restored thread drops it once its tid is back (Util::dropCapSysAdmin).
+static void
+raiseAmbientCapSysAdmin()
+{
+  struct __user_cap_header_struct hdr;
+  struct __user_cap_data_struct data[2];
+
+  hdr.version = _LINUX_CAPABILITY_VERSION_3;
+  hdr.pid = 0;
+  JASSERT(syscall(SYS_capget, &hdr, data) == 0) (JASSERT_ERRNO);
+  data[CAP_TO_INDEX(CAP_SYS_ADMIN)].inheritable |= CAP_TO_MASK(CAP_SYS_ADMIN);
+  JASSERT(syscall(SYS_capset, &hdr, data) == 0) (JASSERT_ERRNO);
+  JASSERT(prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_RAISE, CAP_SYS_ADMIN, 0, 0)
+          == 0) (JASSERT_ERRNO);
+}
+
+// With --native-pids, the computation is restarted in a new user and PID
+// namespace.  This process stays outside of it, and exits with the exit status
+// of the root process.  Its child is the init of the namespace: it reaps the
+// orphans, and takes the namespace down with it if this process is killed.
+// Only the child of the init, which has the pid of the root process, returns.
+static void
+startNativePidNamespace(pid_t rootPid)
+{
+  char buf[64];
+  uid_t uid = getuid();
+  gid_t gid = getgid();
+
+  JASSERT(unshare(CLONE_NEWUSER | CLONE_NEWPID | CLONE_NEWNS) == 0)
+    (JASSERT_ERRNO)
+  .Text("--native-pids: failed to create a user and PID namespace");
+
+  // Map only our own ids; setgroups must be denied before writing gid_map.
+  writeProcFile("/proc/self/setgroups", "deny");
+  sprintf(buf, "%d %d 1", uid, uid);
+  writeProcFile("/proc/self/uid_map", buf);
+  sprintf(buf, "%d %d 1", gid, gid);
+  writeProcFile("/proc/self/gid_map", buf);
+  raiseAmbientCapSysAdmin();
+
+  pid_t init = fork();
+  JASSERT(init != -1) (JASSERT_ERRNO);
+  if (init != 0) {
+    int status;
+    JASSERT(waitpid(init, &status, 0) == init) (JASSERT_ERRNO);
+    exit(exitStatus(status));
+  }
+
+  JASSERT(prctl(PR_SET_PDEATHSIG, SIGKILL) == 0) (JASSERT_ERRNO);
+
+  // Our session and process group are outside of the namespace, where
+  // getsid() and getpgid() return 0 for them.  Start a session of our own;
+  // the processes that weren't session or group leaders end up in it.
+  JASSERT(setsid() != -1) (JASSERT_ERRNO);
+
+  // /proc must show the pids of the new namespace.
+  JASSERT(mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) == 0)
+    (JASSERT_ERRNO);
+  JASSERT(mount("proc", "/proc", "proc", MS_NOSUID | MS_NODEV | MS_NOEXEC,
+                NULL) == 0) (JASSERT_ERRNO);
+
+  pid_t root = forkProcess(rootPid);
+  if (root == 0) {
+    return;
+  }
+
+  int rootStatus = 0;
+  while (true) {
+    int status;
+    pid_t pid = wait(&status);
+    if (pid == -1 && errno == EINTR) {
+      continue;
+    } else if (pid == -1) {
+      break;
+    } else if (pid == root) {
+      rootStatus = exitStatus(status);
+    }
+  }
+  exit(rootStatus);
+}
+
+// Append the images listed in a restart manifest to 'images'.  Each line of
+// the manifest is "<hostname> <ckpt-image>"; lines starting with '#' are
+// comments.  If 'host' is non-NULL, only the images of that host are used.
+static void
+readRestartManifest(const char *manifest,
+                    const char *host,
+                    vector<string> *images)
+{
+  FILE *fp = fopen(manifest, "r");
+  JASSERT(fp != NULL) (manifest) (JASSERT_ERRNO)
+  .Text("Failed to open restart manifest");
+
+  char *line = NULL;
+  size_t len = 0;
+  while (getline(&line, &len, fp) != -1) {
+    char hostname[256];
+    char image[PATH_MAX];
+    if (line[0] == '#' ||
+        sscanf(line, "%255s %4095s", hostname, image) != 2) {
+      continue;
+    }
+    if (host == NULL || strcmp(host, hostname) == 0) {
+      images->push_back(image);
+    }
+  }
+  free(line);
+  fclose(fp);
+
+  JASSERT(!images->empty()) (manifest) (host ? host : "")
+  .Text("No checkpoint images found in restart manifest");
+}
+
 // shift args
 #define shift argc--, argv++
 
@@ -751,6 +1014,9 @@ main(int argc, char **argv)
 {
   char *tmpdir_arg = NULL;
   char *ckptdir_arg = NULL;
+  char *manifest_arg = NULL;
+  char *manifest_host_arg = NULL;
+  bool standby = false;
 
   initializeJalib();
 
@@ -776,7 +1042,9 @@ main(int argc, char **argv)
   shift;
   while (true) {
     string s = argc > 0 ? argv[0] : "--help";
-    if (s == "--help" && argc == 1) {
+    if (argc == 0 && manifest_arg != NULL) {
+      break;
+    } else if (s == "--help" && argc == 1) {
       printf("%s", theUsage);
       return DMTCP_FAIL_RC;
     } else if ((s == "--version") && argc == 1) {
@@ -828,6 +1096,27 @@ main(int argc, char **argv)
     } else if (argc > 1 && (s == "-c" || s == "--ckptdir")) {
       ckptdir_arg = argv[1];
       shift; shift;
+    } else if (argc > 1 && s == "--ckpt-key-file") {
+      setenv(ENV_VAR_CKPT_KEY_FILE, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--ckpt-key-fd") {
+      setenv(ENV_VAR_CKPT_KEY_FD, argv[1], 1);
+      shift; shift;
+    } else if (argc > 1 && s == "--manifest") {
+      manifest_arg = argv[1];
+      shift; shift;
+    } else if (argc > 1 && s == "--manifest-host") {
+      manifest_host_arg = argv[1];
+      shift; shift;
+    } else if (s == "--native-pids") {
+      nativePids = true;
+      shift;
+    } else if (s == "--verify-inline") {
+      setenv(ENV_VAR_RESTART_VERIFY_INLINE, "1", 1);
+      shift;
+    } else if (s == "--standby") {
+      standby = true;
+      shift;
     } else if (argc > 1 && (s == "-t" || s == "--tmpdir")) {
       tmpdir_arg = argv[1];
       shift; shift;
@@ -872,6 +1161,11 @@ main(int argc, char **argv)
   // make sure JASSERT initializes now, rather than during restart
   Util::initializeLogFile(tmpDir.c_str(), NULL, NULL);
 
+  CkptCrypt::installKey();
+
+  // Passed to the restarted processes in their restart environment.
+  Util::setNativePids(nativePids);
+
   if (!noStrictChecking && jassert_quiet < 2 &&
       (getuid() == 0 || geteuid() == 0)) {
     JASSERT_STDERR <<
@@ -880,11 +1174,19 @@ main(int argc, char **argv)
       "  consequences.  Continuing as root ....\n";
   }
 
-  JTRACE("New dmtcp_restart process; _argc_ ckpt images") (argc);
+  vector<string> images;
+  if (manifest_arg != NULL) {
+    readRestartManifest(manifest_arg, manifest_host_arg, &images);
+  }
+  for (; argc > 0; shift) {
+    images.push_back(argv[0]);
+  }
+
+  JTRACE("New dmtcp_restart process; ckpt images") (images.size());
 
   bool doAbort = false;
-  for (; argc > 0; shift) {
-    string restorename(argv[0]);
+  for (size_t n = 0; n < images.size(); n++) {
+    const string &restorename = images[n];
     struct stat buf;
     int rc = stat(restorename.c_str(), &buf);
     if (Util::strEndsWith(restorename.c_str(), "_files")) {
@@ -914,13 +1216,48 @@ main(int argc, char **argv)
       exit(DMTCP_FAIL_RC);
     }
 
-    JTRACE("Will restart ckpt image") (argv[0]);
-    RestoreTarget *t = new RestoreTarget(argv[0]);
+    JTRACE("Will restart ckpt image") (restorename);
+    RestoreTarget *t = new RestoreTarget(restorename);
     targets[t->upid()] = t;
+    if (standby) {
+      standbyImage = restorename;
+    }
   }
 
-  // Prepare list of independent process tree roots
+  if (standby) {
+    // mtcp_restart reopens the image by name for each new checkpoint, and
+    // applies it in place; it can't read a compressed or encrypted stream.
+    JASSERT(targets.size() == 1) (targets.size())
+    .Text("--standby takes a single ckpt image");
+    JASSERT(first_char(standbyImage.c_str()) == DMTCP_MAGIC_FIRST)
+      (standbyImage)
+    .Text("--standby needs an uncompressed, unencrypted ckpt image;"
+          " checkpoint with 'dmtcp_launch --no-gzip'");
+    if (standbyImage[0] != '/') {
+      standbyImage = jalib::Filesystem::GetCWD() + "/" + standbyImage;
+    }
+  }
+
+  // A process whose parent was left out of a subset checkpoint has no one
+  // to fork it; it is the root of a process tree of its own.
   RestoreTargetMap::iterator i;
+  for (i = targets.begin(); i != targets.end(); i++) {
+    RestoreTarget *t1 = i->second;
+    if (!t1->isRootOfProcessTree()) {
+      RestoreTargetMap::iterator j;
+      for (j = targets.begin(); j != targets.end(); j++) {
+        if (j->second != t1 && j->second->isChild(t1->upid())) {
+          break;
+        }
+      }
+      if (j == targets.end()) {
+        JTRACE("Parent not restarted; restoring as root") (t1->upid());
+        t1->setRootOfProcessTree();
+      }
+    }
+  }
+
+  // Prepare list of independent process tree roots
   for (i = targets.begin(); i != targets.end(); i++) {
     RestoreTarget *t1 = i->second;
     if (t1->isRootOfProcessTree()) {
@@ -965,7 +1302,14 @@ main(int argc, char **argv)
   .Text("Process had no coordinator prior to checkpoint;\n"
         "  but either --join-coordinator or --new-coordinator was specified.");
 
-  if (foundNonOrphan) {
+  if (nativePids) {
+    // The init of the namespace is the parent of the root process.
+    if (!foundNonOrphan) {
+      t = independentProcessTreeRoots.begin()->second;
+    }
+    startNativePidNamespace(t->pid());
+    t->createProcess(true);
+  } else if (foundNonOrphan) {
     t->createProcess(true);
   } else {
     /* we were unable to find any non-orphaned procs.
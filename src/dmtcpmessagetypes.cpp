@@ -41,6 +41,9 @@ DmtcpMessage::DmtcpMessage(DmtcpMessageType t /*= DMT_NULL*/)
   , coordTimeStamp(0)
   , theCheckpointInterval(DMTCPMESSAGE_SAME_CKPT_INTERVAL)
   , exitAfterCkpt(0)
+  , reconnectTimeout(0)
+  , padding(0)
+  , lastCkptDuration(0)
 {
   // struct sockaddr_storage _addr;
   // socklen_t _addrlen;
@@ -93,6 +96,7 @@ dmtcp::operator<<(dmtcp::ostream &o, const DmtcpMessageType &s)
     OSHIFTPRINTF(DMT_NEW_WORKER)
     OSHIFTPRINTF(DMT_NAME_SERVICE_WORKER)
     OSHIFTPRINTF(DMT_RESTART_WORKER)
+    OSHIFTPRINTF(DMT_RECONNECT_WORKER)
     OSHIFTPRINTF(DMT_ACCEPT)
     OSHIFTPRINTF(DMT_REJECT_NOT_RESTARTING)
     OSHIFTPRINTF(DMT_REJECT_WRONG_COMP)
@@ -36,6 +36,8 @@ enum DmtcpMessageType {
   DMT_NEW_WORKER,     // on connect established worker-coordinator
   DMT_NAME_SERVICE_WORKER,
   DMT_RESTART_WORKER,     // on connect established worker-coordinator
+  DMT_RECONNECT_WORKER,   // on connect to a coordinator restarted from its
+                          // journal
   DMT_ACCEPT,          // on connect established coordinator-worker
   DMT_REJECT_NOT_RESTARTING,
   DMT_REJECT_WRONG_COMP,
@@ -81,7 +83,8 @@ enum  ErrorCodes {
   NOERROR                 =  0,
   ERROR_INVALID_COMMAND   = -1,
   ERROR_NOT_RUNNING_STATE = -2,
-  ERROR_COORDINATOR_NOT_FOUND = -3
+  ERROR_COORDINATOR_NOT_FOUND = -3,
+  ERROR_NO_MATCHING_PROCESS = -4
 };
 }
 
@@ -127,7 +130,13 @@ struct DmtcpMessage {
   uint32_t uniqueIdOffset;
   uint32_t exitAfterCkpt;
 
-  // uint32_t padding;
+  // Seconds to try to reconnect if the coordinator dies; 0 to give up.
+  uint32_t reconnectTimeout;
+  uint32_t padding;
+
+  // In ns, from the start of the last checkpoint until all processes ran
+  // again; 0 if there was none.  (Status replies to dmtcp_command.)
+  uint64_t lastCkptDuration;
 
   DmtcpMessage(DmtcpMessageType t = DMT_NULL);
   void assertValid() const;
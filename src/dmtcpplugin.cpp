@@ -27,6 +27,7 @@
 #include "processinfo.h"
 #include "shareddata.h"
 #include "syscallwrappers.h"
+#include "threadlist.h"
 #include "threadsync.h"
 #include "util.h"
 
@@ -42,6 +43,8 @@
 #undef dmtcp_get_coord_ckpt_dir
 #undef dmtcp_set_ckpt_dir
 #undef dmtcp_get_ckpt_dir
+#undef dmtcp_safe_point
+#undef dmtcp_get_suspend_latency
 
 using namespace dmtcp;
 
@@ -141,6 +144,18 @@ dmtcp_enable_ckpt()
   return 1;
 }
 
+EXTERNC int
+dmtcp_safe_point()
+{
+  return ThreadList::safePoint();
+}
+
+EXTERNC uint64_t
+dmtcp_get_suspend_latency()
+{
+  return ThreadList::suspendLatency();
+}
+
 EXTERNC int
 dmtcp_get_ckpt_signal(void)
 {
@@ -302,6 +317,18 @@ dmtcp_get_generation(void)
   return ProcessInfo::instance().get_generation();
 }
 
+EXTERNC int
+dmtcp_is_subset_checkpoint(void)
+{
+  return DmtcpWorker::isSubsetCkpt();
+}
+
+EXTERNC int
+dmtcp_exits_after_ckpt(void)
+{
+  return DmtcpWorker::exitsAfterCkpt();
+}
+
 EXTERNC int
 checkpoint_is_pending(void)
 {
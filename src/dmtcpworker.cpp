@@ -60,6 +60,12 @@ EXTERNC void *ibv_get_device_list(void *) __attribute__((weak));
 static volatile bool exitInProgress = false;
 static bool exitAfterCkpt = 0;
 
+// Set by the coordinator for a checkpoint of a subset of the computation;
+// the images of such a checkpoint go to this directory instead.  These are
+// plain arrays: the checkpoint thread can run before our static constructors.
+static char subsetCkptDir[PATH_MAX] = "";
+static char savedCkptDir[PATH_MAX] = "";
+
 /* NOTE:  Please keep this function in sync with its copy at:
  *   dmtcp_nocheckpoint.cpp:restoreUserLDPRELOAD()
  */
@@ -308,6 +314,9 @@ dmtcp_initialize_entry_point()
   // This is called for side effect only.  Force this function to call
   // getenv(ENV_VAR_SIGCKPT) now and cache it to avoid getenv calls later.
   DmtcpWorker::determineCkptSignal();
+  Util::untrackedHelperTimeout();
+  Util::untrackedHelpersEnabled();
+  Util::nativePids();
 
   // Also cache programName and arguments
   string programName = jalib::Filesystem::GetProgramName();
@@ -408,10 +417,23 @@ DmtcpWorker::isExitInProgress()
   return exitInProgress;
 }
 
+bool
+DmtcpWorker::isSubsetCkpt()
+{
+  return subsetCkptDir[0] != '\0';
+}
+
+bool
+DmtcpWorker::exitsAfterCkpt()
+{
+  return exitAfterCkpt;
+}
+
 void
 DmtcpWorker::waitForPreSuspendMessage()
 {
   SharedData::resetBarrierInfo();
+  subsetCkptDir[0] = '\0';
 
   if (dmtcp_no_coordinator()) {
     string shmFile = jalib::Filesystem::GetDeviceName(PROTECTED_SHM_FD);
@@ -426,17 +448,32 @@ DmtcpWorker::waitForPreSuspendMessage()
   JTRACE("waiting for CHECKPOINT message");
 
   DmtcpMessage msg;
-  CoordinatorAPI::recvMsgFromCoordinator(&msg);
+  char *extraData = NULL;
+  while (true) {
+    CoordinatorAPI::recvMsgFromCoordinator(&msg, (void **)&extraData);
 
-  // Before validating message; make sure we are not exiting.
-  if (exitInProgress) {
-    ckptThreadPerformExit();
+    // Before validating message; make sure we are not exiting.
+    if (exitInProgress) {
+      ckptThreadPerformExit();
+    }
+
+    // The coordinator died; it may come back from its journal.
+    if (msg.isValid() || !CoordinatorAPI::reconnectToCoordinator()) {
+      break;
+    }
   }
 
   msg.assertValid();
 
   JASSERT(msg.type == DMT_DO_CHECKPOINT) (msg.type);
 
+  if (extraData != NULL) {
+    JASSERT(strlen(extraData) < sizeof(subsetCkptDir)) (extraData);
+    strcpy(subsetCkptDir, extraData);
+    JALLOC_HELPER_FREE(extraData);
+    JTRACE("This is a subset checkpoint") (subsetCkptDir);
+  }
+
   // Coordinator sends some computation information along with the SUSPEND
   // message. Extracting that.
   SharedData::updateGeneration(msg.compGroup.computationGeneration());
@@ -456,6 +493,12 @@ DmtcpWorker::waitForCheckpointRequest()
 
   waitForPreSuspendMessage();
 
+  // Short-lived untracked helpers are not worth saving; let them finish.
+  // The checkpoint starts only once they are done, so the user threads run
+  // on meanwhile, and the wait is not counted as suspend latency.
+  ProcessInfo::instance().waitForUntrackedHelpers();
+  ThreadList::ckptRequested();
+
   WorkerState::setCurrentState(WorkerState::PRESUSPEND);
 
   JTRACE("Procesing pre-suspend barriers");
@@ -504,6 +547,16 @@ DmtcpWorker::preCheckpoint()
 
   ProcessInfo::instance().numPeers(numPeers);
 
+  // A subset checkpoint must not overwrite the images of the last checkpoint
+  // of the whole computation.  Switch before the plugins save files
+  // alongside the image.
+  if (subsetCkptDir[0] != '\0') {
+    string ckptDir = ProcessInfo::instance().getCkptDir();
+    JASSERT(ckptDir.length() < sizeof(savedCkptDir)) (ckptDir);
+    strcpy(savedCkptDir, ckptDir.c_str());
+    ProcessInfo::instance().setCkptDir(subsetCkptDir);
+  }
+
   WorkerState::setCurrentState(WorkerState::CHECKPOINTING);
   PluginManager::eventHook(DMTCP_EVENT_PRECHECKPOINT);
 }
@@ -514,6 +567,10 @@ DmtcpWorker::postCheckpoint()
   WorkerState::setCurrentState(WorkerState::CHECKPOINTED);
   CoordinatorAPI::sendCkptFilename();
 
+  if (subsetCkptDir[0] != '\0') {
+    ProcessInfo::instance().setCkptDir(savedCkptDir);
+  }
+
   if (exitAfterCkpt) {
     JTRACE("Asked to exit after checkpoint. Exiting!");
     _exit(0);
@@ -537,6 +594,9 @@ DmtcpWorker::postRestart(double ckptReadTime)
   JTRACE("begin postRestart()");
   WorkerState::setCurrentState(WorkerState::RESTARTING);
 
+  // A restarted subset is a computation of its own.
+  subsetCkptDir[0] = '\0';
+
   JTRACE("Waiting for Restart barrier");
   CoordinatorAPI::waitForBarrier("DMT:Restart");
 
@@ -48,6 +48,8 @@ namespace DmtcpWorker
   int determineCkptSignal();
   void ckptThreadPerformExit();
   bool isExitInProgress();
+  bool isSubsetCkpt();
+  bool exitsAfterCkpt();
 };
 }
 #endif // ifndef DMTCPDMTCPWORKER_H
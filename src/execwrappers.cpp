@@ -534,9 +534,22 @@ patchUserEnv(const char *env[], const char *filename)
   return result;
 }
 
+// The lifeboat carries the serialized DMTCP state across exec.  It lives
+// only until the new program has read it back, so there is no reason to
+// create (and unlink) a file in the DMTCP tmpdir for it.  If the kernel
+// supports memfd_create(), keep it in memory instead.  This avoids two
+// metadata operations per exec, which are expensive on shared filesystems.
 static
 int getLifeboatFd()
 {
+#ifdef SYS_memfd_create
+  int memfd = _real_syscall(SYS_memfd_create, "LifeBoat", 0);
+  if (memfd != -1) {
+    Util::changeFd(memfd, PROTECTED_LIFEBOAT_FD);
+    return PROTECTED_LIFEBOAT_FD;
+  }
+#endif // ifdef SYS_memfd_create
+
   char buf[PATH_MAX] = {0};
   snprintf(buf, sizeof(buf) - 1, "%s/LifeBoat.XXXXXX", dmtcp_get_tmpdir());
   int fd = _real_mkostemps(buf, 0, 0);
@@ -546,6 +559,129 @@ int getLifeboatFd()
   return PROTECTED_LIFEBOAT_FD;
 }
 
+// Mark the protected fds close-on-exec, for a program that is to run outside
+// of DMTCP; fdFlags receives the old flags for restoreProtectedFds().
+static void
+closeProtectedFdsOnExec(int *fdFlags)
+{
+  for (size_t i = PROTECTED_FD_START; i < PROTECTED_FD_END; i++) {
+    int flags = fcntl(i, F_GETFD, NULL);
+    fdFlags[i - PROTECTED_FD_START] = flags;
+    if (flags != -1) {
+      fcntl(i, F_SETFD, flags | FD_CLOEXEC);
+    }
+  }
+}
+
+static void
+restoreProtectedFds(const int *fdFlags)
+{
+  for (size_t i = PROTECTED_FD_START; i < PROTECTED_FD_END; i++) {
+    if (fdFlags[i - PROTECTED_FD_START] != -1) {
+      fcntl(i, F_SETFD, fdFlags[i - PROTECTED_FD_START]);
+    }
+  }
+}
+
+// Exec a helper that matches DMTCP_UNTRACKED_HELPERS outside of DMTCP.  The
+// helper inherits neither our LD_PRELOAD nor any of the protected fds, so it
+// runs at native speed and the coordinator sees this process leave the
+// computation.  A checkpoint requested while the helper is still running
+// waits for it to exit (see ProcessInfo::waitForUntrackedHelpers()).
+static int
+execUntrackedHelper(const char *filename,
+                    char *const argv[],
+                    char *const envp[])
+{
+  JTRACE("Exec'ing untracked helper outside of DMTCP") (filename);
+
+  WRAPPER_EXECUTION_GET_EXCL_LOCK();
+
+  int fdFlags[PROTECTED_FD_END - PROTECTED_FD_START];
+  closeProtectedFdsOnExec(fdFlags);
+
+  int retVal = _real_execvpe(filename, argv, envp);
+
+  // The exec failed; we are still a part of the computation.
+  int saved_errno = errno;
+  restoreProtectedFds(fdFlags);
+  errno = saved_errno;
+
+  WRAPPER_EXECUTION_RELEASE_EXCL_LOCK();
+
+  return retVal;
+}
+
+// posix_spawn() of an untracked helper skips the fork() wrapper altogether:
+// the child gets no coordinator connection and no virtual pid, and never runs
+// DMTCP code.  A helper that is fork()ed and then exec()ed pays for the
+// fork() wrapper, since we can't know yet what the child will run.  Other
+// programs are spawned as before; glibc clones and execs them without going
+// through our wrappers.
+static int
+spawnUntrackedHelper(bool searchPath,
+                     pid_t *pid,
+                     const char *file,
+                     const posix_spawn_file_actions_t *file_actions,
+                     const posix_spawnattr_t *attrp,
+                     char *const argv[],
+                     char *const envp[])
+{
+  JTRACE("Spawning untracked helper outside of DMTCP") (file);
+
+  WRAPPER_EXECUTION_GET_EXCL_LOCK();
+
+  int fdFlags[PROTECTED_FD_END - PROTECTED_FD_START];
+  closeProtectedFdsOnExec(fdFlags);
+
+  pid_t childPid = -1;
+  int retVal = searchPath
+    ? _real_posix_spawnp(&childPid, file, file_actions, attrp, argv, envp)
+    : _real_posix_spawn(&childPid, file, file_actions, attrp, argv, envp);
+
+  restoreProtectedFds(fdFlags);
+  if (retVal == 0) {
+    ProcessInfo::instance().insertUntrackedHelper(childPid);
+    if (pid != NULL) {
+      *pid = childPid;
+    }
+  }
+
+  WRAPPER_EXECUTION_RELEASE_EXCL_LOCK();
+
+  return retVal;
+}
+
+extern "C" int
+posix_spawn(pid_t *pid,
+            const char *path,
+            const posix_spawn_file_actions_t *file_actions,
+            const posix_spawnattr_t *attrp,
+            char *const argv[],
+            char *const envp[])
+{
+  if (!isPerformingCkptRestart() && Util::isUntrackedHelper(path)) {
+    return spawnUntrackedHelper(false, pid, path, file_actions, attrp,
+                                argv, envp);
+  }
+  return _real_posix_spawn(pid, path, file_actions, attrp, argv, envp);
+}
+
+extern "C" int
+posix_spawnp(pid_t *pid,
+             const char *file,
+             const posix_spawn_file_actions_t *file_actions,
+             const posix_spawnattr_t *attrp,
+             char *const argv[],
+             char *const envp[])
+{
+  if (!isPerformingCkptRestart() && Util::isUntrackedHelper(file)) {
+    return spawnUntrackedHelper(true, pid, file, file_actions, attrp,
+                                argv, envp);
+  }
+  return _real_posix_spawnp(pid, file, file_actions, attrp, argv, envp);
+}
+
 extern "C" int
 execve(const char *filename, char *const argv[], char *const envp[])
 {
@@ -714,6 +850,10 @@ dmtcp_execvpe(const char *filename, char *const argv[], char *const envp[])
     return _real_execvpe(filename, argv, envp);
   }
 
+  if (Util::isUntrackedHelper(filename)) {
+    return execUntrackedHelper(filename, argv, envp);
+  }
+
   /* Acquire the wrapperExeution lock to prevent checkpoint to happen while
    * processing this system call.
    */
@@ -25,28 +25,54 @@
 
 using namespace dmtcp;
 
+void
+LookupService::clearMap(KeyValueMap &kvmap)
+{
+  KeyValueMap::iterator it;
+
+  for (it = kvmap.begin(); it != kvmap.end(); it++) {
+    KeyValue *k = (KeyValue *)&(it->first);
+    KeyValue *v = it->second;
+    k->destroy();
+    v->destroy();
+    delete v;
+  }
+  kvmap.clear();
+}
+
 void
 LookupService::reset()
 {
   MapIterator i;
 
   for (i = _maps.begin(); i != _maps.end(); i++) {
-    KeyValueMap &kvmap = i->second;
-    KeyValueMap::iterator it;
-    for (it = kvmap.begin(); it != kvmap.end(); it++) {
-      KeyValue *k = (KeyValue *)&(it->first);
-      KeyValue *v = it->second;
-      k->destroy();
-      v->destroy();
-      delete v;
-    }
-    kvmap.clear();
+    clearMap(i->second);
   }
   _maps.clear();
   _lastUniqueIds.clear();
   _offsets.clear();
 }
 
+// Drops the databases that only hold data for one checkpoint.
+void
+LookupService::resetCkptScoped()
+{
+  const size_t prefixLen = strlen(DMTCP_CKPT_SCOPED_DB);
+  MapIterator i = _maps.begin();
+
+  while (i != _maps.end()) {
+    if (i->first.compare(0, prefixLen, DMTCP_CKPT_SCOPED_DB) == 0) {
+      // Unique ids, too, start again from the first one.
+      _lastUniqueIds.erase(i->first);
+      _offsets.erase(i->first);
+      clearMap(i->second);
+      _maps.erase(i++);
+    } else {
+      ++i;
+    }
+  }
+}
+
 void
 LookupService::addKeyValue(string id,
                            const void *key,
@@ -204,3 +230,90 @@ LookupService::sendAllMappings(jalib::JSocket &remote,
   }
   delete[] (char *)val;
 }
+
+static void
+putBytes(string *buf, const void *data, uint32_t len)
+{
+  buf->append((const char *)&len, sizeof(len));
+  buf->append((const char *)data, len);
+}
+
+static void
+getBytes(const string &buf, size_t *offset, const char **data, uint32_t *len)
+{
+  JASSERT(*offset + sizeof(*len) <= buf.size()) (*offset) (buf.size());
+  memcpy(len, buf.data() + *offset, sizeof(*len));
+  *offset += sizeof(*len);
+  JASSERT(*len <= buf.size() - *offset) (*offset) (*len) (buf.size());
+  *data = buf.data() + *offset;
+  *offset += *len;
+}
+
+void
+LookupService::save(string *buf) const
+{
+  uint32_t n = _maps.size();
+
+  buf->append((const char *)&n, sizeof(n));
+  map<string, KeyValueMap>::const_iterator i;
+  for (i = _maps.begin(); i != _maps.end(); i++) {
+    putBytes(buf, i->first.data(), i->first.length());
+    n = i->second.size();
+    buf->append((const char *)&n, sizeof(n));
+    KeyValueMap::const_iterator j;
+    for (j = i->second.begin(); j != i->second.end(); j++) {
+      KeyValue &k = (KeyValue &)j->first;
+      putBytes(buf, k.data(), k.len());
+      putBytes(buf, j->second->data(), j->second->len());
+    }
+  }
+
+  n = _lastUniqueIds.size();
+  buf->append((const char *)&n, sizeof(n));
+  map<string, uint64_t>::const_iterator u;
+  for (u = _lastUniqueIds.begin(); u != _lastUniqueIds.end(); u++) {
+    uint64_t ids[2] = { u->second, _offsets.find(u->first)->second };
+    putBytes(buf, u->first.data(), u->first.length());
+    buf->append((const char *)ids, sizeof(ids));
+  }
+}
+
+void
+LookupService::restore(const string &buf)
+{
+  size_t offset = 0;
+  const char *data, *val;
+  uint32_t n, len, valLen;
+
+  reset();
+  JASSERT(buf.size() >= sizeof(n)) (buf.size());
+  memcpy(&n, buf.data(), sizeof(n));
+  offset += sizeof(n);
+  for (uint32_t i = 0; i < n; i++) {
+    getBytes(buf, &offset, &data, &len);
+    string id(data, len);
+    KeyValueMap &kvmap = _maps[id];
+    uint32_t count;
+    JASSERT(offset + sizeof(count) <= buf.size()) (offset) (buf.size());
+    memcpy(&count, buf.data() + offset, sizeof(count));
+    offset += sizeof(count);
+    for (uint32_t j = 0; j < count; j++) {
+      getBytes(buf, &offset, &data, &len);
+      getBytes(buf, &offset, &val, &valLen);
+      kvmap[KeyValue(data, len)] = new KeyValue(val, valLen);
+    }
+  }
+
+  JASSERT(offset + sizeof(n) <= buf.size()) (offset) (buf.size());
+  memcpy(&n, buf.data() + offset, sizeof(n));
+  offset += sizeof(n);
+  for (uint32_t i = 0; i < n; i++) {
+    uint64_t ids[2];
+    getBytes(buf, &offset, &data, &len);
+    JASSERT(offset + sizeof(ids) <= buf.size()) (offset) (buf.size());
+    memcpy(ids, buf.data() + offset, sizeof(ids));
+    offset += sizeof(ids);
+    _lastUniqueIds[string(data, len)] = ids[0];
+    _offsets[string(data, len)] = ids[1];
+  }
+}
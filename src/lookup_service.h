@@ -82,6 +82,7 @@ class LookupService
     ~LookupService() { reset(); }
 
     void reset();
+    void resetCkptScoped();
     void registerData(const DmtcpMessage &msg, const void *data);
     void respondToQuery(jalib::JSocket &remote,
                         const DmtcpMessage &msg,
@@ -96,9 +97,15 @@ class LookupService
     void sendAllMappings(jalib::JSocket &remote,
                          const DmtcpMessage &msg);
 
+    // The whole database, as a string that restore() takes back; the
+    // coordinator journals it when it compacts its journal.
+    void save(string *buf) const;
+    void restore(const string &buf);
+
   private:
     typedef map<KeyValue, KeyValue *>KeyValueMap;
     typedef map<string, KeyValueMap>::iterator MapIterator;
+    static void clearMap(KeyValueMap &kvmap);
     void addKeyValue(string id,
                      const void *key,
                      size_t keyLen,
@@ -0,0 +1,200 @@
+#ifndef MTCP_CRC32C_H
+#define MTCP_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC32C (Castagnoli) of the checksummed blocks of a ckpt image.  This is
+ * shared by writeckpt.cpp and by mtcp_restart, which has no libc; so it
+ * uses no library calls, and no static data (mtcp_restart moves itself
+ * before it restores memory, and leaves its bss behind).
+ *
+ * On x86_64 with SSE4.2, three independent streams of crc32q instructions
+ * keep the CRC unit busy (a single stream is bound by the latency of the
+ * instruction).  The CRCs of the streams are merged by multiplying them by
+ * x^(8n) mod P, since appending n zero bytes to a message does just that to
+ * its CRC.  Elsewhere, we use slicing-by-8 tables.
+ */
+
+#define MTCP_CRC32C_POLY 0x82f63b78
+
+// Bytes per stream in the three-stream loop.
+#define MTCP_CRC32C_LANE 8192
+
+typedef struct MtcpCrc32c {
+  int hw;
+  uint32_t shift1;   // x^(8 * MTCP_CRC32C_LANE) mod P
+  uint32_t shift2;   // x^(16 * MTCP_CRC32C_LANE) mod P
+  uint32_t table[8][256];
+} MtcpCrc32c;
+
+/* Multiply a and b modulo P; both are bit-reflected, as CRCs are. */
+static inline uint32_t
+mtcp_crc32c_multmodp(uint32_t a, uint32_t b)
+{
+  uint32_t m = (uint32_t)1 << 31;
+  uint32_t p = 0;
+
+  while (m != 0) {
+    if (a & m) {
+      p ^= b;
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ MTCP_CRC32C_POLY : b >> 1;
+  }
+  return p;
+}
+
+/* x^(8 * nbytes) mod P */
+static inline uint32_t
+mtcp_crc32c_x8nmodp(uint64_t nbytes)
+{
+  uint32_t p = (uint32_t)1 << 31;   // x^0
+  uint32_t xpow = (uint32_t)1 << 30;   // x^1, then x^2, x^4, ...
+  uint64_t n = nbytes * 8;
+
+  while (n != 0) {
+    if (n & 1) {
+      p = mtcp_crc32c_multmodp(xpow, p);
+    }
+    xpow = mtcp_crc32c_multmodp(xpow, xpow);
+    n >>= 1;
+  }
+  return p;
+}
+
+static inline void
+mtcp_crc32c_init(MtcpCrc32c *ctx)
+{
+  uint32_t i;
+  int j;
+
+  ctx->hw = 0;
+#if defined(__x86_64__)
+  {
+    // mtcp_sys.h #defines the names of the registers; so don't use them.
+    uint32_t leaf = 1, b, features = 0, d;
+    __asm__ volatile ("cpuid"
+                      : "+a" (leaf), "=b" (b), "+c" (features), "=d" (d));
+    ctx->hw = (features >> 20) & 1;   // SSE4.2
+  }
+#endif // if defined(__x86_64__)
+
+  for (i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (j = 0; j < 8; j++) {
+      crc = (crc & 1) ? (crc >> 1) ^ MTCP_CRC32C_POLY : crc >> 1;
+    }
+    ctx->table[0][i] = crc;
+  }
+  for (i = 0; i < 256; i++) {
+    for (j = 1; j < 8; j++) {
+      uint32_t prev = ctx->table[j - 1][i];
+      ctx->table[j][i] = (prev >> 8) ^ ctx->table[0][prev & 0xff];
+    }
+  }
+  ctx->shift1 = mtcp_crc32c_x8nmodp(MTCP_CRC32C_LANE);
+  ctx->shift2 = mtcp_crc32c_x8nmodp(2 * MTCP_CRC32C_LANE);
+}
+
+/* The update functions below work on the raw CRC register: no pre- or
+ * post-inversion.
+ */
+static inline uint32_t
+mtcp_crc32c_update_sw(const MtcpCrc32c *ctx, uint32_t crc,
+                      const unsigned char *p, size_t n)
+{
+  while (n > 0 && ((uintptr_t)p & 7) != 0) {
+    crc = ctx->table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    n--;
+  }
+  while (n >= 8) {
+    // Little-endian only, as are all the architectures that DMTCP supports.
+    uint64_t v = *(const uint64_t *)p ^ crc;
+    crc = ctx->table[7][v & 0xff] ^
+          ctx->table[6][(v >> 8) & 0xff] ^
+          ctx->table[5][(v >> 16) & 0xff] ^
+          ctx->table[4][(v >> 24) & 0xff] ^
+          ctx->table[3][(v >> 32) & 0xff] ^
+          ctx->table[2][(v >> 40) & 0xff] ^
+          ctx->table[1][(v >> 48) & 0xff] ^
+          ctx->table[0][v >> 56];
+    p += 8;
+    n -= 8;
+  }
+  while (n > 0) {
+    crc = ctx->table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    n--;
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+static inline uint64_t
+mtcp_crc32c_u64(uint64_t crc, uint64_t v)
+{
+  __asm__ ("crc32q %1, %0" : "+r" (crc) : "rm" (v));
+  return crc;
+}
+
+static inline uint32_t
+mtcp_crc32c_u8(uint32_t crc, unsigned char v)
+{
+  __asm__ ("crc32b %1, %0" : "+r" (crc) : "rm" (v));
+  return crc;
+}
+
+static inline uint32_t
+mtcp_crc32c_update_hw(const MtcpCrc32c *ctx, uint32_t crc,
+                      const unsigned char *p, size_t n)
+{
+  while (n > 0 && ((uintptr_t)p & 7) != 0) {
+    crc = mtcp_crc32c_u8(crc, *p++);
+    n--;
+  }
+  while (n >= 3 * MTCP_CRC32C_LANE) {
+    const uint64_t *a = (const uint64_t *)p;
+    const uint64_t *b = (const uint64_t *)(p + MTCP_CRC32C_LANE);
+    const uint64_t *c = (const uint64_t *)(p + 2 * MTCP_CRC32C_LANE);
+    uint64_t crc0 = crc, crc1 = 0, crc2 = 0;
+    size_t i;
+    for (i = 0; i < MTCP_CRC32C_LANE / 8; i++) {
+      crc0 = mtcp_crc32c_u64(crc0, a[i]);
+      crc1 = mtcp_crc32c_u64(crc1, b[i]);
+      crc2 = mtcp_crc32c_u64(crc2, c[i]);
+    }
+    crc = mtcp_crc32c_multmodp(ctx->shift2, (uint32_t)crc0) ^
+          mtcp_crc32c_multmodp(ctx->shift1, (uint32_t)crc1) ^
+          (uint32_t)crc2;
+    p += 3 * MTCP_CRC32C_LANE;
+    n -= 3 * MTCP_CRC32C_LANE;
+  }
+  while (n >= 8) {
+    crc = (uint32_t)mtcp_crc32c_u64(crc, *(const uint64_t *)p);
+    p += 8;
+    n -= 8;
+  }
+  while (n > 0) {
+    crc = mtcp_crc32c_u8(crc, *p++);
+    n--;
+  }
+  return crc;
+}
+#endif // if defined(__x86_64__)
+
+/* Returns the CRC32C of buf, continuing from the CRC32C crc of whatever
+ * came before it (pass 0 to start).
+ */
+static inline uint32_t
+mtcp_crc32c(const MtcpCrc32c *ctx, uint32_t crc, const void *buf, size_t n)
+{
+  const unsigned char *p = (const unsigned char *)buf;
+
+#if defined(__x86_64__)
+  if (ctx->hw) {
+    return ~mtcp_crc32c_update_hw(ctx, ~crc, p, n);
+  }
+#endif // if defined(__x86_64__)
+  return ~mtcp_crc32c_update_sw(ctx, ~crc, p, n);
+}
+#endif // ifndef MTCP_CRC32C_H
@@ -37,7 +37,7 @@ typedef struct _ThreadTLSInfo {
   struct user_desc gdtentrytls[2];
 } ThreadTLSInfo;
 
-#define MTCP_SIGNATURE     "MTCP_HEADER_v2.2\n"
+#define MTCP_SIGNATURE     "MTCP_HEADER_v2.3\n"
 #define MTCP_SIGNATURE_LEN 32
 typedef union _MtcpHeader {
   struct {
@@ -55,6 +55,11 @@ typedef union _MtcpHeader {
     int tls_pid_offset;
     int tls_tid_offset;
     MYINFO_GS_T myinfo_gs;
+
+    // The checkpointed process (as seen by the kernel) and the boot of the
+    // host it ran on; a standby replica is promoted when it's gone.
+    pid_t ckpt_pid;
+    char ckpt_boot_id[40];
   };
 
   char _padding[4096];
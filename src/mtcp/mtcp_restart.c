@@ -40,6 +40,7 @@
 #define _GNU_SOURCE 1
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sched.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -55,6 +56,7 @@
 #include "../membarrier.h"
 #include "config.h"
 #include "mtcp_check_vdso.ic"
+#include "mtcp_crc32c.h"
 #include "mtcp_header.h"
 #include "mtcp_sys.h"
 #include "mtcp_util.ic"
@@ -75,6 +77,12 @@ void mtcp_check_vdso(char **environ);
 static void mmapfile(int fd, void *buf, size_t size, int prot, int flags);
 #endif
 
+#if defined(__x86_64__) || defined(__aarch64__)
+typedef struct stat mtcp_stat_t;
+#else /* if defined(__x86_64__) || defined(__aarch64__) */
+typedef struct stat64 mtcp_stat_t;
+#endif /* if defined(__x86_64__) || defined(__aarch64__) */
+
 #define BINARY_NAME     "mtcp_restart"
 #define BINARY_NAME_M32 "mtcp_restart-32"
 
@@ -126,12 +134,30 @@ typedef struct RestoreInfo {
 #endif
   MYINFO_GS_T myinfo_gs;
   int mtcp_restart_pause;  // Used by env. var. DMTCP_RESTART_PAUSE
+  int verify_inline;  // Checksums not verified yet; check them while reading
+
+  // --standby:  keep applying new checkpoints of standby_image; see
+  // standby_restore().
+  int standby;
+  char standby_image[FILENAMESIZE];
+  VA standby_mem;  // Free part of the restore region, for the standby tables
+  size_t standby_mem_size;
+  pid_t ckpt_pid;
+  char ckpt_boot_id[40];
 } RestoreInfo;
 static RestoreInfo rinfo;
 
 /* Internal routines */
-static void readmemoryareas(int fd);
-static int read_one_memory_area(int fd);
+static void readmemoryareas(int fd, int verify);
+static int read_one_memory_area(int fd, const MtcpCrc32c *crc32c);
+static int restore_area(int fd, Area *area, const MtcpCrc32c *crc32c,
+                        uint32_t *crcs);
+static size_t area_data_len(Area *area);
+static int area_header_ok(const MtcpCrc32c *crc32c, Area *area);
+static void read_area_data(int fd, Area *area, const MtcpCrc32c *crc32c,
+                           uint32_t *crcs);
+static void read_image(int fd, void *buf, size_t size);
+static int verify_ckpt_image(int fd, const char *ckptImage);
 #if 0
 static void adjust_for_smaller_file_size(Area *area, int fd);
 #endif /* if 0 */
@@ -148,6 +174,7 @@ void restore_libc(ThreadTLSInfo *tlsInfo,
                   int tls_tid_offset,
                   MYINFO_GS_T myinfo_gs);
 static void unmap_memory_areas_and_restore_vdso(RestoreInfo *rinfo);
+static void standby_restore(RestoreInfo *rinfo);
 
 
 #define MB                 1024 * 1024
@@ -210,6 +237,7 @@ main(int argc, char *argv[], char **environ)
   MtcpHeader mtcpHdr;
   int mtcp_sys_errno;
   int simulate = 0;
+  int verify = 0;
 
   if (argc == 1) {
     MTCP_PRINTF("***ERROR: This program should not be used directly.\n");
@@ -244,6 +272,8 @@ main(int argc, char *argv[], char **environ)
   rinfo.fd = -1;
   rinfo.mtcp_restart_pause = 0; /* false */
   rinfo.use_gdb = 0;
+  rinfo.verify_inline = 0;
+  rinfo.standby = 0;
   shift;
   while (argc > 0) {
     if (mtcp_strcmp(argv[0], "--use-gdb") == 0) {
@@ -262,6 +292,17 @@ main(int argc, char *argv[], char **environ)
     } else if (mtcp_strcmp(argv[0], "--simulate") == 0) {
       simulate = 1;
       shift;
+    } else if (mtcp_strcmp(argv[0], "--verify-inline") == 0) {
+      // Before "--verify":  mtcp_strcmp() only compares up to strlen(s2).
+      rinfo.verify_inline = 1;
+      shift;
+    } else if (mtcp_strcmp(argv[0], "--verify") == 0) {
+      verify = 1;
+      shift;
+    } else if (mtcp_strcmp(argv[0], "--standby") == 0) {
+      rinfo.standby = 1;
+      mtcp_strncpy(rinfo.standby_image, argv[1], FILENAMESIZE - 1);
+      shift; shift;
     } else if (argc == 1) {
       // We would use MTCP_PRINTF, but it's also for output of util/readdmtcp.sh
       mtcp_printf("Considering '%s' as a ckpt image.\n", argv[0]);
@@ -282,7 +323,7 @@ main(int argc, char *argv[], char **environ)
   mtcp_sys_gettimeofday(&rinfo.startValue, NULL);
 #endif
   if (rinfo.fd != -1) {
-    mtcp_readfile(rinfo.fd, &mtcpHdr, sizeof mtcpHdr);
+    read_image(rinfo.fd, &mtcpHdr, sizeof mtcpHdr);
   } else {
     int rc = -1;
     rinfo.fd = mtcp_sys_open2(ckptImage, O_RDONLY);
@@ -311,6 +352,30 @@ main(int argc, char *argv[], char **environ)
     return 0;
   }
 
+  /* Check the image before we replace any memory.  If the image is not
+   * seekable (e.g., gzip'ed, and read from a pipe), or if asked to
+   * (--verify-inline), we only check it while we are reading it in; a corrupt
+   * image is then found too late to keep the old process image.
+   */
+  int rc = -1;
+  if (verify || !rinfo.verify_inline) {
+    rc = verify_ckpt_image(rinfo.fd, ckptImage);
+  }
+  if (verify) {
+    if (rc == -1) {
+      MTCP_PRINTF("***ERROR: ckpt image is not seekable; can't verify it.\n");
+    } else if (rc == 0) {
+      mtcp_printf("Checksums of the ckpt image are correct.\n");
+    }
+    return rc == 0 ? 0 : 1;
+  }
+  if (rc == -1) {
+    rinfo.verify_inline = 1;
+  } else if (rc != 0) {
+    MTCP_PRINTF("***ERROR: ckpt image is corrupt; not restarting.\n");
+    return 1;
+  }
+
   rinfo.saved_brk = mtcpHdr.saved_brk;
   rinfo.restore_addr = mtcpHdr.restore_addr;
   rinfo.restore_end = mtcpHdr.restore_addr + mtcpHdr.restore_size;
@@ -325,6 +390,9 @@ main(int argc, char *argv[], char **environ)
   rinfo.tls_pid_offset = mtcpHdr.tls_pid_offset;
   rinfo.tls_tid_offset = mtcpHdr.tls_tid_offset;
   rinfo.myinfo_gs = mtcpHdr.myinfo_gs;
+  rinfo.ckpt_pid = mtcpHdr.ckpt_pid;
+  mtcp_memcpy(rinfo.ckpt_boot_id, mtcpHdr.ckpt_boot_id,
+              sizeof rinfo.ckpt_boot_id);
 
   restore_brk(rinfo.saved_brk, rinfo.restore_addr,
               rinfo.restore_addr + rinfo.restore_size);
@@ -541,8 +609,6 @@ restart_slow_path()
 static void
 mtcp_simulateread(int fd, MtcpHeader *mtcpHdr)
 {
-  int mtcp_sys_errno;
-
   // Print miscellaneous information:
   char buf[MTCP_SIGNATURE_LEN + 1];
 
@@ -565,19 +631,8 @@ mtcp_simulateread(int fd, MtcpHeader *mtcpHdr)
     if (area.size == -1) {
       break;
     }
-    if ((area.properties & DMTCP_ZERO_PAGE) == 0 &&
-        (area.properties & DMTCP_SKIP_WRITING_TEXT_SEGMENTS) == 0) {
-      void *addr = mtcp_sys_mmap(0, area.size, PROT_WRITE | PROT_READ,
-                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-      if (addr == MAP_FAILED) {
-        MTCP_PRINTF("***Error: mmap failed; errno: %d\n", mtcp_sys_errno);
-        mtcp_abort();
-      }
-      mtcp_readfile(fd, addr, area.size);
-      if (mtcp_sys_munmap(addr, area.size) == -1) {
-        MTCP_PRINTF("***Error: munmap failed; errno: %d\n", mtcp_sys_errno);
-        mtcp_abort();
-      }
+    if (area_data_len(&area) > 0) {
+      mtcp_skipfile(fd, area_data_len(&area));
     }
 
     mtcp_printf("%p-%p %c%c%c%c "
@@ -656,13 +711,18 @@ restorememoryareas(RestoreInfo *rinfo_ptr)
   unmap_memory_areas_and_restore_vdso(&restore_info);
 
   /* Restore memory areas */
-  DPRINTF("restoring memory areas\n");
-  readmemoryareas(restore_info.fd);
+  if (restore_info.standby) {
+    DPRINTF("restoring memory areas of a standby replica\n");
+    standby_restore(&restore_info);
+  } else {
+    DPRINTF("restoring memory areas\n");
+    readmemoryareas(restore_info.fd, restore_info.verify_inline);
 
-  /* Everything restored, close file and finish up */
+    /* Everything restored, close file and finish up */
 
-  DPRINTF("close cpfd %d\n", restore_info.fd);
-  mtcp_sys_close(restore_info.fd);
+    DPRINTF("close cpfd %d\n", restore_info.fd);
+    mtcp_sys_close(restore_info.fd);
+  }
   double readTime = 0.0;
 #ifdef TIMING
   struct timeval endValue;
@@ -716,6 +776,8 @@ unmap_memory_areas_and_restore_vdso(RestoreInfo *rinfo)
   VA vdsoEnd = NULL;
   VA vvarStart = NULL;
   VA vvarEnd = NULL;
+  VA vclockStart = NULL;
+  VA vclockEnd = NULL;
 
   int mapsfd = mtcp_sys_open2("/proc/self/maps", O_RDONLY);
 
@@ -745,6 +807,10 @@ unmap_memory_areas_and_restore_vdso(RestoreInfo *rinfo)
       // Do not unmap vvar.
       vvarStart = area.addr;
       vvarEnd = area.endAddr;
+    } else if (mtcp_strcmp(area.name, "[vvar_vclock]") == 0) {
+      // Do not unmap the clock pages split off from vvar in Linux 6.13.
+      vclockStart = area.addr;
+      vclockEnd = area.endAddr;
     } else if (mtcp_strcmp(area.name, "[vsyscall]") == 0) {
       // Do not unmap vsyscall.
     } else if (mtcp_strcmp(area.name, "[vectors]") == 0) {
@@ -764,6 +830,12 @@ unmap_memory_areas_and_restore_vdso(RestoreInfo *rinfo)
   }
   mtcp_sys_close(mapsfd);
 
+  // At checkpoint time, vvar included the clock pages that follow it.
+  VA vvarTail = vvarEnd;
+  if (vclockStart != NULL && vclockStart == vvarEnd) {
+    vvarEnd = vclockEnd;
+  }
+
   if ((vdsoStart == vvarEnd && rinfo->vdsoStart != rinfo->vvarEnd) ||
       (vvarStart == vdsoEnd && rinfo->vvarStart != rinfo->vdsoEnd)) {
     MTCP_PRINTF("***Error: vdso/vvar order was different during ckpt.\n");
@@ -861,8 +933,8 @@ unmap_memory_areas_and_restore_vdso(RestoreInfo *rinfo)
 
   if (vvarStart != NULL) {
     void *vvar = mtcp_sys_mremap(vvarStart,
-                                 vvarEnd - vvarStart,
-                                 vvarEnd - vvarStart,
+                                 vvarTail - vvarStart,
+                                 vvarTail - vvarStart,
                                  MREMAP_FIXED | MREMAP_MAYMOVE,
                                  rinfo->vvarStart);
     if (vvar == MAP_FAILED) {
@@ -872,6 +944,20 @@ unmap_memory_areas_and_restore_vdso(RestoreInfo *rinfo)
     }
     MTCP_ASSERT(vvar == rinfo->vvarStart);
 
+    // mremap() cannot move two mappings at once.
+    if (vvarEnd != vvarTail) {
+      vvar = mtcp_sys_mremap(vclockStart,
+                             vclockEnd - vclockStart,
+                             vclockEnd - vclockStart,
+                             MREMAP_FIXED | MREMAP_MAYMOVE,
+                             rinfo->vvarStart + (vclockStart - vvarStart));
+      if (vvar == MAP_FAILED) {
+        MTCP_PRINTF("***Error: failed to mremap vvar_vclock; errno: %d.\n",
+                    mtcp_sys_errno);
+        mtcp_abort();
+      }
+    }
+
 #if defined(__i386__)
     vvar = mtcp_sys_mmap(vvarStart, vvarEnd - vvarStart,
                          PROT_EXEC | PROT_WRITE | PROT_READ,
@@ -921,10 +1007,15 @@ unmap_memory_areas_and_restore_vdso(RestoreInfo *rinfo)
  *
  **************************************************************************/
 static void
-readmemoryareas(int fd)
+readmemoryareas(int fd, int verify)
 {
+  MtcpCrc32c crc32c;
+
+  if (verify) {
+    mtcp_crc32c_init(&crc32c);
+  }
   while (1) {
-    if (read_one_memory_area(fd) == -1) {
+    if (read_one_memory_area(fd, verify ? &crc32c : NULL) == -1) {
       break; /* error */
     }
   }
@@ -940,21 +1031,40 @@ readmemoryareas(int fd)
 
 NO_OPTIMIZE
 static int
-read_one_memory_area(int fd)
+read_one_memory_area(int fd, const MtcpCrc32c *crc32c)
 {
   int mtcp_sys_errno;
-  int imagefd;
-  void *mmappedat;
-  int try_skipping_existing_segment = 0;
 
   /* Read header of memory area into area; mtcp_readfile() will read header */
   Area area;
 
-  mtcp_readfile(fd, &area, sizeof area);
+  read_image(fd, &area, sizeof area);
+  if (crc32c != NULL && !area_header_ok(crc32c, &area)) {
+    MTCP_PRINTF("***ERROR: ckpt image is corrupt: bad area header\n");
+    mtcp_abort();
+  }
   if (area.size == -1) {
     return -1;
   }
+  restore_area(fd, &area, crc32c, NULL);
+  return 0;
+}
 
+/* Map the area whose header was just read, and read its data (if any) into
+ * it.  If crcs is not NULL, store the checksums of its blocks there.
+ * Returns -1 if the area could not be mapped (its data is skipped).
+ */
+NO_OPTIMIZE
+static int
+restore_area(int fd, Area *area_ptr, const MtcpCrc32c *crc32c, uint32_t *crcs)
+{
+  int mtcp_sys_errno;
+  int imagefd;
+  void *mmappedat;
+  int try_skipping_existing_segment = 0;
+  Area area;
+
+  mtcp_memcpy(&area, area_ptr, sizeof area);
   if (area.name[0] && mtcp_strstr(area.name, "[heap]")
       && mtcp_sys_brk(NULL) != area.addr + area.size) {
     DPRINTF("WARNING: break (%p) not equal to end of heap (%p)\n",
@@ -975,9 +1085,13 @@ read_one_memory_area(int fd)
   if ((area.properties & DMTCP_ZERO_PAGE) != 0) {
     DPRINTF("restoring non-rwx anonymous area, %p bytes at %p\n",
             area.size, area.addr);
+
+    /* Zero areas are typically large, never-touched reservations.  Don't
+     * let them count against the overcommit limit on a smaller host.
+     */
     mmappedat = mtcp_sys_mmap(area.addr, area.size,
                               area.prot,
-                              area.flags | MAP_FIXED, -1, 0);
+                              area.flags | MAP_FIXED | MAP_NORESERVE, -1, 0);
 
     if (mmappedat != area.addr) {
       DPRINTF("error %d mapping %p bytes at %p\n",
@@ -1047,7 +1161,8 @@ read_one_memory_area(int fd)
      * are valid.  Can we unmap vdso and vsyscall in Linux?  Used to use
      * mtcp_safemmap here to check for address conflicts.
      */
-    mmappedat = mtcp_sys_mmap(area.addr, area.size, area.prot | PROT_WRITE,
+    mmappedat = mtcp_sys_mmap(area.addr, area.size,
+                              area.prot | PROT_READ | PROT_WRITE,
                               area.flags, imagefd, area.offset);
 
     if (mmappedat == MAP_FAILED) {
@@ -1087,15 +1202,16 @@ read_one_memory_area(int fd)
 
     if (try_skipping_existing_segment) {
       // This fails on teracluster.  Presumably extra symbols cause overflow.
-      mtcp_skipfile(fd, area.size);
+      mtcp_skipfile(fd, area_data_len(&area));
     } else if ((area.properties & DMTCP_SKIP_WRITING_TEXT_SEGMENTS) == 0) {
       /* This mmapfile after prev. mmap is okay; use same args again.
        *  Posix says prev. map will be munmapped.
        */
 
       /* ANALYZE THE CONDITION FOR DOING mmapfile MORE CAREFULLY. */
-      mtcp_readfile(fd, area.addr, area.size);
-      if (!(area.prot & PROT_WRITE)) {
+      read_area_data(fd, &area, crc32c, crcs);
+      if ((area.prot & (PROT_READ | PROT_WRITE)) !=
+          (PROT_READ | PROT_WRITE)) {
         if (mtcp_sys_mprotect(area.addr, area.size, area.prot) < 0) {
           MTCP_PRINTF("error %d write-protecting %p bytes at %p\n",
                       mtcp_sys_errno, area.size, area.addr);
@@ -1111,7 +1227,722 @@ read_one_memory_area(int fd)
   else { /* Internal error. */
     MTCP_ASSERT(0);
   }
-  return 0;
+  return try_skipping_existing_segment ? -1 : 0;
+}
+
+/* Read exactly size bytes of the image.  Running out of data means that the
+ * image, or the stream that decompresses or decrypts it, was cut short.
+ */
+static void
+read_image(int fd, void *buf, size_t size)
+{
+  int mtcp_sys_errno;
+
+  if ((size_t)mtcp_readfile(fd, buf, size) != size) {
+    MTCP_PRINTF("***ERROR: ckpt image is truncated\n");
+    mtcp_abort();
+  }
+}
+
+/* Number of bytes of the image that follow the header of this area. */
+static size_t
+area_data_len(Area *area)
+{
+  if ((area->properties &
+       (DMTCP_ZERO_PAGE | DMTCP_SKIP_WRITING_TEXT_SEGMENTS)) != 0) {
+    return 0;
+  }
+  if (area->properties & DMTCP_CHECKSUMMED) {
+    return area->size +
+           DMTCP_CKSUM_NUM_BLOCKS(area->size) * sizeof(uint32_t);
+  }
+  return area->size;
+}
+
+static int
+area_header_ok(const MtcpCrc32c *crc32c, Area *area)
+{
+  if ((area->properties & DMTCP_CHECKSUMMED) == 0) {
+    return 1;
+  }
+  uint32_t checksum = area->checksum;
+  area->checksum = 0;
+  int ok = mtcp_crc32c(crc32c, 0, area, sizeof(*area)) == checksum;
+  area->checksum = checksum;
+  return ok;
+}
+
+static void
+report_corrupt_block(Area *area, size_t offset, size_t len)
+{
+  mtcp_printf("***ERROR: ckpt image is corrupt: area %p-%p %s:\n"
+              "          bytes %p-%p of it fail their checksum\n",
+              area->addr, area->addr + area->size,
+              area->name[0] ? area->name : "[anonymous]",
+              area->addr + offset, area->addr + offset + len);
+}
+
+/* Read the data of an area into place.  If crc32c is not NULL, the image
+ * could not be verified before restoring memory; so check each block now.
+ * If crcs is not NULL, store the checksum of each block there.
+ */
+static void
+read_area_data(int fd, Area *area, const MtcpCrc32c *crc32c, uint32_t *crcs)
+{
+  size_t offset;
+
+  if ((area->properties & DMTCP_CHECKSUMMED) == 0) {
+    read_image(fd, area->addr, area->size);
+    return;
+  }
+  for (offset = 0; offset < area->size; offset += DMTCP_CKSUM_BLOCK_SIZE) {
+    size_t len = area->size - offset;
+    uint32_t checksum;
+
+    if (len > DMTCP_CKSUM_BLOCK_SIZE) {
+      len = DMTCP_CKSUM_BLOCK_SIZE;
+    }
+    read_image(fd, area->addr + offset, len);
+    read_image(fd, &checksum, sizeof checksum);
+    if (crcs != NULL) {
+      crcs[offset / DMTCP_CKSUM_BLOCK_SIZE] = checksum;
+    }
+    if (crc32c != NULL &&
+        mtcp_crc32c(crc32c, 0, area->addr + offset, len) != checksum) {
+      report_corrupt_block(area, offset, len);
+      mtcp_abort();
+    }
+  }
+}
+
+/* Check the area headers (if job is 0), and every njobs'th data block
+ * starting with block number 'job', of the image at 'path' from 'offset' on.
+ * Returns the number of corrupt headers and blocks found.
+ */
+static int
+verify_blocks(const char *path, off_t offset, int job, int njobs,
+              const MtcpCrc32c *crc32c)
+{
+  int mtcp_sys_errno;
+  int nbad = 0;
+  size_t block = 0;
+  Area area;
+
+  int fd = mtcp_sys_open2(path, O_RDONLY);
+  if (fd == -1) {
+    MTCP_PRINTF("***ERROR opening ckpt image (%s); errno: %d\n",
+                path, mtcp_sys_errno);
+    return 1;
+  }
+  VA buf = mtcp_sys_mmap(0, DMTCP_CKSUM_BLOCK_SIZE + sizeof(uint32_t),
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf == MAP_FAILED) {
+    MTCP_PRINTF("***ERROR: mmap failed; errno: %d\n", mtcp_sys_errno);
+    mtcp_abort();
+  }
+
+  mtcp_sys_lseek(fd, offset, SEEK_SET);
+  while (1) {
+    off_t areaOffset = mtcp_sys_lseek(fd, 0, SEEK_CUR);
+    if (mtcp_readfile(fd, &area, sizeof area) != sizeof area) {
+      if (job == 0) {
+        mtcp_printf("***ERROR: ckpt image is truncated at offset %p\n",
+                    (void *)areaOffset);
+      }
+      nbad++;
+      break;
+    }
+    if (!area_header_ok(crc32c, &area)) {
+      if (job == 0) {
+        mtcp_printf("***ERROR: ckpt image is corrupt: bad area header"
+                    " at offset %p\n", (void *)areaOffset);
+      }
+      nbad++;
+      break;
+    }
+    if (area.size == -1) {
+      break;
+    }
+    if ((area.properties & DMTCP_CHECKSUMMED) == 0 ||
+        area_data_len(&area) == 0) {
+      mtcp_sys_lseek(fd, area_data_len(&area), SEEK_CUR);
+      continue;
+    }
+
+    size_t blockOffset;
+    for (blockOffset = 0; blockOffset < area.size;
+         blockOffset += DMTCP_CKSUM_BLOCK_SIZE, block++) {
+      size_t len = area.size - blockOffset;
+      if (len > DMTCP_CKSUM_BLOCK_SIZE) {
+        len = DMTCP_CKSUM_BLOCK_SIZE;
+      }
+      if (block % njobs != job) {
+        mtcp_sys_lseek(fd, len + sizeof(uint32_t), SEEK_CUR);
+        continue;
+      }
+      if (mtcp_readfile(fd, buf, len + sizeof(uint32_t)) !=
+          len + sizeof(uint32_t)) {
+        if (job == 0) {
+          mtcp_printf("***ERROR: ckpt image is truncated in area %p-%p\n",
+                      area.addr, area.addr + area.size);
+        }
+        nbad++;
+        break;
+      }
+      uint32_t checksum;
+      mtcp_memcpy(&checksum, buf + len, sizeof checksum);
+      if (mtcp_crc32c(crc32c, 0, buf, len) != checksum) {
+        report_corrupt_block(&area, blockOffset, len);
+        nbad++;
+      }
+    }
+  }
+
+  mtcp_sys_munmap(buf, DMTCP_CKSUM_BLOCK_SIZE + sizeof(uint32_t));
+  mtcp_sys_close(fd);
+  return nbad;
+}
+
+/* Verify the checksums of the memory areas in the image, from the current
+ * offset of fd on, with one process per CPU (up to 16), each reading the
+ * image through a file descriptor of its own.  Returns 0 if the image is
+ * intact, 1 if it is corrupt, and -1 if it can't be read twice.
+ */
+static int
+verify_ckpt_image(int fd, const char *ckptImage)
+{
+  int mtcp_sys_errno;
+  MtcpCrc32c crc32c;
+  char path[sizeof("/proc/self/fd/") + 12] = "/proc/self/fd/";
+  unsigned long cpuMask[16];
+  int njobs = 0;
+  int job;
+  int corrupt = 0;
+  pid_t pids[16];
+
+  (void)mtcp_sys_errno; /* Stop compiler warning about unused variable */
+  off_t offset = mtcp_sys_lseek(fd, 0, SEEK_CUR);
+  if (offset == -1) {
+    return -1;
+  }
+  if (ckptImage == NULL) {
+    char digits[12];
+    int i = sizeof digits - 1;
+    int n = fd;
+    digits[i] = '\0';
+    do {
+      digits[--i] = '0' + n % 10;
+      n /= 10;
+    } while (n > 0);
+    mtcp_strcpy(path + mtcp_strlen(path), digits + i);
+    ckptImage = path;
+  }
+
+  int rc = mtcp_inline_syscall(sched_getaffinity, 3, 0,
+                               sizeof cpuMask, cpuMask);
+  if (rc > 0) {
+    int i, bit;
+    for (i = 0; i < rc / (int)sizeof(cpuMask[0]); i++) {
+      for (bit = 0; bit < 8 * (int)sizeof(cpuMask[0]); bit++) {
+        njobs += (cpuMask[i] >> bit) & 1;
+      }
+    }
+  }
+  if (njobs < 1) {
+    njobs = 1;
+  } else if (njobs > 16) {
+    njobs = 16;
+  }
+
+  mtcp_crc32c_init(&crc32c);
+  for (job = 1; job < njobs; job++) {
+    pids[job] = mtcp_sys_fork();
+    if (pids[job] == 0) {
+      mtcp_sys_exit(verify_blocks(ckptImage, offset, job, njobs,
+                                  &crc32c) == 0 ? 0 : 1);
+    } else if (pids[job] == -1) {
+      // Check the blocks of this and the remaining jobs in this process.
+      break;
+    }
+  }
+  int nforked = job;
+  for (; job < njobs; job++) {
+    corrupt |= verify_blocks(ckptImage, offset, job, njobs, &crc32c) != 0;
+  }
+  corrupt |= verify_blocks(ckptImage, offset, 0, njobs, &crc32c) != 0;
+  for (job = 1; job < nforked; job++) {
+    int status;
+    if (mtcp_sys_wait4(pids[job], &status, 0, NULL) != pids[job] ||
+        status != 0) {
+      corrupt = 1;
+    }
+  }
+  return corrupt;
+}
+
+/*****************************************************************************
+ *
+ *  Standby replica (dmtcp_restart --standby)
+ *
+ *  The memory of the first image is restored as usual, but instead of
+ *  jumping back into the process, the replica waits in the restore region
+ *  for newer checkpoints of the process (images that replace the first one).
+ *  Each new image is verified, then applied:  an area with the same mapping
+ *  as in the last image keeps its memory, and only the blocks whose checksum
+ *  changed are read;  the other areas are restored as usual, and what is left
+ *  of the old ones is unmapped.
+ *    The replica is promoted (ThreadList::postRestart()) on SIGUSR1, or as
+ *  soon as the checkpointed process is gone, if it ran on this host.
+ *
+ *****************************************************************************/
+
+#define STANDBY_POLL_NS 10000000  /* 10 ms */
+
+/* An area of the last image applied.  The checksums of its blocks, if it
+ * has any, are crcs[first_crc...] of its table.
+ */
+typedef struct StandbyArea {
+  VA addr;
+  size_t size;
+  off_t offset;
+  int prot;
+  int flags;
+  uint64_t properties;
+  uint32_t name_crc;
+  size_t first_crc;
+} StandbyArea;
+
+typedef struct StandbyTable {
+  StandbyArea *areas;
+  size_t num_areas;
+  size_t max_areas;
+  uint32_t *crcs;
+  size_t num_crcs;
+  size_t max_crcs;
+} StandbyTable;
+
+static void
+standby_table_init(StandbyTable *table, VA mem, size_t size)
+{
+  table->areas = (StandbyArea *)mem;
+  table->num_areas = 0;
+  table->max_areas = size / 2 / sizeof(StandbyArea);
+  table->crcs = (uint32_t *)(mem + size / 2);
+  table->num_crcs = 0;
+  table->max_crcs = size / 2 / sizeof(uint32_t);
+}
+
+static uint32_t
+standby_name_crc(const MtcpCrc32c *crc32c, const Area *area)
+{
+  return mtcp_crc32c(crc32c, 0, area->name, mtcp_strlen(area->name));
+}
+
+/* The area of 'old' with the same mapping as 'area', or NULL.  Images list
+ * their areas by address; *next is where to start looking.
+ */
+static StandbyArea *
+standby_find_area(StandbyTable *old, size_t *next, const Area *area,
+                  uint32_t name_crc)
+{
+  StandbyArea *a;
+
+  while (*next < old->num_areas && old->areas[*next].addr < area->addr) {
+    (*next)++;
+  }
+  if (*next == old->num_areas) {
+    return NULL;
+  }
+  a = &old->areas[*next];
+  if (a->addr != area->addr || a->size != area->size ||
+      a->offset != area->offset || a->prot != area->prot ||
+      a->flags != area->flags || a->properties != area->properties ||
+      a->name_crc != name_crc) {
+    return NULL;
+  }
+  return a;
+}
+
+/* Read the blocks of an area, already mapped, whose checksums differ from
+ * old_crcs; store all of its checksums in crcs.
+ */
+static void
+standby_update_area(int fd, Area *area, const uint32_t *old_crcs,
+                    uint32_t *crcs)
+{
+  int mtcp_sys_errno;
+  int rw = (area->prot & (PROT_READ | PROT_WRITE)) == (PROT_READ | PROT_WRITE);
+  size_t offset;
+
+  if (!rw && mtcp_sys_mprotect(area->addr, area->size,
+                               area->prot | PROT_READ | PROT_WRITE) < 0) {
+    MTCP_PRINTF("error %d unprotecting %p bytes at %p\n",
+                mtcp_sys_errno, area->size, area->addr);
+    mtcp_abort();
+  }
+  for (offset = 0; offset < area->size; offset += DMTCP_CKSUM_BLOCK_SIZE) {
+    size_t block = offset / DMTCP_CKSUM_BLOCK_SIZE;
+    size_t len = area->size - offset;
+
+    if (len > DMTCP_CKSUM_BLOCK_SIZE) {
+      len = DMTCP_CKSUM_BLOCK_SIZE;
+    }
+    mtcp_sys_lseek(fd, len, SEEK_CUR);
+    read_image(fd, &crcs[block], sizeof crcs[block]);
+    if (crcs[block] != old_crcs[block]) {
+      mtcp_sys_lseek(fd, -(off_t)(len + sizeof crcs[block]), SEEK_CUR);
+      read_image(fd, area->addr + offset, len);
+      mtcp_sys_lseek(fd, sizeof crcs[block], SEEK_CUR);
+    }
+  }
+  if (!rw && mtcp_sys_mprotect(area->addr, area->size, area->prot) < 0) {
+    MTCP_PRINTF("error %d write-protecting %p bytes at %p\n",
+                mtcp_sys_errno, area->size, area->addr);
+    mtcp_abort();
+  }
+}
+
+/* Apply the image at fd (just past its MTCP header) on top of the areas of
+ * 'old', which are in memory, and list its areas in 'new'.
+ */
+NO_OPTIMIZE
+static void
+standby_apply(int fd, StandbyTable *old, StandbyTable *new,
+              const MtcpCrc32c *crc32c)
+{
+  int mtcp_sys_errno;
+  size_t next = 0;
+  Area area;
+
+  new->num_areas = 0;
+  new->num_crcs = 0;
+  while (1) {
+    read_image(fd, &area, sizeof area);
+    if (area.size == -1) {
+      break;
+    }
+
+    uint32_t name_crc = standby_name_crc(crc32c, &area);
+    size_t ncrcs = 0;
+    if ((area.properties & DMTCP_CHECKSUMMED) && area_data_len(&area) > 0) {
+      ncrcs = DMTCP_CKSUM_NUM_BLOCKS(area.size);
+    }
+    if (new->num_areas == new->max_areas ||
+        new->num_crcs + ncrcs > new->max_crcs) {
+      MTCP_PRINTF("***ERROR: too many memory areas for a standby replica\n");
+      mtcp_abort();
+    }
+    uint32_t *crcs = new->crcs + new->num_crcs;
+
+    StandbyArea *match = standby_find_area(old, &next, &area, name_crc);
+    if (match != NULL && area_data_len(&area) == 0) {
+      // Same mapping, no data (zero pages, or text of a file):  keep it.
+    } else if (match != NULL && ncrcs > 0) {
+      standby_update_area(fd, &area, old->crcs + match->first_crc, crcs);
+    } else if (restore_area(fd, &area, NULL, ncrcs > 0 ? crcs : NULL) == -1) {
+      continue;  // Not mapped; a later image must restore it in full.
+    }
+
+    StandbyArea *a = &new->areas[new->num_areas++];
+    a->addr = area.addr;
+    a->size = area.size;
+    a->offset = area.offset;
+    a->prot = area.prot;
+    a->flags = area.flags;
+    a->properties = area.properties;
+    a->name_crc = name_crc;
+    a->first_crc = new->num_crcs;
+    new->num_crcs += ncrcs;
+  }
+}
+
+/* The first part of [start, end) that no area of 'table' covers, or NULL. */
+static VA
+standby_uncovered(StandbyTable *table, VA start, VA end, VA *gap_end)
+{
+  size_t i;
+  int moved = 1;
+
+  while (moved && start < end) {
+    moved = 0;
+    for (i = 0; i < table->num_areas; i++) {
+      StandbyArea *a = &table->areas[i];
+      if (a->addr <= start && start < a->addr + a->size) {
+        start = a->addr + a->size;
+        moved = 1;
+      }
+    }
+  }
+  if (start >= end) {
+    return NULL;
+  }
+  *gap_end = end;
+  for (i = 0; i < table->num_areas; i++) {
+    if (table->areas[i].addr > start && table->areas[i].addr < *gap_end) {
+      *gap_end = table->areas[i].addr;
+    }
+  }
+  return start;
+}
+
+/* Unmap what is left of the previous image:  everything but the areas of
+ * 'table', the restore region, and vdso, vvar, vsyscall and vectors.
+ */
+static void
+standby_unmap_stale_areas(RestoreInfo *rinfo, StandbyTable *table)
+{
+  int mtcp_sys_errno;
+  Area area;
+  VA gap;
+  VA gap_end;
+
+  int mapsfd = mtcp_sys_open2("/proc/self/maps", O_RDONLY);
+  if (mapsfd < 0) {
+    MTCP_PRINTF("error opening /proc/self/maps; errno: %d\n", mtcp_sys_errno);
+    mtcp_abort();
+  }
+  while (mtcp_readmapsline(mapsfd, &area)) {
+    if ((area.addr >= rinfo->restore_addr && area.addr < rinfo->restore_end) ||
+        mtcp_strcmp(area.name, "[vdso]") == 0 ||
+        mtcp_strcmp(area.name, "[vvar]") == 0 ||
+        mtcp_strcmp(area.name, "[vvar_vclock]") == 0 ||
+        mtcp_strcmp(area.name, "[vsyscall]") == 0 ||
+        mtcp_strcmp(area.name, "[vectors]") == 0) {
+      continue;
+    }
+    gap = standby_uncovered(table, area.addr, area.endAddr, &gap_end);
+    if (gap != NULL) {
+      DPRINTF("***INFO: munmapping stale (%p..%p)\n", gap, gap_end);
+      if (mtcp_sys_munmap(gap, gap_end - gap) == -1) {
+        MTCP_PRINTF("***WARNING: munmap(%p, %d) failed; errno: %d\n",
+                    gap, gap_end - gap, mtcp_sys_errno);
+        mtcp_abort();
+      }
+
+      // Rewind and reread maps.
+      mtcp_sys_lseek(mapsfd, 0, SEEK_SET);
+    }
+  }
+  mtcp_sys_close(mapsfd);
+}
+
+/* Move the break to that of the next image.  Areas of 'old' between the two
+ * breaks may lose their memory; forget them.
+ */
+static void
+standby_set_brk(StandbyTable *old, VA saved_brk)
+{
+  int mtcp_sys_errno;
+  (void)mtcp_sys_errno; /* Stop compiler warning about unused variable */
+  VA current_brk = mtcp_sys_brk(NULL);
+  VA low = current_brk < saved_brk ? current_brk : saved_brk;
+  VA high = current_brk < saved_brk ? saved_brk : current_brk;
+  size_t i;
+
+  if (saved_brk == NULL || saved_brk == current_brk) {
+    return;
+  }
+  for (i = 0; i < old->num_areas; i++) {
+    StandbyArea *a = &old->areas[i];
+    if (doAreasOverlap(a->addr, a->size, low, high - low)) {
+      a->size = 0;
+    }
+  }
+
+  VA new_brk = mtcp_sys_brk(saved_brk);
+  if (new_brk == saved_brk && new_brk > current_brk) {
+    // As in restore_brk(), leave the new part of the heap to the image.
+    VA start = (VA)(((uintptr_t)current_brk + MTCP_PAGE_SIZE - 1) &
+                    MTCP_PAGE_MASK);
+    VA end = (VA)(((uintptr_t)new_brk + MTCP_PAGE_SIZE - 1) & MTCP_PAGE_MASK);
+    if (end > start) {
+      mtcp_sys_munmap(start, end - start);
+    }
+  } else if (new_brk != saved_brk) {
+    DPRINTF("WARNING: break (%p) not moved to %p\n", new_brk, saved_brk);
+  }
+}
+
+/* Returns a pidfd of the checkpointed process if it ran on this boot of this
+ * host, or -1.  Unlike its pid, which may be reused, a pidfd refers to that
+ * process only, and can be polled whoever owns the process.  Sets *gone if
+ * the process exited already.  Without pidfds (Linux 5.3), or if the process
+ * is in a pid namespace of its own, it can't be watched; then only SIGUSR1
+ * promotes the replica.
+ */
+static int
+standby_watch_primary(RestoreInfo *rinfo, const char *boot_id, int *gone)
+{
+  int mtcp_sys_errno;
+
+  if (rinfo->ckpt_pid <= 0 || boot_id[0] == '\0' ||
+      mtcp_strncmp(boot_id, rinfo->ckpt_boot_id,
+                   sizeof rinfo->ckpt_boot_id) != 0) {
+    return -1;
+  }
+  int pidfd = mtcp_sys_pidfd_open(rinfo->ckpt_pid, 0);
+  if (pidfd == -1) {
+    *gone = mtcp_sys_errno == ESRCH;
+    DPRINTF("can't watch process %d; errno: %d\n",
+            rinfo->ckpt_pid, mtcp_sys_errno);
+  }
+  return pidfd;
+}
+
+/* True if the process of 'pidfd' (see standby_watch_primary()) is gone. */
+static int
+standby_primary_gone(int pidfd)
+{
+  int mtcp_sys_errno;
+  struct pollfd pfd = { pidfd, POLLIN, 0 };
+  struct timespec zero = { 0, 0 };
+
+  (void)mtcp_sys_errno; /* Stop compiler warning about unused variable */
+  return pidfd != -1 && mtcp_sys_ppoll(&pfd, 1, &zero, NULL, 0) == 1;
+}
+
+/* Open the image at rinfo->standby_image if it is not the one last seen
+ * (*st), and read its MTCP header.  Returns -1 if there's no new image, or if
+ * it can't be applied.
+ */
+static int
+standby_open_image(RestoreInfo *rinfo, mtcp_stat_t *st, MtcpHeader *mtcpHdr)
+{
+  int mtcp_sys_errno;
+  mtcp_stat_t newst;
+  int rc;
+
+  int fd = mtcp_sys_open2(rinfo->standby_image, O_RDONLY);
+  if (fd == -1) {
+    return -1;
+  }
+  if (mtcp_sys_fstat(fd, &newst) == -1 ||
+      (newst.st_dev == st->st_dev && newst.st_ino == st->st_ino &&
+       newst.st_size == st->st_size && newst.st_mtime == st->st_mtime)) {
+    mtcp_sys_close(fd);
+    return -1;
+  }
+  *st = newst;
+
+  do {
+    rc = mtcp_readfile(fd, mtcpHdr, sizeof *mtcpHdr);
+  } while (rc > 0 && mtcp_strcmp(mtcpHdr->signature, MTCP_SIGNATURE) != 0);
+  if (rc <= 0) {
+    MTCP_PRINTF("***WARNING: %s doesn't match MTCP_SIGNATURE; skipping it.\n",
+                rinfo->standby_image);
+  } else if (mtcpHdr->restore_addr != rinfo->restore_addr ||
+             mtcpHdr->restore_size != rinfo->restore_size ||
+             mtcpHdr->vdsoStart != rinfo->vdsoStart ||
+             mtcpHdr->vvarStart != rinfo->vvarStart) {
+    MTCP_PRINTF("***WARNING: %s was written with another restore region or\n"
+                "    vdso; skipping it.\n", rinfo->standby_image);
+  } else if (verify_ckpt_image(fd, NULL) != 0) {
+    MTCP_PRINTF("***WARNING: %s is corrupt; skipping it.\n",
+                rinfo->standby_image);
+  } else {
+    return fd;
+  }
+  mtcp_sys_close(fd);
+  return -1;
+}
+
+NO_OPTIMIZE
+static void
+standby_restore(RestoreInfo *rinfo)
+{
+  int mtcp_sys_errno;
+  MtcpCrc32c crc32c;
+  StandbyTable tables[2];
+  StandbyTable *old = &tables[0];
+  StandbyTable *new = &tables[1];
+  StandbyTable *tmp;
+  MtcpHeader mtcpHdr;
+  mtcp_stat_t st;
+  char boot_id[sizeof rinfo->ckpt_boot_id];
+  uint64_t usr1 = 1ULL << (SIGUSR1 - 1);  // Kernel sigset_t
+  uint64_t oldmask;
+  struct timespec poll = { 0, STANDBY_POLL_NS };
+  int fd;
+  int pidfd;
+  int gone = 0;
+
+  (void)mtcp_sys_errno; /* Stop compiler warning about unused variable */
+
+  mtcp_crc32c_init(&crc32c);
+  size_t half = (rinfo->standby_mem_size / 2) & MTCP_PAGE_MASK;
+  standby_table_init(old, rinfo->standby_mem, half);
+  standby_table_init(new, rinfo->standby_mem + half, half);
+
+  mtcp_memset(boot_id, 0, sizeof boot_id);
+  fd = mtcp_sys_open2("/proc/sys/kernel/random/boot_id", O_RDONLY);
+  if (fd != -1) {
+    mtcp_sys_read(fd, boot_id, sizeof boot_id - 1);
+    mtcp_sys_close(fd);
+  }
+
+  // Watch the process before its pid has much of a chance to be reused.
+  pidfd = standby_watch_primary(rinfo, boot_id, &gone);
+
+  // The first image is the one that dmtcp_restart opened, and was verified.
+  if (mtcp_sys_fstat(rinfo->fd, &st) == -1) {
+    mtcp_memset(&st, 0, sizeof st);
+  }
+  standby_apply(rinfo->fd, old, new, &crc32c);
+  mtcp_sys_close(rinfo->fd);
+  tmp = old; old = new; new = tmp;
+
+  mtcp_sys_rt_sigprocmask(SIG_BLOCK, &usr1, &oldmask, sizeof usr1);
+  while (1) {
+    if (mtcp_sys_rt_sigtimedwait(&usr1, NULL, &poll, sizeof usr1) == SIGUSR1) {
+      DPRINTF("standby replica promoted by SIGUSR1\n");
+      break;
+    }
+    if (gone || standby_primary_gone(pidfd)) {
+      DPRINTF("process %d is gone; standby replica promoted\n",
+              rinfo->ckpt_pid);
+      break;
+    }
+    fd = standby_open_image(rinfo, &st, &mtcpHdr);
+    if (fd == -1) {
+      continue;
+    }
+
+    standby_set_brk(old, mtcpHdr.saved_brk);
+    standby_apply(fd, old, new, &crc32c);
+    mtcp_sys_close(fd);
+    standby_unmap_stale_areas(rinfo, new);
+    tmp = old; old = new; new = tmp;
+
+    rinfo->saved_brk = mtcpHdr.saved_brk;
+    rinfo->post_restart = mtcpHdr.post_restart;
+    rinfo->post_restart_debug = mtcpHdr.post_restart_debug;
+    rinfo->motherofall_tls_info = mtcpHdr.motherofall_tls_info;
+    rinfo->tls_pid_offset = mtcpHdr.tls_pid_offset;
+    rinfo->tls_tid_offset = mtcpHdr.tls_tid_offset;
+    rinfo->myinfo_gs = mtcpHdr.myinfo_gs;
+    if (rinfo->ckpt_pid != mtcpHdr.ckpt_pid ||
+        mtcp_strncmp(rinfo->ckpt_boot_id, mtcpHdr.ckpt_boot_id,
+                     sizeof rinfo->ckpt_boot_id) != 0) {
+      // The process was restarted since; watch its new incarnation.
+      rinfo->ckpt_pid = mtcpHdr.ckpt_pid;
+      mtcp_memcpy(rinfo->ckpt_boot_id, mtcpHdr.ckpt_boot_id,
+                  sizeof rinfo->ckpt_boot_id);
+      if (pidfd != -1) {
+        mtcp_sys_close(pidfd);
+      }
+      pidfd = standby_watch_primary(rinfo, boot_id, &gone);
+    }
+    DPRINTF("standby replica now at the image of %s\n", rinfo->standby_image);
+  }
+  mtcp_sys_rt_sigprocmask(SIG_SETMASK, &oldmask, NULL, sizeof oldmask);
+  if (pidfd != -1) {
+    mtcp_sys_close(pidfd);
+  }
+
+#if defined(__arm__) || defined(__aarch64__)
+  WMB;  // As in readmemoryareas()
+#endif /* if defined(__arm__) || defined(__aarch64__) */
 }
 
 #if 0
@@ -1394,6 +2225,19 @@ remapMtcpRestartToReservedArea(RestoreInfo *rinfo)
 
   rinfo->stack_offset = rinfo->old_stack_addr - rinfo->new_stack_addr;
 
+  if (rinfo->standby) {
+    // The tables of the standby replica take what is left between the guard
+    // page and the new stack.
+    rinfo->standby_mem_size = (VA)new_stack_start_addr - guard_page_end_addr;
+    rinfo->standby_mem = mtcp_sys_mmap(guard_page_end_addr,
+                                       rinfo->standby_mem_size,
+                                       PROT_READ | PROT_WRITE,
+                                       MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED,
+                                       -1,
+                                       0);
+    MTCP_ASSERT(rinfo->standby_mem == guard_page_end_addr);
+  }
+
   rinfo->restorememoryareas_fptr =
     (fnptr_t)(&restorememoryareas + restore_region_offset);
 
@@ -338,6 +338,25 @@ struct linux_dirent {
                       args)
 # define mtcp_sys_set_tid_address(args ...) \
   mtcp_inline_syscall(set_tid_address, 1, args)
+# define mtcp_sys_rt_sigprocmask(args ...) \
+  mtcp_inline_syscall(rt_sigprocmask, 4, args)
+# define mtcp_sys_rt_sigtimedwait(args ...) \
+  mtcp_inline_syscall(rt_sigtimedwait, 4, args)
+# define mtcp_sys_kill(args ...)    mtcp_inline_syscall(kill, 2, args)
+# ifndef __NR_pidfd_open
+#  define __NR_pidfd_open 434  /* The same on all architectures */
+# endif // ifndef __NR_pidfd_open
+# ifndef SYS_pidfd_open
+#  define SYS_pidfd_open __NR_pidfd_open
+# endif // ifndef SYS_pidfd_open
+# define mtcp_sys_pidfd_open(args ...) \
+  mtcp_inline_syscall(pidfd_open, 2, args)
+# define mtcp_sys_ppoll(args ...)   mtcp_inline_syscall(ppoll, 5, args)
+# if defined(__x86_64__) || defined(__aarch64__)
+#  define mtcp_sys_fstat(args ...)  mtcp_inline_syscall(fstat, 2, args)
+# else // if defined(__x86_64__) || defined(__aarch64__)
+#  define mtcp_sys_fstat(args ...)  mtcp_inline_syscall(fstat64, 2, args)
+# endif // if defined(__x86_64__) || defined(__aarch64__)
 
 // #define mtcp_sys_stat(args...) mtcp_inline_syscall(stat, 2, args)
 # define mtcp_sys_getuid(args ...)  mtcp_inline_syscall(getuid, 0)
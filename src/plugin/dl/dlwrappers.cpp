@@ -58,6 +58,11 @@ extern "C" void dmtcp_libdlLockUnlock();
  *   wrapperExecutionLock, the fork wrapper will deadlock when trying to get
  *   writer lock.
  *
+ * EDIT: libdlLock is now a reader-writer lock.  dlopen/dlclose take it as
+ * readers, so that threads loading libraries concurrently (Python imports,
+ * JVM class loading) no longer serialize on it; only the ckpt-thread takes it
+ * as the writer.
+ *
  * EDIT: The dlopen() wrappers causes the problems with the semantics of RPATH
  * associated with the caller library. In future, we can work without this
  * plugin by detecting if we are in the middle of a dlopen by looking up the
@@ -50,6 +50,7 @@ class Connection
       INVALID  = 0x00000,
       TCP      = 0x10000,
       RAW      = 0x11000,
+      UDP      = 0x12000,
       PTY      = 0x20000,
       FILE     = 0x21000,
       STDIO    = 0x22000,
@@ -58,9 +59,14 @@ class Connection
       EVENTFD  = 0x31000,
       SIGNALFD = 0x32000,
       INOTIFY  = 0x34000,
+      TIMERFD  = 0x38000,
+      IOURING  = 0x3C000,
+      PIDFD    = 0x3E000,
       POSIXMQ  = 0x40000,
-      TYPEMASK = TCP | RAW | PTY | FILE | STDIO | FIFO | EPOLL | EVENTFD |
-        SIGNALFD | INOTIFY | POSIXMQ
+      MEMFD    = 0x48000,
+      TYPEMASK = TCP | RAW | UDP | PTY | FILE | STDIO | FIFO | EPOLL |
+        EVENTFD | SIGNALFD | INOTIFY | TIMERFD | IOURING | PIDFD | POSIXMQ |
+        MEMFD
     };
 
     Connection() {}
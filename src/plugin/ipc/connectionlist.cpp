@@ -257,10 +257,11 @@ ConnectionList::getConnection(const ConnectionIdentifier &id)
 Connection *
 ConnectionList::getConnection(int fd)
 {
-  if (_fdToCon.find(fd) == _fdToCon.end()) {
+  FdToConMapT::iterator it = _fdToCon.find(fd);
+  if (it == _fdToCon.end()) {
     return NULL;
   }
-  return _fdToCon[fd];
+  return it->second;
 }
 
 void
@@ -296,9 +297,7 @@ ConnectionList::add(int fd, Connection *c)
     processCloseWork(fd);
   }
 
-  if (_connections.find(c->id()) == _connections.end()) {
-    _connections[c->id()] = c;
-  }
+  _connections.insert(std::make_pair(c->id(), c));
   c->addFd(fd);
   _fdToCon[fd] = c;
   _unlock_tbl();
@@ -22,8 +22,10 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <linux/limits.h>
+#include <poll.h>
 #include <sys/file.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/select.h>
 #include <sys/un.h>
 #include <termios.h>
@@ -40,6 +42,7 @@
 #include "util.h"
 
 #include "eventconnection.h"
+#include "eventconnlist.h"
 #include "eventwrappers.h"
 #include "util_descriptor.h"
 using namespace dmtcp;
@@ -262,6 +265,340 @@ SignalFdConnection::serializeSubClass(jalib::JBinarySerializer &o)
 }
 #endif // ifdef HAVE_SYS_SIGNALFD_H
 
+/*****************************************************************************
+ * Timerfd Connection
+ *****************************************************************************/
+#ifdef HAVE_SYS_TIMERFD_H
+# ifndef TFD_IOC_SET_TICKS
+#  define TFD_IOC_SET_TICKS _IOW('T', 0, uint64_t)
+# endif // ifndef TFD_IOC_SET_TICKS
+
+/* Linux 3.17 and later show the timer in fdinfo:
+ *   clockid: 1
+ *   ticks: 0
+ *   settime flags: 01
+ *   it_value: (0, 49406829)
+ *   it_interval: (1, 0)
+ * We only need the ticks and the settime flags from there.
+ */
+bool
+TimerFdConnection::readFdInfo()
+{
+  char path[64];
+  char buf[512];
+
+  snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", _fds[0]);
+  int fd = _real_open(path, O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  ssize_t len = Util::readAll(fd, buf, sizeof(buf) - 1);
+  _real_close(fd);
+  if (len <= 0) {
+    return false;
+  }
+  buf[len] = '\0';
+
+  const char *ticks = strstr(buf, "\nticks:");
+  const char *flags = strstr(buf, "\nsettime flags:");
+  if (ticks == NULL || flags == NULL) {
+    return false;
+  }
+  _ticks = strtoull(ticks + strlen("\nticks:"), NULL, 10);
+  _settimeFlags = strtol(flags + strlen("\nsettime flags:"), NULL, 8);
+  return true;
+}
+
+void
+TimerFdConnection::drain()
+{
+  JASSERT(_fds.size() > 0);
+
+  // Besides the remaining time, timerfd_gettime() brings the ticks of an
+  // interval timer up to date; fdinfo shows stale ones until then.
+  JASSERT(_real_timerfd_gettime(_fds[0], &_value) == 0)
+    (_fds[0]) (JASSERT_ERRNO);
+  if (!readFdInfo()) {
+    // Older kernels:  the settime flags are lost, and only whether some
+    // expirations are pending is known (reading them would consume them).
+    struct pollfd pfd = { _fds[0], POLLIN, 0 };
+    _settimeFlags = 0;
+    _ticks = _real_poll(&pfd, 1, 0) == 1 ? 1 : 0;
+  }
+
+  // The remaining time is restored as a relative time:  the time spent
+  // checkpointed doesn't count.  Only an absolute CLOCK_REALTIME deadline
+  // stays absolute, at the same wall-clock time.
+  bool armed = _value.it_value.tv_sec != 0 || _value.it_value.tv_nsec != 0;
+  if (_clockid != CLOCK_REALTIME && _clockid != CLOCK_REALTIME_ALARM) {
+    _settimeFlags &= ~TFD_TIMER_ABSTIME;
+  }
+  if (armed && (_settimeFlags & TFD_TIMER_ABSTIME)) {
+    struct timespec now;
+    JASSERT(clock_gettime((clockid_t)_clockid, &now) == 0)
+      (_clockid) (JASSERT_ERRNO);
+    _value.it_value.tv_sec += now.tv_sec;
+    _value.it_value.tv_nsec += now.tv_nsec;
+    if (_value.it_value.tv_nsec >= 1000000000) {
+      _value.it_value.tv_sec++;
+      _value.it_value.tv_nsec -= 1000000000;
+    }
+  }
+  JTRACE("Checkpoint timerfd") (_fds[0]) (_clockid) (_settimeFlags) (_ticks)
+    (_value.it_value.tv_sec) (_value.it_interval.tv_sec);
+}
+
+void
+TimerFdConnection::refill(bool isRestart)
+{
+  JASSERT(_fds.size() > 0);
+  if (!isRestart) {
+    return;  // drain() left the timer alone.
+  }
+
+  struct itimerspec value = _value;
+  int flags = _settimeFlags;
+  bool setTicks = false;
+  if (_ticks > 0) {
+    uint64_t zero = 0;
+
+    // TFD_IOC_SET_TICKS rejects zero with EINVAL when it is supported.
+    setTicks = ioctl(_fds[0], TFD_IOC_SET_TICKS, &zero) == -1 &&
+               errno == EINVAL;
+    if (!setTicks) {
+      // Fire at once instead; the interval keeps the timer going.
+      value.it_value.tv_sec = 0;
+      value.it_value.tv_nsec = 1;
+      flags &= ~TFD_TIMER_ABSTIME;
+    }
+  }
+
+  if (value.it_value.tv_sec != 0 || value.it_value.tv_nsec != 0) {
+    JWARNING(_real_timerfd_settime(_fds[0], flags, &value, NULL) == 0)
+      (_fds[0]) (_clockid) (flags) (JASSERT_ERRNO)
+    .Text("Failed to rearm timerfd");
+  }
+  if (setTicks) {
+    // After timerfd_settime(), which clears the ticks.
+    JWARNING(ioctl(_fds[0], TFD_IOC_SET_TICKS, &_ticks) == 0)
+      (_fds[0]) (_ticks) (JASSERT_ERRNO);
+  }
+}
+
+void
+TimerFdConnection::postRestart()
+{
+  JASSERT(_fds.size() > 0);
+
+  JTRACE("Restoring TimerFd Connection") (id()) (_clockid) (_flags);
+  int tempfd = _real_timerfd_create((clockid_t)_clockid, _flags);
+  JASSERT(tempfd >= 0) (_clockid) (_flags) (JASSERT_ERRNO);
+  restoreDupFds(tempfd);
+}
+
+void
+TimerFdConnection::serializeSubClass(jalib::JBinarySerializer &o)
+{
+  JSERIALIZE_ASSERT_POINT("TimerFdConnection");
+  o & _clockid & _flags & _settimeFlags & _ticks & _value;
+}
+#endif // ifdef HAVE_SYS_TIMERFD_H
+
+/*****************************************************************************
+ * Pidfd Connection
+ *****************************************************************************/
+
+// struct clone_args of linux/sched.h, up to CLONE_ARGS_SIZE_VER0.
+struct StandInCloneArgs {
+  uint64_t flags;
+  uint64_t pidfd;
+  uint64_t child_tid;
+  uint64_t parent_tid;
+  uint64_t exit_signal;
+  uint64_t stack;
+  uint64_t stack_size;
+  uint64_t tls;
+};
+
+/* Linux 5.4 and later show the process of a pidfd in fdinfo:
+ *   pos:    0
+ *   flags:  02004002
+ *   mnt_id: 15
+ *   ino:    1062
+ *   Pid:    1234
+ *   NSpid:  1234
+ * Pid is the real pid; -1 once the process is reaped.
+ */
+static bool
+readPidFdInfo(int fd, pid_t *realPid, int *flags)
+{
+  char path[64];
+  char buf[512];
+
+  snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+  int infofd = _real_open(path, O_RDONLY, 0);
+  if (infofd == -1) {
+    return false;
+  }
+  ssize_t len = Util::readAll(infofd, buf, sizeof(buf) - 1);
+  _real_close(infofd);
+  if (len <= 0) {
+    return false;
+  }
+  buf[len] = '\0';
+
+  const char *pid = strstr(buf, "\nPid:");
+  const char *fl = strstr(buf, "\nflags:");
+  if (pid == NULL || fl == NULL) {
+    return false;
+  }
+  *realPid = strtol(pid + strlen("\nPid:"), NULL, 10);
+  *flags = strtol(fl + strlen("\nflags:"), NULL, 8);
+  return true;
+}
+
+void
+PidFdConnection::drain()
+{
+  JASSERT(_fds.size() > 0);
+
+  pid_t realPid;
+  int flags;
+  if (readPidFdInfo(_fds[0], &realPid, &flags)) {
+    _flags = flags & (O_NONBLOCK | PIDFD_THREAD);
+  }
+
+  // A pidfd polls readable once its process has exited.  A child not yet
+  // reaped keeps its exit status; WNOWAIT leaves it so.
+  struct pollfd pfd = { _fds[0], POLLIN, 0 };
+  if (_real_poll(&pfd, 1, 0) != 1) {
+    _state = PIDFD_RUNNING;
+  } else {
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    if (_real_waitid(P_PIDFD, (id_t)_fds[0], &info,
+                     WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid != 0) {
+      _state = PIDFD_ZOMBIE;
+      _code = info.si_code;
+      _status = info.si_status;
+    } else {
+      _state = PIDFD_EXITED;
+    }
+  }
+  JTRACE("Checkpoint pidfd") (_fds[0]) (_pid) (_flags) (_state) (_code)
+    (_status);
+}
+
+/* The stand-in for a process that has exited:  a child that exits at once,
+ * with the saved status if the process was a child not yet reaped.  Then the
+ * stand-in stays a zombie, which waitid(P_PIDFD) and the wait() family find
+ * under the virtual pid of the process.  Any other stand-in is reaped here;
+ * it has no exit signal, so the application sees no SIGCHLD for it.  A core
+ * dump is not redone:  CLD_DUMPED comes back as CLD_KILLED.
+ *
+ * clone3() hands back the pidfd.  It is called through libc, past the fork()
+ * wrappers:  the child is no DMTCP process, and runs nothing but system calls
+ * (libc's cached tid would be ours).
+ */
+int
+PidFdConnection::forkStandIn()
+{
+  long (*rawSyscall)(long, ...) =
+    (long (*)(long, ...))dmtcp_dlsym_lib("libc.so", "syscall");
+  struct StandInCloneArgs args;
+  int pidfd = -1;
+
+  memset(&args, 0, sizeof(args));
+  args.flags = CLONE_PIDFD;
+  args.pidfd = (uint64_t)(uintptr_t)&pidfd;
+  args.exit_signal = _state == PIDFD_ZOMBIE ? SIGCHLD : 0;
+
+  pid_t child = rawSyscall(SYS_clone3, &args, sizeof(args));
+  if (child == 0) {
+    if (_state == PIDFD_ZOMBIE && _code != CLD_EXITED) {
+      // The default action, unblocked, and no core.  A zeroed struct
+      // sigaction is SIG_DFL with or without sa_restorer.
+      uint64_t zero[4] = { 0, 0, 0, 0 };
+      rawSyscall(SYS_rt_sigaction, _status, zero, NULL, sizeof(uint64_t));
+      rawSyscall(SYS_rt_sigprocmask, SIG_SETMASK, zero, NULL,
+                 sizeof(uint64_t));
+      rawSyscall(SYS_prlimit64, 0, RLIMIT_CORE, zero, NULL);
+      rawSyscall(SYS_kill, rawSyscall(SYS_getpid), _status);
+    }
+    rawSyscall(SYS_exit_group, _state == PIDFD_ZOMBIE ? _status : 0);
+  }
+  JASSERT(child > 0) (_pid) (JASSERT_ERRNO)
+  .Text("Failed to fork a stand-in for the process of a pidfd");
+
+  if (_state == PIDFD_ZOMBIE) {
+    if (dmtcp_update_virtual_pid != NULL) {
+      dmtcp_update_virtual_pid(_pid, child);
+    }
+  } else {
+    siginfo_t info;
+    rawSyscall(SYS_waitid, P_PIDFD, pidfd, &info, WEXITED | __WALL, NULL);
+  }
+  return pidfd;
+}
+
+void
+PidFdConnection::postRestart()
+{
+  JASSERT(_fds.size() > 0);
+
+  JTRACE("Restoring pidfd") (id()) (_pid) (_flags) (_state);
+  int tempfd = -1;
+  if (_state == PIDFD_RUNNING) {
+    // Through the pid plugin, which translates the pid.
+    tempfd = _real_syscall(SYS_pidfd_open, (pid_t)_pid, (int)_flags);
+    JWARNING(tempfd >= 0) (_pid) (_flags) (JASSERT_ERRNO)
+    .Text("The process of a pidfd is gone after restart; it will be seen to"
+          " have exited");
+    if (tempfd == -1) {
+      _state = PIDFD_EXITED;
+    }
+  }
+  if (tempfd == -1) {
+    tempfd = forkStandIn();
+  }
+  restoreDupFds(tempfd);
+}
+
+void
+PidFdConnection::serializeSubClass(jalib::JBinarySerializer &o)
+{
+  JSERIALIZE_ASSERT_POINT("PidFdConnection");
+  o & _pid & _flags & _state & _code & _status;
+}
+
+void
+PidFdConnection::scanForUntracked()
+{
+  vector<int>fds = jalib::Filesystem::ListOpenFds();
+
+  for (size_t i = 0; i < fds.size(); i++) {
+    int fd = fds[i];
+    if (dmtcp_is_protected_fd(fd) ||
+        EventConnList::instance().getConnection(fd) != NULL ||
+        jalib::Filesystem::GetDeviceName(fd) != "anon_inode:[pidfd]") {
+      continue;
+    }
+
+    pid_t realPid;
+    int flags;
+    if (!readPidFdInfo(fd, &realPid, &flags)) {
+      continue;
+    }
+    pid_t pid = realPid;
+    if (realPid > 0 && dmtcp_real_to_virtual_pid != NULL) {
+      pid = dmtcp_real_to_virtual_pid(realPid);
+    }
+    JTRACE("Found a pidfd not from pidfd_open()") (fd) (pid);
+    EventConnList::instance().add(fd, new PidFdConnection(
+                                    pid, flags & (O_NONBLOCK | PIDFD_THREAD)));
+  }
+}
+
 #ifdef DMTCP_USE_INOTIFY
 
 /*****************************************************************************
@@ -26,8 +26,10 @@
 #define EVENTCONNECTION_H
 
 // THESE INCLUDES ARE IN RANDOM ORDER.  LET'S CLEAN IT UP AFTER RELEASE. - Gene
+#include <fcntl.h>
 #include <signal.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -64,6 +66,28 @@ enum { EFD_SEMAPHORE = 1 };
 #  include <stdint.h>
 struct signalfd_siginfo { uint32_t ssi_signo; int dummy; };
 # endif // ifdef HAVE_SYS_SIGNALFD_H
+# ifdef HAVE_SYS_TIMERFD_H
+#  include <sys/timerfd.h>
+# endif // ifdef HAVE_SYS_TIMERFD_H
+# include <sys/syscall.h>
+# include <sys/wait.h>
+
+// pidfds are new in Linux 5.3, and P_PIDFD in 5.4; glibc names them in 2.36.
+# ifndef SYS_pidfd_open
+#  define SYS_pidfd_open 434
+# endif // ifndef SYS_pidfd_open
+# ifndef SYS_clone3
+#  define SYS_clone3     435
+# endif // ifndef SYS_clone3
+# ifndef CLONE_PIDFD
+#  define CLONE_PIDFD    0x00001000
+# endif // ifndef CLONE_PIDFD
+# ifndef PIDFD_THREAD
+#  define PIDFD_THREAD   O_EXCL
+# endif // ifndef PIDFD_THREAD
+# if !__GLIBC_PREREQ(2, 36)
+#  define P_PIDFD        ((idtype_t)3)
+# endif // if !__GLIBC_PREREQ(2, 36)
 
 namespace dmtcp
 {
@@ -150,6 +174,101 @@ class SignalFdConnection : public Connection
 };
 # endif // ifdef HAVE_SYS_SIGNALFD_H
 
+# ifdef HAVE_SYS_TIMERFD_H
+
+/* The state of a timerfd is read at checkpoint time, with timerfd_gettime()
+ * and from /proc/self/fdinfo:  remaining time, interval, settime flags and
+ * pending expirations ("ticks").  Nothing is consumed, and this plugin does
+ * not wrap timerfd_settime(), so a checkpoint leaves the timer running and
+ * the event loops that rearm thousands of timerfds pay nothing for it.  (The
+ * timer plugin wraps it, to translate absolute deadlines of virtual clocks.)
+ * On restart, the timer is armed again with the remaining time, and the
+ * pending expirations are put back with TFD_IOC_SET_TICKS.
+ */
+class TimerFdConnection : public Connection
+{
+  public:
+    inline TimerFdConnection(int clockid, int flags)
+      : Connection(TIMERFD),
+      _clockid(clockid),
+      _flags(flags),
+      _settimeFlags(0),
+      _ticks(0)
+    {
+      memset(&_value, 0, sizeof(_value));
+      JTRACE("new timerfd connection created");
+    }
+
+    virtual void drain();
+    virtual void refill(bool isRestart);
+    virtual void postRestart();
+    virtual void serializeSubClass(jalib::JBinarySerializer &o);
+
+    virtual string str() { return "TIMER-FD: <Not-a-File>"; }
+
+  private:
+    bool readFdInfo();
+
+    int64_t _clockid;
+    int64_t _flags;          // for timerfd_create()
+    int64_t _settimeFlags;   // TFD_TIMER_ABSTIME, TFD_TIMER_CANCEL_ON_SET
+    uint64_t _ticks;         // expirations not yet read
+    struct itimerspec _value;
+};
+# endif // ifdef HAVE_SYS_TIMERFD_H
+
+/* A pidfd, from pidfd_open() or found among the fds at checkpoint time (from
+ * clone() with CLONE_PIDFD, say), and the virtual pid it refers to.  At
+ * checkpoint time, its process is either running, or it has exited; if it is
+ * a child not yet reaped, its exit status is saved.
+ *
+ * On restart, the pidfd of a running process is opened again, through the
+ * pid plugin, which knows its new real pid.  The process of any other pidfd
+ * is stood in for by a child that exits at once:  the pidfd polls readable,
+ * pidfd_send_signal() fails with ESRCH, and waitid(P_PIDFD) finds the saved
+ * exit status, or no child.  An epoll set adds the pidfd back in its own
+ * refill, after this.
+ */
+class PidFdConnection : public Connection
+{
+  public:
+    enum PidFdState {
+      PIDFD_RUNNING,
+      PIDFD_EXITED,    // Reaped, or not our child
+      PIDFD_ZOMBIE     // A child not yet reaped; _code and _status are saved
+    };
+
+    inline PidFdConnection(pid_t pid, int flags)
+      : Connection(PIDFD),
+      _pid(pid),
+      _flags(flags),
+      _state(PIDFD_RUNNING),
+      _code(0),
+      _status(0)
+    {
+      JTRACE("new pidfd connection created") (pid) (flags);
+    }
+
+    virtual void drain();
+    virtual void refill(bool isRestart) {}
+    virtual void postRestart();
+    virtual void serializeSubClass(jalib::JBinarySerializer &o);
+
+    virtual string str() { return "PID-FD: <Not-a-File>"; }
+
+    // Adds the pidfds that were not opened through the wrappers.
+    static void scanForUntracked();
+
+  private:
+    int forkStandIn();
+
+    int64_t _pid;      // Virtual
+    int64_t _flags;    // PIDFD_NONBLOCK, PIDFD_THREAD
+    int64_t _state;
+    int64_t _code;     // si_code and si_status of waitid()
+    int64_t _status;
+};
+
 # ifdef HAVE_SYS_INOTIFY_H
 #  ifdef DMTCP_USE_INOTIFY
 class InotifyConnection : public Connection
@@ -2,6 +2,7 @@
 #include <sys/syscall.h>
 #include <unistd.h>
 #include "eventconnection.h"
+#include "iouringconnection.h"
 
 using namespace dmtcp;
 void
@@ -22,6 +23,10 @@ dmtcp_EventConnList_EventHook(DmtcpEvent_t event, DmtcpEventData_t *data)
     break;
 
   case DMTCP_EVENT_PRECHECKPOINT:
+    PidFdConnection::scanForUntracked();
+#ifdef HAVE_IO_URING
+    IoUringConnection::checkUntracked();
+#endif // ifdef HAVE_IO_URING
     EventConnList::saveOptions();
     dmtcp_local_barrier("Event::PRE_CKPT");
     EventConnList::leaderElection();
@@ -96,6 +101,25 @@ EventConnList::createDummyConnection(int type)
     break;
 #endif // ifdef HAVE_SYS_SIGNALFD_H
 
+#ifdef HAVE_SYS_TIMERFD_H
+  case Connection::TIMERFD:
+    return new TimerFdConnection(0, 0);   // dummy val
+
+    break;
+#endif // ifdef HAVE_SYS_TIMERFD_H
+
+  case Connection::PIDFD:
+    return new PidFdConnection(0, 0);   // dummy val
+
+    break;
+
+#ifdef HAVE_IO_URING
+  case Connection::IOURING:
+    return new IoUringConnection(0, NULL);   // dummy val
+
+    break;
+#endif // ifdef HAVE_IO_URING
+
 #ifdef HAVE_SYS_INOTIFY_H
 # ifdef DMTCP_USE_INOTIFY
   case Connection::INOTIFY:
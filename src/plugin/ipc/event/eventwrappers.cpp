@@ -20,6 +20,8 @@
  ****************************************************************************/
 
 #include <poll.h>
+#include <stdarg.h>
+#include <sys/mman.h>
 #include <sys/select.h>
 
 /* According to POSIX.1-2001 */
@@ -34,6 +36,7 @@
 #include "eventconnection.h"
 #include "eventconnlist.h"
 #include "eventwrappers.h"
+#include "iouringconnection.h"
 
 using namespace dmtcp;
 
@@ -192,6 +195,44 @@ eventfd(EVENTFD_VAL_TYPE initval, int flags)
 }
 #endif // ifdef HAVE_SYS_EVENTFD_H
 
+#ifdef HAVE_SYS_TIMERFD_H
+extern "C" int
+timerfd_create(int clockid, int flags)
+{
+  DMTCP_PLUGIN_DISABLE_CKPT();
+  int ret = _real_timerfd_create(clockid, flags);
+  if (ret != -1) {
+    JTRACE("timerfd created") (ret) (clockid) (flags);
+    EventConnList::instance().add(ret, new TimerFdConnection(clockid, flags));
+  }
+  DMTCP_PLUGIN_ENABLE_CKPT();
+  return ret;
+}
+#endif // ifdef HAVE_SYS_TIMERFD_H
+
+static int
+pidfdOpen(pid_t pid, unsigned int flags)
+{
+  DMTCP_PLUGIN_DISABLE_CKPT();
+
+  // The pid plugin, next, translates the pid.
+  int ret = _real_syscall(SYS_pidfd_open, pid, flags);
+  if (ret != -1) {
+    JTRACE("pidfd opened") (ret) (pid) (flags);
+    EventConnList::instance().add(ret, new PidFdConnection(pid, flags));
+  }
+  DMTCP_PLUGIN_ENABLE_CKPT();
+  return ret;
+}
+
+#if __GLIBC_PREREQ(2, 36)
+extern "C" int
+pidfd_open(pid_t pid, unsigned int flags)
+{
+  return pidfdOpen(pid, flags);
+}
+#endif // if __GLIBC_PREREQ(2, 36)
+
 #ifdef HAVE_SYS_EPOLL_H
 extern "C" int
 epoll_create(int size)
@@ -402,3 +443,68 @@ inotify_rm_watch(int fd, int wd)
 }
 # endif // ifndef DMTCP_USE_INOTIFY
 #endif // ifdef HAVE_SYS_INOTIFY_H
+
+/* glibc has no functions for io_uring; liburing, unless built without libc
+ * (the default on x86-64 before liburing 2.6 or so; see --use-libc), calls
+ * syscall().  So do programs written for a glibc without memfd_create() or
+ * pidfd_open().  As in the pid plugin, the system call takes no more than
+ * seven arguments of the natural size of a register.
+ *
+ * XXX: Nothing but io_uring, memfd_create and pidfd_open here may use
+ * JTRACE/JNOTE/JASSERT or the STL.
+ */
+extern "C" long
+syscall(long sys_num, ...)
+{
+  long a[7];
+  va_list ap;
+
+  va_start(ap, sys_num);
+  for (int i = 0; i < 7; i++) {
+    a[i] = va_arg(ap, long);
+  }
+  va_end(ap);
+
+  switch (sys_num) {
+# ifdef HAVE_IO_URING
+  case SYS_io_uring_setup:
+  {
+    DMTCP_PLUGIN_DISABLE_CKPT();
+    long ret = _real_syscall(sys_num, a[0], a[1]);
+    if (ret != -1) {
+      JTRACE("io_uring set up") (ret) (a[0]);
+      EventConnList::instance().add(ret, new IoUringConnection(
+                                      a[0], (struct io_uring_params *)a[1]));
+    }
+    DMTCP_PLUGIN_ENABLE_CKPT();
+    return ret;
+  }
+  case SYS_io_uring_register:
+  {
+    DMTCP_PLUGIN_DISABLE_CKPT();
+    long ret = _real_syscall(sys_num, a[0], a[1], a[2], a[3]);
+    unsigned int opcode = a[1];
+
+    // With a registered ring fd, a[0] is an index into the table of the task.
+    if (ret != -1 && !(opcode & IORING_REGISTER_USE_REGISTERED_RING)) {
+      Connection *con = EventConnList::instance().getConnection(a[0]);
+      if (con != NULL && con->conType() == Connection::IOURING) {
+        ((IoUringConnection *)con)->onRegister(opcode, (const void *)a[2],
+                                                a[3], ret);
+      }
+    }
+    DMTCP_PLUGIN_ENABLE_CKPT();
+    return ret;
+  }
+# endif // ifdef HAVE_IO_URING
+# if __GLIBC_PREREQ(2, 27)
+  case SYS_memfd_create:
+    // The wrapper in the file plugin.
+    return memfd_create((const char *)a[0], a[1]);
+# endif // if __GLIBC_PREREQ(2, 27)
+  case SYS_pidfd_open:
+    return pidfdOpen(a[0], a[1]);
+  default:
+    return _real_syscall(sys_num, a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+  }
+}
@@ -34,9 +34,12 @@
 #  define EVENTFD_VAL_TYPE    int
 # endif // if __GLIBC_PREREQ(2, 21)
 
+# define _real_open           NEXT_FNC(open)
 # define _real_poll           NEXT_FNC(poll)
 # define _real_poll_chk       NEXT_FNC(__poll_chk)
 # define _real_pselect        NEXT_FNC(pselect)
+# define _real_syscall        NEXT_FNC(syscall)
+# define _real_waitid         NEXT_FNC(waitid)
 
 # ifdef HAVE_SYS_EPOLL_H
 #  define _real_epoll_create  NEXT_FNC(epoll_create)
@@ -54,6 +57,12 @@
 #  define _real_signalfd NEXT_FNC(signalfd)
 # endif // ifdef HAVE_SYS_SIGNALFD_H
 
+# ifdef HAVE_SYS_TIMERFD_H
+#  define _real_timerfd_create  NEXT_FNC(timerfd_create)
+#  define _real_timerfd_settime NEXT_FNC(timerfd_settime)
+#  define _real_timerfd_gettime NEXT_FNC(timerfd_gettime)
+# endif // ifdef HAVE_SYS_TIMERFD_H
+
 # ifdef HAVE_SYS_INOTIFY_H
 #  define _real_inotify_init      NEXT_FNC(inotify_init)
 #  define _real_inotify_init1     NEXT_FNC(inotify_init1)
@@ -0,0 +1,916 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "jassert.h"
+#include "jfilesystem.h"
+#include "dmtcp.h"
+#include "procselfmaps.h"
+#include "util.h"
+
+#include "eventconnlist.h"
+#include "eventwrappers.h"
+#include "iouringconnection.h"
+
+#ifdef HAVE_IO_URING
+using namespace dmtcp;
+
+// Time given to the requests in flight to complete at checkpoint time, as
+// long as they keep completing:  the wait ends after IOURING_DRAIN_IDLE_MS
+// without a new CQE (an idle socket, a multishot request).
+#define IOURING_DRAIN_TIMEOUT_MS  1000
+#define IOURING_DRAIN_IDLE_MS     10
+
+// Time given to the cancelled requests to post their CQEs.
+#define IOURING_CANCEL_TIMEOUT_MS 100
+
+// Number of requests submitted to a ring above which restoring its indices
+// takes long enough (a few seconds) to say so.
+#define IOURING_FAST_FORWARD_NOTE (1U << 25)
+
+// SQ ring, CQ ring (the same memory, with IORING_FEAT_SINGLE_MMAP) and SQE
+// array of a ring:  mapped by the plugin itself, or, with
+// IORING_SETUP_NO_MMAP, the memory that the ring was set up on.
+struct IoUringConnection::Views {
+  char *sq;
+  char *cq;
+  char *sqes;
+  size_t sqLen;
+  size_t cqLen;
+  size_t sqesLen;
+  bool mapped;
+};
+
+static size_t
+sqeSize(const struct io_uring_params &p)
+{
+  return p.flags & IORING_SETUP_SQE128 ? 128 : 64;
+}
+
+static size_t
+cqeSize(const struct io_uring_params &p)
+{
+  return p.flags & IORING_SETUP_CQE32 ? 32 : 16;
+}
+
+static inline uint32_t
+ringLoad(const char *ring, uint32_t off)
+{
+  return __atomic_load_n((const uint32_t *)(ring + off), __ATOMIC_ACQUIRE);
+}
+
+static inline void
+ringStore(char *ring, uint32_t off, uint32_t val)
+{
+  __atomic_store_n((uint32_t *)(ring + off), val, __ATOMIC_RELEASE);
+}
+
+static int
+ioUringEnter(int fd,
+             unsigned int toSubmit,
+             unsigned int minComplete,
+             unsigned int flags)
+{
+  return _real_syscall(SYS_io_uring_enter, fd, toSubmit, minComplete, flags,
+                       NULL, 0);
+}
+
+// Not through our wrapper:  what the plugin registers is already recorded.
+static int
+ioUringRegister(int fd, unsigned int opcode, const void *arg, unsigned nrArgs)
+{
+  return _real_syscall(SYS_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+static size_t
+ringsLen(const struct io_uring_params &p)
+{
+  return std::max(p.sq_off.array + p.sq_entries * sizeof(uint32_t),
+                  p.cq_off.cqes + p.cq_entries * cqeSize(p));
+}
+
+static size_t
+sqesLen(const struct io_uring_params &p)
+{
+  return p.sq_entries * sqeSize(p);
+}
+
+static void
+unmapViews(const IoUringConnection::Views &v)
+{
+  if (!v.mapped) {
+    return;
+  }
+  if (v.sqes != MAP_FAILED) {
+    munmap(v.sqes, v.sqesLen);
+  }
+  if (v.cq != MAP_FAILED && v.cq != v.sq) {
+    munmap(v.cq, v.cqLen);
+  }
+  if (v.sq != MAP_FAILED) {
+    munmap(v.sq, v.sqLen);
+  }
+}
+
+static bool
+mapViews(int fd, const struct io_uring_params &p, IoUringConnection::Views *v)
+{
+  int prot = PROT_READ | PROT_WRITE;
+  int flags = MAP_SHARED | MAP_POPULATE;
+
+  v->sqesLen = sqesLen(p);
+  if (p.flags & IORING_SETUP_NO_MMAP) {
+    v->sq = v->cq = (char *)IOURING_USER_ADDR(p.cq_off);
+    v->sqes = (char *)IOURING_USER_ADDR(p.sq_off);
+    v->sqLen = v->cqLen = ringsLen(p);
+    v->mapped = false;
+    return true;
+  }
+
+  v->sqLen = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  v->cqLen = p.cq_off.cqes + p.cq_entries * cqeSize(p);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    v->sqLen = v->cqLen = ringsLen(p);
+  }
+  v->mapped = true;
+  v->sq = (char *)mmap(NULL, v->sqLen, prot, flags, fd, IORING_OFF_SQ_RING);
+  v->cq = v->sq;
+  if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+    v->cq = (char *)mmap(NULL, v->cqLen, prot, flags, fd, IORING_OFF_CQ_RING);
+  }
+  v->sqes = (char *)mmap(NULL, v->sqesLen, prot, flags, fd, IORING_OFF_SQES);
+  if (v->sq == MAP_FAILED || v->cq == MAP_FAILED || v->sqes == MAP_FAILED) {
+    int saved_errno = errno;
+    unmapViews(*v);
+    errno = saved_errno;
+    return false;
+  }
+  return true;
+}
+
+// Whether a and b map the same memory:  a change through a shows through b.
+// The word must be one that the kernel doesn't read.
+static bool
+sameWord(char *a, char *b)
+{
+  volatile uint32_t *x = (volatile uint32_t *)a;
+  volatile uint32_t *y = (volatile uint32_t *)b;
+  uint32_t orig = *x;
+  bool same = *y == orig;
+
+  if (same) {
+    *x = ~orig;
+    same = *y == ~orig;
+    *x = orig;
+  }
+  return same;
+}
+
+IoUringConnection::IoUringConnection(uint32_t entries,
+                                     const struct io_uring_params *params)
+  : Connection(IOURING),
+  _entries(entries),
+  _enabled(false),
+  _sqHead(0),
+  _sqTail(0),
+  _cqHead(0),
+  _cqTail(0),
+  _eventfd(-1),
+  _eventfdAsync(false),
+  _unrestored(0),
+  _inFlight(0)
+{
+  memset(&_params, 0, sizeof(_params));
+  if (params != NULL) {
+    _params = *params;
+    JTRACE("new io_uring connection created") (entries) (params->flags);
+  }
+}
+
+/* Requests submitted but not yet completed, as far as the rings tell:  each
+ * request posts at least one CQE, unless it skips it on success
+ * (IOSQE_CQE_SKIP_SUCCESS).  A multishot request posts many, as does
+ * IORING_OP_MSG_RING from another ring, and may make the count look lower
+ * than it is.
+ */
+static int32_t
+inFlight(const struct io_uring_params &p, const char *sq, const char *cq)
+{
+  return (int32_t)(ringLoad(sq, p.sq_off.head) - ringLoad(cq, p.cq_off.tail));
+}
+
+// An SQPOLL thread may still be taking SQEs from the ring.
+static bool
+sqPending(const struct io_uring_params &p, const char *sq)
+{
+  return (p.flags & IORING_SETUP_SQPOLL) &&
+         ringLoad(sq, p.sq_off.head) != ringLoad(sq, p.sq_off.tail);
+}
+
+// Waits until the CQ tail reaches 'cqTail', or the SQ head if 'toHead', for
+// up to 'timeoutMs', or 'idleMs' in a row without progress.
+static void
+waitForCompletions(int fd,
+                   const struct io_uring_params &p,
+                   const char *sq,
+                   const char *cq,
+                   bool toHead,
+                   uint32_t cqTail,
+                   int timeoutMs,
+                   int idleMs)
+{
+  uint32_t lastHead = ringLoad(sq, p.sq_off.head);
+  uint32_t lastTail = ringLoad(cq, p.cq_off.tail);
+  int idle = 0;
+
+  for (int ms = 0; ms < timeoutMs && idle < idleMs; ms++) {
+    uint32_t head = ringLoad(sq, p.sq_off.head);
+    uint32_t tail = ringLoad(cq, p.cq_off.tail);
+    uint32_t target = toHead ? head : cqTail;
+    if (!sqPending(p, sq) && (int32_t)(target - tail) <= 0) {
+      break;
+    }
+    idle = head == lastHead && tail == lastTail ? idle + 1 : 0;
+    lastHead = head;
+    lastTail = tail;
+
+    // Also moves CQEs that overflowed the CQ ring back into it, if there is
+    // room.  From this thread, this fails on a DEFER_TASKRUN ring.
+    unsigned int flags = IORING_ENTER_GETEVENTS;
+    if (ringLoad(sq, p.sq_off.flags) & IORING_SQ_NEED_WAKEUP) {
+      flags |= IORING_ENTER_SQ_WAKEUP;
+    }
+    ioUringEnter(fd, 0, 0, flags);
+    _real_poll(NULL, 0, 1);
+  }
+}
+
+/* Lets the requests in flight complete, while they do.  The others (reads of
+ * idle sockets, multishot requests, ...) are only cancelled if the process
+ * exits after the checkpoint:  on resume, they are still there, and a
+ * restart from this image can't bring them back anyway.
+ */
+void
+IoUringConnection::quiesce(const Views &v)
+{
+  int fd = _fds[0];
+
+  waitForCompletions(fd, _params, v.sq, v.cq, true, 0,
+                     IOURING_DRAIN_TIMEOUT_MS, IOURING_DRAIN_IDLE_MS);
+
+  int ret = 0;
+  if (dmtcp_exits_after_ckpt() && inFlight(_params, v.sq, v.cq) > 0) {
+    // Their CQEs carry -ECANCELED.
+    struct io_uring_sync_cancel_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.fd = -1;
+    reg.flags = IORING_ASYNC_CANCEL_ANY;
+    reg.timeout.tv_sec = -1;
+    reg.timeout.tv_nsec = -1;
+    uint32_t cqTail = ringLoad(v.cq, _params.cq_off.tail);
+    ret = ioUringRegister(fd, IORING_REGISTER_SYNC_CANCEL, &reg, 1);
+    JTRACE("Cancelled io_uring requests") (fd) (ret) (JASSERT_ERRNO);
+    if (ret > 0) {
+      // The CQEs may come later, from an SQPOLL thread.
+      waitForCompletions(fd, _params, v.sq, v.cq, false, cqTail + ret,
+                         IOURING_CANCEL_TIMEOUT_MS, IOURING_CANCEL_TIMEOUT_MS);
+    }
+  }
+
+  int32_t n = inFlight(_params, v.sq, v.cq);
+  _inFlight = std::max(n, 0);
+  JWARNING(n <= 0 || ret >= 0) (fd) (n) (_params.flags) (JASSERT_ERRNO)
+  .Text("Failed to cancel io_uring requests in flight (Linux 6.0 or later is"
+        " needed, and a SINGLE_ISSUER ring can only be cancelled by its own"
+        " thread); their completions will be missing after restart");
+  JWARNING(!sqPending(_params, v.sq)) (fd)
+  .Text("The SQPOLL thread of an io_uring did not take all the SQEs");
+  JWARNING(!(ringLoad(v.sq, _params.sq_off.flags) & IORING_SQ_CQ_OVERFLOW))
+    (fd).Text("CQEs that overflowed the CQ ring of an io_uring will be"
+              " missing after restart");
+}
+
+void
+IoUringConnection::findMappings(const Views &v)
+{
+  ProcSelfMaps procSelfMaps;
+  ProcMapsArea area;
+  struct stat st;
+
+  // Rings have an inode of their own since Linux 5.12 or so; before, the
+  // marker test below tells them apart.
+  JASSERT(fstat(_fds[0], &st) == 0) (_fds[0]) (JASSERT_ERRNO);
+  _mappings.clear();
+  while (procSelfMaps.getNextArea(&area)) {
+    if (!Util::isIoUringArea(area) || area.inodenum != st.st_ino ||
+        area.addr == v.sq || area.addr == v.cq || area.addr == v.sqes) {
+      continue;
+    }
+
+    // A word of the area that the kernel writes once, or not at all.
+    char *view;
+    size_t off;
+    switch ((uint64_t)area.offset) {
+    case IORING_OFF_SQ_RING:
+      view = v.sq;
+      off = _params.sq_off.ring_entries;
+      break;
+    case IORING_OFF_CQ_RING:
+      view = v.cq;
+      off = _params.cq_off.ring_entries;
+      break;
+    case IORING_OFF_SQES:
+      view = v.sqes;
+      off = offsetof(struct io_uring_sqe, user_data);
+      break;
+    default:
+      JWARNING(false) ((void *)area.addr) ((void *)area.offset)
+      .Text("Mapping of an io_uring (a provided-buffer ring?) is not"
+            " supported");
+      continue;
+    }
+    if (area.size <= off || !sameWord(view + off, area.addr + off)) {
+      continue;
+    }
+
+    Mapping m = { (uint64_t)area.addr, area.size, (uint64_t)area.offset,
+                  area.prot };
+    _mappings.push_back(m);
+  }
+  JTRACE("io_uring mappings") (_fds[0]) (_mappings.size());
+}
+
+void
+IoUringConnection::drain()
+{
+  JASSERT(_fds.size() > 0);
+
+  Views v;
+  if (!mapViews(_fds[0], _params, &v)) {
+    JWARNING(false) (_fds[0]) (_params.flags) (JASSERT_ERRNO)
+    .Text("Can't map an io_uring; its state will be lost on restart");
+    _mappings.clear();
+    _sqHead = _sqTail = _cqHead = _cqTail = 0;
+    return;
+  }
+
+  quiesce(v);
+  _sqHead = ringLoad(v.sq, _params.sq_off.head);
+  _sqTail = ringLoad(v.sq, _params.sq_off.tail);
+  _cqHead = ringLoad(v.cq, _params.cq_off.head);
+  _cqTail = ringLoad(v.cq, _params.cq_off.tail);
+
+  // With IORING_SETUP_NO_MMAP, the application's memory (saved as such), or
+  // the memory that an earlier restart put in place of its mappings.
+  if (v.mapped) {
+    findMappings(v);
+  }
+  unmapViews(v);
+
+  for (size_t i = 0; i < _files.size(); i++) {
+    JWARNING(_files[i] < 0 || Util::isValidFd(_files[i])) (_fds[0]) (i)
+      (_files[i]).Text("A file registered with an io_uring was closed since;"
+                       " its slot will be empty after restart");
+  }
+  JWARNING(_unrestored == 0) (_fds[0]) ((void *)_unrestored)
+  .Text("Some io_uring registrations (personalities, restrictions, provided"
+        " buffer rings, registered ring fds, io-wq settings) are not restored"
+        " on restart");
+  JTRACE("Checkpoint io_uring") (_fds[0]) (_sqHead) (_sqTail) (_cqHead)
+    (_cqTail);
+}
+
+void
+IoUringConnection::refill(bool isRestart)
+{
+  JASSERT(_fds.size() > 0);
+  if (!isRestart) {
+    return;  // The ring is as it was; drain() only waited on it.
+  }
+
+  // All fds are back by now:  the event plugin is restored last.
+  int fd = _fds[0];
+  JWARNING(_inFlight == 0) (fd) (_inFlight)
+  .Text("Requests were in flight in an io_uring at checkpoint time; their"
+        " completions will never come (dmtcp_command --kcheckpoint cancels"
+        " them instead)");
+  if (!_buffers.empty()) {
+    uint32_t nr = _buffers.size();
+    vector<struct iovec>iovs(nr);
+    vector<uint64_t>tags(nr);
+    bool tagged = false;
+    for (uint32_t i = 0; i < nr; i++) {
+      iovs[i].iov_base = (void *)_buffers[i].addr;
+      iovs[i].iov_len = _buffers[i].len;
+      tags[i] = _buffers[i].tag;
+      tagged = tagged || tags[i] != 0;
+    }
+
+    int ret;
+    if (tagged) {
+      struct io_uring_rsrc_register reg;
+      memset(&reg, 0, sizeof(reg));
+      reg.nr = nr;
+      reg.data = (uint64_t)&iovs[0];
+      reg.tags = (uint64_t)&tags[0];
+      ret = ioUringRegister(fd, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg));
+    } else {
+      ret = ioUringRegister(fd, IORING_REGISTER_BUFFERS, &iovs[0], nr);
+    }
+    JWARNING(ret == 0) (fd) (nr) (JASSERT_ERRNO)
+    .Text("Failed to register the buffers of an io_uring again");
+  }
+
+  if (!_files.empty()) {
+    uint32_t nr = _files.size();
+    bool tagged = false;
+    for (uint32_t i = 0; i < nr; i++) {
+      tagged = tagged || _fileTags[i] != 0;
+    }
+
+    int ret;
+    if (tagged) {
+      struct io_uring_rsrc_register reg;
+      memset(&reg, 0, sizeof(reg));
+      reg.nr = nr;
+      reg.data = (uint64_t)&_files[0];
+      reg.tags = (uint64_t)&_fileTags[0];
+      ret = ioUringRegister(fd, IORING_REGISTER_FILES2, &reg, sizeof(reg));
+    } else {
+      ret = ioUringRegister(fd, IORING_REGISTER_FILES, &_files[0], nr);
+    }
+    JWARNING(ret == 0) (fd) (nr) (JASSERT_ERRNO)
+    .Text("Failed to register the files of an io_uring again");
+  }
+
+  if (_eventfd != -1) {
+    unsigned int opcode = _eventfdAsync ? IORING_REGISTER_EVENTFD_ASYNC
+                                        : IORING_REGISTER_EVENTFD;
+    JWARNING(ioUringRegister(fd, opcode, &_eventfd, 1) == 0)
+      (fd) (_eventfd) (JASSERT_ERRNO)
+    .Text("Failed to register the eventfd of an io_uring again");
+  }
+}
+
+/* Brings the SQ head and CQ tail of the new ring, which only the kernel
+ * moves, to their values at checkpoint time.  Each NOP moves the SQ head by
+ * one, and the CQ tail too unless it skips its CQE (IOSQE_CQE_SKIP_SUCCESS,
+ * Linux 5.17).  More CQEs than SQEs (multishot requests) are posted by
+ * IORING_OP_MSG_RING (Linux 5.18) from a ring of our own.  The CQEs are
+ * consumed as they come.
+ *
+ * The application keeps copies of these indices, so they can't start
+ * anywhere else.  This takes one NOP (or MSG_RING) per request ever
+ * submitted to the ring, modulo 2^32:  at 10 to 20 million a second, less
+ * time than the application took to submit them, but minutes for a ring
+ * whose indices went around.  The restart says so when it takes long, and
+ * gives up on a ring that stops moving.
+ */
+void
+IoUringConnection::fastForward(const Views &v)
+{
+  const struct io_uring_params &p = _params;
+  int fd = _fds[0];
+  uint32_t mask = p.sq_entries - 1;
+  uint32_t *array = (uint32_t *)(v.sq + p.sq_off.array);
+  bool sqpoll = p.flags & IORING_SETUP_SQPOLL;
+  uint32_t steps = std::max(_sqHead, _cqTail);
+
+  if (steps >= IOURING_FAST_FORWARD_NOTE) {
+    JNOTE("Restoring the indices of an io_uring; this takes about a second"
+          " per 10 million requests submitted to it") (fd) (_sqHead) (_cqTail);
+  }
+
+  while (ringLoad(v.sq, p.sq_off.head) != _sqHead) {
+    uint32_t head = ringLoad(v.sq, p.sq_off.head);
+    uint32_t tail = ringLoad(v.sq, p.sq_off.tail);
+    uint32_t n = std::min(_sqHead - tail, p.sq_entries - (tail - head));
+    n = std::min(n, p.cq_entries);
+
+    // NOP number k (from 0) posts a CQE if k < _cqTail.
+    uint32_t cqes = _cqTail > tail ? std::min(n, _cqTail - tail) : 0;
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t slot = (tail + i) & mask;
+      struct io_uring_sqe *sqe =
+        (struct io_uring_sqe *)(v.sqes + slot * sqeSize(p));
+      memset(sqe, 0, sqeSize(p));
+      sqe->opcode = IORING_OP_NOP;
+      if (i >= cqes) {
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+      }
+      if (!(p.flags & IORING_SETUP_NO_SQARRAY)) {
+        array[slot] = slot;
+      }
+    }
+    ringStore(v.sq, p.sq_off.tail, tail + n);
+
+    unsigned int flags = IORING_ENTER_GETEVENTS;
+    if (sqpoll) {
+      flags |= IORING_ENTER_SQ_WAKEUP | (n == 0 ? IORING_ENTER_SQ_WAIT : 0);
+    }
+    int ret = ioUringEnter(fd, sqpoll ? 0 : n, cqes, flags);
+    if (ret < 0 || (ret == 0 && !sqpoll)) {
+      JWARNING(false) (fd) (_sqHead) (ret) (JASSERT_ERRNO)
+      .Text("Failed to restore the SQ head of an io_uring");
+      break;
+    }
+    ringStore(v.cq, p.cq_off.head, ringLoad(v.cq, p.cq_off.tail));
+  }
+
+  uint32_t cqTail = ringLoad(v.cq, p.cq_off.tail);
+  if (cqTail != _cqTail && (int32_t)(_cqTail - cqTail) > 0) {
+    struct io_uring_params hp;
+    Views h;
+    memset(&hp, 0, sizeof(hp));
+    int helper = _real_syscall(SYS_io_uring_setup, 256, &hp);
+    if (helper == -1 || !mapViews(helper, hp, &h)) {
+      JWARNING(false) (fd) (JASSERT_ERRNO)
+      .Text("Failed to set up an io_uring for IORING_OP_MSG_RING");
+    } else {
+      uint32_t *harray = (uint32_t *)(h.sq + hp.sq_off.array);
+      while ((cqTail = ringLoad(v.cq, p.cq_off.tail)) != _cqTail) {
+        uint32_t tail = ringLoad(h.sq, hp.sq_off.tail);
+        uint32_t n = std::min(_cqTail - cqTail, hp.sq_entries);
+        n = std::min(n, p.cq_entries);
+        for (uint32_t i = 0; i < n; i++) {
+          uint32_t slot = (tail + i) & (hp.sq_entries - 1);
+          struct io_uring_sqe *sqe =
+            (struct io_uring_sqe *)(h.sqes + slot * sqeSize(hp));
+          memset(sqe, 0, sizeof(*sqe));
+          sqe->opcode = IORING_OP_MSG_RING;
+          sqe->fd = fd;
+          sqe->addr = IORING_MSG_DATA;
+          sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+          harray[slot] = slot;
+        }
+        ringStore(h.sq, hp.sq_off.tail, tail + n);
+        int ret = ioUringEnter(helper, n, 0, IORING_ENTER_GETEVENTS);
+        ringStore(v.cq, p.cq_off.head, ringLoad(v.cq, p.cq_off.tail));
+        if (ret != (int)n ||
+            ringLoad(h.cq, hp.cq_off.tail) != ringLoad(h.cq, hp.cq_off.head)) {
+          break;  // An error CQE
+        }
+      }
+      unmapViews(h);
+    }
+    if (helper != -1) {
+      _real_close(helper);
+    }
+  }
+
+  cqTail = ringLoad(v.cq, p.cq_off.tail);
+  JWARNING(ringLoad(v.sq, p.sq_off.head) == _sqHead && cqTail == _cqTail)
+    (fd) (_sqHead) (_cqTail) (cqTail) (p.features)
+  .Text("Failed to restore the indices of an io_uring (Linux 5.18 or later"
+        " is needed)");
+}
+
+static size_t
+pageAlign(size_t len)
+{
+  size_t pageSize = Util::pageSize();
+
+  return (len + pageSize - 1) & ~(pageSize - 1);
+}
+
+/* The rings of an io_uring can't be mapped at an address of our choosing
+ * (the kernel refuses MAP_FIXED), nor moved.  The new ring is set up instead
+ * with IORING_SETUP_NO_MMAP (Linux 6.5) on shared memory put in place of the
+ * old mappings; the application keeps its pointers.  Takes the contents that
+ * the image put back there aside first.
+ *
+ * Before Linux 6.10, the memory of a ring or SQE array of more than a page
+ * had to be a single folio (a huge page), which shared memory is not, and
+ * huge pages would not fit the addresses of the old mappings.
+ */
+void
+IoUringConnection::placeRing(struct io_uring_params *p,
+                             vector<char> *rings,
+                             vector<char> *sqes)
+{
+  char *ringsAddr = NULL;
+  char *sqesAddr = NULL;
+  size_t ringsSize = pageAlign(ringsLen(_params));
+  size_t sqesSize = pageAlign(sqesLen(_params));
+
+  if (_params.flags & IORING_SETUP_NO_MMAP) {
+    ringsAddr = (char *)IOURING_USER_ADDR(_params.cq_off);
+    sqesAddr = (char *)IOURING_USER_ADDR(_params.sq_off);
+  }
+  for (size_t i = 0; i < _mappings.size(); i++) {
+    const Mapping &m = _mappings[i];
+    char **addr = m.offset == IORING_OFF_SQES ? &sqesAddr : &ringsAddr;
+    size_t len = m.offset == IORING_OFF_SQES ? sqesSize : ringsSize;
+    if (*addr == NULL && m.len >= len) {
+      *addr = (char *)m.addr;
+    }
+  }
+  JASSERT(ringsAddr != NULL && sqesAddr != NULL) (_fds[0]) (_mappings.size())
+  .Text("The rings of an io_uring were not mapped at checkpoint time");
+  JASSERT(_params.features & IORING_FEAT_SINGLE_MMAP) (_params.features);
+
+  rings->assign(ringsAddr, ringsAddr + ringsSize);
+  sqes->assign(sqesAddr, sqesAddr + sqesSize);
+
+  // Shared memory, and the other mappings of the same ring as aliases of it.
+  if (!_mappings.empty()) {
+    int prot = PROT_READ | PROT_WRITE;
+    int flags = MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED;
+    JASSERT(mmap(ringsAddr, ringsSize, prot, flags, -1, 0) == ringsAddr)
+      ((void *)ringsAddr) (ringsSize) (JASSERT_ERRNO);
+    JASSERT(mmap(sqesAddr, sqesSize, prot, flags, -1, 0) == sqesAddr)
+      ((void *)sqesAddr) (sqesSize) (JASSERT_ERRNO);
+    for (size_t i = 0; i < _mappings.size(); i++) {
+      const Mapping &m = _mappings[i];
+      char *from = m.offset == IORING_OFF_SQES ? sqesAddr : ringsAddr;
+      size_t len = m.offset == IORING_OFF_SQES ? sqesSize : ringsSize;
+      if ((char *)m.addr != from) {
+        void *addr = mremap(from, 0, std::min(len, (size_t)m.len),
+                            MREMAP_MAYMOVE | MREMAP_FIXED, (void *)m.addr);
+        JASSERT(addr == (void *)m.addr) (addr) (m.len) (JASSERT_ERRNO);
+      }
+    }
+  }
+
+  // The kernel starts with zero indices, whatever the memory holds.
+  memset(ringsAddr, 0, ringsSize);
+  memset(sqesAddr, 0, sqesSize);
+  p->flags |= IORING_SETUP_NO_MMAP;
+  IOURING_USER_ADDR(p->cq_off) = (uint64_t)ringsAddr;
+  IOURING_USER_ADDR(p->sq_off) = (uint64_t)sqesAddr;
+}
+
+// Brings the new ring to the state of the old one, from the contents taken
+// aside by placeRing().
+void
+IoUringConnection::restoreRing(const vector<char> &rings,
+                               const vector<char> &sqes)
+{
+  const struct io_uring_params &p = _params;
+  Views v;
+
+  JASSERT(mapViews(_fds[0], p, &v));
+  if (!(p.flags & IORING_SETUP_R_DISABLED) || _enabled) {
+    fastForward(v);
+  }
+
+  // Not the SQ flags, which belong to the new ring (IORING_SQ_NEED_WAKEUP).
+  memcpy(v.sqes, &sqes[0], v.sqesLen);
+  if (!(p.flags & IORING_SETUP_NO_SQARRAY)) {
+    memcpy(v.sq + p.sq_off.array, &rings[p.sq_off.array],
+           p.sq_entries * sizeof(uint32_t));
+  }
+  memcpy(v.sq + p.sq_off.dropped, &rings[p.sq_off.dropped], sizeof(uint32_t));
+  memcpy(v.cq + p.cq_off.cqes, &rings[p.cq_off.cqes],
+         p.cq_entries * cqeSize(p));
+  memcpy(v.cq + p.cq_off.overflow, &rings[p.cq_off.overflow],
+         sizeof(uint32_t));
+  if (p.cq_off.flags != 0) {
+    memcpy(v.cq + p.cq_off.flags, &rings[p.cq_off.flags], sizeof(uint32_t));
+  }
+  ringStore(v.cq, p.cq_off.head, _cqHead);
+
+  // Last:  an SQPOLL thread takes the SQEs as soon as it sees them.
+  ringStore(v.sq, p.sq_off.tail, _sqTail);
+
+  for (size_t i = 0; i < _mappings.size(); i++) {
+    const Mapping &m = _mappings[i];
+    if (m.prot != (PROT_READ | PROT_WRITE)) {
+      mprotect((void *)m.addr, m.len, m.prot);
+    }
+  }
+}
+
+static bool
+sameLayout(const struct io_uring_params &p, const struct io_uring_params &q)
+{
+  return p.sq_entries == q.sq_entries && p.cq_entries == q.cq_entries &&
+         p.sq_off.head == q.sq_off.head && p.sq_off.tail == q.sq_off.tail &&
+         p.sq_off.ring_mask == q.sq_off.ring_mask &&
+         p.sq_off.ring_entries == q.sq_off.ring_entries &&
+         p.sq_off.flags == q.sq_off.flags &&
+         p.sq_off.dropped == q.sq_off.dropped &&
+         p.sq_off.array == q.sq_off.array &&
+         p.cq_off.head == q.cq_off.head && p.cq_off.tail == q.cq_off.tail &&
+         p.cq_off.ring_mask == q.cq_off.ring_mask &&
+         p.cq_off.ring_entries == q.cq_off.ring_entries &&
+         p.cq_off.overflow == q.cq_off.overflow &&
+         p.cq_off.cqes == q.cq_off.cqes && p.cq_off.flags == q.cq_off.flags;
+}
+
+void
+IoUringConnection::postRestart()
+{
+  JASSERT(_fds.size() > 0);
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  p.flags = _params.flags & ~IORING_SETUP_ATTACH_WQ;
+  p.sq_thread_cpu = _params.sq_thread_cpu;
+  p.sq_thread_idle = _params.sq_thread_idle;
+  p.cq_entries = _params.cq_entries;
+  if (_enabled) {
+    p.flags &= ~IORING_SETUP_R_DISABLED;
+  }
+
+  // The restarting thread would become the only task allowed to submit.
+  if (p.flags & (IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN)) {
+    JNOTE("Restoring an io_uring without SINGLE_ISSUER and DEFER_TASKRUN")
+      (_fds[0]) (_params.flags);
+    p.flags &= ~(IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN);
+  }
+
+  vector<char>rings;
+  vector<char>sqes;
+  placeRing(&p, &rings, &sqes);
+
+  JTRACE("Restoring io_uring connection") (id()) (_entries) (p.flags);
+  int tempfd = _real_syscall(SYS_io_uring_setup, _params.sq_entries, &p);
+  JASSERT(tempfd >= 0) (_params.sq_entries) (p.flags) (rings.size())
+    (sqes.size()) (JASSERT_ERRNO)
+  .Text("Failed to set up an io_uring again (Linux 6.5 or later is needed,"
+        " and 6.10 for rings or SQE arrays of more than a page)");
+  JASSERT(sameLayout(p, _params)) (p.sq_entries) (p.cq_entries)
+  .Text("The rings of an io_uring have another layout on this kernel");
+  _params = p;
+  restoreDupFds(tempfd);
+  restoreRing(rings, sqes);
+}
+
+void
+IoUringConnection::serializeSubClass(jalib::JBinarySerializer &o)
+{
+  JSERIALIZE_ASSERT_POINT("IoUringConnection");
+  o & _entries & _params & _enabled;
+  o & _sqHead & _sqTail & _cqHead & _cqTail;
+  o & _mappings & _buffers & _files & _fileTags;
+  o & _eventfd & _eventfdAsync & _unrestored & _inFlight;
+}
+
+void
+IoUringConnection::updateBuffers(uint32_t offset,
+                                 const struct iovec *iovs,
+                                 const uint64_t *tags,
+                                 uint32_t nr)
+{
+  if (_buffers.size() < offset + nr) {
+    Buffer none = { 0, 0, 0 };
+    _buffers.resize(offset + nr, none);
+  }
+  for (uint32_t i = 0; i < nr; i++) {
+    Buffer &b = _buffers[offset + i];
+    b.addr = iovs != NULL ? (uint64_t)iovs[i].iov_base : 0;
+    b.len = iovs != NULL ? iovs[i].iov_len : 0;
+    b.tag = tags != NULL ? tags[i] : 0;
+  }
+}
+
+void
+IoUringConnection::updateFiles(uint32_t offset,
+                               const int32_t *fds,
+                               const uint64_t *tags,
+                               uint32_t nr)
+{
+  if (_files.size() < offset + nr) {
+    _files.resize(offset + nr, -1);
+    _fileTags.resize(offset + nr, 0);
+  }
+  for (uint32_t i = 0; i < nr; i++) {
+    if (fds != NULL && fds[i] == IORING_REGISTER_FILES_SKIP) {
+      continue;
+    }
+    _files[offset + i] = fds != NULL ? fds[i] : -1;
+    _fileTags[offset + i] = tags != NULL ? tags[i] : 0;
+  }
+}
+
+void
+IoUringConnection::onRegister(unsigned int opcode,
+                              const void *arg,
+                              unsigned int nrArgs,
+                              long ret)
+{
+  const struct io_uring_rsrc_register *reg =
+    (const struct io_uring_rsrc_register *)arg;
+  const struct io_uring_rsrc_update *update =
+    (const struct io_uring_rsrc_update *)arg;
+  const struct io_uring_rsrc_update2 *update2 =
+    (const struct io_uring_rsrc_update2 *)arg;
+  bool sparse = opcode == IORING_REGISTER_BUFFERS2 ||
+                opcode == IORING_REGISTER_FILES2 ?
+                reg->flags & IORING_RSRC_REGISTER_SPARSE : false;
+
+  switch (opcode) {
+  case IORING_REGISTER_BUFFERS:
+    _buffers.clear();
+    updateBuffers(0, (const struct iovec *)arg, NULL, nrArgs);
+    break;
+  case IORING_REGISTER_BUFFERS2:
+    _buffers.clear();
+    updateBuffers(0, sparse ? NULL : (const struct iovec *)reg->data,
+                  sparse ? NULL : (const uint64_t *)reg->tags, reg->nr);
+    break;
+  case IORING_REGISTER_BUFFERS_UPDATE:
+    // Returns the number of buffers updated.
+    updateBuffers(update2->offset, (const struct iovec *)update2->data,
+                  (const uint64_t *)update2->tags, ret);
+    break;
+  case IORING_UNREGISTER_BUFFERS:
+    _buffers.clear();
+    break;
+
+  case IORING_REGISTER_FILES:
+    _files.clear();
+    _fileTags.clear();
+    updateFiles(0, (const int32_t *)arg, NULL, nrArgs);
+    break;
+  case IORING_REGISTER_FILES2:
+    _files.clear();
+    _fileTags.clear();
+    updateFiles(0, sparse ? NULL : (const int32_t *)reg->data,
+                sparse ? NULL : (const uint64_t *)reg->tags, reg->nr);
+    break;
+  case IORING_REGISTER_FILES_UPDATE:
+    updateFiles(update->offset, (const int32_t *)update->data, NULL, ret);
+    break;
+  case IORING_REGISTER_FILES_UPDATE2:
+    updateFiles(update2->offset, (const int32_t *)update2->data,
+                (const uint64_t *)update2->tags, ret);
+    break;
+  case IORING_UNREGISTER_FILES:
+    _files.clear();
+    _fileTags.clear();
+    break;
+
+  case IORING_REGISTER_EVENTFD:
+  case IORING_REGISTER_EVENTFD_ASYNC:
+    _eventfd = *(const int32_t *)arg;
+    _eventfdAsync = opcode == IORING_REGISTER_EVENTFD_ASYNC;
+    break;
+  case IORING_UNREGISTER_EVENTFD:
+    _eventfd = -1;
+    break;
+
+  case IORING_REGISTER_ENABLE_RINGS:
+    _enabled = true;
+    break;
+
+  // No state, or only state that goes away with what it belongs to.
+  case IORING_REGISTER_PROBE:
+  case IORING_UNREGISTER_PERSONALITY:
+  case IORING_UNREGISTER_IOWQ_AFF:
+  case IORING_UNREGISTER_RING_FDS:
+  case IORING_UNREGISTER_PBUF_RING:
+  case IORING_REGISTER_SYNC_CANCEL:
+    break;
+
+  default:
+    JTRACE("io_uring registration not restored") (_fds[0]) (opcode);
+    if (opcode < 64) {
+      _unrestored |= (uint64_t)1 << opcode;
+    }
+    break;
+  }
+}
+
+void
+IoUringConnection::checkUntracked()
+{
+  vector<int>fds = jalib::Filesystem::ListOpenFds();
+
+  for (size_t i = 0; i < fds.size(); i++) {
+    int fd = fds[i];
+    if (dmtcp_is_protected_fd(fd) ||
+        EventConnList::instance().getConnection(fd) != NULL) {
+      continue;
+    }
+    string device = jalib::Filesystem::GetDeviceName(fd);
+    JWARNING(device != "anon_inode:[io_uring]") (fd)
+    .Text("An io_uring was set up by an inline system call, not through"
+          " syscall() (liburing built without --use-libc?); it will not be"
+          " restored");
+  }
+}
+#endif // ifdef HAVE_IO_URING
@@ -0,0 +1,156 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+#pragma once
+#ifndef IOURINGCONNECTION_H
+#define IOURINGCONNECTION_H
+
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include "connection.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+
+// The checkpoint cancels requests in flight with IORING_REGISTER_SYNC_CANCEL,
+// new in the headers of Linux 6.0.
+# ifdef IORING_ASYNC_CANCEL_ANY
+#  define HAVE_IO_URING 1
+# endif // ifdef IORING_ASYNC_CANCEL_ANY
+#endif // ifdef HAVE_LINUX_IO_URING_H
+
+#ifdef HAVE_IO_URING
+# ifndef SYS_io_uring_setup
+#  define SYS_io_uring_setup    425
+#  define SYS_io_uring_enter    426
+#  define SYS_io_uring_register 427
+# endif // ifndef SYS_io_uring_setup
+
+// Newer than the headers of Linux 6.0.
+# ifndef IORING_SETUP_SINGLE_ISSUER
+#  define IORING_SETUP_SINGLE_ISSUER (1U << 12)
+# endif // ifndef IORING_SETUP_SINGLE_ISSUER
+# ifndef IORING_SETUP_DEFER_TASKRUN
+#  define IORING_SETUP_DEFER_TASKRUN (1U << 13)
+# endif // ifndef IORING_SETUP_DEFER_TASKRUN
+# ifndef IORING_SETUP_NO_MMAP
+#  define IORING_SETUP_NO_MMAP       (1U << 14)
+#  define IOURING_USER_ADDR(off)     ((off).resv2)
+# else // ifndef IORING_SETUP_NO_MMAP
+#  define IOURING_USER_ADDR(off)     ((off).user_addr)
+# endif // ifndef IORING_SETUP_NO_MMAP
+# ifndef IORING_SETUP_NO_SQARRAY
+#  define IORING_SETUP_NO_SQARRAY    (1U << 16)
+# endif // ifndef IORING_SETUP_NO_SQARRAY
+# ifndef IORING_REGISTER_USE_REGISTERED_RING
+#  define IORING_REGISTER_USE_REGISTERED_RING (1U << 31)
+# endif // ifndef IORING_REGISTER_USE_REGISTERED_RING
+
+namespace dmtcp
+{
+/* An io_uring instance:  its setup parameters, the mappings of its rings and
+ * SQE array, and the buffers, files and eventfd registered with it.
+ * io_uring_setup() and io_uring_register() are wrapped (glibc has no
+ * functions for them; they come through syscall()).  io_uring_enter() is
+ * not, so submissions and completions pay nothing.
+ *
+ * At checkpoint time, the ring is quiesced:  requests in flight may complete
+ * while they keep completing.  The rest are left alone on resume; if the
+ * process exits after the checkpoint, they are cancelled, so that each one
+ * has its CQE in the CQ ring.  Then the mappings of the ring are looked up in
+ * /proc/self/maps; writeckpt saves them as private memory, with the SQEs not
+ * yet submitted and the CQEs not yet consumed.
+ *
+ * On restart, a ring is set up with the same parameters, on memory at the
+ * same addresses (IORING_SETUP_NO_MMAP; Linux 6.10 for rings of more than a
+ * page).  The indices that only the kernel moves (SQ head, CQ tail) are
+ * brought to their saved values with NOPs, and the saved SQEs and CQEs are
+ * copied in.  Then the buffers, files and eventfd are registered again.
+ */
+class IoUringConnection : public Connection
+{
+  public:
+    struct Mapping {
+      uint64_t addr;
+      uint64_t len;
+      uint64_t offset;   // IORING_OFF_SQ_RING, _CQ_RING or _SQES
+      int64_t prot;
+    };
+
+    struct Buffer {
+      uint64_t addr;
+      uint64_t len;
+      uint64_t tag;
+    };
+
+    struct Views;
+
+    IoUringConnection(uint32_t entries, const struct io_uring_params *params);
+
+    virtual void drain();
+    virtual void refill(bool isRestart);
+    virtual void postRestart();
+    virtual void serializeSubClass(jalib::JBinarySerializer &o);
+
+    virtual string str() { return "IO-URING-FD: <Not-a-File>"; }
+
+    // Records a successful io_uring_register() call that returned 'ret'.
+    void onRegister(unsigned int opcode,
+                    const void *arg,
+                    unsigned int nrArgs,
+                    long ret);
+
+    // Warns about io_uring fds that were not set up through the wrapper.
+    static void checkUntracked();
+
+  private:
+    void quiesce(const Views &v);
+    void findMappings(const Views &v);
+    void placeRing(struct io_uring_params *p,
+                   vector<char> *rings,
+                   vector<char> *sqes);
+    void restoreRing(const vector<char> &rings, const vector<char> &sqes);
+    void fastForward(const Views &v);
+    void updateBuffers(uint32_t offset,
+                       const struct iovec *iovs,
+                       const uint64_t *tags,
+                       uint32_t nr);
+    void updateFiles(uint32_t offset,
+                     const int32_t *fds,
+                     const uint64_t *tags,
+                     uint32_t nr);
+
+    uint32_t _entries;
+    struct io_uring_params _params;   // As returned by io_uring_setup()
+    bool _enabled;                    // IORING_REGISTER_ENABLE_RINGS done
+    uint32_t _sqHead;
+    uint32_t _sqTail;
+    uint32_t _cqHead;
+    uint32_t _cqTail;
+    vector<Mapping>_mappings;
+    vector<Buffer>_buffers;
+    vector<int32_t>_files;
+    vector<uint64_t>_fileTags;
+    int32_t _eventfd;
+    bool _eventfdAsync;
+    uint64_t _unrestored;             // Bit per register opcode not restored
+    int32_t _inFlight;                // Requests lost on restart
+};
+}
+#endif // ifdef HAVE_IO_URING
+#endif // ifndef IOURINGCONNECTION_H
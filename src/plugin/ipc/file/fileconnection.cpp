@@ -22,10 +22,13 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <linux/limits.h>
+#include <linux/magic.h>
 #include <sys/file.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
+#include <sys/syscall.h>
 #include <sys/un.h>
+#include <sys/vfs.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
@@ -337,7 +340,16 @@ FileConnection::refill(bool isRestart)
 
   if (!_ckpted_file) {
     int tempfd;
-    if (_type == FILE_DELETED &&
+    if (_type == FILE_PROCFS) {
+      // doLocking() kept only the files of our own /proc/<pid>, but that pid
+      // is a virtual one now.  /proc/self is the same directory.
+      char *rest;
+      strtol(&_path[6], &rest, 0);
+      string selfPath = string("/proc/self") + rest;
+      tempfd = _real_open(selfPath.c_str(), _fcntlFlags);
+      JASSERT(tempfd != -1) (_path) (selfPath) (JASSERT_ERRNO)
+      .Text("open() failed");
+    } else if (_type == FILE_DELETED &&
         ((_fcntlFlags & O_WRONLY) || (_fcntlFlags & O_RDWR))) {
       tempfd = _real_open(_path.c_str(), _fcntlFlags | O_CREAT, 0600);
       JASSERT(tempfd != -1) (_path) (JASSERT_ERRNO).Text("open() failed");
@@ -437,11 +449,9 @@ FileConnection::refreshPath()
   } else if (_type == FILE_PROCFS) {
     int index = 6;
     char *rest;
-    char buf[64];
     pid_t proc_pid = strtol(&_path[index], &rest, 0);
     if (proc_pid > 0 && *rest == '/') {
-      sprintf(buf, "/proc/%d/%s", getpid(), rest);
-      _path = buf;
+      _path = "/proc/" + jalib::XToString(getpid()) + rest;
     }
   }
 }
@@ -794,6 +804,220 @@ StdioConnection::postRestart()
   }
 }
 
+/*****************************************************************************
+ * Memfd Connection
+ *****************************************************************************/
+string
+MemfdConnection::nameFromPath(const string &path)
+{
+  string name = path;
+
+  if (Util::strStartsWith(name.c_str(), "/memfd:")) {
+    name = name.substr(strlen("/memfd:"));
+  }
+  if (Util::strEndsWith(name.c_str(), DELETED_FILE_SUFFIX)) {
+    name.resize(name.length() - strlen(DELETED_FILE_SUFFIX));
+  }
+  return name;
+}
+
+int
+MemfdConnection::openRecreated(uint64_t devnum, uint64_t inode)
+{
+  pid_t pid;
+  int32_t fd;
+
+  if (!SharedData::getMemfdMap(devnum, inode, &pid, &fd)) {
+    return -1;
+  }
+
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/fd/%d", pid, fd);
+  int newFd = _real_open(path, O_RDWR);
+  JASSERT(newFd != -1) (path) (JASSERT_ERRNO)
+  .Text("Failed to open the recreated memfd");
+  return newFd;
+}
+
+void
+MemfdConnection::drain()
+{
+  JASSERT(_fds.size() > 0);
+
+  int fd = _fds[0];
+  struct stat statbuf;
+  JASSERT(fstat(fd, &statbuf) == 0) (fd) (JASSERT_ERRNO);
+  _st_dev = statbuf.st_dev;
+  _st_ino = statbuf.st_ino;
+  _size = statbuf.st_size;
+  _mode = statbuf.st_mode & 07777;
+  _offset = lseek(fd, 0, SEEK_CUR);
+  _seals = fcntl(fd, F_GET_SEALS);
+  JASSERT(_seals != -1) (fd) (JASSERT_ERRNO);
+
+  size_t pageSize = Util::pageSize();
+  _flags = (fcntl(fd, F_GETFD) & FD_CLOEXEC) ? MFD_CLOEXEC : 0;
+  struct statfs fsbuf;
+  if (fstatfs(fd, &fsbuf) == 0 && fsbuf.f_type == HUGETLBFS_MAGIC) {
+    pageSize = fsbuf.f_bsize;
+    _flags |= MFD_HUGETLB | ((int64_t)(ffsl(pageSize) - 1) << MFD_HUGE_SHIFT);
+  }
+
+  // Only the first connection to claim the memfd maps it for the ckpt image.
+  _viewLen = (_size + pageSize - 1) / pageSize * pageSize;
+  _extents.clear();
+  _isOwner = SharedData::claimSharedArea(_st_dev, _st_ino, 0, _viewLen, NULL);
+  if (_isOwner) {
+    mapExtents(fd, pageSize);
+  }
+  JTRACE("Checkpointing memfd") (_name) (_size) (_seals) (_isOwner)
+    (_extents.size());
+}
+
+// Maps the data extents of the memfd, in whole pages.  Reading a hole through
+// a mapping would fill it.
+void
+MemfdConnection::mapExtents(int fd, size_t pageSize)
+{
+  off_t next = 0;
+
+  while (next < (off_t)_viewLen) {
+    off_t data = lseek(fd, next, SEEK_DATA);
+    off_t hole = data == -1 ? -1 : lseek(fd, data, SEEK_HOLE);
+    if (data == -1 && errno == ENXIO) {
+      break;  // Only holes from here on
+    } else if (data == -1 || hole == -1) {
+      data = next;
+      hole = _viewLen;
+    }
+
+    Extent e;
+    e.offset = data / pageSize * pageSize;
+    e.len = MIN((uint64_t)hole + pageSize - 1, _viewLen) / pageSize * pageSize
+            - e.offset;
+    e.view = (char *)mmap(NULL, e.len, PROT_READ, MAP_PRIVATE | MAP_NORESERVE,
+                          fd, e.offset);
+    JASSERT(e.view != MAP_FAILED) (_name) (e.offset) (e.len) (JASSERT_ERRNO);
+    _extents.push_back(e);
+    next = e.offset + e.len;
+  }
+
+  // SEEK_DATA and SEEK_HOLE moved the file offset, shared with the app.
+  JASSERT(lseek(fd, _offset, SEEK_SET) == _offset)
+    (_name) (_offset) (JASSERT_ERRNO);
+}
+
+void
+MemfdConnection::unmapExtents()
+{
+  for (size_t i = 0; i < _extents.size(); i++) {
+    munmap(_extents[i].view, _extents[i].len);
+  }
+  _extents.clear();
+}
+
+void
+MemfdConnection::addSeals(int64_t seals)
+{
+  int curSeals = fcntl(_fds[0], F_GET_SEALS);
+
+  JASSERT(curSeals != -1) (_fds[0]) (JASSERT_ERRNO);
+  seals &= ~(int64_t)curSeals;
+  if (seals != 0) {
+    JWARNING(fcntl(_fds[0], F_ADD_SEALS, (int)seals) == 0)
+      (_name) (seals) (JASSERT_ERRNO)
+    .Text("Failed to seal the recreated memfd");
+  }
+}
+
+void
+MemfdConnection::postRestart()
+{
+  JASSERT(_fds.size() > 0);
+
+  // The others open the memfd in refill(), after the owner recreated it.
+  if (!_isOwner) {
+    return;
+  }
+
+  int fd = _real_syscall(SYS_memfd_create, _name.c_str(),
+                         (unsigned int)(_flags | MFD_ALLOW_SEALING));
+  JASSERT(fd != -1) (_name) (_flags) (JASSERT_ERRNO)
+  .Text("Failed to recreate the memfd");
+  JASSERT(ftruncate(fd, _size) == 0) (_name) (_size) (JASSERT_ERRNO);
+
+  // The extents were restored from the ckpt image as private memory.  Their
+  // zero pages are left as holes, like the holes between them.
+  size_t pageSize = Util::pageSize();
+  for (size_t i = 0; i < _extents.size(); i++) {
+    const Extent &e = _extents[i];
+    char *addr = (char *)mmap(NULL, e.len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                              fd, e.offset);
+    JASSERT(addr != MAP_FAILED) (_name) (e.offset) (e.len) (JASSERT_ERRNO);
+    int64_t len = MIN((int64_t)e.len, _size - (int64_t)e.offset);
+    for (int64_t off = 0; off < len; off += pageSize) {
+      if (!Util::areZeroPages(e.view + off, 1)) {
+        memcpy(addr + off, e.view + off, MIN((int64_t)pageSize, len - off));
+      }
+    }
+    munmap(addr, e.len);
+  }
+  unmapExtents();
+
+  struct stat statbuf;
+  JASSERT(fstat(fd, &statbuf) == 0) (JASSERT_ERRNO);
+  if ((statbuf.st_mode & 07777) != _mode) {
+    JWARNING(fchmod(fd, _mode) == 0) (_name) (_mode) (JASSERT_ERRNO);
+  }
+
+  restoreDupFds(fd);
+  pid_t pid = getpid();
+  int32_t memfd = _fds[0];
+  JASSERT(SharedData::insertMemfdMap(_st_dev, _st_ino, &pid, &memfd))
+    (_name) (pid) (memfd);
+
+  if (!(_seals & F_SEAL_FUTURE_WRITE)) {
+    addSeals(_seals);
+  }
+}
+
+void
+MemfdConnection::refill(bool isRestart)
+{
+  if (!isRestart) {
+    return;
+  }
+
+  if (!_isOwner) {
+    int fd = openRecreated(_st_dev, _st_ino);
+    JASSERT(fd != -1) (_name) (_st_dev) (_st_ino)
+    .Text("The memfd was not recreated by its owner");
+    restoreDupFds(fd);
+  }
+  JASSERT(lseek(_fds[0], _offset, SEEK_SET) == _offset)
+    (_name) (_offset) (JASSERT_ERRNO);
+}
+
+void
+MemfdConnection::resume(bool isRestart)
+{
+  if (!isRestart) {
+    unmapExtents();
+  }
+
+  // The writable mappings have been restored; see FileConnList::refill().
+  if (isRestart && _isOwner && (_seals & F_SEAL_FUTURE_WRITE)) {
+    addSeals(_seals);
+  }
+}
+
+void
+MemfdConnection::serializeSubClass(jalib::JBinarySerializer &o)
+{
+  JSERIALIZE_ASSERT_POINT("MemfdConnection");
+  o&_name&_flags&_mode&_offset&_size&_seals&_st_dev&_st_ino&_isOwner;
+}
+
 /*****************************************************************************
  * POSIX Message Queue Connection
  *****************************************************************************/
@@ -878,6 +1102,19 @@ PosixMQConnection::postRestart()
 
   int tempfd = _real_mq_open(_name.c_str(), _oflag, _mode, &_attr);
   JASSERT(tempfd != -1) (JASSERT_ERRNO);
+
+  // The queue can be left over from the checkpointed processes, with the
+  // messages that they had not received.  refill() sends the ones of the
+  // checkpoint; discard the others, like drain() does.
+  struct mq_attr attr;
+  if (mq_getattr(tempfd, &attr) != -1 && attr.mq_curmsgs > 0) {
+    char *buf = (char *)JALLOC_HELPER_MALLOC(attr.mq_msgsize);
+    for (long i = 0; i < attr.mq_curmsgs; i++) {
+      JASSERT(_real_mq_receive(tempfd, buf, attr.mq_msgsize, NULL) != -1)
+        (_name) (JASSERT_ERRNO);
+    }
+    JALLOC_HELPER_FREE(buf);
+  }
   restoreDupFds(tempfd);
 }
 
@@ -28,6 +28,7 @@
 # include <mqueue.h>
 # include <signal.h>
 # include <stdint.h>
+# include <sys/mman.h>
 # include <sys/socket.h>
 # include <sys/stat.h>
 # include <sys/types.h>
@@ -40,6 +41,27 @@
 
 # include "connection.h"
 
+// Not in the headers of older systems.
+# ifndef F_ADD_SEALS
+#  define F_ADD_SEALS         (1024 + 9)
+#  define F_GET_SEALS         (1024 + 10)
+#  define F_SEAL_SEAL         0x0001
+#  define F_SEAL_SHRINK       0x0002
+#  define F_SEAL_GROW         0x0004
+#  define F_SEAL_WRITE        0x0008
+# endif // ifndef F_ADD_SEALS
+# ifndef F_SEAL_FUTURE_WRITE
+#  define F_SEAL_FUTURE_WRITE 0x0010
+# endif // ifndef F_SEAL_FUTURE_WRITE
+# ifndef MFD_CLOEXEC
+#  define MFD_CLOEXEC         0x0001U
+#  define MFD_ALLOW_SEALING   0x0002U
+#  define MFD_HUGETLB         0x0004U
+# endif // ifndef MFD_CLOEXEC
+# ifndef MFD_HUGE_SHIFT
+#  define MFD_HUGE_SHIFT      26
+# endif // ifndef MFD_HUGE_SHIFT
+
 namespace dmtcp
 {
 class StdioConnection : public Connection
@@ -192,6 +214,71 @@ class FifoConnection : public Connection
     int32_t ckptfd;
 };
 
+/* A memfd (memfd_create()).  It has no path to reopen on restart, so it is
+ * saved once, by the first connection to claim the whole object in
+ * SharedData:  that one maps its data extents (SEEK_DATA/SEEK_HOLE)
+ * privately, and the ckpt image carries the mappings; the holes of a sparse
+ * memfd are neither filled nor saved.  Shared mappings of the memfd, here or
+ * in other processes, are contained in the claim, and are saved as zero
+ * pages.
+ *
+ * On restart, the owner creates the memfd again, copies the contents in, and
+ * registers it in SharedData; the other connections, and the file plugin for
+ * the mappings, open it as /proc/<pid>/fd/<fd>.  The seals are added last:
+ * F_SEAL_FUTURE_WRITE waits until the writable mappings are back.
+ */
+class MemfdConnection : public Connection
+{
+  public:
+    MemfdConnection() {}
+
+    MemfdConnection(const string &name)
+      : Connection(MEMFD)
+      , _name(name)
+      , _viewLen(0)
+      , _isOwner(false)
+    { }
+
+    struct Extent {
+      uint64_t offset;
+      uint64_t len;
+      char *view;
+    };
+
+    virtual void drain();
+    virtual void refill(bool isRestart);
+    virtual void resume(bool isRestart);
+    virtual void postRestart();
+
+    virtual void serializeSubClass(jalib::JBinarySerializer &o);
+
+    virtual string str() { return "memfd:" + _name; }
+
+    // "/memfd:NAME (deleted)" -> "NAME"
+    static string nameFromPath(const string &path);
+
+    // A new fd for the memfd that was (devnum, inode) at checkpoint time, or
+    // -1 if no process has recreated it yet.
+    static int openRecreated(uint64_t devnum, uint64_t inode);
+
+  private:
+    void mapExtents(int fd, size_t pageSize);
+    void unmapExtents();
+    void addSeals(int64_t seals);
+
+    string _name;
+    int64_t _flags;        // MFD_CLOEXEC and MFD_HUGETLB with the page size
+    int64_t _mode;
+    int64_t _offset;
+    int64_t _size;
+    int64_t _seals;
+    uint64_t _st_dev;
+    uint64_t _st_ino;
+    uint64_t _viewLen;     // _size, rounded up to pages
+    vector<Extent>_extents; // The contents, if we are the owner
+    int32_t _isOwner;
+};
+
 class PosixMQConnection : public Connection
 {
   public:
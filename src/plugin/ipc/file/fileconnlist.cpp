@@ -45,14 +45,30 @@
  * + Ckpt:
  *   - TODO(kapil): Any file descriptor pointing to the file? If yes, delegate
  *     ckpt to the file descriptor.
- *   - everyone saves the contents of the shared-area.
+ *   - the first process to claim a range of the file (SharedData) saves its
+ *     contents; the others save only the area header (a zero-page area).
  * + Restart
  *   - File already exists: verify that the file is at least as large as
  *     (area.offset+area.size).
- *   - File doesn't exist: try to recreate the file; write content
- * - on restart, everyone tries to recreate the file and write their data
- *   (offset, length) to the file.
- * - everyone tries to unlink the file in a subsequent barrier.
+ *   - File doesn't exist: the owners recreate the file and write their data
+ *     (offset, length) to it; after a barrier, the others map it.
+ * - the owners unlink the file in a subsequent barrier.
+ *
+ * Anonymous shared-memory area (/dev/zero):
+ * - Same as an unlinked file, but the file is recreated in /dev/shm (or in
+ *   the DMTCP tmpdir), under a name derived from the computation id and the
+ *   inode of the original object.
+ *
+ * Shared-memory area with a memfd:
+ * + Ckpt:
+ *   - If a process has an fd for the memfd, its MemfdConnection claimed the
+ *     whole object in drain(), and saves it; all mappings are copies.
+ *   - Otherwise, as for an unlinked file.  The ranges are claimed only after
+ *     the File::DRAIN barrier, once the whole objects have been.
+ * + Restart
+ *   - No file:  the memfd is recreated, by the MemfdConnection or by the
+ *     first owner of a range, and registered in SharedData.  The others open
+ *     it through /proc/<pid>/fd/<fd>, and map it as soon as it exists.
  */
 
 // THESE INCLUDES ARE IN RANDOM ORDER.  LET'S CLEAN IT UP AFTER RELEASE. - Gene
@@ -64,6 +80,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
+#include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -148,6 +165,8 @@ dmtcp_FileConnList_EventHook(DmtcpEvent_t event, DmtcpEventData_t *data)
     FileConnList::restartRefill();
     dmtcp_local_barrier("File::RESTART_REFILL");
     FileConnList::restartResume();
+    dmtcp_local_barrier("File::RESTART_RESUME");
+    FileConnList::restartUnlinkShmFiles();
     break;
 
   default:  // other events are not registered
@@ -172,11 +191,38 @@ ipc_initialize_plugin_file()
   dmtcp_register_plugin(filePlugin);
 }
 
+#define SHM_FILE_PREFIX "dmtcp-shm-"
+
+// A shared area whose backing file is recreated on restart.  Only the owner
+// of the area saved its contents; a copy is mapped after the owners have
+// written the file.
+struct UnlinkedShmArea {
+  ProcMapsArea area;
+  bool isCopy;
+  bool isAnonymous;
+  bool isMemfd;
+  bool isMapped;
+};
+
 static vector<ProcMapsArea>shmAreas;
-static vector<ProcMapsArea>unlinkedShmAreas;
-static vector<ProcMapsArea>missingUnlinkedShmFiles;
+static vector<UnlinkedShmArea>unlinkedShmAreas;
+static vector<UnlinkedShmArea>missingUnlinkedShmFiles;
 static vector<FileConnection *>shmAreaConn;
 
+// The memfds that we recreated for mappings; kept open until the other
+// processes have opened them.
+static vector<int>recreatedMemfds;
+
+// Anonymous and memfd areas are recreated in tmpfs when possible.
+static string
+anonShmFileDir()
+{
+  if (_real_access("/dev/shm", W_OK) == 0) {
+    return "/dev/shm";
+  }
+  return dmtcp_get_tmpdir();
+}
+
 void FileConnList::processReopen(int fd, const char *newPath)
 {
   FileConnection *con = (FileConnection*) getConnection(fd);
@@ -279,6 +325,18 @@ FileConnList::drain()
 void
 FileConnList::preCkpt()
 {
+  // The memfd connections have claimed their whole objects in drain().
+  for (size_t i = 0; i < unlinkedShmAreas.size(); i++) {
+    UnlinkedShmArea &shmArea = unlinkedShmAreas[i];
+    if (shmArea.isMemfd) {
+      const ProcMapsArea &area = shmArea.area;
+      shmArea.isCopy =
+        !SharedData::claimSharedArea(makedev(area.devmajor, area.devminor),
+                                     area.inodenum, area.offset, area.size,
+                                     area.addr);
+    }
+  }
+
   ConnectionList::preCkpt();
 
   string fdInfoFile = dmtcp_get_ckpt_files_subdir();
@@ -308,14 +366,22 @@ FileConnList::postRestart()
   /* Try to map the file as is, if it already exists on the disk.
    */
   for (size_t i = 0; i < unlinkedShmAreas.size(); i++) {
-    if (jalib::Filesystem::FileExists(unlinkedShmAreas[i].name)) {
+    UnlinkedShmArea &shmArea = unlinkedShmAreas[i];
+    if (shmArea.isMemfd) {
+      missingUnlinkedShmFiles.push_back(shmArea);
+    } else if (shmArea.isAnonymous) {
+      string path = anonShmFileDir() + "/" + shmArea.area.name;
+      JASSERT(path.length() < sizeof(shmArea.area.name)) (path);
+      strcpy(shmArea.area.name, path.c_str());
+      missingUnlinkedShmFiles.push_back(shmArea);
+    } else if (jalib::Filesystem::FileExists(shmArea.area.name)) {
       // TODO(kapil): Verify the file contents.
-      JWARNING(false) (unlinkedShmAreas[i].name)
+      JWARNING(false) (shmArea.area.name)
       .Text("File was unlinked at ckpt but is currently present on disk; "
             "remove it and try again.");
-      restoreShmArea(unlinkedShmAreas[i]);
+      restoreShmArea(shmArea.area);
     } else {
-      missingUnlinkedShmFiles.push_back(unlinkedShmAreas[i]);
+      missingUnlinkedShmFiles.push_back(shmArea);
     }
   }
 
@@ -326,14 +392,42 @@ void
 FileConnList::refill(bool isRestart)
 {
   if (isRestart) {
-    // The backing file will be created as a result of restoreShmArea. We need
-    // to unlink all such files in the resume() call below.
+    // The owners recreate the backing files with their data.  We need to
+    // unlink all such files once everyone has mapped them; see
+    // unlinkShmFiles().
     for (size_t i = 0; i < missingUnlinkedShmFiles.size(); i++) {
-      recreateShmFileAndMap(missingUnlinkedShmFiles[i]);
+      if (!missingUnlinkedShmFiles[i].isCopy &&
+          !missingUnlinkedShmFiles[i].isMemfd) {
+        recreateShmFileAndMap(missingUnlinkedShmFiles[i].area);
+      }
     }
   }
 
   ConnectionList::refill(isRestart);
+
+  if (isRestart) {
+    // After the connections, whose fds the memfds must not take.  A memfd
+    // recreated by a MemfdConnection exists already, and its mappings are
+    // restored now, before its owner adds F_SEAL_FUTURE_WRITE in resume().
+    for (size_t i = 0; i < missingUnlinkedShmFiles.size(); i++) {
+      UnlinkedShmArea &shmArea = missingUnlinkedShmFiles[i];
+      if (!shmArea.isMemfd) {
+        continue;
+      }
+      if (!shmArea.isCopy) {
+        recreateMemfdAndMap(shmArea.area);
+        shmArea.isMapped = true;
+      } else {
+        const ProcMapsArea &area = shmArea.area;
+        int fd = MemfdConnection::openRecreated(
+            makedev(area.devmajor, area.devminor), area.inodenum);
+        if (fd != -1) {
+          restoreShmArea(area, fd);
+          shmArea.isMapped = true;
+        }
+      }
+    }
+  }
 }
 
 void
@@ -344,16 +438,50 @@ FileConnList::resume(bool isRestart)
   remapShmMaps();
 
   if (isRestart) {
-    // Now unlink the files that we created as a side-effect of restoreShmArea.
+    // The owners have written the recreated files; map the copies.
     for (size_t i = 0; i < missingUnlinkedShmFiles.size(); i++) {
-      JWARNING(unlink(missingUnlinkedShmFiles[i].name) != -1)
-        (missingUnlinkedShmFiles[i].name) (JASSERT_ERRNO)
-      .Text("The file was unlinked at the time of checkpoint. "
-            "Unlinking it after restart failed");
+      const UnlinkedShmArea &shmArea = missingUnlinkedShmFiles[i];
+      if (!shmArea.isCopy || shmArea.isMapped) {
+        continue;
+      }
+      if (shmArea.isMemfd) {
+        const ProcMapsArea &area = shmArea.area;
+        int fd = MemfdConnection::openRecreated(
+            makedev(area.devmajor, area.devminor), area.inodenum);
+        JASSERT(fd != -1) (area.name)
+        .Text("The memfd was not recreated by the owner of the area");
+        restoreShmArea(area, fd);
+      } else {
+        restoreShmArea(shmArea.area);
+      }
     }
   }
 }
 
+void
+FileConnList::unlinkShmFiles()
+{
+  // Now unlink the files that we created as a side-effect of
+  // recreateShmFileAndMap.
+  for (size_t i = 0; i < missingUnlinkedShmFiles.size(); i++) {
+    const ProcMapsArea &area = missingUnlinkedShmFiles[i].area;
+    if (missingUnlinkedShmFiles[i].isCopy ||
+        missingUnlinkedShmFiles[i].isMemfd) {
+      continue;
+    }
+    JWARNING(unlink(area.name) != -1 || errno == ENOENT)
+      (area.name) (JASSERT_ERRNO)
+    .Text("The file was unlinked at the time of checkpoint. "
+          "Unlinking it after restart failed");
+  }
+  missingUnlinkedShmFiles.clear();
+
+  for (size_t i = 0; i < recreatedMemfds.size(); i++) {
+    _real_close(recreatedMemfds[i]);
+  }
+  recreatedMemfds.clear();
+}
+
 void
 FileConnList::prepareShmList()
 {
@@ -378,7 +506,8 @@ FileConnList::prepareShmList()
 
       if (Util::isNscdArea(area) ||
           Util::isIBShmArea(area) ||
-          Util::isSysVShmArea(area)) {
+          Util::isSysVShmArea(area) ||
+          Util::isIoUringArea(area)) {
         continue;
       }
 
@@ -419,19 +548,36 @@ FileConnList::prepareShmList()
           JTRACE("Will not checkpoint shared memory area") (area.name);
         }
       } else {
-        // TODO: Shared memory areas with unlinked backing files.
         JASSERT(Util::strEndsWith(area.name, DELETED_FILE_SUFFIX)) (area.name);
-        if (Util::strStartsWith(area.name, DEV_ZERO_DELETED_STR) ||
-            Util::strStartsWith(area.name, DEV_NULL_DELETED_STR)) {
-          JWARNING(false) (area.name)
-          .Text("Ckpt/Restart of anonymous shared memory not supported.");
+        UnlinkedShmArea shmArea;
+        shmArea.isMemfd = Util::strStartsWith(area.name, "/memfd:");
+        shmArea.isMapped = false;
+
+        // The ranges of a memfd are claimed in preCkpt().
+        shmArea.isCopy = shmArea.isMemfd ||
+          !SharedData::claimSharedArea(makedev(area.devmajor, area.devminor),
+                                       area.inodenum, area.offset, area.size,
+                                       area.addr);
+        shmArea.isAnonymous =
+          Util::strStartsWith(area.name, DEV_ZERO_DELETED_STR) ||
+          Util::strStartsWith(area.name, DEV_NULL_DELETED_STR);
+        JTRACE("Will recreate shm file on restart.")
+          (area.name) (shmArea.isCopy);
+
+        if (shmArea.isMemfd) {
+          // Recreated as a memfd of the same name.
+        } else if (shmArea.isAnonymous) {
+          // The directory is chosen on restart.
+          snprintf(area.name, sizeof(area.name), "%s%s-%lx-%lu",
+                   SHM_FILE_PREFIX, dmtcp_get_computation_id_str(),
+                   (unsigned long)makedev(area.devmajor, area.devminor),
+                   (unsigned long)area.inodenum);
         } else {
-          JTRACE("Will recreate shm file on restart.") (area.name);
-
           // Remove the DELETED suffix.
           area.name[strlen(area.name) - strlen(DELETED_FILE_SUFFIX)] = '\0';
-          unlinkedShmAreas.push_back(area);
         }
+        shmArea.area = area;
+        unlinkedShmAreas.push_back(shmArea);
       }
     }
   }
@@ -465,8 +611,13 @@ FileConnList::recreateShmFileAndMap(const ProcMapsArea &area)
    * - The file existed before restart. After the next barrier, abort if the
    *   contents differ from our checkpointed copy.
    */
-  int fd = _real_open(area.name, O_CREAT | O_EXCL | O_RDWR,
-                      S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+  mode_t mode = S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH;
+  if (Util::strStartsWith(jalib::Filesystem::BaseName(area.name).c_str(),
+                          SHM_FILE_PREFIX)) {
+    // Anonymous memory; not for other users' eyes.
+    mode = S_IRUSR | S_IWUSR;
+  }
+  int fd = _real_open(area.name, O_CREAT | O_EXCL | O_RDWR, mode);
   JASSERT(fd != -1 || errno == EEXIST) (area.name);
 
   if (fd == -1) {
@@ -483,6 +634,42 @@ FileConnList::recreateShmFileAndMap(const ProcMapsArea &area)
   restoreShmArea(area, fd);
 }
 
+void
+FileConnList::recreateMemfdAndMap(const ProcMapsArea &area)
+{
+  dev_t devnum = makedev(area.devmajor, area.devminor);
+  int fd = MemfdConnection::openRecreated(devnum, area.inodenum);
+
+  if (fd == -1) {
+    string name = MemfdConnection::nameFromPath(area.name);
+    int memfd = _real_syscall(SYS_memfd_create, name.c_str(),
+                              MFD_ALLOW_SEALING);
+    JASSERT(memfd != -1) (area.name) (JASSERT_ERRNO);
+    pid_t pid = getpid();
+    int32_t registeredFd = memfd;
+    if (SharedData::insertMemfdMap(devnum, area.inodenum, &pid,
+                                   &registeredFd)) {
+      recreatedMemfds.push_back(memfd);
+      fd = _real_dup(memfd);
+    } else {
+      // Another owner of a range was first.
+      _real_close(memfd);
+      fd = MemfdConnection::openRecreated(devnum, area.inodenum);
+    }
+  }
+  JASSERT(fd != -1) (area.name) (JASSERT_ERRNO);
+
+  // Grows the memfd, but never shrinks it under another owner.
+  JASSERT(fallocate(fd, 0, area.offset, area.size) == 0)
+    (area.name) (area.offset) (area.size) (JASSERT_ERRNO);
+  char *addr = (char *)mmap(NULL, area.size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd, area.offset);
+  JASSERT(addr != MAP_FAILED) (area.name) (JASSERT_ERRNO);
+  memcpy(addr, area.addr, area.size);
+  munmap(addr, area.size);
+  restoreShmArea(area, fd);
+}
+
 void
 FileConnList::restoreShmArea(const ProcMapsArea &area, int fd)
 {
@@ -568,6 +755,8 @@ FileConnList::scanForPreExisting()
        * a pre-existing device and ignore it for checkpoint-restart.
        */
       continue;
+    } else if (Util::strStartsWith(device.c_str(), "/memfd:")) {
+      add(fd, new MemfdConnection(MemfdConnection::nameFromPath(device)));
     } else if (Util::strStartsWith(device.c_str(), "/") &&
                !Util::isPseudoTty(device.c_str())) {
       if (isRegularFile) {
@@ -617,6 +806,10 @@ FileConnList::createDummyConnection(int type)
   case Connection::STDIO:
     return new StdioConnection();
 
+    break;
+  case Connection::MEMFD:
+    return new MemfdConnection();
+
     break;
   }
   return NULL;
@@ -650,7 +843,10 @@ FileConnList::processFileConnection(int fd,
   }
 
   path = device.c_str();
-  if (S_ISREG(statbuf.st_mode) || S_ISCHR(statbuf.st_mode) ||
+  if (Util::strStartsWith(path, "/memfd:")) {
+    // Reopened through /proc/*/fd.
+    c = new MemfdConnection(MemfdConnection::nameFromPath(device));
+  } else if (S_ISREG(statbuf.st_mode) || S_ISCHR(statbuf.st_mode) ||
       S_ISDIR(statbuf.st_mode) || S_ISBLK(statbuf.st_mode)) {
     int type = FileConnection::FILE_REGULAR;
     if (dmtcp_is_bq_file && dmtcp_is_bq_file(path)) {
@@ -64,6 +64,8 @@ class FileConnList : public ConnectionList
 
     static void restartResume() { instance().resume(true); }
 
+    static void restartUnlinkShmFiles() { instance().unlinkShmFiles(); }
+
     static bool createDirectoryTree(const string &path);
 
     virtual void preLockSaveOptions();
@@ -87,7 +89,9 @@ class FileConnList : public ConnectionList
     void prepareShmList();
     void remapShmMaps();
     void recreateShmFileAndMap(const ProcMapsArea &area);
+    void recreateMemfdAndMap(const ProcMapsArea &area);
     void restoreShmArea(const ProcMapsArea &area, int fd = -1);
+    void unlinkShmFiles();
 };
 }
 #endif // ifndef FILECONNLIST_H
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/ipc.h>
+#include <sys/mman.h>
 #include <sys/shm.h>
 #include <sys/socket.h>
 #include <sys/syscall.h>
@@ -43,3 +44,18 @@
 #include "fileconnlist.h"
 #include "filewrappers.h"
 
+using namespace dmtcp;
+
+#if __GLIBC_PREREQ(2, 27)
+extern "C" int
+memfd_create(const char *name, unsigned int flags)
+{
+  DMTCP_PLUGIN_DISABLE_CKPT();
+  int fd = _real_memfd_create(name, flags);
+  if (fd != -1) {
+    FileConnList::instance().add(fd, new MemfdConnection(name));
+  }
+  DMTCP_PLUGIN_ENABLE_CKPT();
+  return fd;
+}
+#endif // if __GLIBC_PREREQ(2, 27)
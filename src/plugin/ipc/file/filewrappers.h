@@ -57,6 +57,7 @@
 # define _real_mq_timedreceive NEXT_FNC(mq_timedreceive)
 # define _real_mq_notify       NEXT_FNC(mq_notify)
 # define _real_fcntl           NEXT_FNC(fcntl)
+# define _real_memfd_create    NEXT_FNC(memfd_create)
 
 # define _real_system          NEXT_FNC(system)
 #endif // FILE_WRAPPERS_H
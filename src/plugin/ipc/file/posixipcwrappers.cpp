@@ -20,9 +20,7 @@
 
 #include <mqueue.h>
 #include <stdarg.h>
-#include <time.h>
 #include "dmtcp.h"
-#include "util.h"
 
 #include "fileconnection.h"
 #include "fileconnlist.h"
@@ -134,91 +132,11 @@ mq_notify(mqd_t mqdes, const struct sigevent *sevp)
   return res;
 }
 
-extern "C"
-int
-mq_send(mqd_t mqdes, const char *msg_ptr, size_t msg_len, unsigned msg_prio)
-{
-  int res;
-  struct timespec ts;
-
-  do {
-    JASSERT(clock_gettime(CLOCK_REALTIME, &ts) != -1);
-    ts.tv_sec += 1000;
-    res = mq_timedsend(mqdes, msg_ptr, msg_len, msg_prio, &ts);
-  } while (res == -1 && errno == ETIMEDOUT);
-  return res;
-}
-
-extern "C"
-ssize_t
-mq_receive(mqd_t mqdes, char *msg_ptr, size_t msg_len, unsigned *msg_prio)
-{
-  ssize_t res;
-  struct timespec ts;
-
-  do {
-    JASSERT(clock_gettime(CLOCK_REALTIME, &ts) != -1);
-    ts.tv_sec += 1000;
-    res = mq_timedreceive(mqdes, msg_ptr, msg_len, msg_prio, &ts);
-  } while (res == -1 && errno == ETIMEDOUT);
-  return res;
-}
-
-static struct timespec ts_100ms = { 0, 100 * 1000 * 1000 };
-extern "C"
-int
-mq_timedsend(mqd_t mqdes,
-             const char *msg_ptr,
-             size_t msg_len,
-             unsigned msg_prio,
-             const struct timespec *abs_timeout)
-{
-  struct timespec ts;
-  int ret = -1;
-
-  do {
-    DMTCP_PLUGIN_DISABLE_CKPT();
-    JASSERT(clock_gettime(CLOCK_REALTIME, &ts) != -1);
-    if (TIMESPEC_CMP(&ts, abs_timeout, <=)) {
-      TIMESPEC_ADD(&ts, &ts_100ms, &ts);
-    }
-    ret = _real_mq_timedsend(mqdes, msg_ptr, msg_len, msg_prio, &ts);
-    DMTCP_PLUGIN_ENABLE_CKPT();
-
-    if (ret != -1 || (ret == -1 && errno != ETIMEDOUT)) {
-      return ret;
-    }
-  } while (TIMESPEC_CMP(&ts, abs_timeout, <));
-
-  errno = ETIMEDOUT;
-  return ret;
-}
-
-extern "C"
-ssize_t
-mq_timedreceive(mqd_t mqdes,
-                char *msg_ptr,
-                size_t msg_len,
-                unsigned *msg_prio,
-                const struct timespec *abs_timeout)
-{
-  struct timespec ts;
-  int ret = -1;
-
-  do {
-    DMTCP_PLUGIN_DISABLE_CKPT();
-    JASSERT(clock_gettime(CLOCK_REALTIME, &ts) != -1);
-    if (TIMESPEC_CMP(&ts, abs_timeout, <=)) {
-      TIMESPEC_ADD(&ts, &ts_100ms, &ts);
-    }
-    ret = _real_mq_timedreceive(mqdes, msg_ptr, msg_len, msg_prio, &ts);
-    DMTCP_PLUGIN_ENABLE_CKPT();
-
-    if (ret != -1 || (ret == -1 && errno != ETIMEDOUT)) {
-      return ret;
-    }
-  } while (TIMESPEC_CMP(&ts, abs_timeout, <));
-
-  errno = ETIMEDOUT;
-  return ret;
-}
+/* mq_send(), mq_receive(), mq_timedsend() and mq_timedreceive() are
+ * deliberately not wrapped.  A thread blocked in one of them is interrupted
+ * by the checkpoint signal, and the call is transparently restarted
+ * (SA_RESTART) once the queue has been drained, refilled and, on restart,
+ * reopened at the same descriptor.  Wrapping them only added a
+ * clock_gettime() and a disable/enable-ckpt pair per message, and made a
+ * blocked waiter delay the checkpoint by up to 100 ms.
+ */
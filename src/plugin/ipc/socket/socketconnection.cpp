@@ -23,6 +23,9 @@
 #include <fcntl.h>
 #include <linux/limits.h>
 #include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/unix_diag.h>
 #include <poll.h>
 #include <signal.h>
 #include <sys/ioctl.h>
@@ -122,7 +125,15 @@ SocketConnection::addSetsockopt(int level,
                                 const void *value,
                                 int len)
 {
-  _sockOptions[level][option] = jalib::JBuffer(value, len);
+  jalib::JBuffer &opt = _sockOptions[level][option];
+
+  // Servers toggle options such as TCP_CORK per request.  Reuse the buffer
+  // of an already recorded option instead of allocating a new one.
+  if (opt.size() == len) {
+    memcpy(opt.buffer(), value, len);
+  } else {
+    opt = jalib::JBuffer(value, len);
+  }
 }
 
 void
@@ -147,6 +158,37 @@ SocketConnection::restoreSocketOptions(vector<int> &fds)
   }
 }
 
+// Restores the options that must be set before bind():  IPV6_V6ONLY decides
+// which addresses an IPv6 socket binds to, and without SO_REUSEADDR or
+// SO_REUSEPORT, a server can't bind to its port while connections of the
+// checkpointed process are still in TIME_WAIT.
+void
+SocketConnection::restoreBindSocketOptions(int fd)
+{
+  typedef map<int64_t, map<int64_t, jalib::JBuffer> >::iterator levelIterator;
+  typedef map<int64_t, jalib::JBuffer>::iterator optionIterator;
+
+  for (levelIterator lvl = _sockOptions.begin();
+       lvl != _sockOptions.end(); ++lvl) {
+    for (optionIterator opt = lvl->second.begin();
+         opt != lvl->second.end(); ++opt) {
+      if (!(lvl->first == IPPROTO_IPV6 && opt->first == IPV6_V6ONLY) &&
+          !(lvl->first == SOL_SOCKET &&
+            (opt->first == SO_REUSEADDR || opt->first == SO_REUSEPORT))) {
+        continue;
+      }
+      JTRACE("Restoring socket option before binding.")
+        (fd) (opt->first) (opt->second.size());
+      int ret = _real_setsockopt(fd, lvl->first, opt->first,
+                                 opt->second.buffer(),
+                                 opt->second.size());
+      JASSERT(ret == 0) (JASSERT_ERRNO) (fd) (lvl->first)
+        (opt->first) (opt->second.buffer()) (opt->second.size())
+      .Text("Restoring setsockopt failed.");
+    }
+  }
+}
+
 void
 SocketConnection::serialize(jalib::JBinarySerializer &o)
 {
@@ -224,12 +266,15 @@ SocketConnection::serialize(jalib::JBinarySerializer &o)
 TcpConnection::TcpConnection(int domain, int type, int protocol)
   : Connection(TCP_CREATED)
   , SocketConnection(domain, type, protocol)
+  , _typeBeforeSubsetCkpt(0)
 {
   if (domain != -1) {
     // Sometimes _sockType contains SOCK_CLOEXEC/SOCK_NONBLOCK flags.
     if ((type & 077) == SOCK_DGRAM) {
-      JWARNING(false) (type)
-      .Text("Datagram Sockets not supported. "
+      // socket() hands AF_INET, AF_INET6 and AF_UNIX datagram sockets to
+      // UdpConnection; other domains and socketpair() still end up here.
+      JWARNING(false) (domain) (type)
+      .Text("Datagram sockets of this kind not supported. "
             "Hopefully, this is a short lived connection!");
     } else {
       JWARNING((domain == AF_INET || domain == AF_UNIX || domain == AF_INET6)
@@ -407,6 +452,7 @@ TcpConnection::TcpConnection(const TcpConnection &parent,
                      parent._sockType,
                      parent._sockProtocol,
                      remote)
+  , _typeBeforeSubsetCkpt(0)
 {
   if (really_verbose) {
     JTRACE("Accepting.") (id()) (parent.id()) (remote);
@@ -417,6 +463,80 @@ TcpConnection::TcpConnection(const TcpConnection &parent,
   memset(&_bindAddr, 0, sizeof _bindAddr);
 }
 
+/* Peer information lives in checkpoint-scoped name-service databases: a
+ * process that registered a connection in an earlier checkpoint may not be
+ * in this one.
+ */
+#define NS_INET_CONNECTIONS DMTCP_CKPT_SCOPED_DB "SCons"
+#define NS_UNIX_CONNECTIONS DMTCP_CKPT_SCOPED_DB "UCons"
+
+// A connected AF_UNIX socket, named by its host and its socket inode.
+struct UnixConnectionKey {
+  uint64_t hostid;
+  uint64_t inode;
+};
+
+// Returns the socket inode of the peer of a connected AF_UNIX socket, or 0
+// if the kernel won't tell (no sock_diag support).
+static uint64_t
+unixPeerInode(int fd)
+{
+  struct stat st;
+  struct {
+    struct nlmsghdr nlh;
+    struct unix_diag_req req;
+  } request;
+  char buf[1024];
+  uint64_t peer = 0;
+
+  if (fstat(fd, &st) != 0) {
+    return 0;
+  }
+
+  int nlfd = _real_socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                          NETLINK_SOCK_DIAG);
+  if (nlfd == -1) {
+    return 0;
+  }
+
+  memset(&request, 0, sizeof(request));
+  request.nlh.nlmsg_len = sizeof(request);
+  request.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  request.nlh.nlmsg_flags = NLM_F_REQUEST;
+  request.req.sdiag_family = AF_UNIX;
+  request.req.udiag_states = ~0U;
+  request.req.udiag_ino = st.st_ino;
+  request.req.udiag_show = UDIAG_SHOW_PEER;
+  request.req.udiag_cookie[0] = request.req.udiag_cookie[1] = ~0U;
+
+  if (send(nlfd, &request, sizeof(request), 0) == sizeof(request)) {
+    ssize_t len = recv(nlfd, buf, sizeof(buf), 0);
+    struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+    if (len > 0 && NLMSG_OK(nlh, (size_t)len) &&
+        nlh->nlmsg_type == SOCK_DIAG_BY_FAMILY) {
+      struct unix_diag_msg *msg = (struct unix_diag_msg *)NLMSG_DATA(nlh);
+      int attrlen = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*msg));
+      struct rtattr *attr = (struct rtattr *)(msg + 1);
+      for (; RTA_OK(attr, attrlen); attr = RTA_NEXT(attr, attrlen)) {
+        if (attr->rta_type == UNIX_DIAG_PEER) {
+          peer = *(uint32_t *)RTA_DATA(attr);
+        }
+      }
+    }
+  }
+  _real_close(nlfd);
+  return peer;
+}
+
+void
+TcpConnection::markOutsideSubsetCkpt()
+{
+  JTRACE("Peer not in this subset checkpoint; treating socket as external.")
+    (id()) (_fds[0]);
+  _typeBeforeSubsetCkpt = _type;
+  _type = TCP_EXTERNAL_CONNECT;
+}
+
 void
 TcpConnection::sendPeerInformation()
 {
@@ -424,6 +544,21 @@ TcpConnection::sendPeerInformation()
   socklen_t keysz = 0, valuesz = 0;
   bool sendPeerInfo = false;
 
+  // Both ends of a pipe or socketpair are normally checkpointed together;
+  // only a subset checkpoint needs to find out whether the peer is in it.
+  if (_sockDomain == AF_UNIX && (_sockType & 077) == SOCK_STREAM &&
+      (_type == TCP_CONNECT || _type == TCP_ACCEPT) &&
+      dmtcp_is_subset_checkpoint()) {
+    struct stat st;
+    JASSERT(fstat(_fds[0], &st) == 0) (_fds[0]) (JASSERT_ERRNO);
+    UnixConnectionKey unixKey = { dmtcp_get_uniquepid()._hostid,
+                                  (uint64_t)st.st_ino };
+    dmtcp_send_key_val_pair_to_coordinator(NS_UNIX_CONNECTIONS,
+                                           &unixKey, sizeof(unixKey),
+                                           &unixKey, sizeof(unixKey));
+    return;
+  }
+
   if (!(_sockDomain == AF_INET || _sockDomain == AF_INET6) ||
       _sockType != SOCK_STREAM) {
     return;
@@ -457,7 +592,7 @@ TcpConnection::sendPeerInformation()
     break;
   }
   if (sendPeerInfo) {
-    dmtcp_send_key_val_pair_to_coordinator("SCons",
+    dmtcp_send_key_val_pair_to_coordinator(NS_INET_CONNECTIONS,
                                            &key, keysz,
                                            &value, valuesz);
   }
@@ -469,6 +604,22 @@ TcpConnection::recvPeerInformation()
   struct sockaddr key = {0}, value = {0};
   socklen_t keylen = 0, vallen = 0;
 
+  if (_sockDomain == AF_UNIX && (_sockType & 077) == SOCK_STREAM &&
+      (_type == TCP_CONNECT || _type == TCP_ACCEPT) &&
+      dmtcp_is_subset_checkpoint()) {
+    UnixConnectionKey unixKey = { dmtcp_get_uniquepid()._hostid,
+                                  unixPeerInode(_fds[0]) };
+    UnixConnectionKey unixValue;
+    uint32_t unixValueLen = sizeof(unixValue);
+    if (unixKey.inode == 0 ||
+        dmtcp_send_query_to_coordinator(NS_UNIX_CONNECTIONS,
+                                        &unixKey, sizeof(unixKey),
+                                        &unixValue, &unixValueLen) == 0) {
+      markOutsideSubsetCkpt();
+    }
+    return;
+  }
+
   if (!(_sockDomain == AF_INET || _sockDomain == AF_INET6) ||
       _sockType != SOCK_STREAM) {
     return;
@@ -479,11 +630,13 @@ TcpConnection::recvPeerInformation()
     keylen = sizeof(key);
     JASSERT(getpeername(_fds[0], &key, &keylen) == 0);
     vallen = sizeof(value);
-    int ret = dmtcp_send_query_to_coordinator("SCons",
+    int ret = dmtcp_send_query_to_coordinator(NS_INET_CONNECTIONS,
                                               &key, keylen,
                                               &value, &vallen);
     if (ret != 0) {
       JASSERT(vallen == sizeof(value))(vallen)(sizeof(value));
+    } else if (dmtcp_is_subset_checkpoint()) {
+      markOutsideSubsetCkpt();
     } else {
       JWARNING(false) (_fds[0])
        .Text("DMTCP detected an \"external\" connect socket."
@@ -608,6 +761,13 @@ TcpConnection::doRecvHandshakes(const ConnectionIdentifier &coordId)
 void
 TcpConnection::refill(bool isRestart)
 {
+  // On resume, a connection that crossed the subset checkpoint is an
+  // ordinary connection again.
+  if (!isRestart && _typeBeforeSubsetCkpt != 0) {
+    _type = _typeBeforeSubsetCkpt;
+    _typeBeforeSubsetCkpt = 0;
+  }
+
   if ((_fcntlFlags & O_ASYNC) != 0) {
     JTRACE("Re-adding O_ASYNC flag.") (_fds[0]) (id());
     restoreSocketOptions(_fds);
@@ -684,34 +844,7 @@ TcpConnection::postRestart()
      * restart under DMTCP.
      *                               --Kapil
      */
-
-    if (_sockDomain == AF_INET6) {
-      JTRACE("Restoring some socket options before binding.");
-      typedef map<int64_t,
-                  map<int64_t, jalib::JBuffer> >::iterator levelIterator;
-      typedef map<int64_t, jalib::JBuffer>::iterator optionIterator;
-
-      for (levelIterator lvl = _sockOptions.begin();
-           lvl != _sockOptions.end(); ++lvl) {
-        if (lvl->first == IPPROTO_IPV6) {
-          for (optionIterator opt = lvl->second.begin();
-               opt != lvl->second.end(); ++opt) {
-            if (opt->first == IPV6_V6ONLY) {
-              if (really_verbose) {
-                JTRACE("Restoring socket option.")
-                  (_fds[0]) (opt->first) (opt->second.size());
-              }
-              int ret = _real_setsockopt(_fds[0], lvl->first, opt->first,
-                                         opt->second.buffer(),
-                                         opt->second.size());
-              JASSERT(ret == 0) (JASSERT_ERRNO) (_fds[0]) (lvl->first)
-                (opt->first) (opt->second.buffer()) (opt->second.size())
-              .Text("Restoring setsockopt failed.");
-            }
-          }
-        }
-      }
-    }
+    restoreBindSocketOptions(_fds[0]);
 
     if (really_verbose) {
       JTRACE("Binding socket.") (id());
@@ -754,6 +887,7 @@ TcpConnection::postRestart()
     JASSERT(fd != -1) (JASSERT_ERRNO);
     restoreDupFds(fd);
     if (_bindAddrlen != 0) {
+      restoreBindSocketOptions(_fds[0]);
       JWARNING(_real_bind(_fds[0], (sockaddr *)&_bindAddr, _bindAddrlen) != -1)
         (JASSERT_ERRNO);
     }
@@ -986,3 +1120,364 @@ RawSocketConnection::onConnect(const struct sockaddr *serv_addr,
   JWARNING(false).Text("Connect on raw socket type not supported...\n"
                        "Socket won't be restored");
 }
+
+/*****************************************************************************
+ * UDP Connection
+ *****************************************************************************/
+
+// Returns true if 'addr', as returned by getsockname(), names a bound socket.
+static bool
+isBoundAddr(const struct sockaddr_storage &addr, socklen_t len)
+{
+  if (len <= sizeof(addr.ss_family)) {
+    return false;
+  }
+  if (addr.ss_family == AF_INET) {
+    return ((const struct sockaddr_in *)&addr)->sin_port != 0;
+  } else if (addr.ss_family == AF_INET6) {
+    return ((const struct sockaddr_in6 *)&addr)->sin6_port != 0;
+  }
+  return true;
+}
+
+/*onSocket*/
+UdpConnection::UdpConnection(int domain, int type, int protocol)
+  : Connection(UDP_CREATED)
+  , SocketConnection(domain, type, protocol)
+  , _peerAddrlen(0)
+{
+  JTRACE("Creating UdpConnection.") (id()) (domain) (type) (protocol);
+  memset(&_bindAddr, 0, sizeof _bindAddr);
+  memset(&_peerAddr, 0, sizeof _peerAddr);
+}
+
+void
+UdpConnection::onBind(const struct sockaddr *addr, socklen_t len)
+{
+  if (really_verbose) {
+    JTRACE("Binding.") (id()) (len);
+  }
+
+  // As for TCP, look ourselves up in case the port was 0.  drain() refreshes
+  // this, since sendto() and connect() may also bind the socket implicitly.
+  _bindAddrlen = sizeof(_bindAddr);
+  JASSERT(getsockname(_fds[0], (struct sockaddr *)&_bindAddr,
+                      &_bindAddrlen) == 0)
+    (JASSERT_ERRNO);
+  if (_type == UDP_CREATED) {
+    _type = UDP_BIND;
+  }
+}
+
+void
+UdpConnection::onConnect(const struct sockaddr *addr,
+                         socklen_t len,
+                         bool connectInProgress)
+{
+  if (really_verbose) {
+    JTRACE("Connecting.") (id());
+  }
+
+  // connect() on a datagram socket only sets the default peer; there is no
+  // handshake, and an AF_UNSPEC address dissolves the association.
+  if (addr == NULL || addr->sa_family == AF_UNSPEC) {
+    _peerAddrlen = 0;
+    _type = _bindAddrlen != 0 ? UDP_BIND : UDP_CREATED;
+    return;
+  }
+
+  JASSERT(len <= sizeof _peerAddr) (len) (sizeof _peerAddr)
+  .Text("That is one huge sockaddr buddy.");
+  _peerAddrlen = len;
+  memcpy(&_peerAddr, addr, len);
+  _type = UDP_CONNECT;
+}
+
+void
+UdpConnection::drain()
+{
+  JASSERT(_fds.size() > 0) (id());
+
+  if ((_fcntlFlags & O_ASYNC) != 0) {
+    if (really_verbose) {
+      JTRACE("Removing O_ASYNC flag during checkpoint.") (_fds[0]) (id());
+    }
+    errno = 0;
+    JASSERT(fcntl(_fds[0], F_SETFL, _fcntlFlags & ~O_ASYNC) == 0)
+      (JASSERT_ERRNO) (_fds[0]) (id());
+  }
+
+  // Refresh both addresses from the kernel: sendto() binds an unbound socket
+  // to an ephemeral port, and the peer may have been reset.
+  _bindAddrlen = sizeof(_bindAddr);
+  if (getsockname(_fds[0], (struct sockaddr *)&_bindAddr, &_bindAddrlen) != 0 ||
+      !isBoundAddr(_bindAddr, _bindAddrlen)) {
+    _bindAddrlen = 0;
+  }
+  _peerAddrlen = sizeof(_peerAddr);
+  if (getpeername(_fds[0], (struct sockaddr *)&_peerAddr, &_peerAddrlen) != 0) {
+    _peerAddrlen = 0;
+  }
+  if (_peerAddrlen != 0) {
+    _type = UDP_CONNECT;
+  } else {
+    _type = _bindAddrlen != 0 ? UDP_BIND : UDP_CREATED;
+  }
+
+  saveQueuedDatagrams();
+}
+
+void
+UdpConnection::saveQueuedDatagrams()
+{
+  _datagrams.clear();
+  _datagramSenders.clear();
+
+  // A pending error (e.g., ECONNREFUSED after an ICMP port unreachable) is
+  // returned, and cleared, by the next recvfrom(), ahead of any data.  The
+  // process must still get it, so we leave such a socket alone.
+  struct pollfd pfd;
+  pfd.fd = _fds[0];
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  if (_real_poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLERR)) {
+    JTRACE("Socket error pending; queued datagrams are lost on restart.")
+      (id()) (_fds[0]);
+    return;
+  }
+
+  // Copy the receive queue without consuming it: with a peek offset, each
+  // MSG_PEEK returns the next datagram in the queue.  On resume, the process
+  // then finds its datagrams exactly where it left them; only a restart needs
+  // to replay them.
+  int oldPeekOff = -1;
+  socklen_t optlen = sizeof(oldPeekOff);
+  int peekOff = 0;
+  if (_real_getsockopt(_fds[0], SOL_SOCKET, SO_PEEK_OFF,
+                       &oldPeekOff, &optlen) != 0 ||
+      _real_setsockopt(_fds[0], SOL_SOCKET, SO_PEEK_OFF,
+                       &peekOff, sizeof(peekOff)) != 0) {
+    JTRACE("No peek offset; queued datagrams are lost on restart.")
+      (id()) (_fds[0]) (JASSERT_ERRNO);
+    return;
+  }
+
+  // The receive queue can never hold more than SO_RCVBUF bytes.  Stop there,
+  // so that a sender outside of our computation cannot keep us here forever.
+  int rcvbuf = 0;
+  optlen = sizeof(rcvbuf);
+  JASSERT(_real_getsockopt(_fds[0], SOL_SOCKET, SO_RCVBUF,
+                            &rcvbuf, &optlen) == 0)
+    (JASSERT_ERRNO) (_fds[0]);
+
+  // A UDP payload fits in 64 KiB.  The size of an AF_UNIX datagram is only
+  // bounded by the send buffer of its sender, so ask the kernel for it.  (On
+  // a UDP socket, an empty MSG_TRUNC peek would move the peek offset.)
+  jalib::JBuffer buf(65536);
+
+  size_t totalBytes = 0;
+  while (totalBytes < (size_t)rcvbuf) {
+    ssize_t len = buf.size();
+    if (_sockDomain == AF_UNIX) {
+      // With MSG_TRUNC, the kernel returns the real size of the datagram.
+      len = recv(_fds[0], NULL, 0, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+      if (len > buf.size()) {
+        buf = jalib::JBuffer(len);
+      }
+    }
+
+    struct sockaddr_storage from;
+    socklen_t fromlen = sizeof(from);
+    memset(&from, 0, sizeof(from));
+    if (len != -1) {
+      len = recvfrom(_fds[0], buf.buffer(), len, MSG_PEEK | MSG_DONTWAIT,
+                     (struct sockaddr *)&from, &fromlen);
+    }
+    if (len == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // An error that arrived during the copy has been cleared by now; we
+      // can't give it back.
+      JWARNING(errno == EAGAIN || errno == EWOULDBLOCK)
+        (JASSERT_ERRNO) (_fds[0]) (id())
+        .Text("Socket error consumed while saving queued datagrams.");
+      break;
+    }
+
+    _datagrams.push_back(jalib::JBuffer(buf.buffer(), len));
+    _datagramSenders.push_back(jalib::JBuffer((const char *)&from, fromlen));
+    totalBytes += len;
+  }
+
+  JASSERT(_real_setsockopt(_fds[0], SOL_SOCKET, SO_PEEK_OFF,
+                           &oldPeekOff, sizeof(oldPeekOff)) == 0)
+    (JASSERT_ERRNO) (_fds[0]) (id());
+
+  JTRACE("Saved queued datagrams.")
+    (id()) (_fds[0]) (_datagrams.size()) (totalBytes);
+}
+
+void
+UdpConnection::replayQueuedDatagrams()
+{
+  struct sockaddr_storage dest = _bindAddr;
+  socklen_t destlen = _bindAddrlen;
+
+  JWARNING(destlen != 0) (id()) (_datagrams.size())
+  .Text("Queued datagrams on an unbound socket cannot be replayed.");
+  if (destlen == 0) {
+    _datagrams.clear();
+    _datagramSenders.clear();
+    return;
+  }
+
+  // A wildcard local address is not a valid destination; use loopback.
+  if (dest.ss_family == AF_INET) {
+    struct sockaddr_in *in = (struct sockaddr_in *)&dest;
+    if (in->sin_addr.s_addr == htonl(INADDR_ANY)) {
+      in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+  } else if (dest.ss_family == AF_INET6) {
+    struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&dest;
+    if (IN6_IS_ADDR_UNSPECIFIED(&in6->sin6_addr)) {
+      in6->sin6_addr = in6addr_loopback;
+    }
+  }
+
+  // The socket was just recreated: it is not connected to its peer yet, so
+  // it accepts datagrams from any sender.
+
+  size_t numReplayed = 0;
+  for (size_t i = 0; i < _datagrams.size(); i++) {
+    const jalib::JBuffer &from = _datagramSenders[i];
+    int sender = _real_socket(_sockDomain, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    JASSERT(sender != -1) (JASSERT_ERRNO);
+
+    // Try to send from the original address, so that replies reach the
+    // original sender.  That address is usually still in use by the sender;
+    // if so, the datagram arrives from an anonymous address instead.
+    if (_sockDomain != AF_UNIX) {
+      int one = 1;
+      _real_setsockopt(sender, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (from.size() > (int)sizeof(sa_family_t) &&
+        _real_bind(sender, (const struct sockaddr *)from.buffer(),
+                   from.size()) != 0) {
+      JTRACE("Replaying datagram from a different address.")
+        (id()) (JASSERT_ERRNO);
+    }
+
+    ssize_t ret = sendto(sender, _datagrams[i].buffer(), _datagrams[i].size(),
+                         MSG_DONTWAIT, (struct sockaddr *)&dest, destlen);
+    JWARNING(ret == _datagrams[i].size())
+      (ret) (_datagrams[i].size()) (JASSERT_ERRNO) (id())
+    .Text("Failed to replay a queued datagram.");
+    if (ret == _datagrams[i].size()) {
+      numReplayed++;
+    }
+    _real_close(sender);
+  }
+  JTRACE("Replayed queued datagrams.") (id()) (_fds[0]) (numReplayed);
+
+  _datagrams.clear();
+  _datagramSenders.clear();
+}
+
+void
+UdpConnection::refill(bool isRestart)
+{
+  // On resume, the saved datagrams are still queued on the socket.
+  if (!isRestart) {
+    _datagrams.clear();
+    _datagramSenders.clear();
+    return;
+  }
+
+  if (!_datagrams.empty()) {
+    replayQueuedDatagrams();
+  }
+
+  if (_type == UDP_CONNECT) {
+    if (really_verbose) {
+      JTRACE("Reconnecting socket.") (id()) (_fds[0]);
+    }
+    errno = 0;
+    JWARNING(_real_connect(_fds[0], (struct sockaddr *)&_peerAddr,
+                           _peerAddrlen) == 0)
+      (JASSERT_ERRNO) (id()).Text("connect failed.");
+  }
+}
+
+void
+UdpConnection::postRestart()
+{
+  JASSERT(_fds.size() > 0);
+
+  if (really_verbose) {
+    JTRACE("Restoring socket.") (id()) (_fds[0]);
+  }
+
+  int fd = _real_socket(_sockDomain, _sockType, _sockProtocol);
+  JASSERT(fd != -1) (JASSERT_ERRNO);
+  restoreDupFds(fd);
+
+  // Options such as SO_REUSEADDR, SO_REUSEPORT and IPV6_V6ONLY only take
+  // effect if they are set before bind().
+  restoreSocketOptions(_fds);
+
+  // An unbound AF_UNIX socket may still be connected to a peer.
+  if (_bindAddrlen == 0) {
+    return;
+  }
+
+  if (_sockDomain == AF_UNIX) {
+    struct sockaddr_un *uaddr = (sockaddr_un *)&_bindAddr;
+    if (uaddr->sun_path[0] != '\0') {
+      JTRACE("Unlinking stale unix domain socket.") (uaddr->sun_path);
+      JWARNING(unlink(uaddr->sun_path) == 0) (uaddr->sun_path);
+    }
+  }
+
+  if (really_verbose) {
+    JTRACE("Binding socket.") (id());
+  }
+  errno = 0;
+  JWARNING(_real_bind(_fds[0], (sockaddr *)&_bindAddr, _bindAddrlen) == 0)
+    (JASSERT_ERRNO) (id()).Text("Bind failed.");
+
+  // The peer is connected in refill(), after the saved datagrams have been
+  // queued on the socket.
+}
+
+void
+UdpConnection::serializeSubClass(jalib::JBinarySerializer &o)
+{
+  JSERIALIZE_ASSERT_POINT("UdpConnection");
+  o&_bindAddrlen&_bindAddr&_peerAddrlen &_peerAddr;
+  SocketConnection::serialize(o);
+
+  JSERIALIZE_ASSERT_POINT("QueuedDatagrams:");
+  uint64_t numDatagrams = _datagrams.size();
+  o &numDatagrams;
+  if (o.isReader()) {
+    _datagrams.resize(numDatagrams);
+    _datagramSenders.resize(numDatagrams);
+  }
+
+  for (size_t i = 0; i < numDatagrams; i++) {
+    int64_t fromLen = _datagramSenders[i].size();
+    int64_t len = _datagrams[i].size();
+
+    JSERIALIZE_ASSERT_POINT("Datagram");
+
+    o&fromLen &len;
+    if (o.isReader()) {
+      _datagramSenders[i] = jalib::JBuffer(fromLen);
+      _datagrams[i] = jalib::JBuffer(len);
+    }
+    o.readOrWrite(_datagramSenders[i].buffer(), fromLen);
+    o.readOrWrite(_datagrams[i].buffer(), len);
+  }
+  JSERIALIZE_ASSERT_POINT("EndQueuedDatagrams");
+}
@@ -59,6 +59,7 @@ class SocketConnection
                      ConnectionIdentifier remote);
     void addSetsockopt(int level, int option, const void *value, int len);
     void restoreSocketOptions(vector<int32_t> &fds);
+    void restoreBindSocketOptions(int fd);
     void serialize(jalib::JBinarySerializer &o);
     int sockDomain() const { return _sockDomain; }
 
@@ -103,10 +104,11 @@ class TcpConnection : public Connection, public SocketConnection
       TCP_EXTERNAL_CONNECT
     };
 
-    TcpConnection() {}
+    TcpConnection() : _typeBeforeSubsetCkpt(0) {}
 
     // This accessor is needed because _type is protected.
     void markExternalConnect() { _type = TCP_EXTERNAL_CONNECT; }
+    void markOutsideSubsetCkpt();
 
     bool isBlacklistedTcp(const sockaddr *saddr, socklen_t len);
 
@@ -149,6 +151,10 @@ class TcpConnection : public Connection, public SocketConnection
 
   private:
     TcpConnection &asTcp();
+
+    // A connection to a process outside a subset checkpoint is handled as
+    // external for that checkpoint only; this is its type to go back to.
+    uint32_t _typeBeforeSubsetCkpt;
 };
 
 class RawSocketConnection : public Connection, public SocketConnection
@@ -189,5 +195,47 @@ class RawSocketConnection : public Connection, public SocketConnection
     virtual void serializeSubClass(jalib::JBinarySerializer &o);
     virtual string str() { return "<Raw Socket>"; }
 };
+
+class UdpConnection : public Connection, public SocketConnection
+{
+  public:
+    enum UdpType {
+      UDP_INVALID = UDP,
+      UDP_CREATED,
+      UDP_BIND,
+      UDP_CONNECT
+    };
+
+    UdpConnection() {}
+
+    // basic commands for updating state from wrappers
+    UdpConnection(int domain, int type, int protocol);
+    virtual void onBind(const struct sockaddr *addr, socklen_t len);
+    virtual void onConnect(const struct sockaddr *serv_addr = NULL,
+                           socklen_t addrlen = 0,
+                           bool connectInProgress = false);
+
+    // basic checkpointing commands
+    virtual void drain();
+    virtual void refill(bool isRestart);
+    virtual void postRestart();
+
+    virtual void serializeSubClass(jalib::JBinarySerializer &o);
+    virtual string str() { return "<UDP Socket>"; }
+
+  private:
+    void saveQueuedDatagrams();
+    void replayQueuedDatagrams();
+
+    // _bindAddr (from SocketConnection) holds the local address; the peer of
+    // a connected socket is kept separately, since a UDP socket can be both.
+    socklen_t _peerAddrlen;
+    struct sockaddr_storage _peerAddr;
+
+    // Datagrams that were queued on the socket at checkpoint time, along
+    // with the address of their sender.
+    vector<jalib::JBuffer> _datagrams;
+    vector<jalib::JBuffer> _datagramSenders;
+};
 }
 #endif // ifndef SOCKETCONNECTION_H
@@ -1,3 +1,7 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
@@ -33,6 +37,7 @@ dmtcp_SocketConnList_EventHook(DmtcpEvent_t event, DmtcpEventData_t *data)
     break;
 
   case DMTCP_EVENT_PRECHECKPOINT:
+    SocketConnList::instance().scanForAccepted();
     SocketConnList::saveOptions();
     dmtcp_local_barrier("Socket::Pre_Ckpt");
     SocketConnList::leaderElection();
@@ -280,6 +285,74 @@ SocketConnList::scanForPreExisting()
   }
 }
 
+// The port of a bound AF_INET or AF_INET6 socket, or 0.
+static int
+localInetPort(int fd)
+{
+  struct sockaddr_storage addr;
+  socklen_t addrlen = sizeof(addr);
+
+  if (getsockname(fd, (struct sockaddr *)&addr, &addrlen) == -1) {
+    return 0;
+  }
+  if (addr.ss_family == AF_INET) {
+    return ntohs(((struct sockaddr_in *)&addr)->sin_port);
+  } else if (addr.ss_family == AF_INET6) {
+    return ntohs(((struct sockaddr_in6 *)&addr)->sin6_port);
+  }
+  return 0;
+}
+
+/* The accept() wrapper can't disable checkpoints around the blocking
+ * _real_accept(), so a checkpoint can come after the kernel accepted a
+ * connection, and before the wrapper added it to the list.  Find such
+ * sockets:  they are connected, and their local port is that of one of our
+ * listening sockets.  Without them, the peer is restored as a dead socket,
+ * and our end not at all.
+ */
+void
+SocketConnList::scanForAccepted()
+{
+  map<int, TcpConnection *> listeners;
+
+  for (iterator i = begin(); i != end(); ++i) {
+    Connection *con = i->second;
+    if (con->subType() == TcpConnection::TCP_LISTEN) {
+      int port = localInetPort(con->getFds()[0]);
+      if (port != 0) {
+        listeners[port] = static_cast<TcpConnection *>(con);
+      }
+    }
+  }
+  if (listeners.empty()) {
+    return;
+  }
+
+  vector<int>fds = jalib::Filesystem::ListOpenFds();
+  for (size_t i = 0; i < fds.size(); ++i) {
+    int fd = fds[i];
+    struct stat statbuf;
+    int listening = 1;
+    socklen_t len = sizeof(listening);
+
+    if (dmtcp_is_protected_fd(fd) || getConnection(fd) != NULL ||
+        fstat(fd, &statbuf) == -1 || !S_ISSOCK(statbuf.st_mode) ||
+        getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) == -1 ||
+        listening) {
+      continue;
+    }
+
+    map<int, TcpConnection *>::iterator listener =
+      listeners.find(localInetPort(fd));
+    if (listener != listeners.end()) {
+      JTRACE("Adding a socket accepted right before the checkpoint.")
+        (fd) (listener->second->id());
+      add(fd, new TcpConnection(*listener->second,
+                                ConnectionIdentifier::null()));
+    }
+  }
+}
+
 Connection *
 SocketConnList::createDummyConnection(int type)
 {
@@ -287,6 +360,8 @@ SocketConnList::createDummyConnection(int type)
     return new TcpConnection();
   } else if (type == Connection::RAW) {
     return new RawSocketConnection();
+  } else if (type == Connection::UDP) {
+    return new UdpConnection();
   }
   return NULL;
 }
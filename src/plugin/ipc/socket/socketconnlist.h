@@ -62,6 +62,7 @@ class SocketConnList : public ConnectionList
     virtual int protectedFd() { return PROTECTED_SOCKET_FDREWIRER_FD; }
 
     virtual void scanForPreExisting();
+    void scanForAccepted();
     virtual Connection *createDummyConnection(int type);
 };
 }
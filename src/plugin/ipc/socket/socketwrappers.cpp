@@ -50,6 +50,27 @@ using namespace dmtcp;
  */
 static __thread bool _doNotProcessSockets = false;
 
+/* The connection type tells us the concrete class, so we can avoid a
+ * dynamic_cast (a cross-cast from Connection to SocketConnection) on hot
+ * paths such as setsockopt() and accept().
+ */
+static SocketConnection *
+getSocketConnection(int sockfd)
+{
+  Connection *con = SocketConnList::instance().getConnection(sockfd);
+
+  if (con == NULL) {
+    return NULL;
+  } else if (con->conType() == Connection::TCP) {
+    return static_cast<TcpConnection *>(con);
+  } else if (con->conType() == Connection::RAW) {
+    return static_cast<RawSocketConnection *>(con);
+  } else if (con->conType() == Connection::UDP) {
+    return static_cast<UdpConnection *>(con);
+  }
+  return NULL;
+}
+
 extern "C" int
 socket(int domain, int type, int protocol)
 {
@@ -62,6 +83,10 @@ socket(int domain, int type, int protocol)
       JASSERT(domain == AF_NETLINK) (domain) (type)
       .Text("Only Netlink Raw sockets supported");
       con = new RawSocketConnection(domain, type, protocol);
+    } else if ((type & 0xff) == SOCK_DGRAM &&
+               (domain == AF_INET || domain == AF_INET6 ||
+                domain == AF_UNIX)) {
+      con = new UdpConnection(domain, type, protocol);
     } else {
       con = new TcpConnection(domain, type, protocol);
     }
@@ -82,9 +107,7 @@ connect(int sockfd, const struct sockaddr *serv_addr, socklen_t addrlen)
   if ((ret != -1 || errno == EINPROGRESS) &&
       dmtcp_is_running_state() &&
       !_doNotProcessSockets) {
-    SocketConnection *con =
-      dynamic_cast<SocketConnection *>(SocketConnList::instance().getConnection(
-                                         sockfd));
+    SocketConnection *con = getSocketConnection(sockfd);
     if (con == NULL) {
       JTRACE("Connect operation on unsupported socket type.");
     } else {
@@ -103,9 +126,7 @@ bind(int sockfd, const struct sockaddr *my_addr, socklen_t addrlen)
   DMTCP_PLUGIN_DISABLE_CKPT(); // The lock is released inside the macro.
   int ret = _real_bind(sockfd, my_addr, addrlen);
   if (ret != -1 && dmtcp_is_running_state() && !_doNotProcessSockets) {
-    SocketConnection *con =
-      dynamic_cast<SocketConnection *>(SocketConnList::instance().getConnection(
-                                         sockfd));
+    SocketConnection *con = getSocketConnection(sockfd);
     if (con == NULL) {
       JTRACE("bind operation on unsupported socket type.");
     } else {
@@ -122,9 +143,7 @@ listen(int sockfd, int backlog)
   DMTCP_PLUGIN_DISABLE_CKPT(); // The lock is released inside the macro.
   int ret = _real_listen(sockfd, backlog);
   if (ret != -1 && dmtcp_is_running_state() && !_doNotProcessSockets) {
-    SocketConnection *con =
-      dynamic_cast<SocketConnection *>(SocketConnList::instance().getConnection(
-                                         sockfd));
+    SocketConnection *con = getSocketConnection(sockfd);
     if (con == NULL) {
       JTRACE("listen operation on unsupported socket type.");
     } else {
@@ -145,15 +164,15 @@ process_accept(int ret, int sockfd, struct sockaddr *addr, socklen_t *addrlen)
     return;
   }
 
-  SocketConnection *con = NULL;
+  Connection *con = NULL;
 
   // FIXME: Checking for conType is ugly; fix class design
   if (parent->conType() == Connection::TCP) {
-    TcpConnection *tcpParent = dynamic_cast<TcpConnection *>(parent);
+    TcpConnection *tcpParent = static_cast<TcpConnection *>(parent);
     con = new TcpConnection(*tcpParent, ConnectionIdentifier::null());
   } else if (parent->conType() == Connection::RAW) {
     RawSocketConnection *rawSockParent =
-      dynamic_cast<RawSocketConnection *>(parent);
+      static_cast<RawSocketConnection *>(parent);
     con = new RawSocketConnection(*rawSockParent, ConnectionIdentifier::null());
   }
 
@@ -161,7 +180,7 @@ process_accept(int ret, int sockfd, struct sockaddr *addr, socklen_t *addrlen)
     JTRACE("accept operation on unsupported socket type.");
     return;
   } else {
-    SocketConnList::instance().add(ret, dynamic_cast<Connection *>(con));
+    SocketConnList::instance().add(ret, con);
   }
 }
 
@@ -175,7 +194,8 @@ accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
    * DmtcpWorker::wrapperExecutionLockLockExcl().
    *
    * Since it's a blocking call, we cannot grab the actual wrapper-execution
-   * lock here.
+   * lock here.  For a checkpoint between _real_accept() and
+   * process_accept(), see SocketConnList::scanForAccepted().
    */
   struct sockaddr_storage tmp_addr;
   socklen_t tmp_len = 0;
@@ -222,9 +242,7 @@ setsockopt(int sockfd,
 
   if (ret != -1 && dmtcp_is_running_state() && !_doNotProcessSockets) {
     JTRACE("setsockopt") (ret) (sockfd) (optname);
-    SocketConnection *con =
-      dynamic_cast<SocketConnection *>(SocketConnList::instance().getConnection(
-                                         sockfd));
+    SocketConnection *con = getSocketConnection(sockfd);
     if (con == NULL) {
       JTRACE("setsockopt operation on unsupported socket type.");
       return ret;
@@ -67,6 +67,13 @@ dmtcp_virtual_to_real_pid(pid_t virtualPid)
   return VIRTUAL_TO_REAL_PID(virtualPid);
 }
 
+extern "C"
+void
+dmtcp_update_virtual_pid(pid_t virtualPid, pid_t realPid)
+{
+  VirtualPidTable::instance().updateMapping(virtualPid, realPid);
+}
+
 // Also copied into src/threadlist.cpp, so that libdmtcp.sp
 //   won't depend on libdmtcp_pid.sp
 extern "C"
@@ -129,7 +136,8 @@ pidVirt_PostExec(DmtcpEventData_t *data)
 static void
 pid_virtual_to_real_filepath(DmtcpEventData_t *data)
 {
-  if (!Util::strStartsWith(data->virtualToRealPath.path, PROC_PREFIX)) {
+  if (Util::nativePids() ||
+      !Util::strStartsWith(data->virtualToRealPath.path, PROC_PREFIX)) {
     return;
   }
 
@@ -151,7 +159,8 @@ pid_virtual_to_real_filepath(DmtcpEventData_t *data)
 static void
 pid_real_to_virtual_filepath(DmtcpEventData_t *data)
 {
-  if (!Util::strStartsWith(data->realToVirtualPath.path, PROC_PREFIX)) {
+  if (Util::nativePids() ||
+      !Util::strStartsWith(data->realToVirtualPath.path, PROC_PREFIX)) {
     return;
   }
 
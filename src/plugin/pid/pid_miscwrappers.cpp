@@ -41,6 +41,12 @@ LIB_PRIVATE pid_t getPidFromEnvVar();
 void
 pidVirt_pthread_atfork_child()
 {
+  // With native pids, a child that didn't get the pid we asked for in fork()
+  // keeps the pid the kernel gave it.
+  if (Util::nativePids() && _real_getpid() != getPidFromEnvVar()) {
+    pid_t ppid = _real_getppid();
+    Util::setVirtualPidEnvVar(_real_getpid(), ppid, ppid);
+  }
   dmtcpResetPidPpid();
   dmtcpResetTid(getpid());
   VirtualPidTable::instance().resetOnFork();
@@ -64,12 +70,18 @@ fork()
 
   VirtualPidTable::instance().writeVirtualTidToFileForPtrace(virtualPid);
 
+  // glibc's fork() can't be made to pass a pid to clone3; ask the kernel to
+  // hand out virtualPid next instead.
+  if (Util::nativePids()) {
+    Util::setLastPid(virtualPid - 1);
+  }
+
   pid_t realPid = _real_fork();
 
   if (realPid > 0) { /* Parent Process */
-    retval = virtualPid;
-    VirtualPidTable::instance().updateMapping(virtualPid, realPid);
-    SharedData::setPidMap(virtualPid, realPid);
+    retval = Util::nativePids() ? realPid : virtualPid;
+    VirtualPidTable::instance().updateMapping(retval, realPid);
+    SharedData::setPidMap(retval, realPid);
   } else {
     retval = realPid;
     VirtualPidTable::instance().readVirtualTidFromFileForPtrace();
@@ -97,6 +109,10 @@ clone_start(void *arg)
   pid_t virtualTid = threadArg->virtualTid;
 
   if (dmtcp_is_running_state()) {
+    if (Util::nativePids() && virtualTid != _real_gettid()) {
+      // We didn't get the tid we asked for (see __clone); keep this one.
+      virtualTid = threadArg->virtualTid = _real_gettid();
+    }
     dmtcpResetTid(virtualTid);
   }
 
@@ -148,9 +164,20 @@ __clone(int (*fn)(void *arg),
   threadArg->virtualTid = virtualTid;
   sem_init(&threadArg->sem, 0, 0);
 
-  JTRACE("Calling libc:__clone");
-  pid_t tid = _real_clone(clone_start, child_stack, flags, threadArg,
-                          parent_tidptr, newtls, child_tidptr);
+  pid_t tid = -1;
+  if (Util::nativePids()) {
+    // Create the thread with its virtual tid, so that it needs no translation.
+    JTRACE("Calling clone3 with tid") (virtualTid);
+    tid = Util::cloneWithTid(clone_start, child_stack, flags, threadArg,
+                             parent_tidptr, newtls, child_tidptr, virtualTid);
+    JASSERT(tid != -1 || dmtcp_is_running_state()) (virtualTid) (JASSERT_ERRNO)
+    .Text("Failed to recreate the thread with its original tid");
+  }
+  if (tid == -1) {
+    JTRACE("Calling libc:__clone");
+    tid = _real_clone(clone_start, child_stack, flags, threadArg,
+                      parent_tidptr, newtls, child_tidptr);
+  }
 
   if (dmtcp_is_running_state()) {
     VirtualPidTable::instance().readVirtualTidFromFileForPtrace();
@@ -169,6 +196,7 @@ __clone(int (*fn)(void *arg),
      */
     sem_wait(&threadArg->sem);
     sem_destroy(&threadArg->sem);
+    virtualTid = threadArg->virtualTid;
   } else {
     virtualTid = tid;
   }
@@ -311,6 +339,18 @@ mq_notify(mqd_t mqdes, const struct sigevent *sevp)
                      type5, arg5, type6, arg6);                                \
   SYSCALL_GET_ARG(type7, arg7)
 
+// Checkpoints stay disabled across the system call:  the translation takes
+// the lock of the pid table, and a pid translated before a restart would be
+// stale after it.  pidfd_open() doesn't run any handlers of the process.
+static int
+dmtcp_pidfd_open(pid_t pid, unsigned int flags)
+{
+  DMTCP_PLUGIN_DISABLE_CKPT();
+  int ret = _real_syscall(SYS_pidfd_open, VIRTUAL_TO_REAL_PID(pid), flags);
+  DMTCP_PLUGIN_ENABLE_CKPT();
+  return ret;
+}
+
 /* Comments by Gene:
  * Here, syscall is the wrapper, and the call to syscall would be _real_syscall
  * We would add a special case for SYS_gettid, while all others default as below
@@ -415,6 +455,12 @@ syscall(long sys_num, ...)
     break;
   }
 #endif // if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 9))
+  case SYS_pidfd_open:
+  {
+    SYSCALL_GET_ARGS_2(pid_t, pid, unsigned int, flags);
+    ret = dmtcp_pidfd_open(pid, flags);
+    break;
+  }
   case SYS_wait4:
   {
     SYSCALL_GET_ARGS_4(pid_t, pid, __WAIT_STATUS, status, int, options,
@@ -537,6 +583,14 @@ syscall(long sys_num, ...)
   return ret;
 }
 
+#if __GLIBC_PREREQ(2, 36)
+extern "C" int
+pidfd_open(pid_t pid, unsigned int flags)
+{
+  return dmtcp_pidfd_open(pid, flags);
+}
+#endif // if __GLIBC_PREREQ(2, 36)
+
 #ifdef HAS_CMA
 EXTERNC
 ssize_t
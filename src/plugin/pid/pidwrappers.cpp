@@ -138,10 +138,19 @@ dmtcp_gettid()
    * cached before it is accessed by some other DMTCP code.
    */
   if (_dmtcp_thread_tid == -1) {
-    _dmtcp_thread_tid = getpid();
-
-    // Make sure this is the motherofall thread.
-    JASSERT(_real_gettid() == _real_getpid()) (_real_gettid()) (_real_getpid());
+    pid_t realTid = _real_gettid();
+    if (realTid == _real_getpid()) {
+      _dmtcp_thread_tid = getpid();  // The motherofall thread
+    } else {
+      // A thread that glibc 2.34 or later created with clone3(), not through
+      // our __clone() wrapper:  it gets its virtual tid now.  The table's
+      // lock (DmtcpMutex) asks for our tid meanwhile.
+      _dmtcp_thread_tid = realTid;
+      pid_t virtualTid = Util::nativePids()
+        ? realTid : VirtualPidTable::instance().getNewVirtualTid();
+      VirtualPidTable::instance().updateMapping(virtualTid, realTid);
+      _dmtcp_thread_tid = virtualTid;
+    }
   }
   return _dmtcp_thread_tid;
 }
@@ -161,7 +170,12 @@ getppid()
   if (_dmtcp_ppid == -1) {
     dmtcpResetPidPpid();
   }
-  if (_real_getppid() != VIRTUAL_TO_REAL_PID(_dmtcp_ppid)) {
+  // Compare with checkpoints disabled, or a restart in between would make
+  // the parent look dead.
+  DMTCP_PLUGIN_DISABLE_CKPT();
+  bool reparented = _real_getppid() != VIRTUAL_TO_REAL_PID(_dmtcp_ppid);
+  DMTCP_PLUGIN_ENABLE_CKPT();
+  if (reparented) {
     // The original parent died; reset our ppid.
     //
     // On older systems, a process is inherited by init (pid = 1) after its
@@ -306,6 +320,20 @@ setsid(void)
   return origPid;
 }
 
+// Translates with checkpoints disabled:  the translation takes the lock of
+// the pid table, and a thread suspended while holding it would deadlock the
+// checkpoint thread.  The checkpoint can still come right after; a caller
+// that gets ESRCH for the real pid should translate again, since a restart
+// gives it a new one.
+static pid_t
+lockedVirtualToRealPid(pid_t pid)
+{
+  DMTCP_PLUGIN_DISABLE_CKPT();
+  pid_t realPid = VIRTUAL_TO_REAL_PID(pid);
+  DMTCP_PLUGIN_ENABLE_CKPT();
+  return realPid;
+}
+
 extern "C" int
 kill(pid_t pid, int sig)
 {
@@ -363,16 +391,22 @@ kill(pid_t pid, int sig)
    * longjmp() was harmless in the sense that, it didn't cause a
    * callframe like the one mentioned above.
    *
+   * We do need the lock around the translation, though (see
+   * lockedVirtualToRealPid()).  A signal to ourselves is delivered only on
+   * return from _real_kill(), after the lock was released.
    */
 
-  // DMTCP_PLUGIN_DISABLE_CKPT();
-
-  pid_t currPid = VIRTUAL_TO_REAL_PID(pid);
-
-  int retVal = _real_kill(currPid, sig);
-
-  // DMTCP_PLUGIN_ENABLE_CKPT();
+  pid_t currPid = lockedVirtualToRealPid(pid);
+  int retVal;
 
+  while ((retVal = _real_kill(currPid, sig)) == -1 && errno == ESRCH) {
+    pid_t newPid = lockedVirtualToRealPid(pid);
+    if (newPid == currPid) {
+      errno = ESRCH;
+      break;
+    }
+    currPid = newPid;
+  }
   return retVal;
 }
 
@@ -380,15 +414,18 @@ LIB_PRIVATE
 int
 dmtcp_tkill(int tid, int sig)
 {
-  // FIXME: Check the comments in kill()
-  // DMTCP_PLUGIN_DISABLE_CKPT();
-
-  int realTid = VIRTUAL_TO_REAL_PID(tid);
-
-  int retVal = _real_tkill(realTid, sig);
-
-  // DMTCP_PLUGIN_ENABLE_CKPT();
-
+  // See the comments in kill().
+  int realTid = lockedVirtualToRealPid(tid);
+  int retVal;
+
+  while ((retVal = _real_tkill(realTid, sig)) == -1 && errno == ESRCH) {
+    int newTid = lockedVirtualToRealPid(tid);
+    if (newTid == realTid) {
+      errno = ESRCH;
+      break;
+    }
+    realTid = newTid;
+  }
   return retVal;
 }
 
@@ -396,16 +433,22 @@ LIB_PRIVATE
 int
 dmtcp_tgkill(int tgid, int tid, int sig)
 {
-  // FIXME: Check the comments in kill()
-  // DMTCP_PLUGIN_DISABLE_CKPT();
-
-  int realTgid = VIRTUAL_TO_REAL_PID(tgid);
-  int realTid = VIRTUAL_TO_REAL_PID(tid);
-
-  int retVal = _real_tgkill(realTgid, realTid, sig);
-
-  // DMTCP_PLUGIN_ENABLE_CKPT();
-
+  // See the comments in kill().
+  int realTgid = lockedVirtualToRealPid(tgid);
+  int realTid = lockedVirtualToRealPid(tid);
+  int retVal;
+
+  while ((retVal = _real_tgkill(realTgid, realTid, sig)) == -1 &&
+         errno == ESRCH) {
+    int newTgid = lockedVirtualToRealPid(tgid);
+    int newTid = lockedVirtualToRealPid(tid);
+    if (newTgid == realTgid && newTid == realTid) {
+      errno = ESRCH;
+      break;
+    }
+    realTgid = newTgid;
+    realTid = newTid;
+  }
   return retVal;
 }
 
@@ -453,14 +496,16 @@ waitid(idtype_t idtype, id_t id, siginfo_t *infop, int options)
    */
   while (retval == 0) {
     DMTCP_PLUGIN_DISABLE_CKPT();
-    pid_t currPid = VIRTUAL_TO_REAL_PID(id);
+    pid_t currPid = idtype == P_PIDFD ? id : VIRTUAL_TO_REAL_PID(id);
     retval = _real_waitid(idtype, currPid, &siginfop, options | WNOHANG);
 
     if (retval != -1) {
       pid_t virtualPid = REAL_TO_VIRTUAL_PID(siginfop.si_pid);
       siginfop.si_pid = virtualPid;
 
-      if (siginfop.si_code == CLD_EXITED || siginfop.si_code == CLD_KILLED) {
+      // With WNOWAIT, the child is still there to be waited for.
+      if (!(options & WNOWAIT) &&
+          (siginfop.si_code == CLD_EXITED || siginfop.si_code == CLD_KILLED)) {
         VirtualPidTable::instance().erase(virtualPid);
       }
     }
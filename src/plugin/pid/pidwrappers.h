@@ -88,6 +88,15 @@ struct user_desc {
 
 #include "dmtcp.h"
 
+// pidfds are new in Linux 5.3, and P_PIDFD in 5.4; glibc names them in 2.36.
+#include <sys/syscall.h>
+#ifndef SYS_pidfd_open
+# define SYS_pidfd_open 434
+#endif // ifndef SYS_pidfd_open
+#if !__GLIBC_PREREQ(2, 36)
+# define P_PIDFD ((idtype_t)3)
+#endif // if !__GLIBC_PREREQ(2, 36)
+
 // Keep in sync with dmtcp/src/constants.h
 #define ENV_VAR_VIRTUAL_PID "DMTCP_VIRTUAL_PID"
 
@@ -127,6 +127,11 @@ extern "C" int dmtcp_is_ptracing() __attribute__((weak));
 pid_t
 VirtualPidTable::realToVirtual(pid_t realPid)
 {
+  // After dmtcp_restart --native-pids, real and virtual pids are the same.
+  if (Util::nativePids()) {
+    return realPid;
+  }
+
   if (realIdExists(realPid)) {
     return VirtualIdTable<pid_t>::realToVirtual(realPid);
   }
@@ -150,7 +155,7 @@ VirtualPidTable::realToVirtual(pid_t realPid)
 pid_t
 VirtualPidTable::virtualToReal(pid_t virtualId)
 {
-  if (virtualId == -1) {
+  if (virtualId == -1 || Util::nativePids()) {
     return virtualId;
   }
   pid_t id = (virtualId < -1 ? abs(virtualId) : virtualId);
@@ -24,6 +24,7 @@
 #include "config.h"
 #include "dmtcp.h"
 #include "timerwrappers.h"
+#include "virtualtime.h"
 
 using namespace dmtcp;
 
@@ -54,9 +55,39 @@ postRestart()
   TimerList::instance().postRestart();
 }
 
+static void
+resume()
+{
+  TimerList::instance().resume();
+}
+
 static void
 timer_event_hook(DmtcpEvent_t event, DmtcpEventData_t *data)
 {
+  // Virtual time must be frozen and resumed before the timers are saved and
+  // restored.
+  switch (event) {
+  case DMTCP_EVENT_PRE_EXEC:
+    VirtualTime::preExec(data);
+    break;
+
+  case DMTCP_EVENT_POST_EXEC:
+    VirtualTime::postExec(data);
+    break;
+
+  case DMTCP_EVENT_PRECHECKPOINT:
+    VirtualTime::preCheckpoint();
+    break;
+
+  case DMTCP_EVENT_RESUME:
+  case DMTCP_EVENT_RESTART:
+    VirtualTime::resume();
+    break;
+
+  default:
+    break;
+  }
+
   if (_timerlist != NULL) {
     switch (event) {
     case DMTCP_EVENT_ATFORK_CHILD:
@@ -71,6 +102,7 @@ timer_event_hook(DmtcpEvent_t event, DmtcpEventData_t *data)
     break;
 
   case DMTCP_EVENT_RESUME:
+    resume();
     break;
 
   case DMTCP_EVENT_RESTART:
@@ -170,6 +202,32 @@ TimerList::preCheckpoint()
     JASSERT(_real_timer_gettime(realId, &tinfo.curr_timerspec) == 0)
       (virtId) (realId) (JASSERT_ERRNO);
     tinfo.overrun = _real_timer_getoverrun(realId);
+
+    // With virtual time, the timers of the virtual clocks stop while we are
+    // checkpointed (see resume()).
+    if (VirtualTime::isVirtualClock(tinfo.clockid)) {
+      struct itimerspec disarm;
+      memset(&disarm, 0, sizeof(disarm));
+      JASSERT(_real_timer_settime(realId, 0, &disarm, NULL) == 0)
+        (virtId) (realId) (JASSERT_ERRNO);
+    }
+  }
+}
+
+void
+TimerList::resume()
+{
+  for (_iter = _timerInfo.begin(); _iter != _timerInfo.end(); _iter++) {
+    timer_t virtId = _iter->first;
+    timer_t realId = VIRTUAL_TO_REAL_TIMER_ID(virtId);
+    TimerInfo &tinfo = _iter->second;
+    if (VirtualTime::isVirtualClock(tinfo.clockid) &&
+        (tinfo.curr_timerspec.it_value.tv_sec != 0 ||
+         tinfo.curr_timerspec.it_value.tv_nsec != 0)) {
+      JASSERT(_real_timer_settime(realId, 0, &tinfo.curr_timerspec, NULL) == 0)
+        (virtId) (realId) (JASSERT_ERRNO);
+      JTRACE("Resuming timer") (realId) (virtId);
+    }
   }
 }
 
@@ -212,7 +270,12 @@ TimerList::postRestart()
     if (tinfo.curr_timerspec.it_value.tv_sec != 0 ||
         tinfo.curr_timerspec.it_value.tv_nsec != 0) {
       struct itimerspec tspec;
-      if (tinfo.flags & TIMER_ABSTIME) {
+      int flags = tinfo.flags;
+      if (VirtualTime::isVirtualClock(tinfo.clockid)) {
+        // The time left on a virtual clock is the same as at checkpoint.
+        tspec = tinfo.curr_timerspec;
+        flags = 0;
+      } else if (tinfo.flags & TIMER_ABSTIME) {
         // The timer should expire when the clock time equals the time
         // specified in initial_timerspec.
         // FIXME: For clocks measugin CPU time for processes and threads, such
@@ -223,7 +286,7 @@ TimerList::postRestart()
       } else {
         tspec = tinfo.curr_timerspec;
       }
-      JASSERT(_real_timer_settime(realId, tinfo.flags, &tspec, NULL) == 0)
+      JASSERT(_real_timer_settime(realId, flags, &tspec, NULL) == 0)
         (virtId) (JASSERT_ERRNO);
       JTRACE("Restoring timer") (realId) (virtId);
     }
@@ -241,6 +304,19 @@ TimerList::getoverrun(timer_t id)
   return ret;
 }
 
+clockid_t
+TimerList::clockId(timer_t id)
+{
+  clockid_t clockid = -1;
+
+  _do_lock_tbl();
+  if (_timerInfo.find(id) != _timerInfo.end()) {
+    clockid = _timerInfo[id].clockid;
+  }
+  _do_unlock_tbl();
+  return clockid;
+}
+
 timer_t
 TimerList::on_timer_create(timer_t realId,
                            clockid_t clockid,
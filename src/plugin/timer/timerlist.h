@@ -78,6 +78,7 @@ class TimerList
 
     void resetOnFork();
     void preCheckpoint();
+    void resume();
     void postRestart();
 
     timer_t virtualToRealTimerId(timer_t virtId)
@@ -104,6 +105,7 @@ class TimerList
     // }
 
     int getoverrun(timer_t id);
+    clockid_t clockId(timer_t id);  // -1 if there's no such timer
     timer_t on_timer_create(timer_t realId,
                             clockid_t clockid,
                             struct sigevent *sevp);
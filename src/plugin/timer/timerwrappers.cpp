@@ -19,8 +19,14 @@
  *  <http://www.gnu.org/licenses/>.                                         *
  ****************************************************************************/
 
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "timerwrappers.h"
 #include "timerlist.h"
+#include "util.h"
+#include "virtualtime.h"
 
 using namespace dmtcp;
 
@@ -76,7 +82,20 @@ timer_settime(timer_t timerid,
 {
   DMTCP_PLUGIN_DISABLE_CKPT();
   timer_t realId = VIRTUAL_TO_REAL_TIMER_ID(timerid);
-  int ret = _real_timer_settime(realId, flags, new_value, old_value);
+
+  // An absolute expiration time of a virtual clock is virtual, too.
+  const struct itimerspec *value = new_value;
+  struct itimerspec realValue;
+  if ((flags & TIMER_ABSTIME) && new_value != NULL &&
+      (new_value->it_value.tv_sec != 0 || new_value->it_value.tv_nsec != 0)) {
+    clockid_t clockid = TimerList::instance().clockId(timerid);
+    if (VirtualTime::isVirtualClock(clockid)) {
+      realValue = *new_value;
+      realValue.it_value = VirtualTime::toReal(clockid, new_value->it_value);
+      value = &realValue;
+    }
+  }
+  int ret = _real_timer_settime(realId, flags, value, old_value);
   if (ret != -1) {
     TimerList::instance().on_timer_settime(timerid, flags, new_value);
   }
@@ -84,6 +103,63 @@ timer_settime(timer_t timerid,
   return ret;
 }
 
+#ifdef HAVE_SYS_TIMERFD_H
+
+// The clock of a timerfd, from /proc/self/fdinfo; -1 if unknown.
+static clockid_t
+timerfdClockId(int fd)
+{
+  char path[64];
+  char buf[512];
+
+  snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+  int infd = _real_open(path, O_RDONLY, 0);
+  if (infd == -1) {
+    return -1;
+  }
+  ssize_t len = Util::readAll(infd, buf, sizeof(buf) - 1);
+  _real_close(infd);
+  if (len <= 0) {
+    return -1;
+  }
+  buf[len] = '\0';
+
+  const char *clk = strstr(buf, "\nclockid:");
+  return clk != NULL ? strtol(clk + strlen("\nclockid:"), NULL, 10) : -1;
+}
+
+// As for timer_settime(), an absolute expiration time of a virtual clock is
+// virtual.  Only then do we look up the clock of the timerfd; event loops
+// that rearm timerfds with relative times pay nothing.  timerfd_gettime()
+// returns relative times, which need no translation.
+extern "C" int
+timerfd_settime(int fd,
+                int flags,
+                const struct itimerspec *new_value,
+                struct itimerspec *old_value)
+{
+  if (!(flags & TFD_TIMER_ABSTIME) || new_value == NULL ||
+      !VirtualTime::enabled()) {
+    return _real_timerfd_settime(fd, flags, new_value, old_value);
+  }
+
+  DMTCP_PLUGIN_DISABLE_CKPT();
+  const struct itimerspec *value = new_value;
+  struct itimerspec realValue;
+  if (new_value->it_value.tv_sec != 0 || new_value->it_value.tv_nsec != 0) {
+    clockid_t clockid = timerfdClockId(fd);
+    if (VirtualTime::isVirtualClock(clockid)) {
+      realValue = *new_value;
+      realValue.it_value = VirtualTime::toReal(clockid, new_value->it_value);
+      value = &realValue;
+    }
+  }
+  int ret = _real_timerfd_settime(fd, flags, value, old_value);
+  DMTCP_PLUGIN_ENABLE_CKPT();
+  return ret;
+}
+#endif // ifdef HAVE_SYS_TIMERFD_H
+
 extern "C" int
 timer_gettime(timer_t timerid, struct itimerspec *curr_value)
 {
@@ -149,6 +225,12 @@ clock_getres(clockid_t clk_id, struct timespec *res)
 extern "C" int
 clock_gettime(clockid_t clk_id, struct timespec *tp)
 {
+  // The system clocks have no virtual ids, and need no checkpoint lock:
+  // keep the common case close to the vDSO call.
+  if (VirtualTime::isSystemClock(clk_id)) {
+    return VirtualTime::clockGettime(clk_id, tp);
+  }
+
   DMTCP_PLUGIN_DISABLE_CKPT();
 
   // See comment on VIRTUAL_TO_REAL_CLOCK_ID() in timer_create()
@@ -170,22 +252,33 @@ clock_settime(clockid_t clk_id, const struct timespec *tp)
   return ret;
 }
 
-// FIXME: The following wrapper disables ckpt for the entire duration of
-// clock_nanosleep. This is dangerous and can lead to a situation where
-// checkpointing never happens. Disabling the wrapper for now.
-#ifdef ENABLE_CLOCK_NANOSLEEP
+// Unlike the wrappers above, these don't disable checkpointing:  the sleep
+// may be long, and must not hold off a checkpoint.  With virtual time, the
+// time spent checkpointed doesn't count toward the sleep.
 extern "C" int
 clock_nanosleep(clockid_t clock_id,
                 int flags,
                 const struct timespec *request,
                 struct timespec *remain)
 {
-  DMTCP_PLUGIN_DISABLE_CKPT();
+  if (!VirtualTime::isVirtualClock(clock_id)) {
+    return _real_clock_nanosleep(clock_id, flags, request, remain);
+  }
+  return VirtualTime::clockNanosleep(clock_id, flags, request, remain);
+}
 
-  // See comment on VIRTUAL_TO_REAL_CLOCK_ID() in timer_create()
-  clockid_t realId = VIRTUAL_TO_REAL_CLOCK_ID(clock_id);
-  int ret = _real_clock_nanosleep(realId, flags, request, remain);
-  DMTCP_PLUGIN_ENABLE_CKPT();
-  return ret;
+extern "C" int
+nanosleep(const struct timespec *req, struct timespec *rem)
+{
+  if (!VirtualTime::isVirtualClock(CLOCK_MONOTONIC)) {
+    return _real_nanosleep(req, rem);
+  }
+
+  // Linux measures nanosleep() against CLOCK_MONOTONIC.
+  int ret = VirtualTime::clockNanosleep(CLOCK_MONOTONIC, 0, req, rem);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+  return 0;
 }
-#endif // ifdef ENABLE_CLOCK_NANOSLEEP
@@ -25,7 +25,11 @@
 
 #include <signal.h>
 #include <time.h>
+#include "config.h"
 #include "dmtcp.h"
+#ifdef HAVE_SYS_TIMERFD_H
+# include <sys/timerfd.h>
+#endif // ifdef HAVE_SYS_TIMERFD_H
 
 # define _real_timer_create           NEXT_FNC(timer_create)
 # define _real_timer_delete           NEXT_FNC(timer_delete)
@@ -38,6 +42,12 @@
 # define _real_clock_getres          NEXT_FNC(clock_getres)
 # define _real_clock_gettime         NEXT_FNC(clock_gettime)
 # define _real_clock_settime         NEXT_FNC(clock_settime)
+# define _real_clock_nanosleep       NEXT_FNC(clock_nanosleep)
+# define _real_nanosleep             NEXT_FNC(nanosleep)
+
+# define _real_timerfd_settime       NEXT_FNC(timerfd_settime)
+# define _real_open                  NEXT_FNC(open)
+# define _real_close                 NEXT_FNC(close)
 
 int timer_create_sigev_thread(clockid_t clock_id,
                               struct sigevent *evp,
@@ -0,0 +1,221 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jassert.h"
+#include "jserialize.h"
+#include "timerwrappers.h"
+#include "virtualtime.h"
+
+#ifndef CLOCK_BOOTTIME_ALARM
+# define CLOCK_BOOTTIME_ALARM 9
+#endif // ifndef CLOCK_BOOTTIME_ALARM
+
+#define NUM_CLOCKS            16
+#define NSEC_PER_SEC          1000000000LL
+
+using namespace dmtcp;
+
+static const clockid_t virtualClocks[] = {
+  CLOCK_MONOTONIC, CLOCK_MONOTONIC_RAW, CLOCK_MONOTONIC_COARSE,
+  CLOCK_BOOTTIME, CLOCK_BOOTTIME_ALARM
+};
+#define NUM_VIRTUAL_CLOCKS (sizeof(virtualClocks) / sizeof(virtualClocks[0]))
+
+static int enabledState = -1;
+static bool isVirtual[NUM_CLOCKS];
+
+// Real time - virtual time, in ns, of each clock.
+static int64_t offset[NUM_CLOCKS];
+
+// Virtual time of each clock at the last checkpoint.
+static int64_t timeAtCkpt[NUM_CLOCKS];
+
+// Incremented after each change of the offsets.
+static volatile uint32_t generation = 0;
+
+static inline int64_t
+toNs(const struct timespec &ts)
+{
+  return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static inline struct timespec
+toTimespec(int64_t ns)
+{
+  struct timespec ts;
+
+  ts.tv_sec = ns / NSEC_PER_SEC;
+  ts.tv_nsec = ns % NSEC_PER_SEC;
+  if (ts.tv_nsec < 0) {
+    ts.tv_sec--;
+    ts.tv_nsec += NSEC_PER_SEC;
+  }
+  return ts;
+}
+
+static inline uint32_t
+loadGeneration()
+{
+  return __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+}
+
+bool
+VirtualTime::enabled()
+{
+  if (enabledState == -1) {
+    const char *env = getenv(ENV_VAR_VIRTUAL_TIME);
+    enabledState = env != NULL && strcmp(env, "0") != 0;
+    for (size_t i = 0; i < NUM_VIRTUAL_CLOCKS; i++) {
+      isVirtual[virtualClocks[i]] = enabledState;
+    }
+  }
+  return enabledState == 1;
+}
+
+bool
+VirtualTime::isVirtualClock(clockid_t clk)
+{
+  return isSystemClock(clk) && enabled() && isVirtual[clk];
+}
+
+int
+VirtualTime::clockGettime(clockid_t clk, struct timespec *tp)
+{
+  if (!isVirtualClock(clk)) {
+    return _real_clock_gettime(clk, tp);
+  }
+
+  while (true) {
+    uint32_t gen = loadGeneration();
+    int ret = _real_clock_gettime(clk, tp);
+    if (ret != 0) {
+      return ret;
+    }
+    int64_t off = offset[clk];
+    if (loadGeneration() == gen) {
+      *tp = toTimespec(toNs(*tp) - off);
+      return 0;
+    }
+  }
+}
+
+struct timespec
+VirtualTime::toReal(clockid_t clk, const struct timespec &ts)
+{
+  return toTimespec(toNs(ts) + offset[clk]);
+}
+
+int
+VirtualTime::clockNanosleep(clockid_t clk,
+                            int flags,
+                            const struct timespec *request,
+                            struct timespec *remain)
+{
+  struct timespec now;
+
+  if (request->tv_nsec < 0 || request->tv_nsec >= NSEC_PER_SEC) {
+    return EINVAL;
+  }
+
+  // Sleep until an absolute (virtual) deadline.  If a checkpoint happened
+  // meanwhile, the real deadline passed too early; sleep again.
+  int64_t deadline = toNs(*request);
+  if (!(flags & TIMER_ABSTIME)) {
+    JASSERT(clockGettime(clk, &now) == 0) (clk) (JASSERT_ERRNO);
+    deadline += toNs(now);
+  }
+
+  while (true) {
+    uint32_t gen = loadGeneration();
+    struct timespec realDeadline = toTimespec(deadline + offset[clk]);
+    int ret = _real_clock_nanosleep(clk, TIMER_ABSTIME, &realDeadline, NULL);
+    if (loadGeneration() != gen) {
+      continue;
+    }
+    if (ret == EINTR && !(flags & TIMER_ABSTIME) && remain != NULL) {
+      JASSERT(clockGettime(clk, &now) == 0) (clk) (JASSERT_ERRNO);
+      *remain = toTimespec(deadline > toNs(now) ? deadline - toNs(now) : 0);
+    }
+    return ret;
+  }
+}
+
+void
+VirtualTime::preCheckpoint()
+{
+  if (!enabled()) {
+    return;
+  }
+
+  for (size_t i = 0; i < NUM_VIRTUAL_CLOCKS; i++) {
+    clockid_t clk = virtualClocks[i];
+    struct timespec ts;
+    if (_real_clock_gettime(clk, &ts) == 0) {
+      timeAtCkpt[clk] = toNs(ts) - offset[clk];
+    }
+  }
+}
+
+void
+VirtualTime::resume()
+{
+  if (!enabled()) {
+    return;
+  }
+
+  // On restart, the real clocks may have been reset (reboot, other host);
+  // the offsets may come out negative.
+  for (size_t i = 0; i < NUM_VIRTUAL_CLOCKS; i++) {
+    clockid_t clk = virtualClocks[i];
+    struct timespec ts;
+    if (_real_clock_gettime(clk, &ts) == 0) {
+      offset[clk] = toNs(ts) - timeAtCkpt[clk];
+    }
+  }
+  __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+  JTRACE("Virtual time resumed") (offset[CLOCK_MONOTONIC]);
+}
+
+void
+VirtualTime::preExec(DmtcpEventData_t *data)
+{
+  if (!enabled()) {
+    return;
+  }
+
+  jalib::JBinarySerializeWriterRaw wr("", data->preExec.serializationFd);
+  for (size_t i = 0; i < NUM_VIRTUAL_CLOCKS; i++) {
+    wr.serialize(offset[virtualClocks[i]]);
+  }
+}
+
+void
+VirtualTime::postExec(DmtcpEventData_t *data)
+{
+  if (!enabled()) {
+    return;
+  }
+
+  jalib::JBinarySerializeReaderRaw rd("", data->postExec.serializationFd);
+  for (size_t i = 0; i < NUM_VIRTUAL_CLOCKS; i++) {
+    rd.serialize(offset[virtualClocks[i]]);
+  }
+}
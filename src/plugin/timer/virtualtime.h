@@ -0,0 +1,77 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+#pragma once
+#ifndef VIRTUAL_TIME_H
+#define VIRTUAL_TIME_H
+
+#include <time.h>
+#include "dmtcp.h"
+
+// Keep in sync with dmtcp/src/constants.h
+#define ENV_VAR_VIRTUAL_TIME "DMTCP_VIRTUAL_TIME"
+
+/* Virtual time (dmtcp_launch --virtual-time).
+ *
+ * The monotonic clocks (CLOCK_MONOTONIC, CLOCK_MONOTONIC_RAW,
+ * CLOCK_MONOTONIC_COARSE, CLOCK_BOOTTIME and CLOCK_BOOTTIME_ALARM) stop while
+ * the process is checkpointed, and go on from where they stopped after
+ * resume or restart:  virtual time = real time - offset, and the offset of
+ * each clock grows by the time the process spent suspended.  CLOCK_REALTIME
+ * and the CPU-time clocks are left alone.
+ *
+ * The offsets change only while the user threads are suspended.  Readers
+ * don't take the checkpoint lock; they retry if a checkpoint happened between
+ * reading the real clock and its offset (see 'generation').
+ */
+
+namespace dmtcp
+{
+namespace VirtualTime
+{
+bool enabled();
+
+// True if virtual time is enabled and clk is one of the clocks above.
+bool isVirtualClock(clockid_t clk);
+
+// The clocks without a virtual id of the timer plugin.
+static inline bool
+isSystemClock(clockid_t clk)
+{
+  return clk >= 0 && clk < 16;
+}
+
+int clockGettime(clockid_t clk, struct timespec *tp);
+
+// Converts an absolute time of virtual clock clk to real time.  The caller
+// must keep checkpoints out (DMTCP_PLUGIN_DISABLE_CKPT).
+struct timespec toReal(clockid_t clk, const struct timespec &ts);
+
+// Like clock_nanosleep(2), for a virtual clock:  the time spent checkpointed
+// doesn't count.
+int clockNanosleep(clockid_t clk,
+                   int flags,
+                   const struct timespec *request,
+                   struct timespec *remain);
+
+void preCheckpoint();
+void resume();
+void preExec(DmtcpEventData_t *data);
+void postExec(DmtcpEventData_t *data);
+}
+}
+#endif // ifndef VIRTUAL_TIME_H
@@ -22,6 +22,7 @@
 #include "processinfo.h"
 #include <fcntl.h>
 #include <fenv.h>
+#include <poll.h>
 #include <sys/resource.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
@@ -34,6 +35,10 @@
 #include "uniquepid.h"
 #include "util.h"
 
+#ifndef SYS_pidfd_open
+# define SYS_pidfd_open 434
+#endif // ifndef SYS_pidfd_open
+
 namespace dmtcp
 {
 static DmtcpMutex tblLock = DMTCP_MUTEX_INITIALIZER;
@@ -209,6 +214,9 @@ ProcessInfo::growStack()
     } else if (strcmp(area.name, "[vvar]") == 0) {
       _vvarStart = (unsigned long)area.addr;
       _vvarEnd = (unsigned long)area.endAddr;
+    } else if (strcmp(area.name, "[vvar_vclock]") == 0) {
+      // Linux 6.13 and later split off the clock pages that follow [vvar].
+      _vvarEnd = (unsigned long)area.endAddr;
     } else if ((VA)&area >= area.addr && (VA)&area < area.endAddr) {
       JTRACE("Original stack area") ((void *)area.addr) (area.size);
       stackArea = area;
@@ -429,6 +437,28 @@ unmapRestoreArgv()
 }
 #endif // ifdef RESTORE_ARGV_AFTER_RESTART
 
+// With DMTCP_CKPT_SHARDS=N (N > 1), the checkpoint images and their _files
+// subdirectories are spread over N subdirectories of the checkpoint dir,
+// ckpt_shard_000 ... ckpt_shard_<N-1>.  This keeps the create/rename/readdir
+// load of a very large computation off a single directory.
+string
+ProcessInfo::ckptShardSubdir()
+{
+  const char *shards = getenv(ENV_VAR_CKPT_SHARDS);
+  uint32_t numShards = shards ? strtoul(shards, NULL, 10) : 0;
+
+  if (numShards <= 1) {
+    return "";
+  }
+
+  UniquePid upid = UniquePid::ThisProcess();
+  uint64_t hash = upid.hostid() * 2654435761ULL + upid.pid();
+  char buf[64];
+  snprintf(buf, sizeof(buf), "/" CKPT_SHARD_PREFIX "%03u",
+           (uint32_t)(hash % numShards));
+  return buf;
+}
+
 void
 ProcessInfo::updateCkptDirFileSubdir(string newCkptDir)
 {
@@ -445,7 +475,7 @@ ProcessInfo::updateCkptDirFileSubdir(string newCkptDir)
   }
 
   ostringstream o;
-  o << _ckptDir << "/"
+  o << _ckptDir << ckptShardSubdir() << "/"
     << CKPT_FILE_PREFIX
     << jalib::Filesystem::GetProgramName()
     << '_' << UniquePid::ThisProcess();
@@ -472,6 +502,7 @@ ProcessInfo::resetOnFork()
   _pid = getpid();
   _isRootOfProcessTree = false;
   _childTable.clear();
+  _untrackedHelpers.clear();
   _pthreadJoinId.clear();
   _ckptFileName.clear();
   _ckptFilesSubDir.clear();
@@ -584,6 +615,14 @@ ProcessInfo::insertChild(pid_t pid, UniquePid uniquePid)
   JTRACE("Creating new virtualPid -> realPid mapping.") (pid) (uniquePid);
 }
 
+void
+ProcessInfo::insertUntrackedHelper(pid_t pid)
+{
+  _do_lock_tbl();
+  _untrackedHelpers.insert(pid);
+  _do_unlock_tbl();
+}
+
 void
 ProcessInfo::eraseChild(pid_t virtualPid)
 {
@@ -672,8 +711,9 @@ ProcessInfo::setCkptDir(const char *dir)
 {
   JASSERT(dir != NULL);
   _ckptDir = dir;
-  _ckptFileName = _ckptDir + "/" + jalib::Filesystem::BaseName(_ckptFileName);
-  _ckptFilesSubDir = _ckptDir + "/" + jalib::Filesystem::BaseName(
+  string shardDir = _ckptDir + ckptShardSubdir();
+  _ckptFileName = shardDir + "/" + jalib::Filesystem::BaseName(_ckptFileName);
+  _ckptFilesSubDir = shardDir + "/" + jalib::Filesystem::BaseName(
       _ckptFilesSubDir);
 
   JTRACE("setting ckptdir") (_ckptDir) (_ckptFilesSubDir);
@@ -746,6 +786,102 @@ ProcessInfo::refreshChildTable()
   }
 }
 
+// A child is an untracked helper if it exec'ed an executable matching
+// DMTCP_UNTRACKED_HELPERS and thus no longer holds a coordinator connection.
+// Zombies have no /proc/PID/exe and are not counted.
+static bool
+isUntrackedHelper(pid_t pid)
+{
+  string procPid = "/proc/" + jalib::XToString(pid);
+  string exe = jalib::Filesystem::ResolveSymlink(procPid + "/exe");
+  if (exe.empty() || !Util::isUntrackedHelper(exe.c_str())) {
+    return false;
+  }
+
+  struct stat statBuf;
+  string coordFd = procPid + "/fd/" + jalib::XToString(PROTECTED_COORD_FD);
+  return lstat(coordFd.c_str(), &statBuf) == -1;
+}
+
+// Defer the checkpoint until all untracked helpers forked or spawned by this
+// process have exited, or until DMTCP_UNTRACKED_HELPERS_TIMEOUT seconds have
+// passed.  Helpers are never captured in the checkpoint image; the ones still
+// running after the timeout are simply absent on restart.  We sleep on pidfds
+// of the helpers until one of them exits; without pidfd_open(), we poll.
+void
+ProcessInfo::waitForUntrackedHelpers()
+{
+  if (!Util::untrackedHelpersEnabled()) {
+    return;
+  }
+
+  uint32_t timeout = Util::untrackedHelperTimeout();
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (true) {
+    vector<pid_t> helpers;
+    _do_lock_tbl();
+    for (iterator i = _childTable.begin(); i != _childTable.end(); i++) {
+      // /proc and pidfd_open() know only the real pid of a forked child.
+      pid_t pid = i->first;
+      if (dmtcp_virtual_to_real_pid != NULL) {
+        pid = dmtcp_virtual_to_real_pid(pid);
+      }
+      if (isUntrackedHelper(pid)) {
+        helpers.push_back(pid);
+      }
+    }
+    set<pid_t>::iterator h = _untrackedHelpers.begin();
+    while (h != _untrackedHelpers.end()) {
+      set<pid_t>::iterator j = h++;
+      if (isUntrackedHelper(*j)) {
+        helpers.push_back(*j);
+      } else {
+        _untrackedHelpers.erase(j);
+      }
+    }
+    _do_unlock_tbl();
+
+    if (helpers.empty()) {
+      return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t remainingMs = (int64_t)timeout * 1000 -
+                          ((now.tv_sec - start.tv_sec) * 1000 +
+                           (now.tv_nsec - start.tv_nsec) / 1000000);
+    if (remainingMs <= 0) {
+      JWARNING(false) (helpers.size()) (timeout)
+        .Text("Untracked helpers still running; checkpointing without them.");
+      return;
+    }
+
+    JTRACE("Deferring checkpoint for untracked helpers") (helpers.size());
+    vector<struct pollfd> pidfds;
+    for (size_t i = 0; i < helpers.size(); i++) {
+      struct pollfd pfd;
+      pfd.fd = _real_syscall(SYS_pidfd_open, helpers[i], 0);
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if (pfd.fd != -1) {
+        pidfds.push_back(pfd);
+      }
+    }
+
+    if (pidfds.size() == helpers.size()) {
+      poll(&pidfds[0], pidfds.size(), remainingMs);
+    } else {
+      struct timespec delay = { 0, 10 * 1000 * 1000 };
+      nanosleep(&delay, NULL);
+    }
+    for (size_t i = 0; i < pidfds.size(); i++) {
+      _real_close(pidfds[i].fd);
+    }
+  }
+}
+
 bool
 ProcessInfo::vdsoOffsetMismatch(uint64_t f1, uint64_t f2,
                                 uint64_t f3, uint64_t f4)
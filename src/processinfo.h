@@ -60,6 +60,7 @@ class ProcessInfo
     void growStack();
 
     void insertChild(pid_t virtualPid, UniquePid uniquePid);
+    void insertUntrackedHelper(pid_t pid);
     void eraseChild(pid_t virtualPid);
 
     bool beginPthreadJoin(pthread_t thread);
@@ -68,6 +69,7 @@ class ProcessInfo
 
     void getState();
     void refreshChildTable();
+    void waitForUntrackedHelpers();
     void setRootOfProcessTree() { _isRootOfProcessTree = true; }
 
     bool isRootOfProcessTree() const { return _isRootOfProcessTree; }
@@ -161,7 +163,13 @@ class ProcessInfo
     void updateCkptDirFileSubdir(string newCkptDir = "");
 
   private:
+    string ckptShardSubdir();
+
     map<pid_t, UniquePid>_childTable;
+
+    // Real pids of the helpers spawned natively by posix_spawn(); they have
+    // neither a UniquePid nor a virtual pid.
+    set<pid_t>_untrackedHelpers;
     map<pthread_t, pthread_t>_pthreadJoinId;
     map<pid_t, pid_t>_sessionIds;
     typedef map<pid_t, UniquePid>::iterator iterator;
@@ -207,8 +207,9 @@ ProcSelfMaps::getNextArea(ProcMapsArea *area)
   }
 
   area->name[0] = '\0';
-  if (data[dataIdx] == '/' || data[dataIdx] == '[' || data[dataIdx] == '(') {
-    // absolute pathname, or [stack], [vdso], etc.
+  if (data[dataIdx] == '/' || data[dataIdx] == '[' || data[dataIdx] == '(' ||
+      data[dataIdx] == 'a') {
+    // absolute pathname, or [stack], [vdso], anon_inode:[io_uring], etc.
     // On some machines, deleted files have a " (deleted)" prefix to the
     // filename.
     size_t i = 0;
@@ -611,5 +611,82 @@ writeScript(const string &ckptDir,
   }
   return uniqueFilename;
 }
+
+static void
+writeManifestEntries(FILE *fp, const map<string, vector<string> > &filenames)
+{
+  map<string, vector<string> >::const_iterator host;
+  vector<string>::const_iterator file;
+  for (host = filenames.begin(); host != filenames.end(); ++host) {
+    for (file = host->second.begin(); file != host->second.end(); ++file) {
+      fprintf(fp, "%s %s\n", host->first.c_str(), file->c_str());
+    }
+  }
+}
+
+// The manifest lists every checkpoint image of the computation, one
+// "<hostname> <ckpt-image>" per line.  'dmtcp_restart --manifest' reads it so
+// that restart doesn't have to list the (possibly sharded) ckpt directory.
+// For a subset checkpoint, the processes left out are listed in comments.
+string
+writeManifest(const string &ckptDir,
+              bool uniqueCkptFilenames,
+              const UniquePid &compId,
+              const map<string, vector<string> > &restartFilenames,
+              const map<string, vector<string> >& rshCmdFileNames,
+              const map<string, vector<string> >& sshCmdFileNames,
+              const vector<string> &excludedProcesses)
+{
+  ostringstream o;
+  o << string(ckptDir) << "/"
+    << RESTART_MANIFEST_BASENAME << "_" << compId;
+  if (uniqueCkptFilenames) {
+    o << "_" << std::setw(5) << std::setfill('0') <<
+        compId.computationGeneration();
+  }
+  o << "." << RESTART_MANIFEST_EXT;
+  string uniqueFilename = o.str();
+  string tempFilename = uniqueFilename + ".temp";
+
+  JTRACE("writing restart manifest") (uniqueFilename);
+
+  FILE *fp = fopen(tempFilename.c_str(), "w");
+  JASSERT(fp != 0)(JASSERT_ERRNO)(tempFilename)
+  .Text("failed to open file");
+
+  fprintf(fp, "# DMTCP restart manifest for computation %s\n"
+              "# <hostname> <checkpoint image>\n",
+          compId.toString().c_str());
+  if (!excludedProcesses.empty()) {
+    fprintf(fp, "# Subset checkpoint: these processes were not checkpointed,\n"
+                "# and connections to them restart as dead sockets:\n"
+                "# <hostname> <program> <unique pid>\n");
+    for (size_t i = 0; i < excludedProcesses.size(); i++) {
+      fprintf(fp, "#   %s\n", excludedProcesses[i].c_str());
+    }
+  }
+  writeManifestEntries(fp, restartFilenames);
+  writeManifestEntries(fp, rshCmdFileNames);
+  writeManifestEntries(fp, sshCmdFileNames);
+  JASSERT(fclose(fp) == 0) (JASSERT_ERRNO) (tempFilename);
+
+  // Readers never see a partially written manifest.
+  JASSERT(rename(tempFilename.c_str(), uniqueFilename.c_str()) == 0)
+    (tempFilename) (uniqueFilename) (JASSERT_ERRNO);
+
+  {
+    string filename = RESTART_MANIFEST_BASENAME "." RESTART_MANIFEST_EXT;
+    string dirname = jalib::Filesystem::DirName(uniqueFilename);
+    int dirfd = open(dirname.c_str(), O_DIRECTORY | O_RDONLY);
+    JASSERT(dirfd != -1) (dirname) (JASSERT_ERRNO);
+
+    // dmtcp_restart_manifest.txt -> dmtcp_restart_manifest_<curCompId>.txt
+    unlinkat(dirfd, filename.c_str(), 0);
+    JWARNING(symlinkat(basename(uniqueFilename.c_str()), dirfd,
+                       filename.c_str()) == 0) (JASSERT_ERRNO);
+    JASSERT(close(dirfd) == 0);
+  }
+  return uniqueFilename;
+}
 } // namespace dmtcp {
 } // namespace RestartScript {
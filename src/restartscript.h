@@ -40,6 +40,13 @@ string writeScript(const string &ckptDir,
                    const map<string, vector<string> > &restartFilenames,
                    const map<string, vector<string> >& rshFilenames,
                    const map<string, vector<string> >& sshFilenames);
+string writeManifest(const string &ckptDir,
+                     bool uniqueCkptFilenames,
+                     const UniquePid &compId,
+                     const map<string, vector<string> > &restartFilenames,
+                     const map<string, vector<string> >& rshFilenames,
+                     const map<string, vector<string> >& sshFilenames,
+                     const vector<string> &excludedProcesses);
 } // namespace dmtcp {
 } // namespace RestartScript {
 #endif // #ifndef __RESTART_SCRIPT_H__
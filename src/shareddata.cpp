@@ -245,6 +245,8 @@ SharedData::prepareForCkpt()
 {
   nextVirtualPtyId = sharedDataHeader->nextVirtualPtyId;
   sharedDataHeader->numInodeConnIdMaps = 0;
+  sharedDataHeader->numSharedAreaMaps = 0;
+  sharedDataHeader->numMemfdMaps = 0;
   sharedDataHeader->numIncomingConMaps = 0;
 
   initializeBarrier();
@@ -419,6 +421,15 @@ SharedData::getCoordTimeStamp()
   return sharedDataHeader->coordInfo.timeStamp;
 }
 
+uint32_t
+SharedData::getCoordReconnectTimeout()
+{
+  if (sharedDataHeader == NULL) {
+    initialize();
+  }
+  return sharedDataHeader->coordInfo.reconnectTimeout;
+}
+
 void
 SharedData::getCoordAddr(struct sockaddr *addr, uint32_t *len)
 {
@@ -823,3 +834,116 @@ SharedData::getCkptLeaderForFile(dev_t devnum, ino_t inode, void *id)
   }
   return false;
 }
+
+// Returns the first claimed range of (devnum, inode) that contains
+// [offset, offset + size).
+static SharedData::SharedAreaMap *
+findSharedAreaMap(dev_t devnum, ino_t inode, off_t offset, size_t size)
+{
+  for (size_t i = 0; i < sharedDataHeader->numSharedAreaMaps; i++) {
+    SharedData::SharedAreaMap &map = sharedDataHeader->sharedAreaMap[i];
+    if (map.devnum == devnum && map.inode == inode &&
+        map.offset <= (uint64_t)offset &&
+        (uint64_t)offset + size <= map.offset + map.size) {
+      return &map;
+    }
+  }
+  return NULL;
+}
+
+bool
+SharedData::claimSharedArea(dev_t devnum,
+                            ino_t inode,
+                            off_t offset,
+                            size_t size,
+                            void *addr)
+{
+  if (sharedDataHeader == NULL) {
+    initialize();
+  }
+
+  bool claimed = false;
+  Util::lockFile(PROTECTED_SHM_FD);
+  if (findSharedAreaMap(devnum, inode, offset, size) == NULL) {
+    JASSERT(sharedDataHeader->numSharedAreaMaps < MAX_SHARED_AREA_MAPS);
+    SharedAreaMap &map =
+      sharedDataHeader->sharedAreaMap[sharedDataHeader->numSharedAreaMaps];
+    map.devnum = devnum;
+    map.inode = inode;
+    map.offset = offset;
+    map.size = size;
+    map.addr = (uint64_t)addr;
+    map.owner = UniquePid::ThisProcess().upid();
+    sharedDataHeader->numSharedAreaMaps++;
+    claimed = true;
+  }
+  Util::unlockFile(PROTECTED_SHM_FD);
+  return claimed;
+}
+
+bool
+SharedData::isSharedAreaCopy(dev_t devnum,
+                             ino_t inode,
+                             off_t offset,
+                             size_t size,
+                             void *addr)
+{
+  if (sharedDataHeader == NULL) {
+    initialize();
+  }
+
+  if (findSharedAreaMap(devnum, inode, offset, size) == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < sharedDataHeader->numSharedAreaMaps; i++) {
+    SharedAreaMap &map = sharedDataHeader->sharedAreaMap[i];
+    if (map.devnum == devnum && map.inode == inode &&
+        map.offset == (uint64_t)offset && map.size == size &&
+        map.addr == (uint64_t)addr &&
+        map.owner == UniquePid::ThisProcess().upid()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+SharedData::insertMemfdMap(dev_t devnum, ino_t inode, pid_t *pid, int32_t *fd)
+{
+  if (sharedDataHeader == NULL) {
+    initialize();
+  }
+
+  bool inserted = false;
+  Util::lockFile(PROTECTED_SHM_FD);
+  if (!getMemfdMap(devnum, inode, pid, fd)) {
+    JASSERT(sharedDataHeader->numMemfdMaps < MAX_MEMFD_MAPS);
+    MemfdMap &map = sharedDataHeader->memfdMap[sharedDataHeader->numMemfdMaps];
+    map.devnum = devnum;
+    map.inode = inode;
+    map.pid = *pid;
+    map.fd = *fd;
+    sharedDataHeader->numMemfdMaps++;
+    inserted = true;
+  }
+  Util::unlockFile(PROTECTED_SHM_FD);
+  return inserted;
+}
+
+bool
+SharedData::getMemfdMap(dev_t devnum, ino_t inode, pid_t *pid, int32_t *fd)
+{
+  if (sharedDataHeader == NULL) {
+    initialize();
+  }
+
+  for (size_t i = 0; i < sharedDataHeader->numMemfdMaps; i++) {
+    MemfdMap &map = sharedDataHeader->memfdMap[i];
+    if (map.devnum == devnum && map.inode == inode) {
+      *pid = map.pid;
+      *fd = map.fd;
+      return true;
+    }
+  }
+  return false;
+}
@@ -445,6 +445,32 @@ _real_execvpe(const char *file, char *const argv[], char *const envp[])
   REAL_FUNC_PASSTHROUGH(execvpe) (file, argv, envp);
 }
 
+LIB_PRIVATE
+int
+_real_posix_spawn(pid_t *pid,
+                  const char *path,
+                  const posix_spawn_file_actions_t *file_actions,
+                  const posix_spawnattr_t *attrp,
+                  char *const argv[],
+                  char *const envp[])
+{
+  REAL_FUNC_PASSTHROUGH(posix_spawn) (pid, path, file_actions, attrp,
+                                      argv, envp);
+}
+
+LIB_PRIVATE
+int
+_real_posix_spawnp(pid_t *pid,
+                   const char *file,
+                   const posix_spawn_file_actions_t *file_actions,
+                   const posix_spawnattr_t *attrp,
+                   char *const argv[],
+                   char *const envp[])
+{
+  REAL_FUNC_PASSTHROUGH(posix_spawnp) (pid, file, file_actions, attrp,
+                                       argv, envp);
+}
+
 LIB_PRIVATE
 int
 _real_system(const char *cmd)
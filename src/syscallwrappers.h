@@ -30,6 +30,7 @@
 #include <features.h>
 #include <pthread.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <sys/resource.h>
@@ -157,6 +158,8 @@ LIB_PRIVATE extern __thread int thread_performing_dlopen_dlsym;
   MACRO(system)                       \
   MACRO(popen)                        \
   MACRO(pclose)                       \
+  MACRO(posix_spawn)                  \
+  MACRO(posix_spawnp)                 \
                                       \
   MACRO(signal)                       \
   MACRO(sigaction)                    \
@@ -298,6 +301,18 @@ int _real_execvpe(const char *file, char *const argv[], char *const envp[]);
 // int _real_execle(const char *path, const char *arg, ..., char * const
 // envp[]);
 int _real_system(const char *cmd);
+int _real_posix_spawn(pid_t *pid,
+                      const char *path,
+                      const posix_spawn_file_actions_t *file_actions,
+                      const posix_spawnattr_t *attrp,
+                      char *const argv[],
+                      char *const envp[]);
+int _real_posix_spawnp(pid_t *pid,
+                       const char *file,
+                       const posix_spawn_file_actions_t *file_actions,
+                       const posix_spawnattr_t *attrp,
+                       char *const argv[],
+                       char *const envp[]);
 FILE *_real_popen(const char *command, const char *mode);
 int _real_pclose(FILE *fp);
 
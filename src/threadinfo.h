@@ -94,6 +94,11 @@ struct Thread {
    */
   double ckptReadTime;
 
+  /* Set once the thread calls dmtcp_safe_point().  With quiesce mode, the
+   * ckpt thread lets such a thread park itself instead of signalling it.
+   */
+  int usesSafePoints;
+
   Thread *next;
   Thread *prev;
 };
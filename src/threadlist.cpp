@@ -66,6 +66,12 @@ static Thread *ckptThread = NULL;
 static int numUserThreads = 0;
 static bool originalstartup;
 
+// "Quiesce then checkpoint" mode (DMTCP_QUIESCE_TIMEOUT).
+static uint32_t quiesceTimeoutMs = 0;
+static volatile int ckptPending = 0;
+static uint64_t suspendLatencyUsec = 0;
+static struct timespec ckptRequestTime;
+
 extern bool sem_launch_first_time;
 extern sem_t sem_launch; // allocated in coordinatorapi.cpp
 static sem_t semNotifyCkptThread;
@@ -180,6 +186,9 @@ ThreadList::init()
 
   SigInfo::setupCkptSigHandler(&stopthisthread);
 
+  const char *quiesceTimeout = getenv(ENV_VAR_QUIESCE_TIMEOUT);
+  quiesceTimeoutMs = quiesceTimeout ? strtoul(quiesceTimeout, NULL, 10) : 0;
+
   // CONTEXT:  updateTid() resets curThread only if it's non-NULL.
   // ... -> initializeMtcpEngine() -> ThreadList::init() -> updateTid()
   // See addToActiveList() for more information.
@@ -233,6 +242,26 @@ ThreadList::initThread(Thread *th, int (*fn)(
   th->procname[0] = '\0';
 }
 
+/* Since glibc 2.34, pthread_create() calls clone3() from inside libc, and not
+ * through our __clone() wrapper.  The new thread then sets itself up here,
+ * from pthread_start(), with the flags that glibc gives clone3().  Its tid
+ * slot in 'struct pthread' is the ptid and ctid that a clone() on restart
+ * must fill in and clear.
+ */
+void
+ThreadList::initPthread()
+{
+  int flags = CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SYSVSEM |
+              CLONE_SIGHAND | CLONE_THREAD | CLONE_SETTLS |
+              CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID;
+  int *tid = (int *)((char *)pthread_self() + TLSInfo_GetTidOffset());
+  Thread *thread = getNewThread();
+
+  ThreadSync::initThread();
+  initThread(thread, NULL, NULL, flags, tid, tid);
+  updateTid(thread);
+}
+
 /*****************************************************************************
  *
  * Thread exited/exiting.
@@ -309,6 +338,14 @@ prepareMtcpHeader(MtcpHeader *mtcpHdr)
   mtcpHdr->tls_pid_offset = TLSInfo_GetPidOffset();
   mtcpHdr->tls_tid_offset = TLSInfo_GetTidOffset();
   mtcpHdr->myinfo_gs = myinfo_gs;
+
+  mtcpHdr->ckpt_pid = dmtcp_get_real_pid();
+  int fd = _real_open("/proc/sys/kernel/random/boot_id", O_RDONLY, 0);
+  if (fd != -1) {
+    Util::readAll(fd, mtcpHdr->ckpt_boot_id,
+                  sizeof(mtcpHdr->ckpt_boot_id) - 1);
+    _real_close(fd);
+  }
 }
 
 /*************************************************************************
@@ -436,15 +473,47 @@ checkpointhread(void *dummy)
   return NULL;
 }
 
+static uint64_t
+elapsedUsec(const struct timespec &start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) * 1000000 +
+         (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+/* Called by the ckpt thread as soon as the coordinator asks for a checkpoint;
+ * the suspend latency counts from here.  In quiesce mode, threads may park
+ * themselves at a safe point from now on, while the pre-suspend callbacks
+ * run, so threadResumeLock must already be held for them to wait on.
+ */
+void
+ThreadList::ckptRequested()
+{
+  clock_gettime(CLOCK_MONOTONIC, &ckptRequestTime);
+
+  DmtcpRWLockInit(&threadResumeLock);
+  JASSERT(DmtcpRWLockWrLock(&threadResumeLock) == 0);
+
+  if (quiesceTimeoutMs > 0) {
+    __atomic_store_n(&ckptPending, 1, __ATOMIC_RELEASE);
+  }
+}
+
 void
 ThreadList::suspendThreads()
 {
   int needrescan;
   Thread *thread;
   Thread *next;
+  struct timespec start;
 
-  DmtcpRWLockInit(&threadResumeLock);
-  JASSERT(DmtcpRWLockWrLock(&threadResumeLock) == 0);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  /* In quiesce mode, threads that call dmtcp_safe_point() get up to
+   * quiesceTimeoutMs to park themselves.  Only the rest are signalled.
+   */
+  bool waitForSafePoints = quiesceTimeoutMs > 0;
 
   /* Halt all other threads - force them to call stopthisthread
    * If any have blocked checkpointing, wait for them to unblock before
@@ -461,6 +530,10 @@ ThreadList::suspendThreads()
       /* Do various things based on thread's state */
       switch (thread->state) {
       case ST_RUNNING:
+        if (waitForSafePoints && thread->usesSafePoints) {
+          needrescan = 1;
+          break;
+        }
 
         /* Thread is running. Send it a signal so it will call stopthisthread.
          * We will need to rescan (hopefully it will be suspended by then)
@@ -510,6 +583,11 @@ ThreadList::suspendThreads()
     }
     if (needrescan) {
       usleep(10);
+      if (waitForSafePoints &&
+          elapsedUsec(start) >= quiesceTimeoutMs * (uint64_t)1000) {
+        JTRACE("quiesce timeout; signalling remaining threads");
+        waitForSafePoints = false;
+      }
     }
   } while (needrescan);
   unlk_threads();
@@ -517,9 +595,48 @@ ThreadList::suspendThreads()
   for (int i = 0; i < numUserThreads; i++) {
     sem_wait(&semNotifyCkptThread);
   }
+  __atomic_store_n(&ckptPending, 0, __ATOMIC_RELEASE);
+
+  suspendLatencyUsec = elapsedUsec(ckptRequestTime);
 
   JASSERT(activeThreads != NULL);
-  JTRACE("everything suspended") (numUserThreads);
+  JTRACE("everything suspended") (numUserThreads) (suspendLatencyUsec);
+}
+
+/* Microseconds from the last checkpoint request to all threads suspended. */
+uint64_t
+ThreadList::suspendLatency()
+{
+  return suspendLatencyUsec;
+}
+
+/* Called by a user thread at an application-defined safe point.  If a
+ * checkpoint is pending, the thread suspends itself right here, instead of
+ * waiting for the checkpoint signal to interrupt it at an arbitrary point.
+ */
+int
+ThreadList::safePoint()
+{
+  if (curThread == NULL || curThread == ckptThread) {
+    return 0;
+  }
+
+  curThread->usesSafePoints = 1;
+  if (!__atomic_load_n(&ckptPending, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+
+  // If the ckpt thread signalled us first, the signal will suspend us.
+  if (!Thread_UpdateState(curThread, ST_SIGNALED, ST_RUNNING)) {
+    return 0;
+  }
+
+  uint32_t numRestarts = ProcessInfo::instance().numRestarts();
+  stopthisthread(SigInfo::ckptSignal());
+  if (ProcessInfo::instance().numRestarts() != numRestarts) {
+    return DMTCP_AFTER_RESTART;
+  }
+  return DMTCP_AFTER_CHECKPOINT;
 }
 
 /* Resume all threads. */
@@ -758,6 +875,14 @@ ThreadList::postRestart(double readTime)
 
   SharedData::postRestart();
 
+  /* With dmtcp_restart --native-pids, we were recreated with our original pid,
+   * and our threads get their original tids (see the pid plugin).
+   */
+  char nativePids[8];
+  Util::setNativePids(dmtcp_get_restart_env(ENV_VAR_NATIVE_PIDS, nativePids,
+                                            sizeof(nativePids)) ==
+                      RESTART_ENV_SUCCESS);
+
   /* Fill in the new mother process id */
   motherpid = THREAD_REAL_TID();
   motherofall->tid = motherpid;
@@ -827,6 +952,13 @@ restarthread(void *threadv)
     TLSInfo_SetThreadSysinfo(saved_sysinfo);
   }
 
+  // This thread has its tid back.  The motherofall thread, which recreates
+  // the others with theirs, comes here last.
+  if (Util::nativePids()) {
+    JWARNING(Util::dropCapSysAdmin()) (thread->virtual_tid) (JASSERT_ERRNO)
+    .Text("--native-pids: failed to drop CAP_SYS_ADMIN");
+  }
+
   if (thread == motherofall) { // if this is a user thread
     /* If DMTCP_RESTART_PAUSE==3, wait for gdb attach.*/
     char * pause_param = getenv("DMTCP_RESTART_PAUSE");
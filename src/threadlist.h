@@ -39,6 +39,7 @@ void init();
 void initThread(Thread *th, int (*fn)(
                   void *), void *arg, int flags, int *ptid, int *ctid);
 void updateTid(Thread *);
+void initPthread();
 void resetOnFork();
 void threadExit();
 
@@ -47,7 +48,10 @@ void addToActiveList(Thread *th);
 void threadIsDead(Thread *thread);
 void emptyFreeList();
 
+void ckptRequested();
 void suspendThreads();
+int safePoint();
+uint64_t suspendLatency();
 void resumeThreads();
 void waitForAllRestored(Thread *thisthread);
 void writeCkpt();
@@ -70,8 +70,11 @@ static bool _threadCreationLockAcquiredByCkptThread = false;
 static DmtcpMutex theCkptCanStart = DMTCP_MUTEX_INITIALIZER;
 static int ckptCanStartCount = 0;
 
-static DmtcpMutex libdlLock = DMTCP_MUTEX_INITIALIZER;
-static pid_t libdlLockOwner = 0;
+// dlopen/dlclose hold libdlLock as readers, so that concurrent calls don't
+// serialize on it (ld.so still has its own lock); the ckpt-thread takes it as
+// the writer, which waits for the calls in progress to finish, so that the
+// link map is consistent at checkpoint time.
+static DmtcpRWLock libdlLock;
 
 static DmtcpMutex uninitializedThreadCountLock = DMTCP_MUTEX_INITIALIZER;
 static int _uninitializedThreadCount = 0;
@@ -81,6 +84,7 @@ static DmtcpMutex preResumeThreadCountLock = DMTCP_MUTEX_INITIALIZER;
 
 static __thread int _wrapperExecutionLockLockCount = 0;
 static __thread int _threadCreationLockLockCount = 0;
+static __thread int _libdlLockLockCount = 0;
 #if TRACK_DLOPEN_DLSYM_FOR_LOCKS
 static __thread bool _threadPerformingDlopenDlsym = false;
 #endif // if TRACK_DLOPEN_DLSYM_FOR_LOCKS
@@ -114,6 +118,7 @@ ThreadSync::initThread()
   // callbackHoldsAnyLocks -> JASSERT().
   _wrapperExecutionLockLockCount = 0;
   _threadCreationLockLockCount = 0;
+  _libdlLockLockCount = 0;
 #if TRACK_DLOPEN_DLSYM_FOR_LOCKS
   _threadPerformingDlopenDlsym = false;
 #endif // if TRACK_DLOPEN_DLSYM_FOR_LOCKS
@@ -144,7 +149,7 @@ ThreadSync::acquireLocks()
   JASSERT(DmtcpMutexLock(&theCkptCanStart) == 0);
 
   JTRACE("Waiting for libdlLock");
-  JASSERT(DmtcpMutexLock(&libdlLock) == 0);
+  JASSERT(DmtcpRWLockWrLock(&libdlLock) == 0);
 
   JTRACE("Waiting for threads creation lock");
   JASSERT(DmtcpRWLockWrLock(&_threadCreationLock) == 0);
@@ -172,7 +177,7 @@ ThreadSync::releaseLocks()
   _wrapperExecutionLockAcquiredByCkptThread = false;
   JASSERT(DmtcpRWLockUnlock(&_threadCreationLock) == 0);
   _threadCreationLockAcquiredByCkptThread = false;
-  JASSERT(DmtcpMutexUnlock(&libdlLock) == 0);
+  JASSERT(DmtcpRWLockUnlock(&libdlLock) == 0);
   JASSERT(DmtcpMutexUnlock(&theCkptCanStart) == 0);
 
   setOkToGrabLock();
@@ -183,9 +188,11 @@ ThreadSync::resetLocks()
 {
   DmtcpRWLockInit(&_wrapperExecutionLock);
   DmtcpRWLockInit(&_threadCreationLock);
+  DmtcpRWLockInit(&libdlLock);
 
   _wrapperExecutionLockLockCount = 0;
   _threadCreationLockLockCount = 0;
+  _libdlLockLockCount = 0;
 #if TRACK_DLOPEN_DLSYM_FOR_LOCKS
   _threadPerformingDlopenDlsym = false;
 #endif // if TRACK_DLOPEN_DLSYM_FOR_LOCKS
@@ -194,9 +201,6 @@ ThreadSync::resetLocks()
 
   DmtcpMutexInit(&uninitializedThreadCountLock, DMTCP_MUTEX_NORMAL);
   DmtcpMutexInit(&preResumeThreadCountLock, DMTCP_MUTEX_NORMAL);
-  DmtcpMutexInit(&libdlLock, DMTCP_MUTEX_NORMAL);
-
-  libdlLockOwner = 0;
 
   _checkpointThreadInitialized = false;
   _wrapperExecutionLockAcquiredByCkptThread = false;
@@ -307,9 +311,11 @@ ThreadSync::libdlLockLock()
 
   if ((WorkerState::currentState() == WorkerState::RUNNING ||
        WorkerState::currentState() == WorkerState::PRESUSPEND) &&
-      libdlLockOwner != dmtcp_gettid()) {
-    JASSERT(DmtcpMutexLock(&libdlLock) == 0);
-    libdlLockOwner = dmtcp_gettid();
+      _libdlLockLockCount == 0) {
+    // A constructor run by dlopen may itself call dlopen; only the outermost
+    // call takes the lock, or it would queue behind a waiting ckpt-thread.
+    JASSERT(DmtcpRWLockRdLock(&libdlLock) == 0);
+    _libdlLockLockCount++;
     lockAcquired = true;
   }
   errno = saved_errno;
@@ -321,12 +327,11 @@ ThreadSync::libdlLockUnlock()
 {
   int saved_errno = errno;
 
-  JASSERT(libdlLockOwner == 0 || libdlLockOwner == dmtcp_gettid())
-    (libdlLockOwner) (dmtcp_gettid());
+  JASSERT(_libdlLockLockCount == 1) (_libdlLockLockCount);
   JASSERT(WorkerState::currentState() == WorkerState::RUNNING ||
           WorkerState::currentState() == WorkerState::PRESUSPEND);
-  libdlLockOwner = 0;
-  JASSERT(DmtcpMutexUnlock(&libdlLock) == 0);
+  _libdlLockLockCount--;
+  JASSERT(DmtcpRWLockUnlock(&libdlLock) == 0);
   errno = saved_errno;
 }
 
@@ -45,6 +45,9 @@ struct ThreadArg {
   pid_t virtualTid;
 };
 
+// Whether this thread was started by our __clone() wrapper.
+static __thread bool clonedByWrapper = false;
+
 // Invoked via __clone
 LIB_PRIVATE
 int
@@ -52,6 +55,7 @@ clone_start(void *arg)
 {
   Thread *thread = (Thread *)arg;
 
+  clonedByWrapper = true;
   ThreadSync::initThread();
 
   ThreadList::updateTid(thread);
@@ -151,6 +155,11 @@ pthread_start(void *arg)
   JASSERT(pthread_fn != 0x0);
   JALLOC_HELPER_FREE(arg); // Was allocated in calling thread in pthread_create
 
+  // glibc 2.34 and later bypass __clone(); see ThreadList::initPthread().
+  if (!clonedByWrapper) {
+    ThreadList::initPthread();
+  }
+
   // Unblock ckpt signal (unblocking a non-blocked signal has no effect).
   // Normally, DMTCP wouldn't allow the ckpt signal to be blocked. However, in
   // some situations (e.g., timer_create), libc would internally block all
@@ -21,6 +21,7 @@
 
 #include "util.h"
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <string.h>
 #include <sys/resource.h>
 #include <sys/time.h>
@@ -30,6 +31,7 @@
 #include "protectedfds.h"
 #include "shareddata.h"
 #include "syscallwrappers.h"
+#include "tokenize.h"
 #include "uniquepid.h"
 
 using namespace dmtcp;
@@ -296,6 +298,73 @@ Util::isSetuid(const char *filename)
   return false;
 }
 
+// Short-lived helpers (compressors, sort, compiler drivers, ...) named in
+// DMTCP_UNTRACKED_HELPERS are exec'ed outside of DMTCP.  The variable holds a
+// colon-separated list of shell patterns.  A pattern containing a '/' is
+// matched against the full pathname; all others against the basename.
+// The list is read once and cached, so that the checkpoint thread never has
+// to call getenv().
+static const vector<string>&
+untrackedHelperPatterns()
+{
+  static vector<string> *patterns = NULL;
+
+  if (patterns == NULL) {
+    const char *env = getenv(ENV_VAR_UNTRACKED_HELPERS);
+    patterns = new vector<string>(tokenizeString(env != NULL ? env : "", ":"));
+  }
+  return *patterns;
+}
+
+bool
+Util::untrackedHelpersEnabled()
+{
+  return !untrackedHelperPatterns().empty();
+}
+
+bool
+Util::isUntrackedHelper(const char *filename)
+{
+  const vector<string> &patterns = untrackedHelperPatterns();
+
+  if (filename == NULL || patterns.empty()) {
+    return false;
+  }
+
+  char pathname[PATH_MAX];
+  if (expandPathname(filename, pathname, sizeof(pathname)) != 0) {
+    strncpy(pathname, filename, sizeof(pathname) - 1);
+    pathname[sizeof(pathname) - 1] = '\0';
+  }
+  string basename = jalib::Filesystem::BaseName(pathname);
+
+  for (size_t i = 0; i < patterns.size(); i++) {
+    const char *p = patterns[i].c_str();
+    const char *name = strchr(p, '/') != NULL ? pathname : basename.c_str();
+    if (fnmatch(p, name, 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Maximum number of seconds a checkpoint is deferred while waiting for
+// untracked helpers to exit (DMTCP_UNTRACKED_HELPERS_TIMEOUT).
+uint32_t
+Util::untrackedHelperTimeout()
+{
+  static int timeout = -1;
+
+  if (timeout == -1) {
+    const char *env = getenv(ENV_VAR_UNTRACKED_HELPERS_TIMEOUT);
+    timeout = DEFAULT_UNTRACKED_HELPERS_TIMEOUT;
+    if (env != NULL && env[0] != '\0') {
+      timeout = MAX(jalib::StringToInt(env), 0);
+    }
+  }
+  return timeout;
+}
+
 void
 Util::patchArgvIfSetuid(const char *filename,
                         const char *origArgv[],
@@ -21,6 +21,8 @@
 
 #include "util.h"
 #include <pwd.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/fcntl.h>
 #include <sys/stat.h>
@@ -52,6 +54,22 @@ Util::writeCoordPortToFile(int port, const char *portFile)
   }
 }
 
+/*
+ * The coordinator listening on TCP port 'port' also listens on this abstract
+ * Unix-domain socket, for the processes on its own host.  Abstract names
+ * live in the network namespace, as the TCP port does, and go away with the
+ * coordinator; there is no file to clean up.
+ */
+socklen_t
+Util::coordUnixSocketAddr(int port, struct sockaddr_un *addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  int len = snprintf(&addr->sun_path[1], sizeof(addr->sun_path) - 1,
+                     "dmtcp-coord-%d", port);
+  return offsetof(struct sockaddr_un, sun_path) + 1 + len;
+}
+
 /*
  * calcTmpDir() computes the TmpDir to be used by DMTCP. It does so by using
  * DMTCP_TMPDIR env, current username, and hostname. Once computed, we open the
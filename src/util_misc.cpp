@@ -399,8 +399,8 @@ Util::readProcMapsLine(int mapsfd, ProcMapsArea *area)
   while (c == ' ') {
     c = readChar(mapsfd);
   }
-  if (c == '/' || c == '[' || c == '(') {
-    // absolute pathname, or [stack], [vdso], etc.
+  if (c == '/' || c == '[' || c == '(' || c == 'a') {
+    // absolute pathname, or [stack], [vdso], anon_inode:[io_uring], etc.
     // On some machines, deleted files have a " (deleted)" prefix to the
     // filename.
     i = 0;
@@ -647,6 +647,13 @@ Util::isIBShmArea(const ProcMapsArea &area)
   return strStartsWith(area.name, "/dev/infiniband/uverbs");
 }
 
+// Check for the rings or SQE array of an io_uring instance.
+bool
+Util::isIoUringArea(const ProcMapsArea &area)
+{
+  return strStartsWith(area.name, "anon_inode:[io_uring]");
+}
+
 void
 Util::allowGdbDebug(int currentDebugLevel)
 {
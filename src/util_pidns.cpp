@@ -0,0 +1,260 @@
+/****************************************************************************
+ *  This file is part of DMTCP.                                             *
+ *                                                                          *
+ *  DMTCP is free software: you can redistribute it and/or                  *
+ *  modify it under the terms of the GNU Lesser General Public License as   *
+ *  published by the Free Software Foundation, either version 3 of the      *
+ *  License, or (at your option) any later version.                         *
+ *                                                                          *
+ *  DMTCP is distributed in the hope that it will be useful,                *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU Lesser General Public License for more details.                     *
+ *                                                                          *
+ *  You should have received a copy of the GNU Lesser General Public        *
+ *  License along with DMTCP.  If not, see <http://www.gnu.org/licenses/>.  *
+ ****************************************************************************/
+
+/* Native pids (dmtcp_restart --native-pids).
+ *
+ * dmtcp_restart recreates the processes of a computation in a new user and
+ * PID namespace, each with its original (virtual) pid, and their threads with
+ * their original tids.  As long as every process and thread in the namespace
+ * has real id == virtual id, the pid plugin need not translate ids at all.
+ * New processes and threads ask for the id that DMTCP picked for them; if the
+ * kernel can't give it (another process got it first), they keep the id the
+ * kernel gave them, and that becomes their virtual id.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/capability.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include "constants.h"
+#include "syscallwrappers.h"
+#include "util.h"
+
+#ifndef SYS_clone3
+# define SYS_clone3 435
+#endif // ifndef SYS_clone3
+
+#ifndef PR_CAP_AMBIENT
+# define PR_CAP_AMBIENT           47
+# define PR_CAP_AMBIENT_LOWER     3
+#endif // ifndef PR_CAP_AMBIENT
+
+#ifndef CLONE_DETACHED
+# define CLONE_DETACHED 0x00400000
+#endif // ifndef CLONE_DETACHED
+
+using namespace dmtcp;
+
+// struct clone_args of linux/sched.h (CLONE_ARGS_SIZE_VER2), which older
+// kernel headers don't have.
+struct CloneArgs {
+  uint64_t flags;
+  uint64_t pidfd;
+  uint64_t child_tid;
+  uint64_t parent_tid;
+  uint64_t exit_signal;
+  uint64_t stack;
+  uint64_t stack_size;
+  uint64_t tls;
+  uint64_t set_tid;
+  uint64_t set_tid_size;
+  uint64_t cgroup;
+};
+
+static int nativePidsState = -1;
+
+bool
+Util::nativePids()
+{
+  if (nativePidsState == -1) {
+    nativePidsState = getenv(ENV_VAR_NATIVE_PIDS) != NULL;
+  }
+  return nativePidsState == 1;
+}
+
+void
+Util::setNativePids(bool enable)
+{
+  nativePidsState = enable;
+  if (enable) {
+    setenv(ENV_VAR_NATIVE_PIDS, "1", 1);
+  } else {
+    unsetenv(ENV_VAR_NATIVE_PIDS);
+  }
+}
+
+static void
+initCloneArgs(CloneArgs *args, int flags, pid_t *tid)
+{
+  memset(args, 0, sizeof(*args));
+
+  // clone3 takes the exit signal separately, and rejects CLONE_DETACHED,
+  // which clone() has ignored for a long time.
+  args->flags = flags & ~(CSIGNAL | CLONE_DETACHED);
+  args->exit_signal = flags & CSIGNAL;
+  args->set_tid = (uint64_t)(uintptr_t)tid;
+  args->set_tid_size = 1;
+}
+
+pid_t
+Util::forkWithPid(pid_t pid)
+{
+  CloneArgs args;
+
+  // Unlike fork(), this leaves the tid cached by libc in the child's thread
+  // descriptor stale; dmtcp_restart is single-threaded and execs right away.
+  initCloneArgs(&args, SIGCHLD, &pid);
+  return _real_syscall(SYS_clone3, &args, sizeof(args));
+}
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+// The child starts on a new stack, so it can't return from the syscall into
+// C code; it calls fn(arg) and exits from assembly instead.
+static pid_t
+clone3Thread(CloneArgs *args, int (*fn)(void *), void *arg)
+{
+# if defined(__x86_64__)
+  long ret;
+  register void *fnReg asm ("r12") = (void *)fn;
+  register void *argReg asm ("r13") = arg;
+
+  asm volatile ("syscall\n\t"
+                "test %%rax, %%rax\n\t"
+                "jnz 1f\n\t"
+                "xor %%ebp, %%ebp\n\t"
+                "mov %%r13, %%rdi\n\t"
+                "call *%%r12\n\t"
+                "mov %%eax, %%edi\n\t"
+                "mov %[nr_exit], %%eax\n\t"
+                "syscall\n\t"
+                "hlt\n\t"
+                "1:\n\t"
+                : "=a" (ret)
+                : "0" ((long)SYS_clone3), "D" (args), "S" (sizeof(*args)),
+                  "r" (fnReg), "r" (argReg), [nr_exit] "i" (SYS_exit)
+                : "rcx", "r11", "memory");
+# else // if defined(__x86_64__)
+  register long x0 asm ("x0") = (long)args;
+  register long x1 asm ("x1") = sizeof(*args);
+  register long x8 asm ("x8") = SYS_clone3;
+  register void *fnReg asm ("x20") = (void *)fn;
+  register void *argReg asm ("x21") = arg;
+
+  asm volatile ("svc #0\n\t"
+                "cbnz x0, 1f\n\t"
+                "mov x29, xzr\n\t"
+                "mov x0, x21\n\t"
+                "blr x20\n\t"
+                "mov x8, %[nr_exit]\n\t"
+                "svc #0\n\t"
+                "1:\n\t"
+                : "+r" (x0)
+                : "r" (x1), "r" (x8), "r" (fnReg), "r" (argReg),
+                  [nr_exit] "i" (SYS_exit)
+                : "x30", "memory");
+  long ret = x0;
+# endif // if defined(__x86_64__)
+  if (ret < 0) {
+    errno = -ret;
+    return -1;
+  }
+  return ret;
+}
+
+pid_t
+Util::cloneWithTid(int (*fn)(void *),
+                   void *childStack,
+                   int flags,
+                   void *arg,
+                   pid_t *parentTid,
+                   void *tls,
+                   pid_t *childTid,
+                   pid_t tid)
+{
+  CloneArgs args;
+
+  initCloneArgs(&args, flags, &tid);
+  args.parent_tid = (uint64_t)(uintptr_t)parentTid;
+  args.child_tid = (uint64_t)(uintptr_t)childTid;
+  args.tls = (uint64_t)(uintptr_t)tls;
+
+  // clone() takes the top of the stack, clone3 the bottom and the size.  The
+  // child's stack pointer ends up at stack + stack_size, which the ABI wants
+  // 16-byte aligned.
+  uintptr_t top = (uintptr_t)childStack & ~(uintptr_t)15;
+  args.stack = top - 16;
+  args.stack_size = 16;
+  return clone3Thread(&args, fn, arg);
+}
+
+#else // if defined(__x86_64__) || defined(__aarch64__)
+
+pid_t
+Util::cloneWithTid(int (*fn)(void *),
+                   void *childStack,
+                   int flags,
+                   void *arg,
+                   pid_t *parentTid,
+                   void *tls,
+                   pid_t *childTid,
+                   pid_t tid)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
+#endif // if defined(__x86_64__) || defined(__aarch64__)
+
+bool
+Util::setLastPid(pid_t pid)
+{
+  char buf[16];
+  int len = snprintf(buf, sizeof(buf), "%d", pid);
+  int fd = _real_open("/proc/sys/kernel/ns_last_pid", O_WRONLY, 0);
+
+  if (fd == -1) {
+    return false;
+  }
+  bool ret = write(fd, buf, len) == len;
+  _real_close(fd);
+  return ret;
+}
+
+// dmtcp_restart --native-pids gives the computation CAP_SYS_ADMIN in its user
+// namespace, to recreate processes and threads with their ids.  Once they
+// exist, the computation has no use for it:  new processes and threads that
+// can't get the id DMTCP picked keep the one the kernel gives them.
+// Capabilities are per thread; each thread drops its own.
+bool
+Util::dropCapSysAdmin()
+{
+  struct __user_cap_header_struct hdr;
+  struct __user_cap_data_struct data[2];
+  int i = CAP_TO_INDEX(CAP_SYS_ADMIN);
+
+  if (prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_LOWER, CAP_SYS_ADMIN, 0, 0) != 0 &&
+      errno != EINVAL) {
+    return false;
+  }
+  hdr.version = _LINUX_CAPABILITY_VERSION_3;
+  hdr.pid = 0;
+  if (_real_syscall(SYS_capget, &hdr, data) != 0) {
+    return false;
+  }
+  data[i].effective &= ~CAP_TO_MASK(CAP_SYS_ADMIN);
+  data[i].permitted &= ~CAP_TO_MASK(CAP_SYS_ADMIN);
+  data[i].inheritable &= ~CAP_TO_MASK(CAP_SYS_ADMIN);
+  return _real_syscall(SYS_capset, &hdr, data) == 0;
+}
@@ -29,7 +29,9 @@
 #include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include "jassert.h"
+#include "ckptbudget.h"
 #include "constants.h"
 #include "dmtcp.h"
 #include "processinfo.h"
@@ -37,6 +39,7 @@
 #include "procselfmaps.h"
 #include "shareddata.h"
 #include "util.h"
+#include "mtcp/mtcp_crc32c.h"
 
 #define DEV_ZERO_DELETED_STR "/dev/zero (deleted)"
 #define DEV_NULL_DELETED_STR "/dev/null (deleted)"
@@ -50,12 +53,63 @@
 #define _real_open           NEXT_FNC(open)
 #define _real_close          NEXT_FNC(close)
 
+/* Bits of a /proc/self/pagemap entry; see Documentation/vm/pagemap.txt. */
+#define PAGEMAP_PRESENT      (1ULL << 63)
+#define PAGEMAP_SWAPPED      (1ULL << 62)
+
+/* Number of pagemap entries read at a time (16 MB of 4 KB pages). */
+#define PAGEMAP_BATCH        4096
+
+/* Holes of fewer unpopulated pages than this are written along with the
+ * populated pages around them, rather than as areas of their own. */
+#define PAGEMAP_MIN_HOLE     16
+
 using namespace dmtcp;
 
 EXTERNC int dmtcp_infiniband_enabled(void) __attribute__((weak));
 
 static bool skipWritingTextSegments = false;
 
+/* /proc/self/pagemap tells us which pages of an anonymous area were ever
+ * populated, without touching them.  We keep a window of entries, since
+ * reading memory to look for zero pages is what we want to avoid here, and
+ * we can't allocate memory while writing the memory areas.
+ */
+static int pagemapFd = -1;
+static uint64_t pagemapBuf[PAGEMAP_BATCH];
+static VA pagemapStart = NULL;
+static size_t pagemapEntries = 0;
+
+/* Every area header, and every block of area data, is followed into the
+ * image by its CRC32C.  See DMTCP_CHECKSUMMED in procmapsarea.h.  A block is
+ * first copied to streamBuf, and checksummed there:  the checkpoint thread
+ * keeps changing its own stack and DMTCP's data while it writes them, and
+ * the block that is written must be the one that was checksummed.  The copy
+ * is still in cache for the checksum.
+ */
+static MtcpCrc32c crc32c;
+static bool crc32cInitialized = false;
+
+/* The area headers, data blocks and checksums are streamed to the image
+ * through streamBuf, and written out only when it is full.  The DMTCP and
+ * MTCP headers before them fill whole pages (see
+ * CkptSerializer::writeDmtcpHeader), so every write but the last one is of
+ * CKPT_STREAM_SIZE bytes from a page-aligned buffer, at a 4 KB-aligned
+ * offset:  large sequential writes, as direct I/O and parallel filesystems
+ * want, rather than a 4 KB header write and a 4-byte checksum write around
+ * each block.
+ */
+#define CKPT_STREAM_SIZE (4 * DMTCP_CKSUM_BLOCK_SIZE)
+static char *streamBuf = NULL;
+static size_t streamLen = 0;
+
+enum PagemapState {
+  PAGES_UNKNOWN,
+  PAGES_UNPOPULATED,
+  PAGES_RESIDENT,
+  PAGES_SWAPPED
+};
+
 // FIXME:  Why do we create two global variable here?  They should at least
 // be static (file-private), and preferably local to a function.
 ProcSelfMaps *procSelfMaps = NULL;
@@ -74,10 +128,15 @@ vector<ProcMapsArea> *nscdAreas = NULL;
 /* Internal routines */
 
 // static void sync_shared_mem(void);
-static void writememoryarea(int fd, Area *area, int stack_was_seen);
+static void writememoryarea(int fd, Area *area, int stack_was_seen,
+                            int use_pagemap);
 
 static void remap_nscd_areas(const vector<ProcMapsArea> &areas);
 
+static void flushStream(int fd);
+static void writeAreaHeader(int fd, Area *area);
+static void writeAreaData(int fd, Area *area);
+
 /*****************************************************************************
  *
  *  This routine is called from time-to-time to write a new checkpoint file.
@@ -100,6 +159,11 @@ mtcp_writememoryareas(int fd)
     skipWritingTextSegments = true;
   }
 
+  if (!crc32cInitialized) {
+    mtcp_crc32c_init(&crc32c);
+    crc32cInitialized = true;
+  }
+
   JTRACE("Performing checkpoint.");
 
   // Here we want to sync the shared memory pages with the backup files
@@ -147,6 +211,16 @@ mtcp_writememoryareas(int fd)
 
   /* Finally comes the memory contents */
   procSelfMaps = new ProcSelfMaps();
+
+  // Mapped after reading /proc/self/maps, so that it is not saved.
+  streamBuf = (char *)mmap(NULL, CKPT_STREAM_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  JASSERT(streamBuf != MAP_FAILED) (JASSERT_ERRNO);
+  streamLen = 0;
+
+  pagemapFd = _real_open("/proc/self/pagemap", O_RDONLY, 0);
+  JWARNING(pagemapFd != -1) (JASSERT_ERRNO)
+  .Text("Can't open /proc/self/pagemap; reading all anonymous memory.");
   while (procSelfMaps->getNextArea(&area)) {
     // TODO(kapil): Verify that we are not doing any operation that might
     // result in a change of memory layout. For example, a call to JALLOC_NEW
@@ -227,6 +301,31 @@ mtcp_writememoryareas(int fd)
       continue;
     }
 
+    /* Pages of a shared area can be populated by another process, so only
+     * private areas may consult the pagemap of this process.  Nor may the
+     * private mappings of deleted files (and memfds):  the pages not yet
+     * faulted in read from the file, which is gone on restart.
+     */
+    int use_pagemap = (area.flags & MAP_SHARED) == 0 &&
+      !Util::strEndsWith(area.name, DELETED_FILE_SUFFIX);
+
+    /* The file plugin elects one mapping of each shared area (anonymous,
+     * memfd or unlinked file) to save its contents.  The other mappings are
+     * saved as zero pages and mapped back to the shared object on restart.
+     */
+    if ((area.flags & MAP_SHARED) &&
+        SharedData::isSharedAreaCopy(makedev(area.devmajor, area.devminor),
+                                     area.inodenum, area.offset, area.size,
+                                     area.addr)) {
+      JTRACE("shared area saved by another mapping") (area.name)
+        ((void *)area.addr) (area.size);
+      area.properties |= DMTCP_ZERO_PAGE;
+      area.flags = MAP_PRIVATE | MAP_ANONYMOUS;
+      area.name[0] = '\0';
+      writeAreaHeader(fd, &area);
+      continue;
+    }
+
     if (Util::strStartsWith(area.name, DEV_ZERO_DELETED_STR) ||
         Util::strStartsWith(area.name, DEV_NULL_DELETED_STR)) {
       /* If the process has an area labeled as "/dev/zero (deleted)", we mark
@@ -247,12 +346,20 @@ mtcp_writememoryareas(int fd)
       JTRACE("saving area as Anonymous") (area.name);
       area.flags = MAP_PRIVATE | MAP_ANONYMOUS;
       area.name[0] = '\0';
+    } else if (Util::isIoUringArea(area)) {
+      /* The rings and SQEs of an io_uring instance, quiesced by the event
+       * plugin.  On restart, the plugin sets up a new instance, and copies
+       * these contents into it.
+       */
+      JTRACE("saving io_uring area as Anonymous") ((void *)area.addr);
+      area.flags = MAP_PRIVATE | MAP_ANONYMOUS;
+      area.name[0] = '\0';
     } else if (Util::isNscdArea(area)) {
       /* Special Case Handling: nscd is enabled*/
       area.prot = PROT_READ | PROT_WRITE;
       area.properties |= DMTCP_ZERO_PAGE;
       area.flags = MAP_PRIVATE | MAP_ANONYMOUS;
-      Util::writeAll(fd, &area, sizeof(area));
+      writeAreaHeader(fd, &area);
       continue;
     } else if (Util::isIBShmArea(area)) {
       // TODO: Don't checkpoint infiniband shared area for now.
@@ -287,7 +394,12 @@ mtcp_writememoryareas(int fd)
     }
 
     // the whole thing comes after the restore image
-    writememoryarea(fd, &area, stack_was_seen);
+    writememoryarea(fd, &area, stack_was_seen, use_pagemap);
+  }
+
+  if (pagemapFd != -1) {
+    _real_close(pagemapFd);
+    pagemapFd = -1;
   }
 
   // Release the memory.
@@ -299,7 +411,12 @@ mtcp_writememoryareas(int fd)
 
   area.addr = NULL; // End of data
   area.size = -1; // End of data
-  Util::writeAll(fd, &area, sizeof(area));
+  area.properties = 0;
+  writeAreaHeader(fd, &area);
+  flushStream(fd);
+
+  JASSERT(munmap(streamBuf, CKPT_STREAM_SIZE) == 0) (JASSERT_ERRNO);
+  streamBuf = NULL;
 
   /* That's all folks */
   JASSERT(_real_close(fd) == 0);
@@ -317,32 +434,156 @@ remap_nscd_areas(const vector<ProcMapsArea> &areas)
   }
 }
 
+/* Looks up the pages of [addr, addr + len) in /proc/self/pagemap, without
+ * touching them.  Returns PAGES_SWAPPED if any page is in swap,
+ * PAGES_RESIDENT if any page is in RAM, and PAGES_UNPOPULATED if no page was
+ * ever populated (it would read as zero).
+ */
+static int
+pagemap_entry(VA pg, uint64_t *entry)
+{
+  static size_t page_size = Util::pageSize();
+
+  if (pg < pagemapStart || pg >= pagemapStart + pagemapEntries * page_size) {
+    off_t offset = (uint64_t)pg / page_size * sizeof(uint64_t);
+    ssize_t ret = pread(pagemapFd, pagemapBuf, sizeof(pagemapBuf), offset);
+    if (ret < (ssize_t)sizeof(uint64_t)) {
+      return -1;
+    }
+    pagemapStart = pg;
+    pagemapEntries = ret / sizeof(uint64_t);
+  }
+  *entry = pagemapBuf[(pg - pagemapStart) / page_size];
+  return 0;
+}
+
+static int
+pagemap_state(VA addr, size_t len)
+{
+  static size_t page_size = Util::pageSize();
+  int state = PAGES_UNPOPULATED;
+
+  if (pagemapFd == -1) {
+    return PAGES_UNKNOWN;
+  }
+
+  for (VA pg = addr; pg < addr + len; pg += page_size) {
+    uint64_t entry;
+    if (pagemap_entry(pg, &entry) == -1) {
+      return PAGES_UNKNOWN;
+    }
+    if (entry & PAGEMAP_SWAPPED) {
+      return PAGES_SWAPPED;
+    } else if (entry & PAGEMAP_PRESENT) {
+      state = PAGES_RESIDENT;
+    }
+  }
+  return state;
+}
+
+/* Returns the length of the run of pages at the start of [addr, addr + len)
+ * that are all populated, or all unpopulated, and sets *populated to say
+ * which.  Holes of fewer than PAGEMAP_MIN_HOLE pages do not end a populated
+ * run.  Returns 0 if the pagemap can't be read.
+ */
+static size_t
+pagemap_run(VA addr, size_t len, int *populated)
+{
+  static size_t page_size = Util::pageSize();
+  uint64_t entry;
+  VA pg;
+  VA holeStart = NULL;
+
+  if (pagemapFd == -1 || pagemap_entry(addr, &entry) == -1) {
+    return 0;
+  }
+  *populated = (entry & (PAGEMAP_PRESENT | PAGEMAP_SWAPPED)) != 0;
+
+  for (pg = addr + page_size; pg < addr + len; pg += page_size) {
+    if (pagemap_entry(pg, &entry) == -1) {
+      break;
+    }
+    int present = (entry & (PAGEMAP_PRESENT | PAGEMAP_SWAPPED)) != 0;
+    if (!*populated) {
+      if (present) {
+        break;
+      }
+    } else if (present) {
+      holeStart = NULL;
+    } else if (holeStart == NULL) {
+      holeStart = pg;
+    } else if ((size_t)(pg - holeStart) / page_size + 1 >= PAGEMAP_MIN_HOLE) {
+      break;
+    }
+  }
+  return (holeStart != NULL ? holeStart : pg) - addr;
+}
+
+/* Returns 1 if [addr, addr + len) reads as zero.  Unpopulated ranges are
+ * recognized from the pagemap; only populated ranges are read.  Ranges with
+ * swapped-out pages are read in with readahead rather than a fault per page.
+ */
+static int
+is_zero_range(VA addr, size_t len, int use_pagemap, int *swapped)
+{
+  int state = use_pagemap ? pagemap_state(addr, len) : PAGES_UNKNOWN;
+
+  if (state == PAGES_UNPOPULATED) {
+    return 1;
+  } else if (state == PAGES_SWAPPED) {
+    *swapped = 1;
+    madvise(addr, len, MADV_WILLNEED);
+  }
+  return Util::areZeroPages(addr, len / MTCP_PAGE_SIZE);
+}
+
 /* This function returns a range of zero or non-zero pages. If the first page
  * is non-zero, it searches for all contiguous non-zero pages and returns them.
  * If the first page is all-zero, it searches for contiguous zero pages and
- * returns them.
+ * returns them.  *swapped is set if the range had pages in swap.
+ *
+ * With the pagemap, a run of unpopulated pages is a zero range as it is, and
+ * the search for zero pages is confined to the populated run, so that a
+ * sparse area is not written a megabyte per touched page.
  */
 static void
-mtcp_get_next_page_range(Area *area, size_t *size, int *is_zero)
+mtcp_get_next_page_range(Area *area, size_t *size, int *is_zero,
+                         int use_pagemap, int *swapped)
 {
   char *pg;
   char *prevAddr;
   size_t count = 0;
   const size_t one_MB = (1024 * 1024);
 
+  *swapped = 0;
+  if (use_pagemap) {
+    int populated;
+    size_t run = pagemap_run(area->addr, area->size, &populated);
+    if (run > 0 && !populated) {
+      *size = run;
+      *is_zero = 1;
+      return;
+    } else if (run > 0 && run < area->size) {
+      Area populatedRun = *area;
+      populatedRun.size = run;
+      mtcp_get_next_page_range(&populatedRun, size, is_zero, 1, swapped);
+      return;
+    }
+  }
   if (area->size < one_MB) {
     *size = area->size;
-    *is_zero = 0;
+    *is_zero = use_pagemap &&
+      pagemap_state(area->addr, area->size) == PAGES_UNPOPULATED;
     return;
   }
   *size = one_MB;
-  *is_zero = Util::areZeroPages(area->addr, one_MB / MTCP_PAGE_SIZE);
+  *is_zero = is_zero_range(area->addr, one_MB, use_pagemap, swapped);
   prevAddr = area->addr;
   for (pg = area->addr + one_MB;
        pg < area->addr + area->size;
        pg += one_MB) {
     size_t minsize = MIN(one_MB, (size_t)(area->addr + area->size - pg));
-    if (*is_zero != Util::areZeroPages(pg, minsize / MTCP_PAGE_SIZE)) {
+    if (*is_zero != is_zero_range(pg, minsize, use_pagemap, swapped)) {
       break;
     }
     *size += minsize;
@@ -351,14 +592,15 @@ mtcp_get_next_page_range(Area *area, size_t *size, int *is_zero)
                   MADV_DONTNEED) == -1) {
         JNOTE("error doing madvise(..., MADV_DONTNEED)")
           (JASSERT_ERRNO) ((void *)area->addr) ((int)*size);
-        prevAddr = pg;
       }
+      prevAddr = area->addr + *size;
     }
   }
 }
 
 static void
-mtcp_write_non_rwx_and_anonymous_pages(int fd, Area *orig_area)
+mtcp_write_non_rwx_and_anonymous_pages(int fd, Area *orig_area,
+                                       int use_pagemap)
 {
   Area area = *orig_area;
 
@@ -386,24 +628,35 @@ mtcp_write_non_rwx_and_anonymous_pages(int fd, Area *orig_area)
     .Text("error adding PROT_READ to mem region");
   }
 
+  // Entries read for an earlier area may be stale by now.
+  pagemapEntries = 0;
+
   while (area.size > 0) {
     size_t size;
     int is_zero;
+    int swapped = 0;
     Area a = area;
     if (dmtcp_infiniband_enabled && dmtcp_infiniband_enabled()) {
       size = area.size;
       is_zero = 0;
     } else {
-      mtcp_get_next_page_range(&a, &size, &is_zero);
+      mtcp_get_next_page_range(&a, &size, &is_zero, use_pagemap, &swapped);
     }
 
     a.properties = is_zero ? DMTCP_ZERO_PAGE : 0;
     a.size = size;
 
-    Util::writeAll(fd, &a, sizeof(a));
     if (!is_zero) {
-      Util::writeAll(fd, a.addr, a.size);
+      writeAreaData(fd, &a);
+#ifdef MADV_COLD
+      // These pages were in swap before we read them; let them be reclaimed
+      // first again, rather than push the working set out.
+      if (swapped) {
+        madvise(a.addr, a.size, MADV_COLD);
+      }
+#endif // ifdef MADV_COLD
     } else {
+      writeAreaHeader(fd, &a);
       if (madvise(a.addr, a.size, MADV_DONTNEED) == -1) {
         JNOTE("error doing madvise(..., MADV_DONTNEED)")
           (JASSERT_ERRNO) (a.addr) ((int)a.size);
@@ -423,7 +676,67 @@ mtcp_write_non_rwx_and_anonymous_pages(int fd, Area *orig_area)
 }
 
 static void
-writememoryarea(int fd, Area *area, int stack_was_seen)
+flushStream(int fd)
+{
+  if (streamLen > 0) {
+    JASSERT(Util::writeAll(fd, streamBuf, streamLen) == (ssize_t)streamLen)
+      (streamLen) (JASSERT_ERRNO);
+    CkptBudget::wrote(streamLen);
+    streamLen = 0;
+  }
+}
+
+// Appends 'len' bytes at 'buf' to the stream.  If 'checksum' is not NULL,
+// stores the CRC32C of the copied bytes there.
+static void
+streamAppend(int fd, const void *buf, size_t len, uint32_t *checksum)
+{
+  const char *p = (const char *)buf;
+  uint32_t crc = 0;
+
+  while (len > 0) {
+    size_t n = std::min(len, CKPT_STREAM_SIZE - streamLen);
+    memcpy(streamBuf + streamLen, p, n);
+    if (checksum != NULL) {
+      crc = mtcp_crc32c(&crc32c, crc, streamBuf + streamLen, n);
+    }
+    streamLen += n;
+    p += n;
+    len -= n;
+    if (streamLen == CKPT_STREAM_SIZE) {
+      flushStream(fd);
+    }
+  }
+  if (checksum != NULL) {
+    *checksum = crc;
+  }
+}
+
+static void
+writeAreaHeader(int fd, Area *area)
+{
+  area->properties |= DMTCP_CHECKSUMMED;
+  area->checksum = 0;
+  area->checksum = mtcp_crc32c(&crc32c, 0, area, sizeof(*area));
+  streamAppend(fd, area, sizeof(*area), NULL);
+}
+
+static void
+writeAreaData(int fd, Area *area)
+{
+  writeAreaHeader(fd, area);
+  for (size_t offset = 0; offset < area->size;
+       offset += DMTCP_CKSUM_BLOCK_SIZE) {
+    size_t len = std::min(area->size - offset,
+                          (size_t)DMTCP_CKSUM_BLOCK_SIZE);
+    uint32_t checksum;
+    streamAppend(fd, area->addr + offset, len, &checksum);
+    streamAppend(fd, &checksum, sizeof(checksum), NULL);
+  }
+}
+
+static void
+writememoryarea(int fd, Area *area, int stack_was_seen, int use_pagemap)
 {
   void *addr = area->addr;
 
@@ -448,7 +761,8 @@ writememoryarea(int fd, Area *area, int stack_was_seen)
       (addr) (area->size);
   } else if (0 == strcmp(area -> name, "[vsyscall]") ||
              0 == strcmp(area -> name, "[vectors]") ||
-             0 == strcmp(area -> name, "[vvar]"))
+             0 == strcmp(area -> name, "[vvar]") ||
+             0 == strcmp(area -> name, "[vvar_vclock]"))
              // NOTE: We can't trust kernel's "[vdso]" label here.  See below.
   {
     JTRACE("skipping over memory special section")
@@ -489,7 +803,7 @@ writememoryarea(int fd, Area *area, int stack_was_seen)
      * Currently, we detect zero pages in non-rwx mapping and anonymous
      * mappings only
      */
-    mtcp_write_non_rwx_and_anonymous_pages(fd, area);
+    mtcp_write_non_rwx_and_anonymous_pages(fd, area, use_pagemap);
   } else {
     /* Anonymous sections need to have their data copied to the file,
      *   as there is no file that contains their data
@@ -500,11 +814,10 @@ writememoryarea(int fd, Area *area, int stack_was_seen)
 
     if (skipWritingTextSegments && (area->prot & PROT_EXEC)) {
       area->properties |= DMTCP_SKIP_WRITING_TEXT_SEGMENTS;
-      Util::writeAll(fd, area, sizeof(*area));
+      writeAreaHeader(fd, area);
       JTRACE("Skipping over text segments") (area->name) ((void *)area->addr);
     } else {
-      Util::writeAll(fd, area, sizeof(*area));
-      Util::writeAll(fd, area->addr, area->size);
+      writeAreaData(fd, area);
     }
   }
 }
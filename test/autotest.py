@@ -14,6 +14,8 @@ import resource
 import pwd
 import stat
 import re
+import shutil
+import binascii
 
 
 # FIX for bad path for Java:  Travis prepended
@@ -454,7 +456,11 @@ def getNumCkptFiles(dir):
 
 # Test a given list of commands to see if they checkpoint
 # runTest() sets up a keyboard interrupt handler, and then calls this function.
-def runTestRaw(name, numProcs, cmds):
+# restartOpts are passed to dmtcp_restart.  If badRestart is given, the first
+# restart is preceded by one from copies of the images, which badRestart may
+# damage; it returns the dmtcp_restart options to use, and the restart must
+# be refused.
+def runTestRaw(name, numProcs, cmds, restartOpts="", badRestart=None):
   #the expected/correct running status
 #  if USE_M32:
 #    def forall(fnc, lst):
@@ -543,9 +549,27 @@ def runTestRaw(name, numProcs, cmds):
       CHECK(doesStatusSatisfy(getStatus(), status),
             "error: processes checkpointed, but died upon resume")
 
+  def testBadRestart():
+    copies=[ckptDir+"/"+i+".bad" for i in os.listdir(ckptDir)
+              if i.endswith(".dmtcp")]
+    for copy in copies:
+      shutil.copyfile(copy[:-len(".bad")], copy)
+    words=[BIN+"dmtcp_restart --quiet", restartOpts, badRestart(copies)]
+    cmd=" ".join([word for word in words if word] + copies)
+    proc=runCmd(cmd)
+    WAITFOR(lambda: proc.poll() is not None,
+            lambda: "restart from damaged images did not fail")
+    for copy in copies:
+      os.remove(copy)
+    CHECK(proc.returncode != 0, "restart from damaged images succeeded")
+    WAITFOR(lambda: getStatus()==(0, False),
+            lambda: "restart from damaged images left processes behind")
+
   def testRestart():
     #build restart command
     cmd=BIN+"dmtcp_restart --quiet"
+    if restartOpts:
+      cmd+= " "+restartOpts
     for i in os.listdir(ckptDir):
       if i.endswith(".dmtcp"):
         cmd+= " "+ckptDir+"/"+i
@@ -597,6 +621,9 @@ def runTestRaw(name, numProcs, cmds):
       printFixed("PASSED; ")
       testKill()
 
+      if badRestart and i == 0:
+        testBadRestart()
+
       printFixed("rstr:")
       for j in range(RETRIES):
         try:
@@ -668,10 +695,10 @@ def getProcessChildren(pid):
     return [int(pid) for pid in stdout.split()]
 
 # If the user types ^C, then kill all child processes.
-def runTest(name, numProcs, cmds):
+def runTest(name, numProcs, cmds, restartOpts="", badRestart=None):
   for i in range(2):
     try:
-      runTestRaw(name, numProcs, cmds)
+      runTestRaw(name, numProcs, cmds, restartOpts, badRestart)
       break;
     except KeyboardInterrupt:
       for pid in getProcessChildren(os.getpid()):
@@ -686,6 +713,435 @@ def runTest(name, numProcs, cmds):
         stats[1]-=1
         print("Trying once again")
 
+# For badRestart:  flip a byte in the middle of each image.
+def flipByte(images):
+  for image in images:
+    with open(image, "r+b") as f:
+      f.seek(os.path.getsize(image) // 2)
+      byte = bytearray(f.read(1))
+      byte[0] ^= 0xff
+      f.seek(-1, os.SEEK_CUR)
+      f.write(byte)
+  return ""
+
+# Hot standby:  a replica (dmtcp_restart --standby, with a coordinator of its
+# own) follows the checkpoints of test/standby-server.  The server answers
+# each connection with its request count.  Once the server is killed, the
+# replica must take over in the state of the last checkpoint it applied.
+def runStandbyTest(name):
+  printFixed(name,15)
+  if not shouldRunTest(name):
+    print("SKIPPED")
+    return
+
+  stats[1]+=1
+  svcPort=str(randint(2000,10000))
+  portFile=os.path.abspath(ckptDir)+"-standby-port"
+  procs=[]
+
+  def request():
+    client=subprocess.Popen(["./test/standby-server", "-c", svcPort, "10"],
+                            stdout=subprocess.PIPE)
+    m=re.search(r"request (\d+)", client.communicate()[0].decode("ascii"))
+    return int(m.group(1)) if m else 0
+
+  def imageIno():
+    images=[f for f in os.listdir(ckptDir)
+              if f.startswith("ckpt_") and f.endswith(".dmtcp")]
+    return os.stat(ckptDir+"/"+images[0]).st_ino if images else None
+
+  # Checkpoints are renamed over the image; wait for a new one.
+  def checkpoint():
+    ino=imageIno()
+    coordinatorCmd(CKPT_CMD)
+    WAITFOR(lambda: imageIno() not in (None, ino) and getStatus()==(1, True),
+            lambda: "checkpoint error")
+    return ckptDir+"/"+[f for f in os.listdir(ckptDir)
+                          if f.startswith("ckpt_") and f.endswith(".dmtcp")][0]
+
+  try:
+    CHECK(getStatus()==(0, False), "coordinator initial state")
+    procs.append(runCmd(BIN+"dmtcp_launch ./test/standby-server "+svcPort+
+                        " 8"))
+    WAITFOR(lambda: getStatus()==(1, True),
+            lambda: "user program startup error")
+    sleep(POST_LAUNCH_SLEEP)
+    image=checkpoint()
+
+    procs.append(runCmd(BIN+"dmtcp_restart --quiet --standby"+
+                        " --new-coordinator --coord-port 0 --port-file "+
+                        portFile+" "+image))
+    WAITFOR(lambda: os.path.isfile(portFile) and os.path.getsize(portFile) > 0,
+            lambda: "standby replica did not start")
+
+    # Only the second checkpoint holds the first request.
+    CHECK(request()==1, "standby-server did not serve")
+    checkpoint()
+    sleep(S*SLOW)
+    printFixed("ckpt:PASSED; ")
+
+    coordinatorCmd(b'k')
+    WAITFOR(lambda: getStatus()==(0, False),
+            lambda: "coordinator kill command failed")
+    served=request()
+    CHECK(served!=0, "standby replica did not take over")
+    CHECK(served==2, "standby replica did not apply the second checkpoint")
+    printFixed("standby:PASSED")
+    printFixed("\n")
+    stats[0]+=1
+  except CheckFailed as e:
+    print("FAILED")
+    printFixed("",15)
+    print("root-pids:", [x.pid for x in procs], "msg:", e.value)
+    coordinatorCmd(b'k')
+
+  if os.path.isfile(portFile):
+    os.system(BIN+"dmtcp_command --coord-port "+open(portFile).read().strip()+
+              " --quit > /dev/null 2>&1")
+    os.remove(portFile)
+  sleep(S)
+  # A replica still in standby does not listen to its coordinator.
+  for x in procs:
+    if x.poll() is None:
+      os.kill(x.pid, signal.SIGKILL)
+    x.wait()
+  clearCkptDir()
+
+# Coordinator journal:  a coordinator that dies is restarted with the same
+# journal and port; the computation must reconnect to it and checkpoint again.
+# Each checkpoint compacts the journal, so it must not grow with their number.
+def runJournalTest(name):
+  global coordinator
+  printFixed(name,15)
+  if not shouldRunTest(name):
+    print("SKIPPED")
+    return
+
+  stats[1]+=1
+  journal=os.path.abspath(ckptDir)+"-journal"
+  procs=[]
+
+  def checkpoint():
+    clearCkptDir()
+    coordinatorCmd(b'c')
+    WAITFOR(lambda: getNumCkptFiles(ckptDir)>0 and getStatus()==(1, True),
+            lambda: "checkpoint error")
+
+  def restartCoordinator(sig):
+    global coordinator
+    if sig:
+      os.kill(coordinator.pid, sig)
+    else:
+      coordinatorCmd(b'q')
+    coordinator.wait()
+    coordinator=runCmd(BIN+"dmtcp_coordinator --journal "+journal)
+
+  try:
+    CHECK(getStatus()==(0, False), "coordinator initial state")
+    restartCoordinator(None)
+    procs.append(runCmd(BIN+"dmtcp_launch ./test/dmtcp1"))
+    WAITFOR(lambda: getStatus()==(1, True),
+            lambda: "user program startup error")
+    sleep(POST_LAUNCH_SLEEP)
+    checkpoint()
+    size=os.path.getsize(journal)
+    for i in range(4):
+      checkpoint()
+    CHECK(os.path.getsize(journal) < 2*size,
+          "journal grew from %d to %d bytes over 4 checkpoints" %
+          (size, os.path.getsize(journal)))
+    printFixed("ckpt:PASSED; ")
+
+    restartCoordinator(signal.SIGKILL)
+    WAITFOR(lambda: getStatus()==(1, True),
+            lambda: "process did not reconnect to the new coordinator")
+    checkpoint()
+    printFixed("reconnect:PASSED")
+    printFixed("\n")
+    stats[0]+=1
+  except CheckFailed as e:
+    print("FAILED")
+    printFixed("",15)
+    print("root-pids:", [x.pid for x in procs], "msg:", e.value)
+
+  coordinatorCmd(b'k')
+  sleep(S)
+  coordinatorCmd(b'q')
+  coordinator.wait()
+  coordinator=runCmd(BIN+"dmtcp_coordinator")
+  for x in procs:
+    if x.poll() is None:
+      os.kill(x.pid, signal.SIGKILL)
+    x.wait()
+  if os.path.isfile(journal):
+    os.remove(journal)
+  clearCkptDir()
+
+# Retention:  with --keep-generations N, each checkpoint goes to a generation
+# subdirectory, and a reclaimer deletes all but the newest N (the current one
+# among them) in the background.  Two processes must still start only one
+# reclaimer per generation, and no claimed directory or marker may be left.
+def runKeepGenerationsTest(name, keep):
+  printFixed(name,15)
+  if not shouldRunTest(name):
+    print("SKIPPED")
+    return
+
+  stats[1]+=1
+  procs=[]
+
+  def generations():
+    return sorted(int(f.rsplit("_", 1)[1]) for f in os.listdir(ckptDir)
+                    if f.startswith("ckpt_") and
+                       os.path.isdir(ckptDir+"/"+f))
+
+  # The marker of the current generation stays, so that a late process
+  # cannot start a second reclaimer; the next reclaimer removes it.
+  def leftovers():
+    return [f for f in os.listdir(ckptDir)
+              if f.endswith(".deleting") or (f.endswith(".reclaim") and
+                 not f.endswith("_%05d.reclaim" % committed[-1]))]
+
+  try:
+    CHECK(getStatus()==(0, False), "coordinator initial state")
+    for i in range(2):
+      procs.append(runCmd(BIN+"dmtcp_launch --keep-generations "+str(keep)+
+                          " ./test/dmtcp1"))
+    WAITFOR(lambda: getStatus()==(2, True),
+            lambda: "user program startup error")
+    sleep(POST_LAUNCH_SLEEP)
+
+    committed=[]
+    for i in range(keep+2):
+      coordinatorCmd(b'c')
+      WAITFOR(lambda: getStatus()==(2, True) and generations() and
+                      generations()[-1] not in committed,
+              lambda: "checkpoint error")
+      committed.append(generations()[-1])
+    printFixed("ckpt:PASSED; ")
+
+    WAITFOR(lambda: generations()==committed[-keep:] and not leftovers(),
+            lambda: "expected generations %s, found %s; leftovers: %s" %
+                    (committed[-keep:], generations(), leftovers()))
+    printFixed("reclaim:PASSED")
+    printFixed("\n")
+    stats[0]+=1
+  except CheckFailed as e:
+    print("FAILED")
+    printFixed("",15)
+    print("root-pids:", [x.pid for x in procs], "msg:", e.value)
+
+  coordinatorCmd(b'k')
+  WAITFOR(lambda: getStatus()==(0, False),
+          lambda: "coordinator kill command failed")
+  for x in procs:
+    x.wait()
+  clearCkptDir()
+
+# Sharded checkpoint dir:  with --ckpt-shards N, the images are spread over
+# the subdirectories ckpt_shard_000 ... ckpt_shard_<N-1> of ckptDir, and the
+# restart goes through the manifest that the coordinator writes, rather than
+# a list of images.
+def runShardsTest(name, numProcs, cmd, shards):
+  printFixed(name,15)
+  if not shouldRunTest(name):
+    print("SKIPPED")
+    return
+
+  stats[1]+=1
+  manifest=ckptDir+"/dmtcp_restart_manifest.txt"
+  procs=[]
+
+  def images():
+    if not os.path.isfile(manifest):
+      return []
+    with open(manifest) as f:
+      return [line.split()[1] for line in f
+                if not line.startswith("#") and len(line.split()) == 2]
+
+  def checkpoint():
+    if os.path.lexists(manifest):
+      os.remove(manifest)
+    coordinatorCmd(b'c')
+    WAITFOR(lambda: len(images())==numProcs and
+                    all(os.path.isfile(i) for i in images()) and
+                    getStatus()==(numProcs, True),
+            lambda: "checkpoint error; manifest lists %s" % images())
+    for image in images():
+      shard=os.path.basename(os.path.dirname(image))
+      CHECK(shard.startswith("ckpt_shard_") and
+            int(shard[len("ckpt_shard_"):]) < shards,
+            "image %s is not in a shard" % image)
+
+  def restart():
+    coordinatorCmd(b'k')
+    WAITFOR(lambda: getStatus()==(0, False),
+            lambda: "coordinator kill command failed")
+    procs.append(runCmd(BIN+"dmtcp_restart --quiet --manifest "+manifest))
+    WAITFOR(lambda: getStatus()==(numProcs, True),
+            lambda: "restart error, %d expected, %d found, running=%d" %
+                    ((numProcs,) + getStatus()))
+
+  try:
+    CHECK(getStatus()==(0, False), "coordinator initial state")
+    for i in range(numProcs):
+      procs.append(runCmd(BIN+"dmtcp_launch --ckpt-shards "+str(shards)+
+                          " "+cmd))
+    WAITFOR(lambda: getStatus()==(numProcs, True),
+            lambda: "user program startup error")
+    sleep(POST_LAUNCH_SLEEP)
+
+    for i in range(2):
+      if i != 0:
+        printFixed(" -> ")
+      checkpoint()
+      printFixed("ckpt:PASSED; ")
+      restart()
+      printFixed("rstr:PASSED")
+    printFixed("\n")
+    stats[0]+=1
+  except CheckFailed as e:
+    print("FAILED")
+    printFixed("",15)
+    print("root-pids:", [x.pid for x in procs], "msg:", e.value)
+
+  coordinatorCmd(b'k')
+  WAITFOR(lambda: getStatus()==(0, False),
+          lambda: "coordinator kill command failed")
+  for x in procs:
+    x.wait()
+  clearCkptDir()
+
+# Subset checkpoint:  "dmtcp_command --checkpoint --only PID" checkpoints the
+# server of client-server alone, into ckptDir/subset_<compid>_<n>.  The
+# client keeps running through it.  Then the subset restarts by itself.  Its
+# connection to the client comes back dead; client-server is launched with
+# SIGPIPE ignored, so that the server survives writing to it.
+def runSubsetCkptTest(name):
+  printFixed(name,15)
+  if not shouldRunTest(name):
+    print("SKIPPED")
+    return
+
+  stats[1]+=1
+  procs=[]
+
+  def subsetDirs():
+    return sorted(d for d in os.listdir(ckptDir) if d.startswith("subset_"))
+
+  def images(d):
+    return [d+"/"+f for f in os.listdir(d)
+              if f.startswith("ckpt_") and f.endswith(".dmtcp")]
+
+  try:
+    CHECK(getStatus()==(0, False), "coordinator initial state")
+    # restore_signals=False:  the SIGPIPE disposition of Python (ignored)
+    # is inherited by client-server.
+    procs.append(subprocess.Popen([BIN+"dmtcp_launch", "./test/client-server"],
+                                  stdin=subprocess.PIPE, stdout=devnullFd,
+                                  stderr=subprocess.STDOUT,
+                                  restore_signals=False))
+    WAITFOR(lambda: getStatus()==(2, True),
+            lambda: "user program startup error")
+    sleep(POST_LAUNCH_SLEEP)
+
+    out=subprocess.check_output([BIN+"dmtcp_command", "--list"])
+    server=re.search(r'_\(forked\)\[(\d+):', out.decode("ascii"))
+    CHECK(server != None, "server not in the client list")
+
+    for n in range(1, 3):
+      rc=subprocess.call([BIN+"dmtcp_command", "--only", server.group(1),
+                          "--bcheckpoint"], stdout=devnullFd,
+                         stderr=devnullFd)
+      CHECK(rc == 0, "dmtcp_command --only failed: %d" % rc)
+      dirs=subsetDirs()
+      CHECK(len(dirs) == n and
+            re.match(r'subset_[0-9a-f]+-\d+-[0-9a-f]+_%05d$' % n, dirs[-1]),
+            "subset checkpoint dirs: %s" % dirs)
+      subsetDir=ckptDir+"/"+dirs[-1]
+      CHECK(len(images(subsetDir)) == 1,
+            "subset images: %s" % images(subsetDir))
+      CHECK(not images(ckptDir), "image outside of the subset dir")
+      sleep(S*SLOW)
+      CHECK(getStatus()==(2, True), "excluded peer did not keep running")
+      printFixed("subset%d:PASSED; " % n)
+
+    coordinatorCmd(b'k')
+    WAITFOR(lambda: getStatus()==(0, False),
+            lambda: "coordinator kill command failed")
+    procs.append(runCmd(BIN+"dmtcp_restart --quiet "+
+                        " ".join(images(subsetDir))))
+    WAITFOR(lambda: getStatus()==(1, True),
+            lambda: "restart error, %d expected, %d found, running=%d" %
+                    ((1,) + getStatus()))
+    sleep(S*SLOW)
+    CHECK(getStatus()==(1, True), "subset restarted and then died")
+    printFixed("rstr:PASSED\n")
+    stats[0]+=1
+  except CheckFailed as e:
+    print("FAILED")
+    printFixed("",15)
+    print("root-pids:", [x.pid for x in procs], "msg:", e.value)
+
+  coordinatorCmd(b'k')
+  WAITFOR(lambda: getStatus()==(0, False),
+          lambda: "coordinator kill command failed")
+  for x in procs:
+    x.wait()
+  clearCkptDir()
+
+# io_uring indices that wrapped around 2^32:  "io-uring1 ENTRIES wrap" takes
+# its rings there first, which takes minutes, and says when they wrapped.
+# The checkpoints come after that; a restart then brings the indices of the
+# new rings only up to their small values after the wrap.
+def runIoUringWrapTest(name, entries):
+  printFixed(name,15)
+  stats[1]+=1
+  procs=[]
+
+  def images():
+    return [ckptDir+"/"+f for f in os.listdir(ckptDir)
+              if f.startswith("ckpt_") and f.endswith(".dmtcp")]
+
+  try:
+    CHECK(getStatus()==(0, False), "coordinator initial state")
+    proc=subprocess.Popen((BIN+"dmtcp_launch ./test/io-uring1 "+str(entries)+
+                           " wrap").split(), stdout=subprocess.PIPE)
+    procs.append(proc)
+    CHECK(proc.stdout.readline().strip()==b"wrapped",
+          "io_uring indices did not wrap")
+    printFixed("wrap:PASSED; ")
+
+    for i in range(2):
+      if i != 0:
+        printFixed(" -> ")
+      clearCkptDir()
+      coordinatorCmd(b'c')
+      WAITFOR(lambda: images() and getStatus()==(1, True),
+              lambda: "checkpoint error")
+      printFixed("ckpt:PASSED; ")
+      coordinatorCmd(b'k')
+      WAITFOR(lambda: getStatus()==(0, False),
+              lambda: "coordinator kill command failed")
+      procs.append(runCmd(BIN+"dmtcp_restart --quiet "+" ".join(images())))
+      WAITFOR(lambda: getStatus()==(1, True), lambda: "restart error")
+      sleep(S*SLOW)
+      CHECK(getStatus()==(1, True), "processes restarted and then died")
+      printFixed("rstr:PASSED")
+    printFixed("\n")
+    stats[0]+=1
+  except CheckFailed as e:
+    print("FAILED")
+    printFixed("",15)
+    print("root-pids:", [x.pid for x in procs], "msg:", e.value)
+
+  coordinatorCmd(b'k')
+  WAITFOR(lambda: getStatus()==(0, False),
+          lambda: "coordinator kill command failed")
+  for x in procs:
+    x.wait()
+  clearCkptDir()
+
 def saveResultsNMI():
   if DEBUG == "yes":
     # WARNING:  This can cause a several second delay on some systems.
@@ -728,6 +1184,33 @@ runTest("dmtcp3",        1, ["./test/dmtcp3"])
 
 runTest("dmtcp4",        1, ["./test/dmtcp4"])
 
+runTest("sparse-mmap",   1, ["./test/sparse-mmap"])
+
+# Each block of an image has a CRC32C; a damaged image must be refused,
+# whether it is checked before or while it is restored.  (A compressed image
+# can only be checked while it is restored.)
+os.environ['DMTCP_GZIP'] = "0"
+runTest("corrupt-image", 1, ["./test/dmtcp1"], badRestart=flipByte)
+runTest("verify-inline", 1, ["./test/dmtcp1"], "--verify-inline", flipByte)
+os.environ['DMTCP_GZIP'] = GZIP
+
+# Encrypted images (AES-256-GCM):  the image must restart with its key, and
+# be refused with another key, or if it was tampered with.  The key files
+# must not be in ckptDir, where they would be taken for images.
+ckptKey=os.path.abspath(ckptDir)+"-key"
+wrongKey=os.path.abspath(ckptDir)+"-wrong-key"
+for keyFile in [ckptKey, wrongKey]:
+  with open(keyFile, "w") as f:
+    f.write(binascii.hexlify(os.urandom(32)).decode()+"\n")
+runTest("ckpt-crypt",    1, ["--ckpt-key-file "+ckptKey+" ./test/dmtcp1"],
+        "--ckpt-key-file "+ckptKey,
+        lambda images: "--ckpt-key-file "+wrongKey)
+runTest("crypt-tamper",  1,
+        ["--ckpt-key-file "+ckptKey+" ./test/dmtcp1"],
+        "--ckpt-key-file "+ckptKey, flipByte)
+os.remove(ckptKey)
+os.remove(wrongKey)
+
 runTest("alarm",        1, ["./test/alarm"])
 
 runTest("sched_test",    2, ["./test/sched_test"])
@@ -782,6 +1265,25 @@ runTest("stat",         1, ["./test/stat"])
 
 runTest("presuspend",   [1, 2], ["./test/presuspend"])
 
+runTest("safepoint",    1, ["--quiesce-timeout 100 ./test/safepoint"])
+
+# Helpers run outside of DMTCP, and a checkpoint waits for them to exit.
+runTest("untracked",    1,
+        ["--untracked-helpers sleep ./test/untracked-helper"])
+
+# --standby needs a single, uncompressed image.
+os.environ['DMTCP_GZIP'] = "0"
+runStandbyTest("standby")
+os.environ['DMTCP_GZIP'] = GZIP
+
+runJournalTest("coord-journal")
+
+runKeepGenerationsTest("keep-gens", 2)
+
+runShardsTest("ckpt-shards", 4, "./test/dmtcp1", 4)
+
+runSubsetCkptTest("ckpt-subset")
+
 PWD=os.getcwd()
 runTest("plugin-sleep2", 1, ["--with-plugin "+
                              PWD+"/test/plugin/sleep1/dmtcp_sleep1hijack.so:"+
@@ -829,6 +1331,22 @@ runTest("epoll1",        2, ["./test/epoll1"])
 if HAS_EPOLL_CREATE1 == "yes":
   runTest("epoll2",        2, ["./test/epoll1 --use-epoll-create1"])
 
+runTest("timerfd1",      1, ["./test/timerfd1"])
+runTest("memfd1",        2, ["./test/memfd1"])
+runTest("pidfd1",        [2,3,4], ["./test/pidfd1"])
+
+# A restarted io_uring is set up with IORING_SETUP_NO_MMAP, new in Linux 6.5;
+# on rings of more than a page since Linux 6.10.
+kernel = re.match(r'(\d+)\.(\d+)', os.uname()[2])
+if kernel and (int(kernel.group(1)), int(kernel.group(2))) >= (6, 5):
+  runTest("io-uring1",     1, ["./test/io-uring1"])
+if kernel and (int(kernel.group(1)), int(kernel.group(2))) >= (6, 10):
+  runTest("io-uring2",     1, ["./test/io-uring1 1024"])
+# Only when asked for by name:  it takes minutes.
+if kernel and (int(kernel.group(1)), int(kernel.group(2))) >= (6, 10) and \
+   "io-uring-wrap" in args.tests:
+  runIoUringWrapTest("io-uring-wrap", 4096)
+
 runTest("environ",       1, ["./test/environ"])
 
 runTest("forkexec",      2, ["./test/forkexec"])
@@ -836,6 +1354,28 @@ runTest("forkexec",      2, ["./test/forkexec"])
 runTest("realpath",      1, ["./test/realpath"])
 runTest("pthread1",      1, ["./test/pthread1"])
 runTest("pthread2",      1, ["./test/pthread2"])
+runTest("pid-syscalls",  1, ["./test/pid-syscalls"])
+
+# dmtcp_restart --native-pids needs clone3 with set_tid (Linux 5.5), and a
+# user namespace that an unprivileged user may create.
+def unprivilegedUserns():
+  for path, allowed in (("/proc/sys/user/max_user_namespaces",
+                         lambda v: int(v) > 0),
+                        ("/proc/sys/kernel/unprivileged_userns_clone",
+                         lambda v: v == "1"),
+                        ("/proc/sys/kernel/apparmor_restrict_unprivileged_userns",
+                         lambda v: v == "0")):
+    if os.path.isfile(path):
+      with open(path) as f:
+        if not allowed(f.read().strip()):
+          return False
+  return True
+
+kernel = re.match(r'(\d+)\.(\d+)', os.uname()[2])
+if kernel and (int(kernel.group(1)), int(kernel.group(2))) >= (5, 5) and \
+   unprivilegedUserns():
+  runTest("pid-native",    1, ["./test/pid-syscalls"],
+          restartOpts="--native-pids")
 
 S=10*DEFAULT_S
 runTest("pthread3",      1, ["./test/pthread2 80"])
@@ -881,6 +1421,8 @@ if not USE_M32:  # waitpid forks a 64-bit child process, /bin/sleep
   S=DEFAULT_S
 
 runTest("client-server", 2, ["./test/client-server"])
+runTest("socket-churn",  2, ["./test/socket-churn"])
+runTest("udp",           2, ["./test/udp"])
 
 # frisbee creates three processes, each with 14 MB, if no gzip is used
 os.environ['DMTCP_GZIP'] = "1"
@@ -896,6 +1438,7 @@ os.environ['DMTCP_GZIP'] = GZIP
 S=10*DEFAULT_S
 runTest("shared-memory1", 2, ["./test/shared-memory1"])
 runTest("shared-memory2", 2, ["./test/shared-memory2"])
+runTest("shared-anon",   3, ["./test/shared-anon 3"])
 S=DEFAULT_S
 
 runTest("sysv-shm1",     2, ["./test/sysv-shm1"])
@@ -909,9 +1452,10 @@ if HAS_CMA == "yes":
 
 # ARM glibc 2.16 with Linux kernel 3.0 doesn't support mq_send, etc.
 if uname_p[0:3] == 'arm':
-  print("Skipping posix-mq1/mq2 tests; ARM/glibc/Linux does not support mq_send")
+  print("Skipping posix-mq1/mq2/mq3 tests; ARM/glibc/Linux does not support mq_send")
 elif TEST_POSIX_MQ == "yes":
   runTest("posix-mq1",     2, ["./test/posix-mq1"])
+  runTest("posix-mq3",     2, ["./test/posix-mq3"])
   # mq-notify seems to be broken at the moment.
   #runTest("posix-mq2",     2, ["./test/posix-mq2"])
 
@@ -929,6 +1473,9 @@ runTest("timer1",   1, ["./test/timer1"])
 ##########################################################
 ## runTest("timer2",   1, ["./test/timer2"])
 runTest("clock",   1, ["./test/clock"])
+os.environ['DMTCP_VIRTUAL_TIME'] = "1"
+runTest("virtual-time",   1, ["./test/virtual-time"])
+del os.environ['DMTCP_VIRTUAL_TIME']
 
 old_ld_library_path = os.getenv("LD_LIBRARY_PATH")
 if old_ld_library_path:
@@ -937,6 +1484,7 @@ if old_ld_library_path:
 else:
   os.environ['LD_LIBRARY_PATH'] = os.getenv("PWD") + "/test:" + os.getenv("PWD")
 runTest("dlopen1",        1, ["./test/dlopen1"])
+runTest("dlopen3",        1, ["./test/dlopen3"])
 # Disable the dlopen2 test until we can figure out a way to handle calls to
 # fork/exec/wait during library intialization with dlopen().
 # This seems to affect Travis CI of github, but not Ubuntu-12.04
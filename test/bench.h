@@ -0,0 +1,61 @@
+/* Shared by the test programs that double as benchmarks.
+ *
+ * Without a count on the command line, such a program loops forever, as a
+ * checkpoint test for autotest.py.  With a count, it times that many
+ * iterations, prints one line per rate, and exits.  test/misc/rate-runner.sh
+ * runs it natively and under DMTCP, and compares the rates of the lines.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline double
+bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The count in argv[i], or -1 (loop forever) if there is none. */
+static inline long
+bench_count(int argc, char **argv, int i)
+{
+  return argc > i ? atol(argv[i]) : -1;
+}
+
+/* Whether iteration 'i' of 'count' is to be done. */
+static inline int
+bench_more(long i, long count)
+{
+  return count < 0 || i < count;
+}
+
+/* Show that a checkpoint test is alive:  print 'i' every 'every' iterations
+ * if it loops forever.
+ */
+static inline void
+bench_progress(long i, long count, long every)
+{
+  if (count < 0 && i % every == 0) {
+    printf("%ld ", i);
+    fflush(stdout);
+  }
+}
+
+/* Print 'count' iterations of 'what' in 'seconds' as
+ *   WHAT: COUNT in SECONDS s, RATE/s
+ * which is the format that test/misc/rate-runner.sh compares.
+ */
+static inline void
+bench_report(const char *what, long count, double seconds)
+{
+  printf("%s: %ld in %.3f s, %.0f/s\n", what, count, seconds, count / seconds);
+}
+
+#endif // ifndef BENCH_H
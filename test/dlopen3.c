@@ -0,0 +1,72 @@
+/* Several threads dlopen/dlsym/dlclose libdlopen-lib[12].so (see dlopen1.c)
+ * concurrently, as Python imports and JVM class loading do.
+ *
+ * Usage:  LD_LIBRARY_PATH=. ./dlopen3 [NUM_THREADS [CALLS_PER_THREAD]]
+ *   NUM_THREADS defaults to 4.  See bench.h and test/misc/dlopen-rate.sh.
+ */
+
+#include <assert.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define MAX_THREADS 256
+
+static long calls_per_thread = -1;
+
+static void *
+loader(void *arg)
+{
+  int lib = (int)(long)arg % 2 + 1;
+  int result[2] = { 0, 0 };
+  long i;
+
+  for (i = 0; bench_more(i, calls_per_thread); i++) {
+    int (*fnc)(int result[2]);
+    void *handle = dlopen(lib == 1 ? "libdlopen-lib1.so" : "libdlopen-lib2.so",
+                          RTLD_NOW);
+    if (handle == NULL) {
+      fprintf(stderr, "dlopen failed: %s\n", dlerror());
+      exit(1);
+    }
+
+    /* See 'man dlopen' for example:  POSIX.1-2002 prefers this workaround */
+    *(void **)(&fnc) = dlsym(handle, "fnc");
+    assert(fnc != NULL);
+    if (fnc(result) != result[lib - 1]) {
+      fprintf(stderr, "lib %d returned wrong answer.\n", lib);
+      exit(1);
+    }
+    assert(dlclose(handle) == 0);
+    lib = 3 - lib; /* switch libraries to load */
+  }
+  return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+  int num_threads = argc > 1 ? atoi(argv[1]) : 4;
+  pthread_t threads[MAX_THREADS];
+  double start;
+  long i;
+
+  assert(num_threads > 0 && num_threads <= MAX_THREADS);
+  calls_per_thread = bench_count(argc, argv, 2);
+
+  start = bench_now();
+  for (i = 0; i < num_threads; i++) {
+    assert(pthread_create(&threads[i], NULL, loader, (void *)i) == 0);
+  }
+  for (i = 0; i < num_threads; i++) {
+    assert(pthread_join(threads[i], NULL) == 0);
+  }
+
+  bench_report("dlopen/dlclose pairs", num_threads * calls_per_thread,
+               bench_now() - start);
+  return 0;
+}
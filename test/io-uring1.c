@@ -0,0 +1,232 @@
+/* An io_uring, set up and driven through syscall() as liburing does, with a
+ * registered buffer, a registered (fixed) file and a registered eventfd.
+ * Batches of READ_FIXED and NOP requests are submitted and reaped; after a
+ * checkpoint or restart, the data read and the user_data of each CQE must
+ * still be right, and the eventfd must still be signalled.  With 256
+ * entries or more, the rings and SQE array are larger than a page.
+ *
+ * With "wrap", NOPs first bring the indices of the rings to just below 2^32,
+ * so that they wrap around soon after; "wrapped" is printed once they have.
+ * That takes about 2^32 NOPs:  minutes.
+ *
+ * Usage:  io-uring1 [ENTRIES [wrap]]
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+# endif
+#endif
+
+#if defined(IORING_ASYNC_CANCEL_ANY) && defined(SYS_io_uring_setup)
+# define ENTRIES   64
+# define BATCH     16
+# define FILE_SIZE (1024 * 1024)
+# define BLOCK     4096
+# define WRAP_START (UINT32_MAX - 64 * 1024)
+
+static struct io_uring_params p;
+static char *sq;
+static char *cq;
+static struct io_uring_sqe *sqes;
+
+static uint32_t
+load(const char *ring, uint32_t off)
+{
+  return __atomic_load_n((const uint32_t *)(ring + off), __ATOMIC_ACQUIRE);
+}
+
+static void
+store(char *ring, uint32_t off, uint32_t val)
+{
+  __atomic_store_n((uint32_t *)(ring + off), val, __ATOMIC_RELEASE);
+}
+
+static struct io_uring_sqe *
+getSqe()
+{
+  uint32_t tail = load(sq, p.sq_off.tail);
+  uint32_t slot = tail & (p.sq_entries - 1);
+  struct io_uring_sqe *sqe = &sqes[slot];
+
+  assert(tail - load(sq, p.sq_off.head) < p.sq_entries);
+  memset(sqe, 0, sizeof(*sqe));
+  ((uint32_t *)(sq + p.sq_off.array))[slot] = slot;
+  return sqe;
+}
+
+int
+main(int argc, char **argv)
+{
+  char path[] = "/tmp/io-uring1-XXXXXX";
+  char *file = malloc(FILE_SIZE);
+  char *buf = mmap(NULL, BATCH * BLOCK, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  struct iovec iov = { buf, BATCH * BLOCK };
+  uint64_t count = 0;
+  int wrap = argc > 2 && strcmp(argv[2], "wrap") == 0;
+  int fd, tmpfd, efd;
+  size_t len;
+  int i;
+
+  // A file of known contents, registered as fixed file 0.
+  tmpfd = mkstemp(path);
+  assert(tmpfd != -1 && buf != MAP_FAILED);
+  unlink(path);
+  for (i = 0; i < FILE_SIZE; i++) {
+    file[i] = (char)(i * 7 + i / BLOCK);
+  }
+  assert(write(tmpfd, file, FILE_SIZE) == FILE_SIZE);
+
+  fd = syscall(SYS_io_uring_setup, argc > 1 ? atoi(argv[1]) : ENTRIES, &p);
+  assert(fd != -1);
+  len = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  if (len < p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe)) {
+    len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  }
+  sq = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+            IORING_OFF_SQ_RING);
+  cq = sq;
+  sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+              PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+              IORING_OFF_SQES);
+  assert(sq != MAP_FAILED && sqes != MAP_FAILED);
+  assert(p.features & IORING_FEAT_SINGLE_MMAP);
+
+  while (wrap && load(sq, p.sq_off.tail) < WRAP_START) {
+    uint32_t tail = load(sq, p.sq_off.tail);
+    uint32_t n = WRAP_START - tail < p.sq_entries ? WRAP_START - tail
+                                                  : p.sq_entries;
+    for (i = 0; i < (int)n; i++) {
+      struct io_uring_sqe *sqe = getSqe();
+      sqe->opcode = IORING_OP_NOP;
+      store(sq, p.sq_off.tail, load(sq, p.sq_off.tail) + 1);
+    }
+    assert(syscall(SYS_io_uring_enter, fd, n, n, IORING_ENTER_GETEVENTS,
+                   NULL, 0) == (int)n);
+    store(cq, p.cq_off.head, load(cq, p.cq_off.tail));
+  }
+
+  efd = eventfd(0, EFD_NONBLOCK);
+  assert(efd != -1);
+  assert(syscall(SYS_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                 &iov, 1) == 0);
+  assert(syscall(SYS_io_uring_register, fd, IORING_REGISTER_FILES,
+                 &tmpfd, 1) == 0);
+  assert(syscall(SYS_io_uring_register, fd, IORING_REGISTER_EVENTFD,
+                 &efd, 1) == 0);
+
+  while (1) {
+    uint64_t base = count;
+    uint64_t signalled;
+    int n = 0;
+
+    // A read of each block of the batch into its part of the buffer, and a
+    // NOP after each.
+    for (i = 0; i < BATCH; i++) {
+      struct io_uring_sqe *sqe = getSqe();
+      sqe->opcode = IORING_OP_READ_FIXED;
+      sqe->flags = IOSQE_FIXED_FILE;
+      sqe->fd = 0;
+      sqe->addr = (uint64_t)(buf + i * BLOCK);
+      sqe->len = BLOCK;
+      sqe->off = ((base + i) * BLOCK) % FILE_SIZE;
+      sqe->buf_index = 0;
+      sqe->user_data = 2 * (base + i);
+      store(sq, p.sq_off.tail, load(sq, p.sq_off.tail) + 1);
+
+      sqe = getSqe();
+      sqe->opcode = IORING_OP_NOP;
+      sqe->user_data = 2 * (base + i) + 1;
+      store(sq, p.sq_off.tail, load(sq, p.sq_off.tail) + 1);
+    }
+
+    // Interrupted by a checkpoint:  the requests are submitted anyway, or
+    // cancelled (-ECANCELED) and then read again below.
+    while (n < 2 * BATCH) {
+      uint32_t head = load(cq, p.cq_off.head);
+      uint32_t tail = load(cq, p.cq_off.tail);
+      int pending = load(sq, p.sq_off.tail) - load(sq, p.sq_off.head);
+
+      if (head == tail) {
+        syscall(SYS_io_uring_enter, fd, pending, 1, IORING_ENTER_GETEVENTS,
+                NULL, 0);
+        continue;
+      }
+      for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = (struct io_uring_cqe *)
+          (cq + p.cq_off.cqes) + (head & (p.cq_entries - 1));
+        uint64_t req = cqe->user_data / 2;
+
+        assert(req >= base && req < base + BATCH);
+        if (cqe->res == -ECANCELED) {
+          struct io_uring_sqe *sqe = getSqe();
+          if (cqe->user_data % 2 == 0) {
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->flags = IOSQE_FIXED_FILE;
+            sqe->addr = (uint64_t)(buf + (req - base) * BLOCK);
+            sqe->len = BLOCK;
+            sqe->off = (req * BLOCK) % FILE_SIZE;
+          } else {
+            sqe->opcode = IORING_OP_NOP;
+          }
+          sqe->user_data = cqe->user_data;
+          store(sq, p.sq_off.tail, load(sq, p.sq_off.tail) + 1);
+          continue;
+        }
+        if (cqe->user_data % 2 == 0) {
+          if (cqe->res != BLOCK ||
+              memcmp(buf + (req - base) * BLOCK,
+                     file + (req * BLOCK) % FILE_SIZE, BLOCK) != 0) {
+            printf("bad read %llu: %d\n", (unsigned long long)req, cqe->res);
+            return 1;
+          }
+        } else {
+          assert(cqe->res == 0);
+        }
+        n++;
+      }
+      store(cq, p.cq_off.head, head);
+    }
+
+    if (read(efd, &signalled, sizeof(signalled)) != sizeof(signalled)) {
+      printf("eventfd not signalled after %llu requests\n",
+             (unsigned long long)count);
+      return 1;
+    }
+
+    count += BATCH;
+    if (wrap && load(sq, p.sq_off.tail) < WRAP_START &&
+        load(cq, p.cq_off.tail) < WRAP_START) {
+      printf("wrapped\n");
+      fflush(stdout);
+      wrap = 0;
+    }
+    if (count % (BATCH * 100000) == 0) {
+      printf("%llu ", (unsigned long long)count);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
+#else // if defined(IORING_ASYNC_CANCEL_ANY) && defined(SYS_io_uring_setup)
+int
+main(int argc, char **argv)
+{
+  printf("io_uring not supported by the headers of this system\n");
+  return 1;
+}
+#endif // if defined(IORING_ASYNC_CANCEL_ANY) && defined(SYS_io_uring_setup)
@@ -0,0 +1,147 @@
+/* A sealed memfd, shared by a parent and a child through an inherited fd and
+ * mapped by both, and an unsealed memfd that the child reopens through
+ * /proc/<ppid>/fd.  The parent counts in the sealed memfd's mapping, and the
+ * child writes into the other one; after a checkpoint or restart, each must
+ * still see the other's writes, with the same names, sizes and seals.  A
+ * third, sparse memfd must keep its data, and its holes.
+ *
+ * Usage:  memfd1
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(SYS_memfd_create) && defined(F_ADD_SEALS)
+# define SIZE  (64 * 4096)
+# define SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+# define SPARSE_SIZE (1024L * 1024 * 1024)
+
+static void
+check(int fd, const char *name, int seals)
+{
+  char link[64];
+  char path[256];
+  struct stat st;
+  ssize_t len;
+
+  snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+  len = readlink(link, path, sizeof(path) - 1);
+  assert(len > 0);
+  path[len] = '\0';
+  if (strncmp(path, name, strlen(name)) != 0 ||
+      fcntl(fd, F_GET_SEALS) != seals ||
+      fstat(fd, &st) != 0 || st.st_size != SIZE) {
+    printf("memfd %d changed: %s, seals %x\n", fd, path,
+           fcntl(fd, F_GET_SEALS));
+    exit(1);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  int sealed = syscall(SYS_memfd_create, "memfd1-sealed", MFD_ALLOW_SEALING);
+  int other = syscall(SYS_memfd_create, "memfd1-other", MFD_ALLOW_SEALING);
+  int sparse = syscall(SYS_memfd_create, "memfd1-sparse", 0);
+  struct stat st;
+  volatile long *counter;
+  volatile long *echo;
+  long last = -1;
+  pid_t parent = getpid();
+  int i;
+
+  assert(sealed != -1 && other != -1);
+  assert(ftruncate(sealed, SIZE) == 0 && ftruncate(other, SIZE) == 0);
+  for (i = 0; i < SIZE; i += 4096) {
+    assert(pwrite(sealed, &i, sizeof(i), i) == sizeof(i));
+  }
+  assert(fcntl(sealed, F_ADD_SEALS, SEALS) == 0);
+
+  // A page of data at 1 MB and at the end, holes elsewhere.
+  assert(sparse != -1 && ftruncate(sparse, SPARSE_SIZE) == 0);
+  assert(pwrite(sparse, "head", 4, 1024 * 1024) == 4);
+  assert(pwrite(sparse, "tail", 4, SPARSE_SIZE - 4) == 4);
+
+  counter = mmap(NULL, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, sealed, 0);
+  assert(counter != MAP_FAILED);
+
+  if (fork() == 0) {
+    char path[64];
+    int fd;
+
+    snprintf(path, sizeof(path), "/proc/%d/fd/%d", parent, other);
+    fd = open(path, O_RDWR);
+    assert(fd != -1);
+    echo = mmap(NULL, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert(echo != MAP_FAILED);
+    while (getppid() == parent) {
+      long count = counter[1];
+      if (count < last) {
+        printf("counter went back: %ld < %ld\n", count, last);
+        exit(1);
+      }
+      last = count;
+      echo[0] = count;
+      check(sealed, "/memfd:memfd1-sealed", SEALS);
+      check(fd, "/memfd:memfd1-other", 0);
+      usleep(1000);
+    }
+    return 0;
+  }
+
+  echo = mmap(NULL, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, other, 0);
+  assert(echo != MAP_FAILED);
+  while (1) {
+    long count = ++counter[1];
+    for (i = 1; i < SIZE / 4096; i++) {
+      int stamp;
+      assert(pread(sealed, &stamp, sizeof(stamp), i * 4096) == sizeof(stamp));
+      if (stamp != i * 4096) {
+        printf("page %d of the sealed memfd lost its stamp\n", i);
+        return 1;
+      }
+    }
+    if (echo[0] > count) {
+      printf("echo %ld ahead of counter %ld\n", echo[0], count);
+      return 1;
+    }
+    check(sealed, "/memfd:memfd1-sealed", SEALS);
+    check(other, "/memfd:memfd1-other", 0);
+    if (count % 1000 == 0) {
+      char head[4], tail[4];
+      if (pread(sparse, head, 4, 1024 * 1024) != 4 ||
+          pread(sparse, tail, 4, SPARSE_SIZE - 4) != 4 ||
+          memcmp(head, "head", 4) != 0 || memcmp(tail, "tail", 4) != 0 ||
+          fstat(sparse, &st) != 0 || st.st_size != SPARSE_SIZE ||
+          st.st_blocks * 512 > 1024 * 1024) {
+        printf("the sparse memfd changed: %lld bytes, %lld blocks\n",
+               (long long)st.st_size, (long long)st.st_blocks);
+        return 1;
+      }
+    }
+    if (count % 10000 == 0) {
+      printf("%ld ", count);
+      fflush(stdout);
+    }
+    usleep(100);
+  }
+  return 0;
+}
+#else // if defined(SYS_memfd_create) && defined(F_ADD_SEALS)
+int
+main(int argc, char **argv)
+{
+  printf("memfd_create() not supported by the headers of this system\n");
+  return 1;
+}
+#endif // if defined(SYS_memfd_create) && defined(F_ADD_SEALS)
@@ -0,0 +1,68 @@
+#!/bin/sh
+
+# Checkpoint budgets:  checkpoint test/standby-server (a process with MB of
+# non-zero memory) without a budget, with --ckpt-write-rate, and with gzip
+# under --ckpt-compress-cpu, and print the duration of the checkpoint for
+# each, as the coordinator measured it (LAST_CKPT_DURATION in
+# dmtcp_command --status):  from the start of the checkpoint until all
+# processes run again.  With a write rate of RATE MB/s,
+# the checkpoint can't take less than MB / RATE seconds.
+#
+# Usage:  test/misc/ckpt-budget.sh [MB [RATE [PERCENT]]]
+#   MB defaults to 256; RATE (MB/s) to 64; PERCENT (CPU share) to 10.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+mb=${1:-256}
+rate=${2:-64}
+percent=${3:-10}
+
+bindir=${DMTCP_BIN:-`dirname $0`/../../bin}
+testdir=`dirname $0`/..
+if [ ! -x $bindir/dmtcp_launch ]; then
+  echo "$bindir/dmtcp_launch not found.  Please build DMTCP first."
+  exit 1
+fi
+if [ ! -x $testdir/standby-server ]; then
+  echo "$testdir/standby-server not found.  Please run 'make -C test standby-server'."
+  exit 1
+fi
+
+tmpdir=`mktemp -d`
+trap "rm -rf $tmpdir" EXIT
+
+wait_for_port() {
+  while [ ! -s $tmpdir/port ]; do sleep 0.1; done
+  port=`cat $tmpdir/port`
+  rm -f $tmpdir/port
+}
+
+# Prints the duration of one checkpoint, in seconds.
+ckpt_duration() {
+  $bindir/dmtcp_launch --new-coordinator --coord-port 0 \
+    --port-file $tmpdir/port --ckptdir $tmpdir "$@" \
+    $testdir/standby-server 7782 $mb > /dev/null 2>&1 &
+  wait_for_port
+  sleep 1
+  $bindir/dmtcp_command --coord-port $port --bcheckpoint > /dev/null
+  # --bcheckpoint returns once the images are written; the duration is known
+  # once the process runs again.
+  while true; do
+    duration=`$bindir/dmtcp_command --coord-port $port --status |
+              sed -n 's/^ *LAST_CKPT_DURATION=//p'`
+    [ -n "$duration" ] && break
+    sleep 0.1
+  done
+  echo "$duration"
+  $bindir/dmtcp_command --coord-port $port --quit > /dev/null
+  wait
+  rm -f $tmpdir/ckpt_*
+}
+
+echo "$mb MB, no gzip:"
+echo "  no budget:                `ckpt_duration --no-gzip`"
+echo "  --ckpt-write-rate ${rate}M:    `ckpt_duration --no-gzip \
+  --ckpt-write-rate ${rate}M` (at least `echo "scale=2; $mb / $rate" | bc` s)"
+echo "$mb MB, gzip:"
+echo "  no budget:                `ckpt_duration --gzip`"
+echo "  --ckpt-compress-cpu $percent:    `ckpt_duration --gzip \
+  --ckpt-compress-cpu $percent`"
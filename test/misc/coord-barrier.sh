@@ -0,0 +1,91 @@
+#!/bin/sh
+
+# Coordinator transport, through the coordinator's Unix-domain socket (the
+# default on its own host) and over TCP (DMTCP_COORD_TCP_ONLY):
+# - the median time of ROUNDS request/reply round trips with the coordinator
+#   (dmtcp_command --status), less the time to start dmtcp_command itself;
+# - the mean time of a blocking checkpoint (dmtcp_command --bcheckpoint) of
+#   NPROCS small processes (sleep), over COUNT checkpoints.  This includes
+#   writing the images.
+#
+# Usage:  test/misc/coord-barrier.sh [NPROCS [COUNT [ROUNDS]]]
+#   NPROCS defaults to 16; COUNT to 20; ROUNDS to 1000.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+nprocs=${1:-16}
+count=${2:-20}
+rounds=${3:-1000}
+
+bindir=${DMTCP_BIN:-`dirname $0`/../../bin}
+if [ ! -x $bindir/dmtcp_launch ]; then
+  echo "$bindir/dmtcp_launch not found.  Please build DMTCP first."
+  exit 1
+fi
+
+tmpdir=`mktemp -d`
+trap "rm -rf $tmpdir" EXIT
+
+wait_for_port() {
+  while [ ! -s $tmpdir/port ]; do sleep 0.1; done
+  port=`cat $tmpdir/port`
+  rm -f $tmpdir/port
+}
+
+# Prints the time of one run of a command, in nanoseconds.
+run_time() {
+  start=`date +%s%N`
+  "$@" > /dev/null 2>&1
+  echo "$start `date +%s%N`" | awk '{ print $2 - $1 }'
+}
+
+# Prints the median time of a round trip with the coordinator, in
+# microseconds.  Each round times dmtcp_command --status, and then
+# dmtcp_command --help, which starts the same way but does not connect; the
+# median of their differences cancels the noise of starting a process, which
+# takes much longer than the round trip itself.  Arguments are environment
+# settings for dmtcp_command and the coordinator.
+median_round_trip() {
+  env "$@" $bindir/dmtcp_coordinator --daemon --quiet --coord-port 0 \
+    --port-file $tmpdir/port > /dev/null 2>&1
+  wait_for_port
+  for i in `seq $rounds`; do
+    rtt=`run_time env "$@" $bindir/dmtcp_command --coord-port $port --status`
+    startup=`run_time env "$@" $bindir/dmtcp_command --help`
+    expr $rtt - $startup
+  done | sort -n > $tmpdir/rtts
+  $bindir/dmtcp_command --coord-port $port --quit > /dev/null
+  awk '{ t[NR] = $1 } END { printf "%.1f\n", t[int((NR + 1) / 2)] / 1e3 }' \
+    $tmpdir/rtts
+  rm -f $tmpdir/rtts
+}
+
+# Prints the mean duration of a checkpoint, in seconds.  Arguments are
+# environment settings for the computation and its coordinator.
+mean_ckpt_duration() {
+  env "$@" $bindir/dmtcp_launch --new-coordinator --coord-port 0 \
+    --port-file $tmpdir/port --ckptdir $tmpdir --no-gzip \
+    sh -c "for i in \`seq $nprocs\`; do sleep 1000 & done; wait" \
+    > /dev/null 2>&1 &
+  wait_for_port
+  while [ "`$bindir/dmtcp_command --coord-port $port --status | \
+            sed -n 's/^ *NUM_PEERS=//p'`" != `expr $nprocs + 1` ]; do
+    sleep 0.1
+  done
+  for i in `seq $count`; do
+    start=`date +%s%N`
+    $bindir/dmtcp_command --coord-port $port --bcheckpoint > /dev/null
+    echo "$start `date +%s%N`" >> $tmpdir/durations
+    rm -f $tmpdir/ckpt_*
+  done
+  $bindir/dmtcp_command --coord-port $port --quit > /dev/null
+  wait
+  awk '{ s += $2 - $1 } END { printf "%.4f\n", s / NR / 1e9 }' $tmpdir/durations
+  rm -f $tmpdir/durations
+}
+
+echo "$rounds round trips with the coordinator, median time (us):"
+echo "  Unix-domain socket: `median_round_trip`"
+echo "  TCP:                `median_round_trip DMTCP_COORD_TCP_ONLY=1`"
+echo "$nprocs processes, $count checkpoints, mean duration (s):"
+echo "  Unix-domain socket: `mean_ckpt_duration`"
+echo "  TCP:                `mean_ckpt_duration DMTCP_COORD_TCP_ONLY=1`"
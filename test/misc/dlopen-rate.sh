@@ -0,0 +1,19 @@
+#!/bin/sh
+
+# Measure the rate of concurrent dlopen/dlclose calls from several threads
+# (test/dlopen3), natively and under DMTCP.
+#
+# Usage:  test/misc/dlopen-rate.sh [NUM_THREADS [CALLS_PER_THREAD]]
+#   NUM_THREADS defaults to 8; CALLS_PER_THREAD defaults to 20000.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+num_threads=${1:-8}
+calls_per_thread=${2:-20000}
+
+. `dirname $0`/rate-runner.sh
+require_test_program dlopen3
+
+LD_LIBRARY_PATH=$testdir${LD_LIBRARY_PATH:+:$LD_LIBRARY_PATH}
+export LD_LIBRARY_PATH
+
+run_native_vs_dmtcp dlopen3 $num_threads $calls_per_thread
@@ -0,0 +1,34 @@
+#!/bin/sh
+
+# Measure the exec rate of a shell loop, natively and under DMTCP.
+# Shell-script-driven pipelines and build systems exec thousands of
+# short-lived tools, so the per-exec overhead of DMTCP matters there.
+#
+# Usage:  test/misc/exec-rate.sh [NUM_EXECS] [PROGRAM]
+#   NUM_EXECS defaults to 1000; PROGRAM defaults to /bin/true.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+iterations=${1:-1000}
+program=${2:-/bin/true}
+
+. `dirname $0`/rate-runner.sh
+
+loop="i=0; while [ \$i -lt $iterations ]; do $program; i=\$((i+1)); done"
+
+# Print the exec rate of the command, in the format of test/bench.h.
+exec_rate() {
+  start=`date +%s%N`
+  "$@" > /dev/null 2>&1
+  end=`date +%s%N`
+  awk -v n=$iterations -v ns=$((end - start)) \
+    'BEGIN { s = ns / 1e9; printf "execs: %d in %.3f s, %.0f/s\n", n, s, n / s }'
+}
+
+rates=`mktemp -d`
+exec_rate sh -c "$loop" > $rates/native
+exec_rate $bindir/dmtcp_launch --new-coordinator --coord-port 0 \
+  sh -c "$loop" > $rates/dmtcp
+sed 's/^/native:  /' $rates/native
+sed 's/^/dmtcp:   /' $rates/dmtcp
+compare_rates $rates/native $rates/dmtcp
+rm -rf $rates
@@ -0,0 +1,15 @@
+#!/bin/sh
+
+# Measure the round-trip rate of a POSIX message queue ping-pong
+# (test/posix-mq3), natively and under DMTCP.
+#
+# Usage:  test/misc/mq-pingpong.sh [ROUND_TRIPS]
+#   ROUND_TRIPS defaults to 100000.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+round_trips=${1:-100000}
+
+. `dirname $0`/rate-runner.sh
+require_test_program posix-mq3
+
+run_native_vs_dmtcp posix-mq3 $round_trips
@@ -0,0 +1,65 @@
+#!/bin/sh
+
+# Measure the cost of system calls that take pids (test/pid-syscalls):
+# natively, under DMTCP, and after a restart with and without
+# dmtcp_restart --native-pids.  With --native-pids, the pid plugin no longer
+# translates pids, and the costs should be back to about the native ones.
+#
+# Usage:  test/misc/pid-syscalls.sh [ITERATIONS]
+#   ITERATIONS defaults to 100000.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+iterations=${1:-100000}
+
+bindir=${DMTCP_BIN:-`dirname $0`/../../bin}
+testdir=`dirname $0`/..
+if [ ! -x $bindir/dmtcp_launch ]; then
+  echo "$bindir/dmtcp_launch not found.  Please build DMTCP first."
+  exit 1
+fi
+if [ ! -x $testdir/pid-syscalls ]; then
+  echo "$testdir/pid-syscalls not found.  Please run 'make -C test pid-syscalls'."
+  exit 1
+fi
+
+tmpdir=`mktemp -d`
+trap "rm -rf $tmpdir" EXIT
+
+wait_for_port() {
+  while [ ! -s $tmpdir/port ]; do sleep 0.1; done
+  port=`cat $tmpdir/port`
+  rm -f $tmpdir/port
+}
+
+printf "native:               "
+$testdir/pid-syscalls $iterations 3 | tail -n 1
+printf "dmtcp:                "
+$bindir/dmtcp_launch --new-coordinator --coord-port 0 \
+  $testdir/pid-syscalls $iterations 3 | tail -n 1
+
+# Checkpoint a long run, then restart it and print its last round.
+$bindir/dmtcp_launch --new-coordinator --coord-port 0 \
+  --port-file $tmpdir/port --ckptdir $tmpdir \
+  $testdir/pid-syscalls $iterations 1000000 > $tmpdir/out 2>&1 &
+wait_for_port
+sleep 2
+$bindir/dmtcp_command --coord-port $port --bcheckpoint > /dev/null
+$bindir/dmtcp_command --coord-port $port --quit > /dev/null
+wait
+
+# $1: extra options of dmtcp_restart
+# The restarted process writes to the stdout of dmtcp_restart.
+restarted() {
+  $bindir/dmtcp_restart --new-coordinator --coord-port 0 \
+    --port-file $tmpdir/port $1 $tmpdir/ckpt_*.dmtcp > $tmpdir/out 2>&1 &
+  wait_for_port
+  sleep 3
+  $bindir/dmtcp_command --coord-port $port --quit > /dev/null
+  wait
+  grep '^getppid' $tmpdir/out | tail -n 1
+}
+
+printf "restarted:            "
+restarted
+printf "restarted, native:    "
+restarted --native-pids
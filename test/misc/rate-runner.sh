@@ -0,0 +1,44 @@
+# Sourced by the benchmarks of this directory that run a test program
+# natively and under DMTCP.  The programs print one line per rate (see
+# test/bench.h):
+#   WHAT: COUNT in SECONDS s, RATE/s
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+bindir=${DMTCP_BIN:-`dirname $0`/../../bin}
+testdir=`dirname $0`/..
+if [ ! -x $bindir/dmtcp_launch ]; then
+  echo "$bindir/dmtcp_launch not found.  Please build DMTCP first."
+  exit 1
+fi
+
+# $1: a program of test/
+require_test_program() {
+  if [ ! -x $testdir/$1 ]; then
+    echo "$testdir/$1 not found.  Please run 'make -C test $1'."
+    exit 1
+  fi
+}
+
+# $1, $2: files with the lines of a native run and of a run under DMTCP.
+# Print each rate under DMTCP as a percentage of the native one.
+compare_rates() {
+  awk -F ': ' '
+    function rate(line) { sub(/.*, /, "", line); sub(/\/s$/, "", line);
+                          return line }
+    NR == FNR { native[FNR] = rate($0); next }
+    native[FNR] > 0 { printf "dmtcp/native:  %5.1f%%  %s\n",
+                             100 * rate($0) / native[FNR], $1 }' $1 $2
+}
+
+# $@: a program of test/ and its arguments.  Run it natively and under DMTCP,
+# then compare the rates that the two runs printed.
+run_native_vs_dmtcp() {
+  rates=`mktemp -d`
+  $testdir/"$@" > $rates/native
+  $bindir/dmtcp_launch --new-coordinator --coord-port 0 \
+    $testdir/"$@" > $rates/dmtcp
+  sed 's/^/native:  /' $rates/native
+  sed 's/^/dmtcp:   /' $rates/dmtcp
+  compare_rates $rates/native $rates/dmtcp
+  rm -rf $rates
+}
@@ -0,0 +1,75 @@
+#!/bin/sh
+
+# Checkpoint test/shared-anon, whose processes share an anonymous and a memfd
+# area, and check that:
+# - the shared areas are written to only one ckpt image:  every image but one
+#   is smaller than the areas;
+# - after restart, the areas are shared again:  the processes are still
+#   running after shared-anon's timeout without a turn (10 s).
+#
+# Usage:  test/misc/shared-ckpt.sh [NPROCS [MB]]
+#   NPROCS defaults to 4; MB (size of each area) defaults to 64.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+nprocs=${1:-4}
+mb=${2:-64}
+
+bindir=${DMTCP_BIN:-`dirname $0`/../../bin}
+testdir=`dirname $0`/..
+if [ ! -x $bindir/dmtcp_launch ]; then
+  echo "$bindir/dmtcp_launch not found.  Please build DMTCP first."
+  exit 1
+fi
+if [ ! -x $testdir/shared-anon ]; then
+  echo "$testdir/shared-anon not found.  Please run 'make -C test shared-anon'."
+  exit 1
+fi
+
+tmpdir=`mktemp -d`
+trap "rm -rf $tmpdir" EXIT
+
+wait_for_port() {
+  while [ ! -s $tmpdir/port ]; do sleep 0.1; done
+  port=`cat $tmpdir/port`
+  rm -f $tmpdir/port
+}
+
+$bindir/dmtcp_launch --new-coordinator --coord-port 0 --no-gzip \
+  --port-file $tmpdir/port --ckptdir $tmpdir \
+  $testdir/shared-anon $nprocs $mb > /dev/null 2>&1 &
+wait_for_port
+sleep 2
+$bindir/dmtcp_command --coord-port $port --bcheckpoint > /dev/null
+$bindir/dmtcp_command --coord-port $port --quit > /dev/null
+wait
+
+areas_kb=$((2 * mb * 1024))
+large=0
+for image in $tmpdir/ckpt_*.dmtcp; do
+  kb=`du -k $image | cut -f 1`
+  echo "`basename $image`: $kb KB"
+  if [ $kb -ge $areas_kb ]; then
+    large=$((large + 1))
+  fi
+done
+echo "shared areas: $areas_kb KB"
+status=0
+if [ $large -ne 1 ]; then
+  echo "FAILED: $large images hold the shared areas; expected 1."
+  status=1
+fi
+
+$bindir/dmtcp_restart --new-coordinator --coord-port 0 \
+  --port-file $tmpdir/port $tmpdir/ckpt_*.dmtcp > /dev/null 2>&1 &
+wait_for_port
+sleep 15
+peers=`$bindir/dmtcp_command --coord-port $port --status | \
+       sed -n 's/.*NUM_PEERS=//p'`
+$bindir/dmtcp_command --coord-port $port --quit > /dev/null
+wait
+echo "processes running after restart: $peers"
+if [ "$peers" != "$nprocs" ]; then
+  echo "FAILED: the areas are not shared after restart."
+  status=1
+fi
+exit $status
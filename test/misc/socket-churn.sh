@@ -0,0 +1,15 @@
+#!/bin/sh
+
+# Measure the accept() and setsockopt() rates of a loopback server
+# (test/socket-churn), natively and under DMTCP.
+#
+# Usage:  test/misc/socket-churn.sh [NUM_CONNECTIONS]
+#   NUM_CONNECTIONS defaults to 20000.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+num_connections=${1:-20000}
+
+. `dirname $0`/rate-runner.sh
+require_test_program socket-churn
+
+run_native_vs_dmtcp socket-churn $num_connections
@@ -0,0 +1,49 @@
+#!/bin/sh
+
+# Measure the time to checkpoint test/sparse-mmap with a small and a large
+# reservation.  Both touch the same number of pages, so with presence-aware
+# memory writing the two checkpoint times should be about the same.
+#
+# Usage:  test/misc/sparse-ckpt.sh [SMALL_GB] [LARGE_GB]
+#   SMALL_GB defaults to 1; LARGE_GB defaults to 64.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+small=${1:-1}
+large=${2:-64}
+
+bindir=${DMTCP_BIN:-`dirname $0`/../../bin}
+testdir=`dirname $0`/..
+if [ ! -x $bindir/dmtcp_launch ]; then
+  echo "$bindir/dmtcp_launch not found.  Please build DMTCP first."
+  exit 1
+fi
+if [ ! -x $testdir/sparse-mmap ]; then
+  echo "$testdir/sparse-mmap not found.  Please run 'make -C test sparse-mmap'."
+  exit 1
+fi
+
+tmpdir=`mktemp -d`
+trap "rm -rf $tmpdir" EXIT
+
+# Print the time, in milliseconds, to checkpoint sparse-mmap with a
+# reservation of $1 GB.
+ckpt_ms() {
+  $bindir/dmtcp_launch --new-coordinator --coord-port 0 \
+    --port-file $tmpdir/port --ckptdir $tmpdir \
+    $testdir/sparse-mmap $1 > /dev/null 2>&1 &
+  while [ ! -s $tmpdir/port ]; do sleep 0.1; done
+  port=`cat $tmpdir/port`
+  sleep 2
+
+  start=`date +%s%N`
+  $bindir/dmtcp_command --coord-port $port --bcheckpoint > /dev/null
+  end=`date +%s%N`
+
+  $bindir/dmtcp_command --coord-port $port --quit > /dev/null
+  wait
+  rm -rf $tmpdir/*
+  echo $(( (end - start) / 1000000 ))
+}
+
+printf "%4d GB reservation: %6d ms\n" $small `ckpt_ms $small`
+printf "%4d GB reservation: %6d ms\n" $large `ckpt_ms $large`
@@ -0,0 +1,64 @@
+#!/bin/sh
+
+# Hot standby (dmtcp_restart --standby):  run test/standby-server under DMTCP
+# with a checkpoint every second, follow its checkpoints with a standby
+# replica, kill the server, and measure the time until the replica serves
+# (time-to-serve).
+#
+# Usage:  test/misc/standby.sh [MB [PORT]]
+#   MB (memory of the server) defaults to 256; PORT defaults to 7781.
+# Set DMTCP_BIN to test an installed DMTCP instead of the build tree.
+
+mb=${1:-256}
+svcport=${2:-7781}
+
+bindir=${DMTCP_BIN:-`dirname $0`/../../bin}
+testdir=`dirname $0`/..
+if [ ! -x $bindir/dmtcp_launch ]; then
+  echo "$bindir/dmtcp_launch not found.  Please build DMTCP first."
+  exit 1
+fi
+if [ ! -x $testdir/standby-server ]; then
+  echo "$testdir/standby-server not found.  Please run 'make -C test standby-server'."
+  exit 1
+fi
+
+tmpdir=`mktemp -d`
+trap "rm -rf $tmpdir" EXIT
+
+wait_for_port() {
+  while [ ! -s $tmpdir/port ]; do sleep 0.1; done
+  port=`cat $tmpdir/port`
+  rm -f $tmpdir/port
+}
+
+$bindir/dmtcp_launch --new-coordinator --coord-port 0 --no-gzip \
+  --port-file $tmpdir/port --ckptdir $tmpdir --interval 1 \
+  $testdir/standby-server $svcport $mb > /dev/null 2>&1 &
+primary=$!
+wait_for_port
+primary_port=$port
+while ! ls $tmpdir/ckpt_*.dmtcp > /dev/null 2>&1; do sleep 0.1; done
+
+# The replica has a coordinator of its own.
+$bindir/dmtcp_restart --standby --new-coordinator --coord-port 0 \
+  --port-file $tmpdir/port $tmpdir/ckpt_*.dmtcp > /dev/null 2>&1 &
+wait_for_port
+standby_port=$port
+
+# Let the replica apply a few checkpoints.
+sleep 5
+$testdir/standby-server -c $svcport 1 | sed 's/^/primary:  /'
+
+kill -9 $primary
+$bindir/dmtcp_command --coord-port $primary_port --quit > /dev/null 2>&1
+printf "replica:  "
+$testdir/standby-server -c $svcport 10
+status=$?
+
+$bindir/dmtcp_command --coord-port $standby_port --quit > /dev/null 2>&1
+wait
+if [ $status -ne 0 ]; then
+  echo "FAILED: the standby replica did not take over."
+fi
+exit $status
@@ -0,0 +1,87 @@
+/* Time system calls that take or return pids, which DMTCP's pid plugin
+ * translates between virtual and real pids (unless the process was restarted
+ * with dmtcp_restart --native-pids).
+ *
+ * Usage:  ./pid-syscalls [ITERATIONS [ROUNDS]]
+ *   ITERATIONS defaults to 100000.  Without ROUNDS, loop forever (as a
+ *   checkpoint test).  With ROUNDS, print the cost of each call in ns after
+ *   each round (as a benchmark; see test/misc/pid-syscalls.sh).
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+static double
+now_ns()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main(int argc, char **argv)
+{
+  long iterations = argc > 1 ? atol(argv[1]) : 100000;
+  long rounds = argc > 2 ? atol(argv[2]) : -1;
+  char procPath[64];
+  long round;
+  long i;
+
+  assert(iterations > 0);
+  for (round = 0; rounds < 0 || round < rounds; round++) {
+    double start;
+    double getppid_ns, kill_ns, getpgid_ns, tgkill_ns, proc_ns;
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+      assert(getppid() > 0);
+    }
+    getppid_ns = (now_ns() - start) / iterations;
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+      assert(kill(getpid(), 0) == 0);
+    }
+    kill_ns = (now_ns() - start) / iterations;
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+      assert(getpgid(0) > 0);
+    }
+    getpgid_ns = (now_ns() - start) / iterations;
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+      assert(syscall(SYS_tgkill, getpid(), syscall(SYS_gettid), 0) == 0);
+    }
+    tgkill_ns = (now_ns() - start) / iterations;
+
+    /* The pid in the path is translated, too. */
+    snprintf(procPath, sizeof(procPath), "/proc/%d/stat", getpid());
+    start = now_ns();
+    for (i = 0; i < iterations / 10 + 1; i++) {
+      int fd = open(procPath, O_RDONLY);
+      assert(fd != -1);
+      close(fd);
+    }
+    proc_ns = (now_ns() - start) / (iterations / 10 + 1);
+
+    if (rounds < 0) {
+      continue;
+    }
+    printf("getppid %.0f  kill %.0f  getpgid %.0f  tgkill %.0f  "
+           "open(/proc/PID) %.0f  (ns/call)\n",
+           getppid_ns, kill_ns, getpgid_ns, tgkill_ns, proc_ns);
+    fflush(stdout);
+  }
+  return 0;
+}
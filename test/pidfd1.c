@@ -0,0 +1,145 @@
+/* A supervisor that keeps a few children going, each watched through a pidfd
+ * in an epoll set.  The supervisor signals its children with
+ * pidfd_send_signal(); a child exits after a number of signals, with a status
+ * of its own, and the supervisor reaps it with waitid(P_PIDFD) and starts
+ * another one.  After a checkpoint or restart, the children must still get
+ * their signals, and each exit must be seen through its pidfd, with the right
+ * pid and status.
+ *
+ * Usage:  pidfd1
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(SYS_pidfd_open) && defined(SYS_pidfd_send_signal)
+# define CHILDREN 3
+# define SIGNALS  50
+
+# if !__GLIBC_PREREQ(2, 36)
+#  define P_PIDFD ((idtype_t)3)
+# endif // if !__GLIBC_PREREQ(2, 36)
+
+static volatile int signals = 0;
+
+static void
+handler(int sig)
+{
+  signals++;
+}
+
+static void
+child(int i)
+{
+  sigset_t mask;
+
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  sigemptyset(&mask);
+  while (signals < SIGNALS) {
+    sigsuspend(&mask);
+  }
+  exit(10 + i);
+}
+
+static void
+spawn(int ep, int i, pid_t *pid, int *pidfd)
+{
+  struct epoll_event ev;
+
+  pid[i] = fork();
+  assert(pid[i] != -1);
+  if (pid[i] == 0) {
+    child(i);
+  }
+  pidfd[i] = syscall(SYS_pidfd_open, pid[i], 0);
+  assert(pidfd[i] != -1);
+  ev.events = EPOLLIN;
+  ev.data.u32 = i;
+  assert(epoll_ctl(ep, EPOLL_CTL_ADD, pidfd[i], &ev) == 0);
+}
+
+int
+main(int argc, char **argv)
+{
+  pid_t pid[CHILDREN];
+  int pidfd[CHILDREN];
+  struct sigaction sa;
+  sigset_t mask;
+  long count = 0;
+  int ep;
+  int i;
+
+  // Children wait for SIGUSR1 in sigsuspend(); block it in between.
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handler;
+  assert(sigaction(SIGUSR1, &sa, NULL) == 0);
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  assert(sigprocmask(SIG_BLOCK, &mask, NULL) == 0);
+
+  ep = epoll_create1(0);
+  assert(ep != -1);
+  for (i = 0; i < CHILDREN; i++) {
+    spawn(ep, i, pid, pidfd);
+  }
+
+  while (1) {
+    struct epoll_event events[CHILDREN];
+    int n = epoll_wait(ep, events, CHILDREN, 10);
+    int j;
+
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    assert(n != -1);
+    for (j = 0; j < n; j++) {
+      siginfo_t info;
+
+      i = events[j].data.u32;
+      memset(&info, 0, sizeof(info));
+      if (waitid(P_PIDFD, pidfd[i], &info, WEXITED) != 0 ||
+          info.si_pid != pid[i] || info.si_code != CLD_EXITED ||
+          info.si_status != 10 + i) {
+        printf("child %d (%d): pid %d, code %d, status %d: %s\n", i, pid[i],
+               info.si_pid, info.si_code, info.si_status, strerror(errno));
+        return 1;
+      }
+      assert(epoll_ctl(ep, EPOLL_CTL_DEL, pidfd[i], NULL) == 0);
+      close(pidfd[i]);
+      spawn(ep, i, pid, pidfd);
+      if (++count % 10 == 0) {
+        printf("%ld ", count);
+        fflush(stdout);
+      }
+    }
+
+    // A child that has exited, but is not reaped yet, still takes signals.
+    for (i = 0; i < CHILDREN; i++) {
+      if (syscall(SYS_pidfd_send_signal, pidfd[i], SIGUSR1, NULL, 0) != 0) {
+        printf("pidfd_send_signal to child %d (%d): %s\n", i, pid[i],
+               strerror(errno));
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+#else // if defined(SYS_pidfd_open) && defined(SYS_pidfd_send_signal)
+int
+main(int argc, char **argv)
+{
+  printf("pidfd_open() not supported by the headers of this system\n");
+  return 1;
+}
+#endif // if defined(SYS_pidfd_open) && defined(SYS_pidfd_send_signal)
@@ -0,0 +1,107 @@
+/* Ping-pong between a parent and a child over two POSIX message queues.
+ *
+ * Usage:  posix-mq3 [ROUND_TRIPS]
+ *   See bench.h and test/misc/mq-pingpong.sh.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <mqueue.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define MSG_SIZE 64
+
+static mqd_t
+open_queue(const char *name)
+{
+  struct mq_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.mq_maxmsg = 1;
+  attr.mq_msgsize = MSG_SIZE;
+
+  mqd_t mqdes = mq_open(name, O_RDWR | O_CREAT, 0666, &attr);
+  if (mqdes == -1) {
+    perror("mq_open() failed");
+    exit(1);
+  }
+  return mqdes;
+}
+
+static void
+bounce(mqd_t in, mqd_t out, long i, int send_first)
+{
+  char buf[MSG_SIZE];
+
+  if (send_first) {
+    snprintf(buf, sizeof(buf), "%ld", i);
+    if (mq_send(out, buf, strlen(buf) + 1, 0) == -1) {
+      perror("mq_send failed");
+      exit(1);
+    }
+  }
+
+  if (mq_receive(in, buf, sizeof(buf), NULL) == -1) {
+    perror("mq_receive failed");
+    exit(1);
+  }
+  if (atol(buf) != i) {
+    printf("Msg mismatch: expected: %ld, got: %s\n", i, buf);
+    exit(1);
+  }
+
+  if (!send_first && mq_send(out, buf, strlen(buf) + 1, 0) == -1) {
+    perror("mq_send failed");
+    exit(1);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  long round_trips = bench_count(argc, argv, 1);
+  char ping[64], pong[64];
+
+  snprintf(ping, sizeof(ping), "/dmtcp-mq-ping-%d", getpid());
+  snprintf(pong, sizeof(pong), "/dmtcp-mq-pong-%d", getpid());
+  // Queues left behind by a killed run under DMTCP have the same names (the
+  // pid is a virtual one), and may still hold a message of that run.
+  mq_unlink(ping);
+  mq_unlink(pong);
+  mqd_t ping_mq = open_queue(ping);
+  mqd_t pong_mq = open_queue(pong);
+
+  pid_t child = fork();
+  assert(child != -1);
+
+  double start = bench_now();
+  long i;
+
+  for (i = 0; bench_more(i, round_trips); i++) {
+    if (child > 0) {
+      bounce(pong_mq, ping_mq, i, 1);
+      bench_progress(i, round_trips, 10000);
+    } else {
+      bounce(ping_mq, pong_mq, i, 0);
+    }
+  }
+
+  if (child == 0) {
+    return 0;
+  }
+
+  double elapsed = bench_now() - start;
+  waitpid(child, NULL, 0);
+  mq_unlink(ping);
+  mq_unlink(pong);
+
+  bench_report("round trips", round_trips, elapsed);
+  return 0;
+}
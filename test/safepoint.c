@@ -0,0 +1,86 @@
+/* Compile with:  gcc THIS_FILE -lpthread
+ * Run with:  dmtcp_launch --quiesce-timeout 100 ./safepoint
+ *
+ * Worker threads call dmtcp_safe_point() in their inner loop and so park
+ * themselves when a checkpoint is pending; each checkpoint or restart must
+ * return to every one of them through its safe point.  The main thread never
+ * calls it, and so is signalled right away, as usual.  It checks the workers
+ * after each checkpoint, and that a suspend latency was reported.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dmtcp.h"
+
+#define NUM_THREADS 4
+
+static volatile unsigned long counters[NUM_THREADS];
+static volatile unsigned long parked[NUM_THREADS];
+
+void *
+worker(void *arg)
+{
+  long id = (long)arg;
+
+  while (1) {
+    counters[id]++;
+    int rc = dmtcp_safe_point();
+    if (rc == DMTCP_AFTER_CHECKPOINT || rc == DMTCP_AFTER_RESTART) {
+      parked[id]++;
+    } else {
+      assert(rc == 0 || rc == DMTCP_NOT_PRESENT);
+    }
+  }
+  return NULL;
+}
+
+int
+main()
+{
+  pthread_t threads[NUM_THREADS];
+  unsigned long seen[NUM_THREADS] = { 0 };
+  int numCheckpoints = 0;
+  int numRestarts = 0;
+  long i;
+
+  for (i = 0; i < NUM_THREADS; i++) {
+    assert(pthread_create(&threads[i], NULL, worker, (void *)i) == 0);
+  }
+
+  while (1) {
+    int c, r;
+    sleep(1);
+
+    if (dmtcp_get_local_status(&c, &r) == DMTCP_IS_PRESENT &&
+        (c != numCheckpoints || r != numRestarts)) {
+      numCheckpoints = c;
+      numRestarts = r;
+
+      // The workers resume with us; give them a moment to get out of
+      // dmtcp_safe_point().
+      for (i = 0; i < NUM_THREADS; i++) {
+        int tries;
+        for (tries = 0; parked[i] == seen[i] && tries < 1000; tries++) {
+          usleep(1000);
+        }
+        if (parked[i] == seen[i]) {
+          printf("thread %ld was not suspended at its safe point\n", i);
+          return 1;
+        }
+        seen[i] = parked[i];
+      }
+      if (dmtcp_get_suspend_latency() == 0) {
+        printf("no suspend latency reported\n");
+        return 1;
+      }
+      printf("checkpoints: %d, restarts: %d, suspend latency: %llu us\n",
+             c, r, (unsigned long long)dmtcp_get_suspend_latency());
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,121 @@
+/* Share an anonymous (MAP_SHARED | MAP_ANONYMOUS) and a memfd area between
+ * forked processes.  The processes take turns:  on its turn, a process checks
+ * the page stamped by the previous one, and stamps the next page.  If the
+ * areas are not shared after restart, the turns stop and the processes exit.
+ *
+ * Usage:  shared-anon [NPROCS [MB]]
+ *   NPROCS (total number of processes) defaults to 2; MB (size of each area)
+ *   defaults to 8.  See test/misc/shared-ckpt.sh for the size of the ckpt
+ *   images.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define PAGE_SIZE 4096
+
+/* About 10 s of running time (checkpoints don't count) without a turn. */
+#define MAX_WAITS 10000
+
+struct turn {
+  volatile long count;
+};
+
+static char *
+map_memfd(size_t len)
+{
+#ifdef SYS_memfd_create
+  int fd = syscall(SYS_memfd_create, "shared-anon", 0);
+  if (fd != -1) {
+    char *area;
+
+    assert(ftruncate(fd, len) == 0);
+    area = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert(area != MAP_FAILED);
+    close(fd);
+    return area;
+  }
+#endif // ifdef SYS_memfd_create
+  return NULL;
+}
+
+static void
+check_and_stamp(char *area, size_t npages, long count)
+{
+  if (area == NULL) {
+    return;
+  }
+  if (count > 0 &&
+      *(long *)(area + ((count - 1) % npages) * PAGE_SIZE) != count - 1) {
+    printf("area %p is not shared (turn %ld)\n", area, count);
+    exit(1);
+  }
+  *(long *)(area + (count % npages) * PAGE_SIZE) = count;
+}
+
+int
+main(int argc, char **argv)
+{
+  int nprocs = argc > 1 ? atoi(argv[1]) : 2;
+  size_t len = (size_t)(argc > 2 ? atol(argv[2]) : 8) << 20;
+  size_t npages = len / PAGE_SIZE;
+  struct turn *turn;
+  char *anon;
+  char *memfd;
+  int id;
+  int waits = 0;
+  size_t i;
+
+  assert(nprocs > 0 && npages > 0);
+  turn = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  anon = mmap(NULL, len, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  assert(turn != MAP_FAILED && anon != MAP_FAILED);
+  memfd = map_memfd(len);
+
+  // Fill the areas, so that they can't be saved as zero pages.
+  for (i = 0; i < len; i += sizeof(long)) {
+    *(long *)(anon + i) = -1;
+    if (memfd != NULL) {
+      *(long *)(memfd + i) = -1;
+    }
+  }
+  turn->count = 0;
+
+  for (id = 0; id < nprocs - 1; id++) {
+    if (fork() == 0) {
+      break;
+    }
+  }
+
+  while (1) {
+    long count = turn->count;
+
+    if (count % nprocs != id) {
+      if (++waits > MAX_WAITS) {
+        printf("process %d: no turn after %ld\n", id, count);
+        return 1;
+      }
+      usleep(1000);
+      continue;
+    }
+    waits = 0;
+    check_and_stamp(anon, npages, count);
+    check_and_stamp(memfd, npages, count);
+    if (count % 1000 == 0) {
+      printf("%ld ", count);
+      fflush(stdout);
+    }
+    __sync_synchronize();
+    turn->count = count + 1;
+  }
+  return 0;
+}
@@ -0,0 +1,99 @@
+/* A loopback server that accepts short-lived connections and toggles
+ * TCP_CORK on each of them, as busy HTTP servers do per response.
+ *
+ * Usage:  socket-churn [NUM_CONNECTIONS]
+ *   See bench.h and test/misc/socket-churn.sh.
+ */
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define SETSOCKOPTS_PER_CONNECTION 16
+
+static void
+client(struct sockaddr_in *addr, long num_connections)
+{
+  long i;
+
+  for (i = 0; bench_more(i, num_connections); i++) {
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(sd != -1);
+    assert(connect(sd, (struct sockaddr *)addr, sizeof(*addr)) == 0);
+
+    // Wait for the server to close its end.
+    char c;
+    assert(read(sd, &c, 1) == 0);
+    close(sd);
+  }
+  exit(0);
+}
+
+int
+main(int argc, char **argv)
+{
+  long num_connections = bench_count(argc, argv, 1);
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof(addr);
+  int one = 1;
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  assert(listener != -1);
+  assert(setsockopt(listener, SOL_SOCKET, SO_REUSEADDR,
+                    &one, sizeof(one)) == 0);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  assert(bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  assert(getsockname(listener, (struct sockaddr *)&addr, &addrlen) == 0);
+  assert(listen(listener, 128) == 0);
+
+  pid_t child = fork();
+  assert(child != -1);
+  if (child == 0) {
+    close(listener);
+    client(&addr, num_connections);
+  }
+
+  double accept_time = 0;
+  double setsockopt_time = 0;
+  long i;
+
+  for (i = 0; bench_more(i, num_connections); i++) {
+    double t0 = bench_now();
+    int sd = accept(listener, NULL, NULL);
+    assert(sd != -1);
+    double t1 = bench_now();
+
+    int j;
+    for (j = 0; j < SETSOCKOPTS_PER_CONNECTION; j++) {
+      int cork = j % 2 == 0;
+      assert(setsockopt(sd, IPPROTO_TCP, TCP_CORK,
+                        &cork, sizeof(cork)) == 0);
+    }
+    double t2 = bench_now();
+    close(sd);
+
+    accept_time += t1 - t0;
+    setsockopt_time += t2 - t1;
+    bench_progress(i, num_connections, 1000);
+  }
+
+  waitpid(child, NULL, 0);
+  bench_report("accepts", num_connections, accept_time);
+  bench_report("setsockopts", num_connections * SETSOCKOPTS_PER_CONNECTION,
+               setsockopt_time);
+  return 0;
+}
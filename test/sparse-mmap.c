@@ -0,0 +1,60 @@
+/* Reserve a large, sparsely populated anonymous mapping, as garbage-collected
+ * runtimes and address-space-reserving allocators do.  Only a few megabytes
+ * are ever touched, so checkpointing should take time proportional to that,
+ * not to the size of the reservation.
+ *
+ * Usage:  sparse-mmap [RESERVATION_GB]
+ *   RESERVATION_GB defaults to 64.  If the kernel refuses the reservation,
+ *   it is halved until it succeeds.  See test/misc/sparse-ckpt.sh.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define TOUCHED_PAGES 4096
+#define PAGE_SIZE     4096
+
+int
+main(int argc, char **argv)
+{
+  size_t gb = argc > 1 ? atol(argv[1]) : 64;
+  size_t len = gb << 30;
+  char *base;
+
+  while (1) {
+    base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base != MAP_FAILED) {
+      break;
+    }
+    assert(len > (1UL << 30));
+    len /= 2;
+  }
+  printf("reserved %zu MB at %p\n", len >> 20, base);
+  fflush(stdout);
+
+  // Touch pages spread evenly over the whole reservation.
+  size_t stride = len / TOUCHED_PAGES;
+  size_t i;
+  for (i = 0; i < TOUCHED_PAGES; i++) {
+    *(long *)(base + i * stride) = i + 1;
+  }
+
+  long count = 0;
+  while (1) {
+    for (i = 0; i < TOUCHED_PAGES; i++) {
+      assert(*(long *)(base + i * stride) == (long)(i + 1));
+      // The page after each touched page must still read as zero.
+      assert(*(long *)(base + i * stride + PAGE_SIZE) == 0);
+    }
+    if (++count % 10 == 0) {
+      printf("%ld ", count);
+      fflush(stdout);
+    }
+    sleep(1);
+  }
+  return 0;
+}
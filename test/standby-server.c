@@ -0,0 +1,123 @@
+/* A loopback server with some state in memory, for hot-standby tests
+ * (dmtcp_restart --standby).  It keeps rewriting a few pages of a larger
+ * area, so that each checkpoint changes a little of its memory, and answers
+ * each connection with its request count.
+ *
+ * Usage:  standby-server PORT [MB]
+ *           Serve on 127.0.0.1:PORT; MB (size of the area) defaults to 64.
+ *         standby-server -c PORT [TIMEOUT_SEC]
+ *           Connect to the server until it answers, and print how long that
+ *           took (time-to-serve).  TIMEOUT_SEC defaults to 10.
+ * See test/misc/standby.sh.
+ */
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PAGE_SIZE 4096
+
+static double
+now_sec()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+client(struct sockaddr_in *addr, double timeout)
+{
+  double start = now_sec();
+  struct timespec delay = { 0, 1000000 };
+
+  while (now_sec() - start < timeout) {
+    char buf[64];
+    ssize_t len;
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+
+    assert(sd != -1);
+    if (connect(sd, (struct sockaddr *)addr, sizeof(*addr)) == 0 &&
+        (len = read(sd, buf, sizeof(buf) - 1)) > 0) {
+      buf[len] = '\0';
+      printf("served after %.1f ms: %s\n", (now_sec() - start) * 1000, buf);
+      close(sd);
+      return 0;
+    }
+    close(sd);
+    nanosleep(&delay, NULL);
+  }
+  printf("not served within %.1f s\n", timeout);
+  return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+  struct sockaddr_in addr;
+  int one = 1;
+  int is_client = argc > 1 && strcmp(argv[1], "-c") == 0;
+
+  if (argc < 2 + is_client) {
+    fprintf(stderr, "Usage: %s [-c] PORT [MB | TIMEOUT_SEC]\n", argv[0]);
+    return 1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(atoi(argv[1 + is_client]));
+  if (is_client) {
+    return client(&addr, argc > 3 ? atof(argv[3]) : 10);
+  }
+
+  size_t len = (size_t)(argc > 2 ? atol(argv[2]) : 64) << 20;
+  size_t npages = len / PAGE_SIZE;
+  char *area = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  assert(area != MAP_FAILED && npages > 0);
+  memset(area, 0xff, len);
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  assert(listener != -1);
+  assert(setsockopt(listener, SOL_SOCKET, SO_REUSEADDR,
+                    &one, sizeof(one)) == 0);
+  if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    perror("bind");
+    return 1;
+  }
+  assert(listen(listener, 128) == 0);
+
+  long requests = 0;
+  long tick;
+  for (tick = 0;; tick++) {
+    struct timeval timeout = { 0, 10000 };
+    fd_set fds;
+
+    // Rewrite a page; the area changes by about 100 pages a second.
+    *(long *)(area + (tick % npages) * PAGE_SIZE) = tick;
+
+    FD_ZERO(&fds);
+    FD_SET(listener, &fds);
+    if (select(listener + 1, &fds, NULL, NULL, &timeout) > 0) {
+      int sd = accept(listener, NULL, NULL);
+      if (sd != -1) {
+        char buf[64];
+        int n = snprintf(buf, sizeof(buf), "request %ld, tick %ld",
+                         ++requests, tick);
+        assert(write(sd, buf, n) == n);
+        close(sd);
+      }
+    }
+  }
+  return 0;
+}
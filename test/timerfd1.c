@@ -0,0 +1,82 @@
+/* An event loop on many timerfds.  Periodic timers of several clocks and
+ * intervals are polled through epoll; after a checkpoint or restart, they
+ * must keep firing, and an armed one-shot timer must stay armed.
+ *
+ * Usage:  timerfd1 [NTIMERS]   (default: 1000)
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+int
+main(int argc, char **argv)
+{
+  int ntimers = argc > 1 ? atoi(argv[1]) : 1000;
+  clockid_t clocks[] = { CLOCK_MONOTONIC, CLOCK_REALTIME, CLOCK_BOOTTIME };
+  struct epoll_event events[64];
+  struct itimerspec spec;
+  struct timespec now;
+  uint64_t expirations = 0;
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  int oneshot;
+  int i;
+
+  assert(epfd != -1 && ntimers > 0);
+  for (i = 0; i < ntimers; i++) {
+    int fd = timerfd_create(clocks[i % 3], TFD_NONBLOCK | TFD_CLOEXEC);
+    struct epoll_event ev = { EPOLLIN, { .fd = fd } };
+
+    assert(fd != -1);
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = (10 + i % 50) * 1000000;
+    spec.it_value = spec.it_interval;
+    assert(timerfd_settime(fd, 0, &spec, NULL) == 0);
+    assert(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0);
+  }
+
+  // An absolute CLOCK_REALTIME deadline, an hour from now.
+  oneshot = timerfd_create(CLOCK_REALTIME, 0);
+  assert(oneshot != -1);
+  assert(clock_gettime(CLOCK_REALTIME, &now) == 0);
+  spec.it_interval.tv_sec = spec.it_interval.tv_nsec = 0;
+  spec.it_value.tv_sec = now.tv_sec + 3600;
+  spec.it_value.tv_nsec = 0;
+  assert(timerfd_settime(oneshot, TFD_TIMER_ABSTIME, &spec, NULL) == 0);
+
+  while (1) {
+    int n = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]), 2000);
+
+    if (n == -1) {
+      continue;  // EINTR
+    }
+    if (n == 0) {
+      printf("timerfds stopped firing after %llu expirations\n",
+             (unsigned long long)expirations);
+      return 1;
+    }
+    for (i = 0; i < n; i++) {
+      uint64_t count;
+      if (read(events[i].data.fd, &count, sizeof(count)) == sizeof(count)) {
+        if (expirations / 100000 != (expirations + count) / 100000) {
+          printf("%llu ", (unsigned long long)(expirations + count));
+          fflush(stdout);
+        }
+        expirations += count;
+      }
+    }
+
+    assert(timerfd_gettime(oneshot, &spec) == 0);
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+      printf("one-shot timerfd was disarmed\n");
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,204 @@
+/* Exchange sequence-numbered datagrams over loopback UDP and over AF_UNIX
+ * datagram sockets.  The sender keeps a window of datagrams in flight, so a
+ * checkpoint usually finds some of them queued at the receiver.  A datagram
+ * that is lost or duplicated across a checkpoint shows up as a sequence
+ * mismatch.  A datagram must arrive from the address of its sender, unless
+ * it was replayed after a restart.
+ *
+ * The senders are bound and connected to the receivers; the receivers are
+ * bound but not connected, and acknowledge each window with sendto().
+ *
+ * Usage:  udp [NUM_WINDOWS]
+ *   Without NUM_WINDOWS, run forever (as a checkpoint test).
+ */
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "dmtcp.h"
+
+#define WINDOW 8
+
+struct endpoint {
+  int sd;
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+};
+
+static void
+bind_inet(struct endpoint *ep)
+{
+  struct sockaddr_in *addr = (struct sockaddr_in *)&ep->addr;
+
+  ep->sd = socket(AF_INET, SOCK_DGRAM, 0);
+  assert(ep->sd != -1);
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr->sin_port = 0;
+  assert(bind(ep->sd, (struct sockaddr *)addr, sizeof(*addr)) == 0);
+  ep->addrlen = sizeof(ep->addr);
+  assert(getsockname(ep->sd, (struct sockaddr *)&ep->addr,
+                     &ep->addrlen) == 0);
+}
+
+static void
+bind_unix(struct endpoint *ep, const char *name)
+{
+  struct sockaddr_un *addr = (struct sockaddr_un *)&ep->addr;
+
+  ep->sd = socket(AF_UNIX, SOCK_DGRAM, 0);
+  assert(ep->sd != -1);
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  snprintf(addr->sun_path, sizeof(addr->sun_path), "/tmp/dmtcp-udp-%d-%s",
+           getpid(), name);
+  unlink(addr->sun_path);
+  ep->addrlen = sizeof(*addr);
+  assert(bind(ep->sd, (struct sockaddr *)addr, ep->addrlen) == 0);
+}
+
+static void
+send_window(struct endpoint *sender, long first)
+{
+  long seq;
+
+  for (seq = first; seq < first + WINDOW; seq++) {
+    assert(send(sender->sd, &seq, sizeof(seq), 0) == sizeof(seq));
+  }
+}
+
+static void
+recv_ack(struct endpoint *sender, long first)
+{
+  long ack;
+
+  assert(recv(sender->sd, &ack, sizeof(ack), 0) == sizeof(ack));
+  if (ack != first + WINDOW - 1) {
+    printf("Ack mismatch: expected: %ld, got: %ld\n", first + WINDOW - 1, ack);
+    exit(1);
+  }
+}
+
+static int
+num_restarts(void)
+{
+  int numCheckpoints = 0;
+  int numRestarts = 0;
+
+  dmtcp_get_local_status(&numCheckpoints, &numRestarts);
+  return numRestarts;
+}
+
+static int
+same_addr(struct sockaddr_storage *a, struct sockaddr_storage *b)
+{
+  if (a->ss_family != b->ss_family) {
+    return 0;
+  }
+  if (a->ss_family == AF_INET) {
+    struct sockaddr_in *ina = (struct sockaddr_in *)a;
+    struct sockaddr_in *inb = (struct sockaddr_in *)b;
+    return ina->sin_port == inb->sin_port &&
+           ina->sin_addr.s_addr == inb->sin_addr.s_addr;
+  }
+  return strcmp(((struct sockaddr_un *)a)->sun_path,
+                ((struct sockaddr_un *)b)->sun_path) == 0;
+}
+
+static void
+recv_window(struct endpoint *receiver, struct endpoint *sender, long first)
+{
+  struct sockaddr_storage from;
+  socklen_t fromlen;
+  long seq;
+  long expected;
+  int restarts = num_restarts();
+  int wrongSender = 0;
+
+  for (expected = first; expected < first + WINDOW; expected++) {
+    fromlen = sizeof(from);
+    assert(recvfrom(receiver->sd, &seq, sizeof(seq), 0,
+                    (struct sockaddr *)&from, &fromlen) == sizeof(seq));
+    if (seq != expected) {
+      printf("Datagram mismatch: expected: %ld, got: %ld\n", expected, seq);
+      exit(1);
+    }
+    if (!same_addr(&from, &sender->addr)) {
+      wrongSender = 1;
+    }
+  }
+
+  // A checkpoint must leave queued datagrams alone; only a restart, which
+  // replays them, may change the address that they come from.
+  if (wrongSender && num_restarts() == restarts) {
+    printf("Datagram from the wrong sender in window %ld\n", first / WINDOW);
+    exit(1);
+  }
+
+  // Acknowledge to the known address of the sender: a datagram replayed
+  // after restart may arrive from a different address.
+  assert(sendto(receiver->sd, &seq, sizeof(seq), 0,
+                (struct sockaddr *)&sender->addr,
+                sender->addrlen) == sizeof(seq));
+}
+
+int
+main(int argc, char **argv)
+{
+  long num_windows = argc > 1 ? atol(argv[1]) : -1;
+  struct endpoint inet_receiver, inet_sender;
+  struct endpoint unix_receiver, unix_sender;
+
+  bind_inet(&inet_receiver);
+  bind_inet(&inet_sender);
+  bind_unix(&unix_receiver, "recv");
+  bind_unix(&unix_sender, "send");
+  assert(connect(inet_sender.sd, (struct sockaddr *)&inet_receiver.addr,
+                 inet_receiver.addrlen) == 0);
+  assert(connect(unix_sender.sd, (struct sockaddr *)&unix_receiver.addr,
+                 unix_receiver.addrlen) == 0);
+
+  pid_t child = fork();
+  assert(child != -1);
+
+  long i;
+  if (child == 0) {
+    close(inet_receiver.sd);
+    close(unix_receiver.sd);
+    for (i = 0; num_windows < 0 || i < num_windows; i++) {
+      send_window(&inet_sender, i * WINDOW);
+      send_window(&unix_sender, i * WINDOW);
+      recv_ack(&inet_sender, i * WINDOW);
+      recv_ack(&unix_sender, i * WINDOW);
+    }
+    return 0;
+  }
+
+  close(inet_sender.sd);
+  close(unix_sender.sd);
+  for (i = 0; num_windows < 0 || i < num_windows; i++) {
+    recv_window(&inet_receiver, &inet_sender, i * WINDOW);
+    recv_window(&unix_receiver, &unix_sender, i * WINDOW);
+    if (num_windows < 0 && i % 10000 == 0) {
+      printf("%ld ", i);
+      fflush(stdout);
+    }
+  }
+
+  waitpid(child, NULL, 0);
+  unlink(((struct sockaddr_un *)&unix_receiver.addr)->sun_path);
+  unlink(((struct sockaddr_un *)&unix_sender.addr)->sun_path);
+  printf("%ld windows of %d datagrams received in order\n",
+         num_windows, WINDOW);
+  return 0;
+}
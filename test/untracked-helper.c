@@ -0,0 +1,60 @@
+/* Starts short-lived helpers back to back, alternately with fork()/exec() and
+ * with posix_spawnp(), so that a checkpoint nearly always finds one running.
+ * Run with --untracked-helpers sleep:  the helpers then run outside of DMTCP,
+ * and a checkpoint waits for them to exit.  The child that was forked has a
+ * virtual pid; the spawned one has only its real pid.
+ *
+ * A helper that exited before a checkpoint, but was not yet reaped, is not
+ * in the image; after restart, waitpid() fails with ECHILD for it.
+ *
+ * Usage:  untracked-helper
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+int
+main(int argc, char **argv)
+{
+  char *helperArgv[] = { "sleep", "0.05", NULL };
+  long count = 0;
+
+  while (1) {
+    pid_t pid;
+    int status;
+
+    if (count % 2 == 0) {
+      pid = fork();
+      assert(pid != -1);
+      if (pid == 0) {
+        execvp(helperArgv[0], helperArgv);
+        _exit(127);
+      }
+    } else {
+      assert(posix_spawnp(&pid, helperArgv[0], NULL, NULL,
+                          helperArgv, environ) == 0);
+    }
+
+    pid_t ret = waitpid(pid, &status, 0);
+    if (ret == -1) {
+      assert(errno == ECHILD);
+    } else {
+      assert(ret == pid);
+      assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    if (++count % 20 == 0) {
+      printf("%ld ", count);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
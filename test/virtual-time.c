@@ -0,0 +1,155 @@
+/* Check that, with DMTCP_VIRTUAL_TIME=1 (dmtcp_launch --virtual-time), the
+ * monotonic clocks don't jump forward across a checkpoint or restart, and that
+ * an interval timer (setitimer) keeps ticking.  Without DMTCP_VIRTUAL_TIME,
+ * only check that the clocks don't go backward.
+ *
+ * The loop reads the clocks every 10 ms.  A step that spans a checkpoint or
+ * restart may advance the monotonic clocks by no more than MAX_STEP_NS,
+ * however long the process was stopped (CLOCK_REALTIME shows how long).
+ * Every other step waits on a timerfd armed with an absolute CLOCK_MONOTONIC
+ * deadline, which must not expire before the (virtual) deadline.
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/timerfd.h>
+
+#include "dmtcp.h"
+
+#define MAX_STEP_NS      200000000LL
+#define MAX_TICK_GAP_NS 1000000000LL
+
+static volatile sig_atomic_t ticks = 0;
+
+static void
+handler(int sig)
+{
+  ticks++;
+}
+
+static int
+num_ckpts_and_restarts(void)
+{
+  int numCheckpoints = 0;
+  int numRestarts = 0;
+
+  dmtcp_get_local_status(&numCheckpoints, &numRestarts);
+  return numCheckpoints + numRestarts;
+}
+
+static long long
+now_ns(clockid_t clk)
+{
+  struct timespec ts;
+
+  if (clock_gettime(clk, &ts) != 0) {
+    perror("clock_gettime");
+    exit(1);
+  }
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int
+main()
+{
+  struct itimerval timer = { { 0, 50000 }, { 0, 50000 } };
+  struct timespec delay = { 0, 10000000 };
+  int virtualTime = getenv("DMTCP_VIRTUAL_TIME") != NULL &&
+                    strcmp(getenv("DMTCP_VIRTUAL_TIME"), "0") != 0;
+  long long mono = now_ns(CLOCK_MONOTONIC);
+  long long boot = now_ns(CLOCK_BOOTTIME);
+  long long real = now_ns(CLOCK_REALTIME);
+  long long lastTick = mono;
+  int lastTicks = 0;
+  int events = num_ckpts_and_restarts();
+  int stepsToCheck = 0;
+  int tfd = timerfd_create(CLOCK_MONOTONIC, 0);
+  long i;
+
+  if (tfd == -1) {
+    perror("timerfd_create");
+    return 1;
+  }
+
+  signal(SIGALRM, handler);
+  if (setitimer(ITIMER_REAL, &timer, NULL) != 0) {
+    perror("setitimer");
+    return 1;
+  }
+
+  for (i = 0;; i++) {
+    long long newMono, newBoot, newReal;
+    long long deadline = 0;
+    int newEvents;
+
+    if (i % 2 == 0) {
+      nanosleep(&delay, NULL);
+    } else {
+      struct itimerspec value = { { 0, 0 }, { 0, 0 } };
+      uint64_t expirations;
+
+      deadline = mono + delay.tv_nsec;
+      value.it_value.tv_sec = deadline / 1000000000;
+      value.it_value.tv_nsec = deadline % 1000000000;
+      if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &value, NULL) != 0 ||
+          read(tfd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        perror("timerfd");
+        return 1;
+      }
+    }
+    newMono = now_ns(CLOCK_MONOTONIC);
+    newBoot = now_ns(CLOCK_BOOTTIME);
+    newReal = now_ns(CLOCK_REALTIME);
+    if (newMono < mono || newBoot < boot) {
+      printf("monotonic clock went backward\n");
+      return 1;
+    }
+
+    // The checkpoint may have come after we read the clocks, but before we
+    // read the counters; then it is in the next step.
+    newEvents = num_ckpts_and_restarts();
+    if (newEvents == events && newMono < deadline) {
+      // A checkpoint while the timer was armed would make it expire early.
+      printf("timerfd expired %lld us before its deadline\n",
+             (deadline - newMono) / 1000);
+      return 1;
+    }
+    if (newEvents != events) {
+      events = newEvents;
+      stepsToCheck = 2;
+    }
+    if (virtualTime && stepsToCheck > 0) {
+      stepsToCheck--;
+      if (newMono - mono > MAX_STEP_NS || newBoot - boot > MAX_STEP_NS) {
+        printf("monotonic clock stepped by %lld ms across a checkpoint,"
+               " for %lld ms of real time\n",
+               (newMono - mono) / 1000000, (newReal - real) / 1000000);
+        return 1;
+      }
+    }
+    mono = newMono;
+    boot = newBoot;
+    real = newReal;
+
+    if (ticks != lastTicks) {
+      lastTicks = ticks;
+      lastTick = mono;
+    } else if (virtualTime && mono - lastTick > MAX_TICK_GAP_NS) {
+      printf("interval timer stopped\n");
+      return 1;
+    }
+
+    if (i % 100 == 0) {
+      printf("%ld s, %d ticks\n", (long)(mono / 1000000000), ticks);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+
+if test "$1" = ""; then
+  echo 'Usage:  verifydmtcp.sh <CKPT IMAGE>'
+  echo 'Example:  util/verifydmtcp.sh ckpt_dmtcp1_*.dmtcp'
+  echo 'Checks the checksums of the memory areas of a checkpoint image.'
+  echo 'Exits with status 0 if the image is intact, and 1 if not.'
+  exit 0
+fi
+
+trap 'rm -f ckpt_tmp.dmtcp' INT QUIT EXIT
+
+if file $1 | grep gzip > /dev/null; then
+  echo '***' $1 is a gzipped file.  Will uncompress it into ckpt_tmp.dmcp first.
+  gzip -dc $1 > ckpt_tmp.dmtcp || exit 1
+  set ckpt_tmp.dmtcp
+fi
+
+dir=`dirname $0`
+
+if which mtcp_restart > /dev/null 2> /dev/null; then
+  mtcp_restart --verify $1 2>&1
+  exit $?
+fi
+
+# This next one assumes that this script resides in DMTCP_ROOT/util/
+if test -x $dir/../bin/mtcp_restart; then
+  $dir/../bin/mtcp_restart --verify $1 2>&1
+  exit $?
+fi
+
+echo 'mtcp_restart not found.'
+exit 1